@@ -0,0 +1,633 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#include <algorithm>
+
+#include "async.hpp"
+
+
+/*!
+  - Asynchronous (non-blocking) point, batch, and box queries on top of a block cache (see async.hpp).  The service
+    thread never does anything more expensive than probing the cache (clm_cache_try_get) and linking the query into
+    the waiter lists of the blocks that it needs.  Reads and decompression happen in a pool of asyncThreads.
+*/
+
+
+
+//!  Land (1) or water (0) for lat, lon in the mixed block at ilat, ilon (as in clm_cache_point).
+
+static int32_t async_point_value (CLM_CACHE *cache, double lat, double lon, int32_t ilat, int32_t ilon, uint8_t *bits)
+{
+  int32_t pc = cache->clm->point_count;
+
+  int32_t row = qMin (pc - 1, (int32_t) ((lat - (double) ilat) * (double) pc));
+  int32_t col = qMin (pc - 1, (int32_t) ((lon - (double) ilon) * (double) pc));
+
+  return (clm_cache_value (cache, bits, row, col));
+}
+
+
+
+static CLM_QUERY *async_query (int32_t type, CLM_QUERY_CALLBACK callback, void *data)
+{
+  CLM_QUERY *query = (CLM_QUERY *) calloc (1, sizeof (CLM_QUERY));
+  if (query == NULL)
+    {
+      perror ("Allocating query memory");
+      exit (-1);
+    }
+
+  query->type = type;
+  query->callback = callback;
+  query->data = data;
+
+  return (query);
+}
+
+
+
+/*!
+  - Call the callback, then mark the query done and wake clm_query_wait.  The callback has to come first since a
+    caller that is waiting may free the query as soon as it's marked done (so the query is never touched after
+    that).
+*/
+
+static void async_complete (CLM_ASYNC *async, CLM_QUERY *query, uint8_t immediate)
+{
+  if (query->callback != NULL) (*query->callback) (query, query->data);
+
+  QMutexLocker locker (&async->mutex);
+
+  query->done = NVTrue;
+  if (immediate) async->immediate++;
+  async->completed.wakeAll ();
+}
+
+
+
+//!  Answer the query from the cache.  Only called in the pool (or when all of its blocks are held).
+
+static void async_answer (CLM_ASYNC *async, CLM_QUERY *query, uint8_t immediate)
+{
+  switch (query->type)
+    {
+    case CLM_QUERY_POINT:
+      query->result = clm_cache_point (async->cache, query->lat, query->lon);
+      break;
+
+    case CLM_QUERY_BATCH:
+      clm_cache_points (async->cache, query->count, query->lats, query->lons, query->results, query->order);
+      break;
+
+    case CLM_QUERY_BOX:
+      clm_cache_box (async->cache, query->south, query->west, query->north, query->east, query->cells, query->area);
+      break;
+    }
+
+  async_complete (async, query, immediate);
+}
+
+
+
+/*!
+  - Make the query wait for the num_blocks blocks (none of them twice) that weren't in the cache.  The first waiter
+    for a block queues its read, later ones just join the list.  A query that doesn't have to wait for anything is
+    put on the run queue.
+*/
+
+static void async_submit (CLM_ASYNC *async, CLM_QUERY *query, int32_t num_blocks, int32_t *blocks)
+{
+  if (num_blocks && (query->waiter = (CLM_ASYNC_WAITER *) malloc (num_blocks * sizeof (CLM_ASYNC_WAITER))) == NULL)
+    {
+      perror ("Allocating query waiter memory");
+      exit (-1);
+    }
+
+
+  QMutexLocker locker (&async->mutex);
+
+  query->pending = num_blocks;
+
+  for (int32_t i = 0 ; i < num_blocks ; i++)
+    {
+      int32_t index = blocks[i];
+      CLM_ASYNC_WAITER *waiter = &query->waiter[i];
+
+      waiter->query = query;
+      waiter->next = async->waiting[index];
+
+      if (async->waiting[index] == NULL)
+        {
+          async->reads[(async->read_head + async->read_count) % CLM_BLOCKS] = index;
+          async->read_count++;
+          async->block_reads++;
+        }
+      else
+        {
+          async->coalesced++;
+        }
+
+      async->waiting[index] = waiter;
+    }
+
+  if (!num_blocks)
+    {
+      query->next = NULL;
+
+      if (async->run_tail != NULL)
+        {
+          async->run_tail->next = query;
+        }
+      else
+        {
+          async->run_head = query;
+        }
+
+      async->run_tail = query;
+    }
+
+  async->work.wakeAll ();
+}
+
+
+
+/*!
+  - Probe the cache for the num_blocks (unique) blocks of a batch or box query.  If they're all there (and there
+    aren't so many that holding them could starve the cache) the query is answered now, while they're held so that
+    they can't be evicted.  Otherwise the query waits for the missing blocks.  blocks is overwritten.
+*/
+
+static void async_probe (CLM_ASYNC *async, CLM_QUERY *query, int32_t num_blocks, int32_t *blocks)
+{
+  uint8_t hold = (num_blocks <= async->cache->num_slots / 4);
+  int32_t misses = 0, held = 0;
+  uint8_t *bits;
+
+
+  //  Held blocks are moved to the end of the array, misses to the start.
+
+  for (int32_t i = 0 ; i < num_blocks ; i++)
+    {
+      int32_t index = blocks[i];
+      int32_t code = clm_cache_try_get (async->cache, index / 360 - 90, index % 360 - 180, &bits);
+
+      if (code == CLM_CACHE_MISS)
+        {
+          blocks[misses++] = index;
+        }
+      else if (code == CLM_MIXED)
+        {
+          if (hold)
+            {
+              held++;
+              blocks[num_blocks - held] = index;
+            }
+          else
+            {
+              clm_cache_release (async->cache, index / 360 - 90, index % 360 - 180);
+            }
+        }
+    }
+
+
+  if (hold && !misses)
+    {
+      async_answer (async, query, NVTrue);
+    }
+  else
+    {
+      async_submit (async, query, misses, blocks);
+    }
+
+
+  //  The query may have been freed by its callback by now so only our copy of the block list is used.
+
+  for (int32_t i = num_blocks - held ; i < num_blocks ; i++)
+    {
+      clm_cache_release (async->cache, blocks[i] / 360 - 90, blocks[i] % 360 - 180);
+    }
+}
+
+
+
+/*!
+  - Start num_threads pool threads for queries on cache.  The cache must stay open until clm_async_destroy.
+*/
+
+CLM_ASYNC *clm_async_create (CLM_CACHE *cache, int32_t num_threads)
+{
+  CLM_ASYNC *async = new CLM_ASYNC;
+
+  async->cache = cache;
+  async->num_threads = qMax (1, qMin (CLM_MAX_THREADS, num_threads));
+  async->read_head = async->read_count = 0;
+  async->run_head = async->run_tail = NULL;
+  async->stop = NVFalse;
+  async->immediate = async->block_reads = async->coalesced = 0;
+
+  for (int32_t i = 0 ; i < CLM_BLOCKS ; i++) async->waiting[i] = NULL;
+
+  if ((async->reads = (int32_t *) malloc (CLM_BLOCKS * sizeof (int32_t))) == NULL)
+    {
+      perror ("Allocating async read queue memory");
+      exit (-1);
+    }
+
+  async->thread = new asyncThread[async->num_threads];
+
+  for (int32_t i = 0 ; i < async->num_threads ; i++) async->thread[i].pool (async);
+
+  return (async);
+}
+
+
+
+//!  Finish everything that has been submitted and stop the pool.
+
+void clm_async_destroy (CLM_ASYNC *async)
+{
+  async->mutex.lock ();
+  async->stop = NVTrue;
+  async->work.wakeAll ();
+  async->mutex.unlock ();
+
+  for (int32_t i = 0 ; i < async->num_threads ; i++) async->thread[i].wait ();
+
+  delete[] async->thread;
+  free (async->reads);
+  delete async;
+}
+
+
+
+/*!
+  - Land (1), water (0), or undefined (-1) at lat, lon (CLM_QUERY result).  If the block is in the cache (or
+    isn't mixed) the query is done, and the callback has been called, when this returns.  If the callback frees
+    the query the returned pointer must not be used.
+*/
+
+CLM_QUERY *clm_async_point (CLM_ASYNC *async, double lat, double lon, CLM_QUERY_CALLBACK callback, void *data)
+{
+  CLM_QUERY *query = async_query (CLM_QUERY_POINT, callback, data);
+
+  query->lat = lat;
+  query->lon = lon;
+
+  if (!(lat >= -90.0 && lat <= 90.0 && lon >= -360.0 && lon <= 360.0))
+    {
+      query->result = -1;
+      async_complete (async, query, NVTrue);
+      return (query);
+    }
+
+  if (lon < -180.0) lon += 360.0;
+  if (lon >= 180.0) lon -= 360.0;
+
+  int32_t ilat = qMin (89, (int32_t) floor (lat));
+  int32_t ilon = (int32_t) floor (lon);
+
+
+  uint8_t *bits;
+  int32_t code = clm_cache_try_get (async->cache, ilat, ilon, &bits);
+
+  switch (code)
+    {
+    case CLM_CACHE_MISS:
+      {
+        int32_t index = clm_block_index (ilat, ilon);
+        async_submit (async, query, 1, &index);
+      }
+      return (query);
+
+    case CLM_UNDEFINED:
+      query->result = -1;
+      break;
+
+    case CLM_ALL_LAND:
+      query->result = 1;
+      break;
+
+    case CLM_ALL_WATER:
+      query->result = 0;
+      break;
+
+    default:
+      query->result = async_point_value (async->cache, lat, lon, ilat, ilon, bits);
+      clm_cache_release (async->cache, ilat, ilon);
+      break;
+    }
+
+  async_complete (async, query, NVTrue);
+
+  return (query);
+}
+
+
+
+/*!
+  - Land, water, or undefined for count points (see clm_cache_points, count must be less than 16777216).  lat, lon,
+    and result belong to the caller and must stay valid until the query is done.
+*/
+
+CLM_QUERY *clm_async_batch (CLM_ASYNC *async, int32_t count, double *lat, double *lon, int8_t *result,
+                            CLM_QUERY_CALLBACK callback, void *data)
+{
+  CLM_QUERY *query = async_query (CLM_QUERY_BATCH, callback, data);
+
+  query->count = count;
+  query->lats = lat;
+  query->lons = lon;
+  query->results = result;
+
+  int32_t *blocks = (int32_t *) malloc (qMax (1, count) * sizeof (int32_t));
+  if ((query->order = (uint64_t *) malloc (qMax (1, count) * sizeof (uint64_t))) == NULL || blocks == NULL)
+    {
+      perror ("Allocating batch query memory");
+      exit (-1);
+    }
+
+
+  //  Unique blocks of the points (same normalization as clm_cache_points).
+
+  int32_t n = 0;
+
+  for (int32_t i = 0 ; i < count ; i++)
+    {
+      double y = lat[i], x = lon[i];
+
+      if (!(y >= -90.0 && y <= 90.0 && x >= -360.0 && x <= 360.0)) continue;
+
+      if (x < -180.0) x += 360.0;
+      if (x >= 180.0) x -= 360.0;
+
+      blocks[n++] = clm_block_index (qMin (89, (int32_t) floor (y)), qMin (179, (int32_t) floor (x)));
+    }
+
+  std::sort (blocks, blocks + n);
+  n = (int32_t) (std::unique (blocks, blocks + n) - blocks);
+
+
+  async_probe (async, query, n, blocks);
+
+  free (blocks);
+
+  return (query);
+}
+
+
+
+/*!
+  - Land, water, and undefined cells and areas in a box (see clm_cache_box).
+*/
+
+CLM_QUERY *clm_async_box (CLM_ASYNC *async, double south, double west, double north, double east, CLM_QUERY_CALLBACK callback,
+                          void *data)
+{
+  CLM_QUERY *query = async_query (CLM_QUERY_BOX, callback, data);
+
+  query->south = south;
+  query->west = west;
+  query->north = north;
+  query->east = east;
+
+  int32_t *blocks = (int32_t *) malloc (CLM_BLOCKS * sizeof (int32_t));
+  if (blocks == NULL)
+    {
+      perror ("Allocating box query memory");
+      exit (-1);
+    }
+
+
+  //  Blocks with at least one cell center in the box (same limits as clm_cache_box), split at 180 if needed.  A
+  //  box that clm_cache_box treats as empty (NaN or out of range edges) doesn't need any.
+
+  int32_t pc = async->cache->clm->point_count, n = 0;
+  double w[2] = {west, -180.0}, e[2] = {east, east};
+
+  if (west > east) e[0] = 180.0;
+
+  if (!(south <= north && west >= -360.0 && west <= 360.0 && east >= -360.0 && east <= 360.0)) south = north = 0.0;
+
+  south = qMax (south, -90.0);
+  north = qMin (north, 90.0);
+
+  for (int32_t part = 0 ; part < (west > east ? 2 : 1) ; part++)
+    {
+      double pw = qMax (w[part], -180.0), pe = qMin (e[part], 180.0);
+
+      if (south >= north || pw >= pe) continue;
+
+      for (int32_t lat = (int32_t) floor (south) ; lat <= qMin (89, (int32_t) floor (north)) ; lat++)
+        {
+          int32_t first_row = qMax (0, (int32_t) ceil ((south - (double) lat) * (double) pc - 0.5));
+          int32_t last_row = qMin (pc - 1, (int32_t) ceil ((north - (double) lat) * (double) pc - 0.5) - 1);
+
+          if (last_row < first_row) continue;
+
+          for (int32_t lon = (int32_t) floor (pw) ; lon <= qMin (179, (int32_t) floor (pe)) ; lon++)
+            {
+              int32_t first_col = qMax (0, (int32_t) ceil ((pw - (double) lon) * (double) pc - 0.5));
+              int32_t last_col = qMin (pc - 1, (int32_t) ceil ((pe - (double) lon) * (double) pc - 0.5) - 1);
+
+              if (last_col >= first_col) blocks[n++] = clm_block_index (lat, lon);
+            }
+        }
+    }
+
+
+  //  The two parts can't overlap (west > east) but make sure anyway since a block must only be waited for once.
+
+  std::sort (blocks, blocks + n);
+  n = (int32_t) (std::unique (blocks, blocks + n) - blocks);
+
+
+  async_probe (async, query, n, blocks);
+
+  free (blocks);
+
+  return (query);
+}
+
+
+
+//!  NVTrue if the query is done (never blocks on a read).
+
+uint8_t clm_query_ready (CLM_ASYNC *async, CLM_QUERY *query)
+{
+  QMutexLocker locker (&async->mutex);
+
+  return (query->done);
+}
+
+
+
+//!  Block until the query is done (for callers that can block, and for tests).
+
+void clm_query_wait (CLM_ASYNC *async, CLM_QUERY *query)
+{
+  QMutexLocker locker (&async->mutex);
+
+  while (!query->done) async->completed.wait (&async->mutex);
+}
+
+
+
+void clm_query_free (CLM_QUERY *query)
+{
+  if (query == NULL) return;
+
+  free (query->order);
+  free (query->waiter);
+  free (query);
+}
+
+
+
+asyncThread::asyncThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+asyncThread::~asyncThread ()
+{
+}
+
+
+
+void asyncThread::pool (CLM_ASYNC *a)
+{
+  QMutexLocker locker (&mutex);
+
+  l_async = a;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+/*!
+  - Pool thread.  Queries on the run queue are answered, queued block reads are done and the queries that were
+    only waiting for that block are answered.  The block is released before they're answered so that a query that
+    needs other blocks can't tie up a cache slot while it waits for them (if it was evicted in the meantime it's
+    just read again here).  The pool only stops when there's nothing left to do.
+*/
+
+void asyncThread::run ()
+{
+  mutex.lock ();
+
+  CLM_ASYNC *async = l_async;
+
+  mutex.unlock ();
+
+
+  async->mutex.lock ();
+
+  while (1)
+    {
+      if (async->run_head != NULL)
+        {
+          CLM_QUERY *query = async->run_head;
+
+          async->run_head = query->next;
+          if (async->run_head == NULL) async->run_tail = NULL;
+
+          async->mutex.unlock ();
+
+          async_answer (async, query, NVFalse);
+
+          async->mutex.lock ();
+          continue;
+        }
+
+      if (async->read_count)
+        {
+          int32_t index = async->reads[async->read_head];
+
+          async->read_head = (async->read_head + 1) % CLM_BLOCKS;
+          async->read_count--;
+
+          async->mutex.unlock ();
+
+
+          int32_t lat = index / 360 - 90, lon = index % 360 - 180;
+          uint8_t *bits;
+
+          if (clm_cache_get (async->cache, lat, lon, &bits) == CLM_MIXED) clm_cache_release (async->cache, lat, lon);
+
+
+          //  Take the waiter list and collect the queries that aren't waiting for anything else.
+
+          async->mutex.lock ();
+
+          CLM_QUERY *ready = NULL;
+
+          for (CLM_ASYNC_WAITER *waiter = async->waiting[index] ; waiter != NULL ; waiter = waiter->next)
+            {
+              if (!--waiter->query->pending)
+                {
+                  waiter->query->next = ready;
+                  ready = waiter->query;
+                }
+            }
+
+          async->waiting[index] = NULL;
+
+          async->mutex.unlock ();
+
+
+          while (ready != NULL)
+            {
+              CLM_QUERY *query = ready;
+
+              ready = query->next;
+              async_answer (async, query, NVFalse);
+            }
+
+          async->mutex.lock ();
+          continue;
+        }
+
+      if (async->stop) break;
+
+      async->work.wait (&async->mutex);
+    }
+
+  async->mutex.unlock ();
+}
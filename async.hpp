@@ -0,0 +1,169 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#ifndef ASYNC_H
+#define ASYNC_H
+
+
+#include "cache.hpp"
+
+
+//  Query types.
+
+#define CLM_QUERY_POINT              0
+#define CLM_QUERY_BATCH              1
+#define CLM_QUERY_BOX                2
+
+
+typedef struct CLM_QUERY CLM_QUERY;
+
+typedef void (*CLM_QUERY_CALLBACK) (CLM_QUERY *query, void *data);
+
+
+//!  One of the mixed blocks that a query is waiting for (linked into the block's waiter list).
+
+typedef struct CLM_ASYNC_WAITER
+{
+  CLM_QUERY               *query;
+  struct CLM_ASYNC_WAITER *next;
+} CLM_ASYNC_WAITER;
+
+
+/*!
+  - A query submitted with clm_async_point, clm_async_batch, or clm_async_box (the "future").  The results are
+    valid once the callback is called, clm_query_ready returns NVTrue, or clm_query_wait returns.  The callback is
+    called (in whichever thread answered the query) before the query is marked done, so it must not free the
+    query.  The caller frees it with clm_query_free once clm_query_ready returns NVTrue or clm_query_wait returns.
+*/
+
+struct CLM_QUERY
+{
+  int32_t          type;                    //!<  CLM_QUERY_POINT, CLM_QUERY_BATCH, or CLM_QUERY_BOX
+  double           lat, lon;                //!<  Point
+  int32_t          result;                  //!<  Point result, 1 land, 0 water, -1 undefined
+  int32_t          count;                   //!<  Batch size
+  double           *lats, *lons;            //!<  Batch points (the caller's, must stay valid until completion)
+  int8_t           *results;                //!<  Batch results (the caller's, as in clm_cache_points)
+  uint64_t         *order;                  //!<  clm_cache_points work space
+  double           south, west, north, east; //!<  Box
+  int64_t          cells[3];                //!<  Box land, water, undefined cells (see clm_cache_box)
+  double           area[3];                 //!<  Box land, water, undefined area
+  CLM_QUERY_CALLBACK callback;
+  void             *data;                   //!<  Passed to the callback
+  int32_t          pending;                 //!<  Blocks still being read (protected by the CLM_ASYNC mutex)
+  uint8_t          done;                    //!<  Protected by the CLM_ASYNC mutex
+  CLM_ASYNC_WAITER *waiter;                 //!<  One entry for each block that had to be read
+  CLM_QUERY        *next;                   //!<  Run queue link
+};
+
+
+class asyncThread;
+
+
+/*!
+  - Non-blocking queries of a block cache.  Submitting a query never reads, decompresses, or waits for a block.
+    Queries whose blocks are all in the cache are answered right away (points) or by the pool (batches and boxes,
+    since their blocks could be evicted before they're done).  Otherwise the query is added to the waiter list of
+    each block that it needs.  The first query to wait for a block queues one read for it, the others just join
+    the list, so concurrent requests for the same block cause a single read and decompression.  A pool thread
+    reads the block into the cache and answers the queries that were only waiting for that block.
+*/
+
+typedef struct
+{
+  CLM_CACHE        *cache;
+  int32_t          num_threads;
+  asyncThread      *thread;
+  QMutex           mutex;
+  QWaitCondition   work;                    //!<  Signaled when a read or a query is queued (or on shutdown)
+  QWaitCondition   completed;               //!<  Signaled when a query is done
+  CLM_ASYNC_WAITER *waiting[CLM_BLOCKS];    //!<  Queries waiting for each block
+  int32_t          *reads;                  //!<  Circular queue of block indices to read (one entry per block at most)
+  int32_t          read_head, read_count;
+  CLM_QUERY        *run_head, *run_tail;    //!<  Queries to answer in the pool
+  uint8_t          stop;
+  int64_t          immediate;               //!<  Queries answered when they were submitted
+  int64_t          block_reads;             //!<  Reads queued
+  int64_t          coalesced;               //!<  Waits that joined a read that was already queued
+} CLM_ASYNC;
+
+
+CLM_ASYNC *clm_async_create (CLM_CACHE *cache, int32_t num_threads);
+void clm_async_destroy (CLM_ASYNC *async);
+CLM_QUERY *clm_async_point (CLM_ASYNC *async, double lat, double lon, CLM_QUERY_CALLBACK callback, void *data);
+CLM_QUERY *clm_async_batch (CLM_ASYNC *async, int32_t count, double *lat, double *lon, int8_t *result,
+                            CLM_QUERY_CALLBACK callback, void *data);
+CLM_QUERY *clm_async_box (CLM_ASYNC *async, double south, double west, double north, double east, CLM_QUERY_CALLBACK callback,
+                          void *data);
+uint8_t clm_query_ready (CLM_ASYNC *async, CLM_QUERY *query);
+void clm_query_wait (CLM_ASYNC *async, CLM_QUERY *query);
+void clm_query_free (CLM_QUERY *query);
+
+
+class asyncThread:public QThread
+{
+  Q_OBJECT 
+
+
+public:
+
+  asyncThread (QObject *parent = 0);
+  ~asyncThread ();
+
+  void pool (CLM_ASYNC *a = NULL);
+
+
+signals:
+
+
+protected:
+
+
+  QMutex           mutex;
+
+  CLM_ASYNC        *l_async;
+
+
+  void             run ();
+
+
+protected slots:
+
+private:
+};
+
+#endif
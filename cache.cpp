@@ -0,0 +1,1140 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include <algorithm>
+
+#include "cache.hpp"
+
+#ifndef NVWIN3X
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+/*!
+  - Create a cache of uncompressed blocks for clm that uses no more than max_bytes of block memory (but always
+    holds at least 16 blocks).  Block memory is allocated as it is needed.
+*/
+
+CLM_CACHE *clm_cache_create (CLM_FILE *clm, int64_t max_bytes)
+{
+  CLM_CACHE *cache = new CLM_CACHE;
+
+  cache->clm = clm;
+  cache->overlay = NULL;
+  cache->runs = NVFalse;
+  cache->max_bytes = max_bytes;
+  cache->used_bytes = 0;
+  cache->hand = 0;
+  cache->hits = cache->misses = 0;
+  cache->shared = NULL;
+
+  int64_t num_slots = max_bytes / clm->bit_size;
+  if (num_slots < 16) num_slots = 16;
+  if (num_slots > CLM_BLOCKS) num_slots = CLM_BLOCKS;
+  cache->num_slots = (int32_t) num_slots;
+
+  cache->slot = (CLM_CACHE_SLOT *) calloc (cache->num_slots, sizeof (CLM_CACHE_SLOT));
+  if (cache->slot == NULL)
+    {
+      delete cache;
+      return (NULL);
+    }
+
+  for (int32_t i = 0 ; i < cache->num_slots ; i++) cache->slot[i].index = -1;
+  for (int32_t i = 0 ; i < CLM_BLOCKS ; i++) cache->lookup[i] = -1;
+
+  return (cache);
+}
+
+
+
+/*!
+  - Create a cache that holds blocks in run-length form (see runs.hpp) instead of as packed bits, using no more
+    than max_bytes for them.  Most blocks are a lot smaller that way so many more of them fit in the same memory.
+    Points are looked up with a binary search in their row's runs and rows are counted or expanded from the runs.
+    clm_cache_get (and clm_cache_try_get) return the run form in *bits so only clm_cache_value, clm_runs_value,
+    clm_runs_get_row, and clm_runs_count can be used on it (clm_cache_point, clm_cache_points, clm_cache_box, and
+    the async queries do).
+*/
+
+CLM_CACHE *clm_cache_create_runs (CLM_FILE *clm, int64_t max_bytes)
+{
+  CLM_CACHE *cache = clm_cache_create (clm, 0);
+  if (cache == NULL) return (NULL);
+
+
+  //  Slots only cost a few bytes each so there are enough for every block that could fit (the smallest run form is
+  //  the row start table).
+
+  int64_t num_slots = max_bytes / (4 + (int64_t) (clm->point_count + 1) * 4);
+  if (num_slots < 16) num_slots = 16;
+  if (num_slots > CLM_BLOCKS) num_slots = CLM_BLOCKS;
+
+  free (cache->slot);
+
+  cache->num_slots = (int32_t) num_slots;
+  cache->runs = NVTrue;
+  cache->max_bytes = max_bytes;
+
+  cache->slot = (CLM_CACHE_SLOT *) calloc (cache->num_slots, sizeof (CLM_CACHE_SLOT));
+  if (cache->slot == NULL)
+    {
+      delete cache;
+      return (NULL);
+    }
+
+  for (int32_t i = 0 ; i < cache->num_slots ; i++) cache->slot[i].index = -1;
+
+  return (cache);
+}
+
+
+
+//!  Free the cache (the .clm file is not closed).
+
+void clm_cache_destroy (CLM_CACHE *cache)
+{
+  if (cache == NULL) return;
+
+#ifndef NVWIN3X
+  if (cache->shared != NULL)
+    {
+      for (int32_t i = 0 ; i < cache->num_private ; i++) free (cache->shared_private[i].bits);
+      free (cache->shared_private);
+
+      munmap (cache->shared, cache->shared_size);
+      delete cache;
+      return;
+    }
+#endif
+
+  for (int32_t i = 0 ; i < cache->num_slots ; i++)
+    {
+      if (cache->slot[i].bits != NULL) free (cache->slot[i].bits);
+    }
+
+  free (cache->slot);
+
+  delete cache;
+}
+
+
+
+/*!
+  - Apply the corrections in overlay to every block as it is read into the cache (so a query costs the same as
+    without an overlay, the corrections are paid for once per block read).  Blocks that the overlay doesn't touch
+    are read as they were.  The overlay must have the same resolution as the .clm file.  Set it before using the
+    cache.  Shared caches can't have an overlay (other processes may be using the same blocks without it).
+    Returns NVFalse if the overlay can't be used.
+*/
+
+int32_t clm_cache_set_overlay (CLM_CACHE *cache, CLM_OVERLAY *overlay)
+{
+  if (cache->shared != NULL || (overlay != NULL && overlay->resolution != cache->clm->resolution)) return (NVFalse);
+
+  cache->overlay = overlay;
+
+  return (NVTrue);
+}
+
+
+
+//!  Read a block for the cache, applying the overlay (if there is one).  Returns CLM_MIXED if bits was filled.
+
+static int32_t cache_read_block (CLM_CACHE *cache, int32_t lat, int32_t lon, uint8_t *bits)
+{
+  int32_t code = clm_read_block (cache->clm, lat, lon, bits);
+
+  if (cache->overlay == NULL || code < 0) return (code);
+
+
+  uint8_t *work = (uint8_t *) malloc (2 * cache->overlay->bit_size);
+  if (work == NULL)
+    {
+      perror ("Allocating overlay memory");
+      exit (-1);
+    }
+
+  code = clm_overlay_apply (cache->overlay, lat, lon, code, bits, work);
+
+  free (work);
+
+  return (code);
+}
+
+
+
+/*!
+  - Create (or attach to) a cache of uncompressed blocks for clm in the POSIX shared memory segment "name" (for
+    example "/swbd_mask_01").  The first process to use the name creates the segment with room for max_bytes of
+    blocks.  Other processes that use the same name and .clm file share it, so each block is only uncompressed
+    once on the host and then read in place (no copying) by everybody.  The slot table is lock free (see
+    clm_cache_get).  The segment stays around until it is removed (shm_unlink or rm /dev/shm/NAME) and it is an
+    error to attach to it with a different .clm file.  Returns NULL on error (check errno).
+*/
+
+CLM_CACHE *clm_cache_create_shared (CLM_FILE *clm, const char *name, int64_t max_bytes)
+{
+#ifdef NVWIN3X
+
+  errno = ENOSYS;
+  return (NULL);
+
+#else
+
+  struct stat st;
+  if (stat (clm->path, &st)) return (NULL);
+
+
+  int64_t num_slots = max_bytes / clm->bit_size;
+  if (num_slots < 16) num_slots = 16;
+  if (num_slots > CLM_BLOCKS) num_slots = CLM_BLOCKS;
+
+
+  //  Try to create it.  If somebody else already has, wait for them to finish setting it up.
+
+  uint8_t created = NVTrue;
+  int32_t fd = shm_open (name, O_RDWR | O_CREAT | O_EXCL, 0666);
+
+  if (fd < 0)
+    {
+      if (errno != EEXIST) return (NULL);
+
+      created = NVFalse;
+      if ((fd = shm_open (name, O_RDWR, 0666)) < 0) return (NULL);
+    }
+
+
+  CLM_SHARED_HEADER *header;
+  int64_t size;
+
+  if (created)
+    {
+      size = sizeof (CLM_SHARED_HEADER) + num_slots * (sizeof (uint64_t) + sizeof (int32_t));
+      size = ((size + 63) / 64) * 64 + num_slots * clm->bit_size;
+
+      if (ftruncate (fd, size))
+        {
+          close (fd);
+          shm_unlink (name);
+          return (NULL);
+        }
+    }
+  else
+    {
+      //  The creator might not have set the size yet.
+
+      for (int32_t i = 0 ; i < 10000 ; i++)
+        {
+          if (fstat (fd, &st))
+            {
+              close (fd);
+              return (NULL);
+            }
+
+          if (st.st_size >= (off_t) sizeof (CLM_SHARED_HEADER)) break;
+
+          usleep (1000);
+        }
+
+      size = st.st_size;
+    }
+
+
+  header = (CLM_SHARED_HEADER *) mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+
+  if (header == MAP_FAILED) return (NULL);
+
+
+  if (created)
+    {
+      stat (clm->path, &st);
+
+      header->resolution = clm->resolution;
+      header->bit_size = clm->bit_size;
+      header->num_slots = (int32_t) num_slots;
+      header->file_size = st.st_size;
+      header->file_time = st.st_mtime;
+      header->hand = 0;
+
+      for (int32_t i = 0 ; i < CLM_BLOCKS ; i++) header->lookup[i] = -1;
+
+      __atomic_store_n (&header->magic, CLM_SHARED_MAGIC, __ATOMIC_RELEASE);
+    }
+  else
+    {
+      for (int32_t i = 0 ; i < 10000 && __atomic_load_n (&header->magic, __ATOMIC_ACQUIRE) != CLM_SHARED_MAGIC ; i++)
+        usleep (1000);
+
+      stat (clm->path, &st);
+
+      if (__atomic_load_n (&header->magic, __ATOMIC_ACQUIRE) != CLM_SHARED_MAGIC || header->resolution != clm->resolution ||
+          header->bit_size != clm->bit_size || header->file_size != st.st_size || header->file_time != st.st_mtime)
+        {
+          fprintf (stderr, "Shared memory cache %s was not made for %s\n", name, clm->path);
+          munmap (header, size);
+          errno = EINVAL;
+          return (NULL);
+        }
+    }
+
+
+  CLM_CACHE *cache = new CLM_CACHE;
+
+  cache->clm = clm;
+  cache->overlay = NULL;
+  cache->runs = NVFalse;
+  cache->max_bytes = max_bytes;
+  cache->used_bytes = 0;
+  cache->num_slots = header->num_slots;
+  cache->hand = 0;
+  cache->slot = NULL;
+  cache->hits = cache->misses = 0;
+  cache->shared = header;
+  cache->shared_size = size;
+  cache->shared_slot = (uint64_t *) &header[1];
+  cache->shared_owner = (int32_t *) &cache->shared_slot[cache->num_slots];
+  cache->shared_private = NULL;
+  cache->num_private = 0;
+
+  int64_t data_offset = sizeof (CLM_SHARED_HEADER) + cache->num_slots * (sizeof (uint64_t) + sizeof (int32_t));
+  cache->shared_data = (uint8_t *) header + ((data_offset + 63) / 64) * 64;
+
+  return (cache);
+
+#endif
+}
+
+
+
+#ifndef NVWIN3X
+
+//!  NVTrue if the process that is reading a block into shared slot s no longer exists.
+
+static uint8_t shared_owner_gone (CLM_CACHE *cache, int32_t s)
+{
+  pid_t pid = (pid_t) __atomic_load_n (&cache->shared_owner[s], __ATOMIC_ACQUIRE);
+
+  return (pid > 0 && kill (pid, 0) && errno == ESRCH);
+}
+
+
+
+//!  Read a block into private memory for the calling thread (see shared_get).  It's freed by clm_cache_release.
+
+static uint8_t *shared_private_get (CLM_CACHE *cache, int32_t index)
+{
+  uint8_t *bits = (uint8_t *) malloc (cache->clm->bit_size);
+  if (bits == NULL)
+    {
+      perror ("Allocating private block memory");
+      exit (-1);
+    }
+
+  if (clm_read_block (cache->clm, index / 360 - 90, index % 360 - 180, bits) != CLM_MIXED)
+    {
+      fprintf (stderr, "\nError reading block %d %d from %s\n", index / 360 - 90, index % 360 - 180, cache->clm->path);
+      exit (-1);
+    }
+
+
+  QMutexLocker locker (&cache->mutex);
+
+  CLM_SHARED_PRIVATE *p = (CLM_SHARED_PRIVATE *) realloc (cache->shared_private, (cache->num_private + 1) *
+                                                          sizeof (CLM_SHARED_PRIVATE));
+  if (p == NULL)
+    {
+      perror ("Allocating private block memory");
+      exit (-1);
+    }
+
+  cache->shared_private = p;
+  p[cache->num_private].index = index;
+  p[cache->num_private].thread = pthread_self ();
+  p[cache->num_private].bits = bits;
+
+  __atomic_store_n (&cache->num_private, cache->num_private + 1, __ATOMIC_RELEASE);
+  __atomic_fetch_add (&cache->misses, 1, __ATOMIC_RELAXED);
+
+  return (bits);
+}
+
+
+
+/*!
+  - clm_cache_get for a shared memory cache.  Nothing is locked.  A reader takes a reference to a slot by
+    incrementing the count in the slot word with a compare and swap that only succeeds if the slot still holds
+    the block and the block is ready.  A slot can only be taken for another block by a compare and swap that
+    only succeeds if nobody holds it, so the two can't both happen.  Whoever takes a slot for a block publishes it
+    in the lookup table, reads the block into it, and then sets the ready flag.  Anybody else that wants the
+    block waits for that flag instead of reading the block again.  If two processes take slots for the same
+    block at the same time the one that loses the race to publish gives its slot back.
+  - A process that dies while it's reading a block would leave the slot claimed but never ready, so the reader
+    records its process ID and the waiters take the slot back if that process is gone.  References that a dead
+    process never released can't be told apart from live ones, so if no slot comes free for CLM_SHARED_TIMEOUT
+    milliseconds the block is read into private memory for this thread instead of waiting forever.
+*/
+
+static uint8_t *shared_get (CLM_CACHE *cache, int32_t index)
+{
+  CLM_SHARED_HEADER *header = cache->shared;
+  int32_t num_slots = header->num_slots;
+  uint64_t key = (uint64_t) (index + 1) << 32;
+  int32_t spins = 0;
+  QElapsedTimer timer;
+
+  timer.start ();
+
+  while (1)
+    {
+      int32_t s = __atomic_load_n (&header->lookup[index], __ATOMIC_ACQUIRE);
+
+
+      //  Hit (or it is being read by somebody else).
+
+      if (s >= 0)
+        {
+          uint64_t *word = &cache->shared_slot[s];
+          uint64_t w = __atomic_load_n (word, __ATOMIC_ACQUIRE);
+
+          if ((w & ~0xffffffffULL) == key)
+            {
+              if (!(w & CLM_SHARED_READY))
+                {
+                  //  Check on the reader now and then.  If it died take the slot back (and unpublish it).
+
+                  if (!(++spins % 1000) && shared_owner_gone (cache, s) &&
+                      __atomic_compare_exchange_n (word, &w, 0, NVFalse, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                    {
+                      int32_t expected = s;
+                      __atomic_compare_exchange_n (&header->lookup[index], &expected, -1, NVFalse, __ATOMIC_ACQ_REL,
+                                                   __ATOMIC_ACQUIRE);
+                    }
+
+                  sched_yield ();
+                  continue;
+                }
+
+              if (__atomic_compare_exchange_n (word, &w, (w + 1) | CLM_SHARED_REFERENCED, NVFalse, __ATOMIC_ACQ_REL,
+                                               __ATOMIC_ACQUIRE))
+                {
+                  __atomic_fetch_add (&cache->hits, 1, __ATOMIC_RELAXED);
+                  return (cache->shared_data + (int64_t) s * header->bit_size);
+                }
+
+              continue;
+            }
+        }
+
+
+      //  Miss.  Take a slot that nobody is using with the clock (second chance) algorithm.
+
+      int32_t victim = -1;
+      uint64_t old = 0;
+
+      for (int32_t i = 0 ; i < 2 * num_slots && victim < 0 ; i++)
+        {
+          int32_t h = __atomic_fetch_add (&header->hand, 1, __ATOMIC_RELAXED) % num_slots;
+          uint64_t *word = &cache->shared_slot[h];
+          uint64_t w = __atomic_load_n (word, __ATOMIC_ACQUIRE);
+
+          if (w & CLM_SHARED_REFS) continue;
+          if ((w >> 32) && !(w & CLM_SHARED_READY)) continue;
+
+          if (w & CLM_SHARED_REFERENCED)
+            {
+              __atomic_compare_exchange_n (word, &w, w & ~CLM_SHARED_REFERENCED, NVFalse, __ATOMIC_ACQ_REL,
+                                           __ATOMIC_ACQUIRE);
+              continue;
+            }
+
+          if (__atomic_compare_exchange_n (word, &w, key | CLM_SHARED_REFERENCED | 1, NVFalse, __ATOMIC_ACQ_REL,
+                                           __ATOMIC_ACQUIRE))
+            {
+              victim = h;
+              old = w;
+            }
+        }
+
+
+      //  Everything is in use.  If that goes on for too long (references leaked by a process that died) read the
+      //  block privately.
+
+      if (victim < 0)
+        {
+          if (timer.elapsed () > CLM_SHARED_TIMEOUT) return (shared_private_get (cache, index));
+
+          sched_yield ();
+          continue;
+        }
+
+
+      //  Nobody can wait on the slot until it's published below so the owner is always set by then.
+
+      __atomic_store_n (&cache->shared_owner[victim], (int32_t) getpid (), __ATOMIC_RELEASE);
+
+
+      //  Unpublish the block that used to be in the slot.
+
+      if (old >> 32)
+        {
+          int32_t expected = victim;
+          __atomic_compare_exchange_n (&header->lookup[(old >> 32) - 1], &expected, -1, NVFalse, __ATOMIC_ACQ_REL,
+                                       __ATOMIC_ACQUIRE);
+        }
+
+
+      //  Publish ours unless somebody beat us to it.
+
+      int32_t current = __atomic_load_n (&header->lookup[index], __ATOMIC_ACQUIRE);
+      uint8_t published = NVFalse;
+
+      while (1)
+        {
+          if (current >= 0 && current != victim &&
+              (__atomic_load_n (&cache->shared_slot[current], __ATOMIC_ACQUIRE) & ~0xffffffffULL) == key) break;
+
+          if (__atomic_compare_exchange_n (&header->lookup[index], &current, victim, NVFalse, __ATOMIC_ACQ_REL,
+                                           __ATOMIC_ACQUIRE))
+            {
+              published = NVTrue;
+              break;
+            }
+        }
+
+      if (!published)
+        {
+          __atomic_store_n (&cache->shared_slot[victim], 0, __ATOMIC_RELEASE);
+          continue;
+        }
+
+
+      uint8_t *bits = cache->shared_data + (int64_t) victim * header->bit_size;
+
+      int32_t lat = index / 360 - 90;
+      int32_t lon = index % 360 - 180;
+
+      if (clm_read_block (cache->clm, lat, lon, bits) != CLM_MIXED)
+        {
+          //  Give the slot back so that the other processes don't wait for it forever.
+
+          int32_t expected = victim;
+          __atomic_compare_exchange_n (&header->lookup[index], &expected, -1, NVFalse, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+          __atomic_store_n (&cache->shared_slot[victim], 0, __ATOMIC_RELEASE);
+
+          fprintf (stderr, "\nError reading block %d %d from %s\n", lat, lon, cache->clm->path);
+          exit (-1);
+        }
+
+      __atomic_fetch_or (&cache->shared_slot[victim], CLM_SHARED_READY, __ATOMIC_RELEASE);
+      __atomic_fetch_add (&cache->misses, 1, __ATOMIC_RELAXED);
+
+      return (bits);
+    }
+}
+
+#endif
+
+
+
+/*!
+  - Drop blocks from a run-length cache (with the clock algorithm) until the run forms fit in max_bytes again.
+    Blocks that are in use or being read are skipped so this may leave it over budget until they're released.
+    The cache mutex must be held.
+*/
+
+static void cache_trim (CLM_CACHE *cache)
+{
+  for (int32_t i = 0 ; i < 2 * cache->num_slots && cache->used_bytes > cache->max_bytes ; i++)
+    {
+      CLM_CACHE_SLOT *slot = &cache->slot[cache->hand];
+
+      cache->hand = (cache->hand + 1) % cache->num_slots;
+
+      if (slot->index < 0 || slot->refs || slot->loading) continue;
+
+      if (slot->referenced)
+        {
+          slot->referenced = NVFalse;
+          continue;
+        }
+
+      cache->lookup[slot->index] = -1;
+      slot->index = -1;
+
+      free (slot->bits);
+      slot->bits = NULL;
+      cache->used_bytes -= slot->size;
+      slot->size = 0;
+    }
+}
+
+
+
+/*!
+  - Get the block whose southwest corner is at lat, lon.  Returns the map code (CLM_UNDEFINED, CLM_ALL_LAND,
+    CLM_ALL_WATER, or CLM_MIXED).  For mixed blocks *bits is set to the uncompressed block (the run form in a
+    run-length cache) which stays valid until clm_cache_release is called for the block.
+*/
+
+int32_t clm_cache_get (CLM_CACHE *cache, int32_t lat, int32_t lon, uint8_t **bits)
+{
+  uint32_t address = clm_block_address (cache->clm, lat, lon, NULL);
+
+
+  //  An overlay can replace the whole block or make a uniform block mixed (undefined blocks stay undefined).
+
+  if (cache->overlay != NULL)
+    {
+      int32_t override = clm_overlay_code (cache->overlay, lat, lon);
+
+      if (override == CLM_ALL_LAND || override == CLM_ALL_WATER) return (override);
+
+      if (override == CLM_MIXED && address != CLM_UNDEFINED) address = CLM_MIXED;
+    }
+
+  if (address <= CLM_ALL_WATER) return ((int32_t) address);
+
+
+  int32_t index = clm_block_index (lat, lon);
+
+#ifndef NVWIN3X
+  if (cache->shared != NULL)
+    {
+      *bits = shared_get (cache, index);
+      return (CLM_MIXED);
+    }
+#endif
+
+
+  QMutexLocker locker (&cache->mutex);
+
+  while (1)
+    {
+      int32_t s = cache->lookup[index];
+
+
+      //  Already in the cache (or being read by somebody else).
+
+      if (s >= 0)
+        {
+          if (cache->slot[s].loading)
+            {
+              cache->loaded.wait (&cache->mutex);
+              continue;
+            }
+
+          cache->slot[s].refs++;
+          cache->slot[s].referenced = NVTrue;
+          cache->hits++;
+
+          *bits = cache->slot[s].bits;
+          return (CLM_MIXED);
+        }
+
+
+      //  Find a slot that isn't in use with the clock (second chance) algorithm.
+
+      int32_t victim = -1;
+
+      for (int32_t i = 0 ; i < 2 * cache->num_slots ; i++)
+        {
+          CLM_CACHE_SLOT *slot = &cache->slot[cache->hand];
+          int32_t h = cache->hand;
+
+          cache->hand = (cache->hand + 1) % cache->num_slots;
+
+          if (slot->refs || slot->loading) continue;
+
+          if (slot->referenced)
+            {
+              slot->referenced = NVFalse;
+              continue;
+            }
+
+          victim = h;
+          break;
+        }
+
+
+      //  Everything is in use so wait for something to be released.
+
+      if (victim < 0)
+        {
+          cache->loaded.wait (&cache->mutex);
+          continue;
+        }
+
+
+      CLM_CACHE_SLOT *slot = &cache->slot[victim];
+
+      if (slot->index >= 0) cache->lookup[slot->index] = -1;
+
+
+      //  Run forms are all different sizes so the old one is dropped (the new one is allocated when it's built).
+
+      if (cache->runs)
+        {
+          free (slot->bits);
+          slot->bits = NULL;
+          cache->used_bytes -= slot->size;
+          slot->size = 0;
+        }
+      else if (slot->bits == NULL && (slot->bits = (uint8_t *) malloc (cache->clm->bit_size)) == NULL)
+        {
+          perror ("Allocating cache block memory");
+          exit (-1);
+        }
+
+      slot->index = index;
+      slot->refs = 1;
+      slot->loading = NVTrue;
+      slot->referenced = NVTrue;
+      cache->lookup[index] = victim;
+      cache->misses++;
+
+
+      //  Read the block without holding the lock.
+
+      locker.unlock ();
+
+      int32_t code, size = 0;
+      uint8_t *runs = NULL;
+
+      if (cache->runs)
+        {
+          uint8_t *bits = (uint8_t *) malloc (cache->clm->bit_size);
+          if (bits == NULL)
+            {
+              perror ("Allocating cache block memory");
+              exit (-1);
+            }
+
+          if ((code = cache_read_block (cache, lat, lon, bits)) == CLM_MIXED && (runs = clm_runs_encode (cache->clm, bits, &size)) == NULL)
+            {
+              perror ("Allocating cache run memory");
+              exit (-1);
+            }
+
+          free (bits);
+        }
+      else
+        {
+          code = cache_read_block (cache, lat, lon, slot->bits);
+        }
+
+      locker.relock ();
+
+      if (code != CLM_MIXED)
+        {
+          fprintf (stderr, "\nError reading block %d %d from %s\n", lat, lon, cache->clm->path);
+          exit (-1);
+        }
+
+      if (cache->runs)
+        {
+          slot->bits = runs;
+          slot->size = size;
+          cache->used_bytes += size;
+          cache_trim (cache);
+        }
+
+      slot->loading = NVFalse;
+      cache->loaded.wakeAll ();
+
+      *bits = slot->bits;
+      return (CLM_MIXED);
+    }
+}
+
+
+
+/*!
+  - Same as clm_cache_get but never reads a block or waits for one that somebody else is reading.  Returns
+    CLM_CACHE_MISS (and leaves *bits alone) if the block is mixed and isn't ready in the cache.
+*/
+
+int32_t clm_cache_try_get (CLM_CACHE *cache, int32_t lat, int32_t lon, uint8_t **bits)
+{
+  uint32_t address = clm_block_address (cache->clm, lat, lon, NULL);
+
+  if (cache->overlay != NULL)
+    {
+      int32_t override = clm_overlay_code (cache->overlay, lat, lon);
+
+      if (override == CLM_ALL_LAND || override == CLM_ALL_WATER) return (override);
+
+      if (override == CLM_MIXED && address != CLM_UNDEFINED) address = CLM_MIXED;
+    }
+
+  if (address <= CLM_ALL_WATER) return ((int32_t) address);
+
+
+  int32_t index = clm_block_index (lat, lon);
+
+#ifndef NVWIN3X
+  if (cache->shared != NULL)
+    {
+      CLM_SHARED_HEADER *header = cache->shared;
+      uint64_t key = (uint64_t) (index + 1) << 32;
+
+      while (1)
+        {
+          int32_t s = __atomic_load_n (&header->lookup[index], __ATOMIC_ACQUIRE);
+          if (s < 0) return (CLM_CACHE_MISS);
+
+          uint64_t *word = &cache->shared_slot[s];
+          uint64_t w = __atomic_load_n (word, __ATOMIC_ACQUIRE);
+
+          if ((w & ~0xffffffffULL) != key || !(w & CLM_SHARED_READY)) return (CLM_CACHE_MISS);
+
+          if (__atomic_compare_exchange_n (word, &w, (w + 1) | CLM_SHARED_REFERENCED, NVFalse, __ATOMIC_ACQ_REL,
+                                           __ATOMIC_ACQUIRE))
+            {
+              __atomic_fetch_add (&cache->hits, 1, __ATOMIC_RELAXED);
+              *bits = cache->shared_data + (int64_t) s * header->bit_size;
+              return (CLM_MIXED);
+            }
+        }
+    }
+#endif
+
+
+  QMutexLocker locker (&cache->mutex);
+
+  int32_t s = cache->lookup[index];
+
+  if (s < 0 || cache->slot[s].loading) return (CLM_CACHE_MISS);
+
+  cache->slot[s].refs++;
+  cache->slot[s].referenced = NVTrue;
+  cache->hits++;
+
+  *bits = cache->slot[s].bits;
+  return (CLM_MIXED);
+}
+
+
+
+//!  Let go of a mixed block that was returned by clm_cache_get.
+
+void clm_cache_release (CLM_CACHE *cache, int32_t lat, int32_t lon)
+{
+#ifndef NVWIN3X
+  if (cache->shared != NULL)
+    {
+      int32_t index = clm_block_index (lat, lon);
+
+
+      //  A private copy read by this thread (almost never, so the mutex is only taken if there are any).
+
+      if (__atomic_load_n (&cache->num_private, __ATOMIC_ACQUIRE))
+        {
+          QMutexLocker locker (&cache->mutex);
+
+          for (int32_t i = 0 ; i < cache->num_private ; i++)
+            {
+              if (cache->shared_private[i].index == index && pthread_equal (cache->shared_private[i].thread, pthread_self ()))
+                {
+                  free (cache->shared_private[i].bits);
+                  cache->shared_private[i] = cache->shared_private[cache->num_private - 1];
+                  __atomic_store_n (&cache->num_private, cache->num_private - 1, __ATOMIC_RELEASE);
+                  return;
+                }
+            }
+        }
+
+      int32_t s = __atomic_load_n (&cache->shared->lookup[index], __ATOMIC_ACQUIRE);
+
+      __atomic_fetch_sub (&cache->shared_slot[s], 1, __ATOMIC_ACQ_REL);
+      return;
+    }
+#endif
+
+  QMutexLocker locker (&cache->mutex);
+
+  int32_t s = cache->lookup[clm_block_index (lat, lon)];
+
+  if (s >= 0 && cache->slot[s].refs > 0)
+    {
+      cache->slot[s].refs--;
+      if (!cache->slot[s].refs) cache->loaded.wakeAll ();
+    }
+}
+
+
+
+//!  Land (1) or water (0) at row, col of a mixed block returned by clm_cache_get (packed bits or run form).
+
+int32_t clm_cache_value (CLM_CACHE *cache, uint8_t *bits, int32_t row, int32_t col)
+{
+  if (cache->runs) return (clm_runs_value (cache->clm, bits, row, col));
+
+  return (bit_unpack (bits, row * cache->clm->point_count + col, 1));
+}
+
+
+
+//!  Land (1), water (0), or undefined (-1) at lat, lon (which may be from -360 to 360).  NaN is undefined.
+
+int32_t clm_cache_point (CLM_CACHE *cache, double lat, double lon)
+{
+  if (!(lat >= -90.0 && lat <= 90.0 && lon >= -360.0 && lon <= 360.0)) return (-1);
+
+  if (lon < -180.0) lon += 360.0;
+  if (lon >= 180.0) lon -= 360.0;
+
+
+  int32_t pc = cache->clm->point_count;
+  int32_t ilat = (int32_t) floor (lat);
+  int32_t ilon = (int32_t) floor (lon);
+  if (ilat > 89) ilat = 89;
+
+  uint8_t *bits;
+  int32_t code = clm_cache_get (cache, ilat, ilon, &bits);
+
+  switch (code)
+    {
+    case CLM_UNDEFINED:
+      return (-1);
+
+    case CLM_ALL_LAND:
+      return (1);
+
+    case CLM_ALL_WATER:
+      return (0);
+    }
+
+
+  int32_t row = (int32_t) ((lat - (double) ilat) * (double) pc);
+  int32_t col = (int32_t) ((lon - (double) ilon) * (double) pc);
+  if (row >= pc) row = pc - 1;
+  if (col >= pc) col = pc - 1;
+
+  int32_t land = clm_cache_value (cache, bits, row, col);
+
+  clm_cache_release (cache, ilat, ilon);
+
+  return (land);
+}
+
+
+
+/*!
+  - Land (1), water (0), or undefined (-1) for count points.  The queries are sorted by block and row first so that
+    each block is only looked up (and held) once no matter what order the points are in.  "order" is work space for
+    count 64 bit values.  count must be less than 16777216.
+*/
+
+void clm_cache_points (CLM_CACHE *cache, int32_t count, double *lat, double *lon, int8_t *result, uint64_t *order)
+{
+  int32_t pc = cache->clm->point_count, n = 0;
+
+
+  //  Sort key is block index (17 bits), row (12 bits), point index (24 bits).
+
+  for (int32_t i = 0 ; i < count ; i++)
+    {
+      double y = lat[i], x = lon[i];
+
+      if (!(y >= -90.0 && y <= 90.0 && x >= -360.0 && x <= 360.0))
+        {
+          result[i] = -1;
+          continue;
+        }
+
+      if (x < -180.0) x += 360.0;
+      if (x >= 180.0) x -= 360.0;
+
+      int32_t ilat = qMin (89, (int32_t) floor (y));
+      int32_t ilon = qMin (179, (int32_t) floor (x));
+      int32_t row = qMin (pc - 1, (int32_t) ((y - (double) ilat) * (double) pc));
+
+      order[n++] = ((uint64_t) clm_block_index (ilat, ilon) << 36) | ((uint64_t) row << 24) | (uint64_t) i;
+    }
+
+  std::sort (order, order + n);
+
+
+  for (int32_t i = 0 ; i < n ; )
+    {
+      int32_t index = (int32_t) (order[i] >> 36);
+      int32_t ilat = index / 360 - 90, ilon = index % 360 - 180;
+
+      uint8_t *bits;
+      int32_t code = clm_cache_get (cache, ilat, ilon, &bits);
+      int8_t value = (code == CLM_ALL_LAND) ? 1 : (code == CLM_ALL_WATER) ? 0 : -1;
+
+      for ( ; i < n && (int32_t) (order[i] >> 36) == index ; i++)
+        {
+          int32_t p = (int32_t) (order[i] & 0xffffff);
+
+          if (code == CLM_MIXED)
+            {
+              double x = lon[p];
+              if (x < -180.0) x += 360.0;
+              if (x >= 180.0) x -= 360.0;
+
+              int32_t row = (int32_t) ((order[i] >> 24) & 0xfff);
+              int32_t col = qMin (pc - 1, (int32_t) ((x - (double) ilon) * (double) pc));
+
+              result[p] = clm_cache_value (cache, bits, row, col);
+            }
+          else
+            {
+              result[p] = value;
+            }
+        }
+
+      if (code == CLM_MIXED) clm_cache_release (cache, ilat, ilon);
+    }
+}
+
+
+/*!
+  - Count the land (cells[0], area[0]), water (cells[1], area[1]), and undefined (cells[2], area[2]) cells whose
+    centers are in the box from south, west to north, east.  Areas are in square kilometers.  If west is greater
+    than east the box crosses the 180 degree meridian.  Boxes with NaN (or infinite, or beyond 360 degree)
+    longitudes are empty.
+*/
+
+void clm_cache_box (CLM_CACHE *cache, double south, double west, double north, double east, int64_t *cells,
+                    double *area)
+{
+  for (int32_t i = 0 ; i < 3 ; i++)
+    {
+      cells[i] = 0;
+      area[i] = 0.0;
+    }
+
+  if (!(south <= north && west >= -360.0 && west <= 360.0 && east >= -360.0 && east <= 360.0)) return;
+
+  south = qMax (south, -90.0);
+  north = qMin (north, 90.0);
+
+  if (west > east)
+    {
+      int64_t c[3];
+      double a[3];
+
+      clm_cache_box (cache, south, west, north, 180.0, cells, area);
+      clm_cache_box (cache, south, -180.0, north, east, c, a);
+
+      for (int32_t i = 0 ; i < 3 ; i++)
+        {
+          cells[i] += c[i];
+          area[i] += a[i];
+        }
+
+      return;
+    }
+
+  west = qMax (west, -180.0);
+  east = qMin (east, 180.0);
+
+  if (south >= north || west >= east) return;
+
+
+  int32_t pc = cache->clm->point_count;
+  uint64_t words[CLM_MAX_ROW_WORDS];
+
+  for (int32_t lat = (int32_t) floor (south) ; lat <= qMin (89, (int32_t) floor (north)) ; lat++)
+    {
+      //  Rows and columns whose centers are in the box (as in fill_span_cells).
+
+      int32_t first_row = qMax (0, (int32_t) ceil ((south - (double) lat) * (double) pc - 0.5));
+      int32_t last_row = qMin (pc - 1, (int32_t) ceil ((north - (double) lat) * (double) pc - 0.5) - 1);
+
+      for (int32_t lon = (int32_t) floor (west) ; lon <= qMin (179, (int32_t) floor (east)) ; lon++)
+        {
+          int32_t first_col = qMax (0, (int32_t) ceil ((west - (double) lon) * (double) pc - 0.5));
+          int32_t last_col = qMin (pc - 1, (int32_t) ceil ((east - (double) lon) * (double) pc - 0.5) - 1);
+
+          if (last_row < first_row || last_col < first_col) continue;
+
+
+          uint8_t *bits;
+          int32_t code = clm_cache_get (cache, lat, lon, &bits);
+          int32_t width = last_col - first_col + 1;
+
+          for (int32_t row = first_row ; row <= last_row ; row++)
+            {
+              double cell_area = clm_cell_area (cache->clm, lat, row);
+              int32_t land = 0;
+
+              switch (code)
+                {
+                case CLM_UNDEFINED:
+                  cells[2] += width;
+                  area[2] += cell_area * (double) width;
+                  continue;
+
+                case CLM_ALL_LAND:
+                  land = width;
+                  break;
+
+                case CLM_ALL_WATER:
+                  land = 0;
+                  break;
+
+                default:
+                  if (cache->runs)
+                    {
+                      land = clm_runs_count (cache->clm, bits, row, first_col, last_col + 1);
+                    }
+                  else
+                    {
+                      clm_get_row (cache->clm, bits, row, words);
+                      land = clm_count_bits (words, first_col, last_col + 1);
+                    }
+                  break;
+                }
+
+              cells[0] += land;
+              cells[1] += width - land;
+              area[0] += cell_area * (double) land;
+              area[1] += cell_area * (double) (width - land);
+            }
+
+          if (code == CLM_MIXED) clm_cache_release (cache, lat, lon);
+        }
+    }
+}
@@ -0,0 +1,161 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef CACHE_H
+#define CACHE_H
+
+
+#include "clm.hpp"
+#include "overlay.hpp"
+#include "runs.hpp"
+
+#ifndef NVWIN3X
+#include <pthread.h>
+#endif
+
+
+//!  Returned by clm_cache_try_get for a mixed block that would have to be read (or waited for).
+
+#define CLM_CACHE_MISS               -1
+
+
+//!  A cached, uncompressed block.
+
+typedef struct
+{
+  int32_t          index;                   //!<  Block index (clm_block_index) or -1 if empty
+  int32_t          refs;                    //!<  Number of users holding the block
+  uint8_t          loading;                 //!<  NVTrue while the block is being read
+  uint8_t          referenced;              //!<  Clock (second chance) replacement flag
+  uint8_t          *bits;                   //!<  Packed bits or, in a run-length cache, the run form (runs.hpp)
+  int32_t          size;                    //!<  Size of the run form (run-length cache only)
+} CLM_CACHE_SLOT;
+
+
+/*!
+  - Header of a cross-process (POSIX shared memory) cache.  It is followed by num_slots 64 bit slot words, then
+    num_slots process IDs (the process that is reading the block into each slot), and then the block data.  A slot
+    word holds the block index + 1 (0 if the slot is empty) in the upper 32 bits, then the CLM_SHARED_READY and
+    CLM_SHARED_REFERENCED flags, then the reference count.  Slot words and lookup entries are only changed with
+    atomic operations.
+*/
+
+#define CLM_SHARED_MAGIC             0x434c4d44
+#define CLM_SHARED_READY             0x80000000ULL
+#define CLM_SHARED_REFERENCED        0x40000000ULL
+#define CLM_SHARED_REFS              0x3fffffffULL
+
+
+//!  Milliseconds to wait for a shared slot to come free before reading the block into private memory instead.
+
+#define CLM_SHARED_TIMEOUT           1000
+
+typedef struct
+{
+  uint32_t         magic;                   //!<  Set to CLM_SHARED_MAGIC (last) by the process that creates it
+  int32_t          resolution;
+  int32_t          bit_size;
+  int32_t          num_slots;
+  int64_t          file_size;               //!<  Size of the .clm file the cache was created for
+  int64_t          file_time;               //!<  Modification time of the .clm file the cache was created for
+  uint32_t         hand;                    //!<  Clock hand
+  int32_t          lookup[CLM_BLOCKS];      //!<  Slot holding each block or -1
+} CLM_SHARED_HEADER;
+
+
+#ifndef NVWIN3X
+
+//!  Private copy of a block that one thread read because every slot of the shared cache stayed in use.
+
+typedef struct
+{
+  int32_t          index;
+  pthread_t        thread;                  //!<  Thread that read it (and will release it)
+  uint8_t          *bits;
+} CLM_SHARED_PRIVATE;
+
+#endif
+
+
+/*!
+  - Shared cache of uncompressed blocks for a .clm file.  Any number of threads may get blocks from the cache.
+    A block that is being read by one thread is waited for (not read again) by the others.  If "shared" is set
+    the blocks live in a POSIX shared memory segment that other processes can use at the same time.
+*/
+
+typedef struct
+{
+  CLM_FILE         *clm;
+  CLM_OVERLAY      *overlay;                 //!<  Corrections applied to blocks as they are read or NULL
+  uint8_t          runs;                    //!<  NVTrue if blocks are held in run-length form (clm_cache_create_runs)
+  int64_t          max_bytes;               //!<  Run-length cache memory budget
+  int64_t          used_bytes;              //!<  Memory used by the run forms in the cache
+  int32_t          num_slots;
+  int32_t          hand;                    //!<  Clock hand
+  CLM_CACHE_SLOT   *slot;
+  int32_t          lookup[CLM_BLOCKS];      //!<  Slot holding each block or -1
+  int64_t          hits;
+  int64_t          misses;
+  QMutex           mutex;
+  QWaitCondition   loaded;
+  CLM_SHARED_HEADER *shared;                //!<  Shared memory segment or NULL
+  int64_t          shared_size;
+  uint64_t         *shared_slot;
+  int32_t          *shared_owner;
+  uint8_t          *shared_data;
+#ifndef NVWIN3X
+  CLM_SHARED_PRIVATE *shared_private;       //!<  Private copies (protected by mutex)
+  int32_t          num_private;             //!<  Number of private copies (also read atomically without the mutex)
+#endif
+} CLM_CACHE;
+
+
+CLM_CACHE *clm_cache_create (CLM_FILE *clm, int64_t max_bytes);
+CLM_CACHE *clm_cache_create_runs (CLM_FILE *clm, int64_t max_bytes);
+CLM_CACHE *clm_cache_create_shared (CLM_FILE *clm, const char *name, int64_t max_bytes);
+void clm_cache_destroy (CLM_CACHE *cache);
+int32_t clm_cache_set_overlay (CLM_CACHE *cache, CLM_OVERLAY *overlay);
+int32_t clm_cache_get (CLM_CACHE *cache, int32_t lat, int32_t lon, uint8_t **bits);
+int32_t clm_cache_try_get (CLM_CACHE *cache, int32_t lat, int32_t lon, uint8_t **bits);
+void clm_cache_release (CLM_CACHE *cache, int32_t lat, int32_t lon);
+int32_t clm_cache_value (CLM_CACHE *cache, uint8_t *bits, int32_t row, int32_t col);
+int32_t clm_cache_point (CLM_CACHE *cache, double lat, double lon);
+void clm_cache_points (CLM_CACHE *cache, int32_t count, double *lat, double *lon, int8_t *result, uint64_t *order);
+void clm_cache_box (CLM_CACHE *cache, double south, double west, double north, double east, int64_t *cells,
+                    double *area);
+
+
+#endif
@@ -0,0 +1,151 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#include "calibrate.hpp"
+
+
+/*!
+  - Re-run the rasterization engine calibration (see engine.hpp) and save it where the main build looks for it
+    ($ABE_DATA/land_mask/swbd_mask_engine.cal) or in the -o file.  The timings, the fitted constants, and, for a
+    single ring covering most of a cell, the vertex count above which the scanline engine is picked at each
+    resolution are printed.
+*/
+
+
+static void calibrate_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask calibrate [-o FILE]\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-o FILE = save the calibration in FILE instead of $ABE_DATA/land_mask/%s\n\n", CLM_ENGINE_FILE);
+  exit (-1);
+}
+
+
+
+int32_t calibrate (int32_t argc, char **argv)
+{
+  int32_t           c;
+  char              path[512];
+  CLM_ENGINE_MODEL  model;
+
+
+  path[0] = 0;
+
+  while ((c = getopt (argc, argv, "o:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'o':
+          snprintf (path, sizeof (path), "%s", optarg);
+          break;
+
+        default:
+          calibrate_usage ();
+          break;
+        }
+    }
+
+
+  if (optind != argc) calibrate_usage ();
+
+
+  if (!path[0] && clm_engine_path (path))
+    {
+      fprintf (stderr, "\n\nEnvironment variable ABE_DATA is not set (use -o)\n\n");
+      exit (-1);
+    }
+
+
+  clm_engine_calibrate (&model, stdout);
+
+
+  printf ("\nBrute force:  %.3e s per ring per bin, %.3e s per covered vertex per bin\n", model.ring, model.vertex);
+  printf ("Scanline:     %.3e s per edge per row, %.3e s per bin\n\n", model.edge, model.pixel);
+
+
+  //  Crossover for one ring whose bounding box covers 64% of the cell (as in the calibration cells).
+
+  int32_t resolution[5] = {60, 30, 10, 3, 1};
+
+  for (int32_t r = 0 ; r < 5 ; r++)
+    {
+      CLM_ENGINE_FEATURES features;
+
+      features.rings = 1;
+      features.rows = 3600 / resolution[r];
+      features.pixels = (int64_t) features.rows * features.rows;
+
+      int32_t crossover = -1;
+
+      for (int32_t v = 4 ; v <= 1048576 ; v *= 2)
+        {
+          features.vertices = v;
+          features.covered = 0.64 * (double) v;
+
+          if (clm_engine_select (&model, &features) == CLM_ENGINE_SCANLINE)
+            {
+              crossover = v;
+              break;
+            }
+        }
+
+      if (crossover < 0)
+        {
+          printf ("%2d second:  brute force up to at least 1048576 vertices\n", resolution[r]);
+        }
+      else if (crossover == 4)
+        {
+          printf ("%2d second:  scanline for any number of vertices\n", resolution[r]);
+        }
+      else
+        {
+          printf ("%2d second:  scanline from about %d vertices\n", resolution[r], crossover);
+        }
+    }
+
+
+  if (clm_engine_save (path, &model))
+    {
+      perror (path);
+      exit (-1);
+    }
+
+  printf ("\nSaved %s\n\n", path);
+
+
+  return (0);
+}
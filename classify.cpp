@@ -0,0 +1,675 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "classify.hpp"
+
+
+/*!
+  - Flag (or filter out) points that fall on land.  The input is either ASCII XYZ (LON LAT Z, or LAT LON Z with -y,
+    separated by spaces, tabs, or commas) or a LAS file with geographic (longitude/latitude) coordinates.  The
+    file is read in chunks (whole lines or whole records) and a round of chunks is handed to the threads, which
+    parse them and look the points up with clm_cache_points (sorted by block so each block is only fetched once per
+    chunk).  The results are then written in input order before the next round is read, so memory use doesn't
+    depend on the size of the input.
+
+    Output is either the input with a flag (1 land, 0 water, -1 undefined or unreadable) added to each line (for
+    LAS, one flag per line), or a filtered copy of the input that keeps the points that aren't on land (or, with
+    -l, only those that are).  Filtered LAS files get their point counts, return counts, and bounds fixed.  LAS
+    extended variable length records are not copied.  LAS data is assumed to be little endian, like the host.
+*/
+
+
+classifyThread::classifyThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+classifyThread::~classifyThread ()
+{
+}
+
+
+
+void classifyThread::classify (CLM_CACHE *c, CLASSIFY_FORMAT *f, CLASSIFY_CHUNK *ch, int32_t nc, QAtomicInt *n)
+{
+  QMutexLocker locker (&mutex);
+
+  l_cache = c;
+  l_format = f;
+  l_chunk = ch;
+  l_num_chunks = nc;
+  l_next = n;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+//!  Make sure a chunk has room for count points.
+
+static void chunk_points (CLASSIFY_CHUNK *chunk, int32_t count)
+{
+  if (count <= chunk->max_count) return;
+
+  chunk->max_count = count;
+  chunk->line = (int64_t *) realloc (chunk->line, count * sizeof (int64_t));
+  chunk->lat = (double *) realloc (chunk->lat, count * sizeof (double));
+  chunk->lon = (double *) realloc (chunk->lon, count * sizeof (double));
+  chunk->result = (int8_t *) realloc (chunk->result, count);
+  chunk->order = (uint64_t *) realloc (chunk->order, count * sizeof (uint64_t));
+
+  if (chunk->line == NULL || chunk->lat == NULL || chunk->lon == NULL || chunk->result == NULL || chunk->order == NULL)
+    {
+      perror ("Allocating chunk memory");
+      exit (-1);
+    }
+}
+
+
+
+//!  Read a number followed by spaces, tabs, or commas.  Returns NVFalse if there isn't one.
+
+static uint8_t read_number (char **p, double *value)
+{
+  char *end;
+
+  *value = strtod (*p, &end);
+  if (end == *p) return (NVFalse);
+
+  while (*end == ' ' || *end == '\t' || *end == ',') end++;
+  *p = end;
+
+  return (NVTrue);
+}
+
+
+
+void classifyThread::run ()
+{
+  mutex.lock ();
+
+  CLM_CACHE *cache = l_cache;
+  CLASSIFY_FORMAT *format = l_format;
+  CLASSIFY_CHUNK *chunk = l_chunk;
+  int32_t num_chunks = l_num_chunks;
+  QAtomicInt *next = l_next;
+
+  mutex.unlock ();
+
+
+  int32_t c;
+  while ((c = next->fetchAndAddOrdered (1)) < num_chunks)
+    {
+      CLASSIFY_CHUNK *ch = &chunk[c];
+
+      if (format->las)
+        {
+          //  LAS X and Y are the first two 32 bit integers in every point record format.
+
+          ch->count = (int32_t) (ch->size / format->record_length);
+          chunk_points (ch, ch->count);
+
+          for (int32_t i = 0 ; i < ch->count ; i++)
+            {
+              int32_t xy[2];
+
+              memcpy (xy, &ch->data[(int64_t) i * format->record_length], 8);
+
+              ch->lon[i] = (double) xy[0] * format->scale[0] + format->offset[0];
+              ch->lat[i] = (double) xy[1] * format->scale[1] + format->offset[1];
+            }
+        }
+      else
+        {
+          //  Split the text into lines (the newlines are put back when the lines are written).
+
+          int32_t count = 0;
+          for (int64_t i = 0 ; i < ch->size ; i++) if (ch->data[i] == '\n') count++;
+          if (ch->size && ch->data[ch->size - 1] != '\n') count++;
+
+          chunk_points (ch, count);
+
+          ch->count = 0;
+          for (int64_t i = 0 ; i < ch->size ; )
+            {
+              int64_t end = i;
+              while (end < ch->size && ch->data[end] != '\n') end++;
+
+              ch->line[ch->count++] = i;
+              ch->data[end] = 0;
+              i = end + 1;
+            }
+
+          for (int32_t i = 0 ; i < ch->count ; i++)
+            {
+              char *p = &ch->data[ch->line[i]];
+              double a, b;
+
+              while (*p == ' ' || *p == '\t') p++;
+
+              if (read_number (&p, &a) && read_number (&p, &b))
+                {
+                  ch->lat[i] = format->lat_first ? a : b;
+                  ch->lon[i] = format->lat_first ? b : a;
+                }
+              else
+                {
+                  ch->lat[i] = ch->lon[i] = 999.0;
+                }
+            }
+        }
+
+      clm_cache_points (cache, ch->count, ch->lat, ch->lon, ch->result, ch->order);
+    }
+}
+
+
+
+static void classify_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask classify [-f] [-l] [-y] [-m CACHE_MB] [-r] [-s SHM_NAME] [-o OVERLAY] [-t NUM_THREADS]\n");
+  fprintf (stderr, "                          INPUT_CLM INPUT_FILE OUTPUT_FILE\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-f = write flags (1 land, 0 water, -1 undefined) instead of filtering the points\n");
+  fprintf (stderr, "\t-l = keep the points on land instead of the ones that aren't\n");
+  fprintf (stderr, "\t-y = XYZ input is LAT LON Z (default LON LAT Z)\n");
+  fprintf (stderr, "\t-m CACHE_MB = megabytes of uncompressed blocks to cache (default 256)\n");
+  fprintf (stderr, "\t-r = hold the cached blocks in run-length form (many more blocks fit in CACHE_MB, not with -s)\n");
+  fprintf (stderr, "\t-s SHM_NAME = keep the cache in POSIX shared memory SHM_NAME (see crossing)\n");
+  fprintf (stderr, "\t-o OVERLAY = apply the corrections in overlay file OVERLAY (see patch, not with -s)\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of parsing/query threads (1 to %d, default 4)\n\n", CLM_MAX_THREADS);
+  fprintf (stderr, "INPUT_FILE is ASCII XYZ or LAS (geographic coordinates).  With -f each XYZ line gets its flag\n");
+  fprintf (stderr, "added to the end and LAS files get one flag per line of OUTPUT_FILE.  Otherwise OUTPUT_FILE\n");
+  fprintf (stderr, "is the same format as INPUT_FILE.\n\n");
+  exit (-1);
+}
+
+
+
+/*!
+  - Classify a file of points.
+*/
+
+int32_t classify (int32_t argc, char **argv)
+{
+  int32_t           num_threads = 4, cache_mb = 256, c;
+  uint8_t           flags = NVFalse, keep_land = NVFalse, lat_first = NVFalse, runs = NVFalse;
+  char              *shm_name = NULL, *overlay_name = NULL;
+  CLASSIFY_FORMAT   format;
+  classifyThread    classify_thread[CLM_MAX_THREADS];
+
+
+  while ((c = getopt (argc, argv, "flym:rs:o:t:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'f':
+          flags = NVTrue;
+          break;
+
+        case 'l':
+          keep_land = NVTrue;
+          break;
+
+        case 'y':
+          lat_first = NVTrue;
+          break;
+
+        case 'm':
+          sscanf (optarg, "%d", &cache_mb);
+          break;
+
+        case 'r':
+          runs = NVTrue;
+          break;
+
+        case 's':
+          shm_name = optarg;
+          break;
+
+        case 'o':
+          overlay_name = optarg;
+          break;
+
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          classify_usage ();
+          break;
+        }
+    }
+
+
+  if (optind + 3 != argc || cache_mb < 1 || num_threads < 1 || num_threads > CLM_MAX_THREADS || (runs && shm_name != NULL))
+    classify_usage ();
+
+
+  CLM_FILE *clm = clm_open (argv[optind]);
+  if (clm == NULL)
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+  CLM_CACHE *cache;
+  if (shm_name != NULL)
+    {
+      if ((cache = clm_cache_create_shared (clm, shm_name, (int64_t) cache_mb * 1048576)) == NULL)
+        {
+          perror (shm_name);
+          exit (-1);
+        }
+    }
+  else if ((cache = runs ? clm_cache_create_runs (clm, (int64_t) cache_mb * 1048576) :
+             clm_cache_create (clm, (int64_t) cache_mb * 1048576)) == NULL)
+    {
+      perror ("Allocating cache memory");
+      exit (-1);
+    }
+
+
+  //  Corrections from an overlay file are applied as blocks are read into the cache.
+
+  CLM_OVERLAY *overlay = NULL;
+  if (overlay_name != NULL)
+    {
+      if ((overlay = clm_overlay_open (overlay_name, NVFalse)) == NULL)
+        {
+          perror (overlay_name);
+          exit (-1);
+        }
+
+      if (!clm_cache_set_overlay (cache, overlay))
+        {
+          fprintf (stderr, "\n\nOverlay %s can't be used with %s (different resolution or a shared cache)\n\n", overlay_name,
+                   clm->path);
+          exit (-1);
+        }
+    }
+
+
+  FILE *ifp = fopen (argv[optind + 1], "rb");
+  if (ifp == NULL)
+    {
+      perror (argv[optind + 1]);
+      exit (-1);
+    }
+
+  FILE *ofp = fopen (argv[optind + 2], "wb");
+  if (ofp == NULL)
+    {
+      perror (argv[optind + 2]);
+      exit (-1);
+    }
+
+
+  //  Figure out what we're reading.
+
+  uint8_t header[CLASSIFY_LAS_HEADER_SIZE];
+  uint8_t *las_header = NULL;
+  uint32_t point_offset = 0;
+  uint16_t header_size = 0;
+  int64_t las_remaining = 0;
+  double z_scale = 1.0, z_offset = 0.0;
+
+  memset (&format, 0, sizeof (format));
+  memset (header, 0, sizeof (header));
+  format.lat_first = lat_first;
+
+  size_t n = fread (header, 1, CLASSIFY_LAS_HEADER_SIZE, ifp);
+
+  if (n >= 227 && !memcmp (header, "LASF", 4))
+    {
+      format.las = NVTrue;
+
+      memcpy (&header_size, &header[94], 2);
+      memcpy (&point_offset, &header[96], 4);
+
+      uint16_t record_length;
+      memcpy (&record_length, &header[105], 2);
+      format.record_length = record_length;
+
+      memcpy (&format.scale[0], &header[131], 8);
+      memcpy (&format.scale[1], &header[139], 8);
+      memcpy (&z_scale, &header[147], 8);
+      memcpy (&format.offset[0], &header[155], 8);
+      memcpy (&format.offset[1], &header[163], 8);
+      memcpy (&z_offset, &header[171], 8);
+
+      uint32_t legacy_count;
+      memcpy (&legacy_count, &header[107], 4);
+      las_remaining = legacy_count;
+
+      if (header[24] == 1 && header[25] >= 4 && header_size >= CLASSIFY_LAS_HEADER_SIZE)
+        {
+          uint64_t count;
+          memcpy (&count, &header[247], 8);
+          if (count) las_remaining = (int64_t) count;
+        }
+
+      if (header[104] & 0xc0)
+        {
+          fprintf (stderr, "%s is compressed (LAZ), decompress it first\n\n", argv[optind + 1]);
+          exit (-1);
+        }
+
+      if (format.record_length < 20 || point_offset < header_size)
+        {
+          fprintf (stderr, "%s does not look like a valid LAS file\n\n", argv[optind + 1]);
+          exit (-1);
+        }
+
+
+      //  The header and variable length records are copied to a filtered output file.
+
+      las_header = (uint8_t *) malloc (point_offset);
+      if (las_header == NULL)
+        {
+          perror ("Allocating LAS header memory");
+          exit (-1);
+        }
+
+      fseek (ifp, 0, SEEK_SET);
+      if (fread (las_header, point_offset, 1, ifp) != 1)
+        {
+          perror (argv[optind + 1]);
+          exit (-1);
+        }
+
+      if (!flags) fwrite (las_header, point_offset, 1, ofp);
+    }
+  else
+    {
+      fseek (ifp, 0, SEEK_SET);
+    }
+
+
+  int32_t num_chunks = num_threads * 2;
+  CLASSIFY_CHUNK *chunk = (CLASSIFY_CHUNK *) calloc (num_chunks, sizeof (CLASSIFY_CHUNK));
+  char *carry = (char *) malloc (2 * CLASSIFY_TEXT_CHUNK);
+  if (chunk == NULL || carry == NULL)
+    {
+      perror ("Allocating chunk memory");
+      exit (-1);
+    }
+
+  int64_t chunk_bytes = format.las ? (int64_t) CLASSIFY_LAS_CHUNK * format.record_length : CLASSIFY_TEXT_CHUNK;
+
+  for (int32_t i = 0 ; i < num_chunks ; i++)
+    {
+      //  One extra byte so that the last line can be terminated in place even when it fills the chunk.
+
+      chunk[i].capacity = qMax (chunk_bytes, (int64_t) (2 * CLASSIFY_TEXT_CHUNK));
+      if ((chunk[i].data = (char *) malloc (chunk[i].capacity + 1)) == NULL)
+        {
+          perror ("Allocating chunk memory");
+          exit (-1);
+        }
+    }
+
+
+  int64_t total = 0, num_land = 0, num_water = 0, num_undefined = 0, kept = 0;
+  int64_t carry_size = 0, return_count[15];
+  int32_t min_xyz[3] = {INT32_MAX, INT32_MAX, INT32_MAX}, max_xyz[3] = {INT32_MIN, INT32_MIN, INT32_MIN};
+  uint8_t eof = NVFalse;
+
+  memset (return_count, 0, sizeof (return_count));
+
+  QElapsedTimer timer;
+  timer.start ();
+
+  while (!eof)
+    {
+      //  Read a round of chunks.
+
+      int32_t filled = 0;
+
+      while (filled < num_chunks && !eof)
+        {
+          CLASSIFY_CHUNK *ch = &chunk[filled];
+
+          if (format.las)
+            {
+              int64_t records = qMin (las_remaining, (int64_t) CLASSIFY_LAS_CHUNK);
+
+              ch->size = (int64_t) fread (ch->data, 1, records * format.record_length, ifp);
+              ch->size -= ch->size % format.record_length;
+              las_remaining -= ch->size / format.record_length;
+
+              if (!las_remaining || ch->size < records * format.record_length) eof = NVTrue;
+            }
+          else
+            {
+              //  Start with the partial line left over from the last chunk and only take whole lines.
+
+              memcpy (ch->data, carry, carry_size);
+              ch->size = carry_size + (int64_t) fread (&ch->data[carry_size], 1,
+                                                       qMin ((int64_t) CLASSIFY_TEXT_CHUNK, ch->capacity - carry_size), ifp);
+              carry_size = 0;
+
+              if (feof (ifp) || ferror (ifp))
+                {
+                  eof = NVTrue;
+                }
+              else
+                {
+                  int64_t end = ch->size;
+                  while (end > 0 && ch->data[end - 1] != '\n') end--;
+
+                  if (end > 0)
+                    {
+                      carry_size = ch->size - end;
+                      memcpy (carry, &ch->data[end], carry_size);
+                      ch->size = end;
+                    }
+                }
+            }
+
+          if (ch->size) filled++;
+        }
+
+      if (!filled) break;
+
+
+      QAtomicInt next (0);
+
+      for (int32_t i = 0 ; i < num_threads ; i++) classify_thread[i].classify (cache, &format, chunk, filled, &next);
+      for (int32_t i = 0 ; i < num_threads ; i++) classify_thread[i].wait ();
+
+
+      //  Write the results in input order.
+
+      for (int32_t k = 0 ; k < filled ; k++)
+        {
+          CLASSIFY_CHUNK *ch = &chunk[k];
+
+          for (int32_t i = 0 ; i < ch->count ; i++)
+            {
+              int8_t r = ch->result[i];
+
+              if (r == 1)
+                {
+                  num_land++;
+                }
+              else if (r == 0)
+                {
+                  num_water++;
+                }
+              else
+                {
+                  num_undefined++;
+                }
+
+              uint8_t keep = keep_land ? (r == 1) : (r != 1);
+
+              if (format.las)
+                {
+                  char *record = &ch->data[(int64_t) i * format.record_length];
+
+                  if (flags)
+                    {
+                      fprintf (ofp, "%d\n", r);
+                    }
+                  else if (keep)
+                    {
+                      int32_t xyz[3];
+                      memcpy (xyz, record, 12);
+
+                      for (int32_t j = 0 ; j < 3 ; j++)
+                        {
+                          min_xyz[j] = qMin (min_xyz[j], xyz[j]);
+                          max_xyz[j] = qMax (max_xyz[j], xyz[j]);
+                        }
+
+                      int32_t ret = (header[104] & 0x3f) >= 6 ? (record[14] & 0x0f) : (record[14] & 0x07);
+                      if (ret >= 1 && ret <= 15) return_count[ret - 1]++;
+
+                      fwrite (record, format.record_length, 1, ofp);
+                      kept++;
+                    }
+                }
+              else
+                {
+                  char *line = &ch->data[ch->line[i]];
+
+                  if (flags)
+                    {
+                      fprintf (ofp, "%s %d\n", line, r);
+                    }
+                  else if (keep)
+                    {
+                      fprintf (ofp, "%s\n", line);
+                      kept++;
+                    }
+                }
+            }
+
+          total += ch->count;
+        }
+
+
+      double seconds = (double) timer.elapsed () / 1000.0;
+
+      fprintf (stderr, "%lld points, %.0f points/second\r", (long long) total, seconds > 0.0 ? (double) total / seconds : 0.0);
+      fflush (stderr);
+    }
+
+
+  //  Fix the counts, return counts, and bounds of a filtered LAS file.
+
+  if (format.las && !flags)
+    {
+      uint8_t point_format = header[104] & 0x3f;
+      uint32_t legacy = (point_format < 6 && kept <= (int64_t) UINT32_MAX) ? (uint32_t) kept : 0;
+
+      memcpy (&las_header[107], &legacy, 4);
+
+      for (int32_t j = 0 ; j < 5 ; j++)
+        {
+          uint32_t count = legacy ? (uint32_t) return_count[j] : 0;
+          memcpy (&las_header[111 + 4 * j], &count, 4);
+        }
+
+      if (kept)
+        {
+          double scale[3] = {format.scale[0], format.scale[1], z_scale};
+          double offset[3] = {format.offset[0], format.offset[1], z_offset};
+
+          for (int32_t j = 0 ; j < 3 ; j++)
+            {
+              double max = (double) max_xyz[j] * scale[j] + offset[j];
+              double min = (double) min_xyz[j] * scale[j] + offset[j];
+
+              memcpy (&las_header[179 + 16 * j], &max, 8);
+              memcpy (&las_header[187 + 16 * j], &min, 8);
+            }
+        }
+
+      if (header[24] == 1 && header[25] >= 4 && header_size >= CLASSIFY_LAS_HEADER_SIZE)
+        {
+          uint64_t zero = 0, count = kept;
+          uint32_t zero32 = 0;
+
+          memcpy (&las_header[235], &zero, 8);
+          memcpy (&las_header[243], &zero32, 4);
+          memcpy (&las_header[247], &count, 8);
+
+          for (int32_t j = 0 ; j < 15 ; j++)
+            {
+              count = return_count[j];
+              memcpy (&las_header[255 + 8 * j], &count, 8);
+            }
+        }
+
+      fseek (ofp, 0, SEEK_SET);
+      fwrite (las_header, header_size, 1, ofp);
+    }
+
+
+  double seconds = (double) timer.elapsed () / 1000.0;
+
+  fprintf (stderr, "%lld points (%lld land, %lld water, %lld undefined or unreadable) in %.3f seconds, %.0f points/second\n\n",
+           (long long) total, (long long) num_land, (long long) num_water, (long long) num_undefined, seconds,
+           seconds > 0.0 ? (double) total / seconds : 0.0);
+  fflush (stderr);
+
+
+  fclose (ifp);
+  fclose (ofp);
+
+  for (int32_t i = 0 ; i < num_chunks ; i++)
+    {
+      free (chunk[i].data);
+      free (chunk[i].line);
+      free (chunk[i].lat);
+      free (chunk[i].lon);
+      free (chunk[i].result);
+      free (chunk[i].order);
+    }
+
+  free (chunk);
+  free (carry);
+  if (las_header != NULL) free (las_header);
+  clm_cache_destroy (cache);
+  clm_overlay_close (overlay);
+  clm_close (clm);
+
+  return (0);
+}
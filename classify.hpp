@@ -0,0 +1,120 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef CLASSIFY_H
+#define CLASSIFY_H
+
+
+#include "cache.hpp"
+
+
+#define CLASSIFY_TEXT_CHUNK          8388608      //!<  Bytes of XYZ text per chunk
+#define CLASSIFY_LAS_CHUNK           262144       //!<  LAS point records per chunk
+#define CLASSIFY_LAS_HEADER_SIZE     375          //!<  Largest LAS public header block (LAS 1.4)
+
+
+//!  One chunk of input points.
+
+typedef struct
+{
+  char             *data;                   //!<  Input bytes (whole text lines or whole LAS records)
+  int64_t          size;
+  int64_t          capacity;                //!<  Bytes of data that can be used (there is one more for a terminator)
+  int32_t          count;                   //!<  Number of points (lines or records)
+  int32_t          max_count;
+  int64_t          *line;                   //!<  Start of each text line in data
+  double           *lat, *lon;
+  int8_t           *result;                 //!<  1 land, 0 water, -1 undefined (or a bad line)
+  uint64_t         *order;
+} CLASSIFY_CHUNK;
+
+
+//!  How to get points out of a chunk.
+
+typedef struct
+{
+  uint8_t          las;                     //!<  NVTrue for LAS, NVFalse for XYZ text
+  uint8_t          lat_first;               //!<  XYZ text is LAT LON Z instead of LON LAT Z
+  int32_t          record_length;           //!<  LAS point record length
+  double           scale[2], offset[2];     //!<  LAS X and Y scale and offset
+} CLASSIFY_FORMAT;
+
+
+int32_t classify (int32_t argc, char **argv);
+
+
+class classifyThread:public QThread
+{
+  Q_OBJECT 
+
+
+public:
+
+  classifyThread (QObject *parent = 0);
+  ~classifyThread ();
+
+  void classify (CLM_CACHE *c = NULL, CLASSIFY_FORMAT *f = NULL, CLASSIFY_CHUNK *ch = NULL, int32_t nc = 0,
+                 QAtomicInt *n = NULL);
+
+
+signals:
+
+
+protected:
+
+
+  QMutex           mutex;
+
+  CLM_CACHE        *l_cache;
+
+  CLASSIFY_FORMAT  *l_format;
+
+  CLASSIFY_CHUNK   *l_chunk;
+
+  int32_t          l_num_chunks;
+
+  QAtomicInt       *l_next;
+
+
+  void             run ();
+
+
+protected slots:
+
+private:
+};
+
+#endif
@@ -0,0 +1,780 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "clm.hpp"
+#include "version.h"
+
+
+/*!
+  - Open an existing compressed land mask (.clm) file for reading.  Returns NULL on failure (errno will be set
+    if the failure was a system error).
+*/
+
+CLM_FILE *clm_open (const char *path)
+{
+  char header[SWBD_MASK_HEADER_SIZE + 1];
+
+
+  CLM_FILE *clm = new CLM_FILE;
+
+  clm->write = NVFalse;
+  clm->resolution = 0;
+  clm->align = 0;
+  clm->unordered = NVFalse;
+  strcpy (clm->path, path);
+
+  if ((clm->fp = fopen (path, "rb")) == NULL)
+    {
+      delete clm;
+      return (NULL);
+    }
+
+
+  //  Read the ASCII header and the one-degree map.
+
+  if (fread (header, SWBD_MASK_HEADER_SIZE, 1, clm->fp) != 1 || fread (clm->map, sizeof (clm->map), 1, clm->fp) != 1)
+    {
+      fclose (clm->fp);
+      delete clm;
+      errno = EINVAL;
+      return (NULL);
+    }
+
+  header[SWBD_MASK_HEADER_SIZE] = 0;
+
+
+  char *line = header;
+  while (line != NULL && *line)
+    {
+      if (!strncmp (line, "[RESOLUTION] = ", 15)) sscanf (&line[15], "%d", &clm->resolution);
+
+      if (!strncmp (line, "[END OF HEADER]", 15)) break;
+
+      if ((line = strchr (line, '\n')) != NULL) line++;
+    }
+
+
+  if (clm->resolution != 1 && clm->resolution != 3 && clm->resolution != 10 && clm->resolution != 30 && clm->resolution != 60)
+    {
+      fclose (clm->fp);
+      delete clm;
+      errno = EINVAL;
+      return (NULL);
+    }
+
+
+  clm->point_count = 3600 / clm->resolution;
+  clm->bit_size = (clm->point_count * clm->point_count) / 8;
+  clm->row_words = (clm->point_count + 63) / 64;
+
+  return (clm);
+}
+
+
+
+/*!
+  - Create a new compressed land mask (.clm) file.  All of the one-degree map entries are set to undefined.
+    If extra_header is not NULL it is added to the header just before the [END OF HEADER] tag (it must be
+    made up of complete, newline terminated, [TAG] = value lines).  Returns NULL on failure.
+*/
+
+CLM_FILE *clm_create (const char *path, int32_t resolution, const char *extra_header)
+{
+  CLM_FILE *clm = new CLM_FILE;
+
+  clm->write = NVTrue;
+  clm->resolution = resolution;
+  clm->align = 0;
+  clm->unordered = NVFalse;
+  clm->point_count = 3600 / resolution;
+  clm->bit_size = (clm->point_count * clm->point_count) / 8;
+  clm->row_words = (clm->point_count + 63) / 64;
+  strcpy (clm->path, path);
+
+  if ((clm->fp = fopen (path, "wb+")) == NULL)
+    {
+      delete clm;
+      return (NULL);
+    }
+
+
+  //  Write the (minimalist) ASCII header.
+
+  time_t t = time (&t);
+  struct tm *cur_tm = gmtime (&t);
+
+  fprintf (clm->fp, "[HEADER SIZE] = %d\n", SWBD_MASK_HEADER_SIZE);
+  fprintf (clm->fp, "[VERSION] = %s\n", VERSION);
+  fprintf (clm->fp, "[ZLIB VERSION] = %s\n", zlibVersion ());
+  fprintf (clm->fp, "[CREATION DATE] = %s", asctime (cur_tm));
+  fprintf (clm->fp, "[RESOLUTION] = %d\n", resolution);
+  if (extra_header != NULL) fprintf (clm->fp, "%s", extra_header);
+  fprintf (clm->fp, "[END OF HEADER]\n");
+
+
+  //  Zero out the remainder of the header and the map (all map addresses default to 0, undefined).
+
+  memset (clm->map, 0, sizeof (clm->map));
+
+  uint8_t zero = 0;
+  int32_t j = ftell (clm->fp);
+  for (int32_t i = j ; i < SWBD_MASK_HEADER_SIZE ; i++) fwrite (&zero, 1, 1, clm->fp);
+
+  if (fwrite (clm->map, sizeof (clm->map), 1, clm->fp) != 1)
+    {
+      fclose (clm->fp);
+      delete clm;
+      return (NULL);
+    }
+
+  return (clm);
+}
+
+
+
+/*!
+  - Close a .clm file.  If the file was created with clm_create the one-degree map is written back to the file.
+*/
+
+void clm_close (CLM_FILE *clm)
+{
+  if (clm == NULL) return;
+
+  if (clm->write)
+    {
+      fseek (clm->fp, SWBD_MASK_HEADER_SIZE, SEEK_SET);
+      if (fwrite (clm->map, sizeof (clm->map), 1, clm->fp) != 1) perror (clm->path);
+    }
+
+  fclose (clm->fp);
+
+  delete clm;
+}
+
+
+
+/*!
+  - Switch a file created with clm_create to unordered writes.  Instead of seeking to the end of the file and
+    writing under the mutex, clm_write_raw reserves the next range of the file with an atomic add and writes
+    the block there with pwrite, so any number of threads can write blocks at the same time.  The map entries
+    are only updated in memory (each block has its own entry) and are written once by clm_close.  Blocks end up
+    in the file in whatever order the writers reserve them, so this is for scratch files where the block order
+    doesn't matter.  Set clm->align before calling this.  Returns NVFalse (and the file stays in ordered mode) if
+    it isn't supported (Windows, or Qt older than 5.3, see CLM_UNORDERED).
+*/
+
+int32_t clm_set_unordered (CLM_FILE *clm)
+{
+#ifndef CLM_UNORDERED
+
+  return (NVFalse);
+
+#else
+
+  if (!clm->write) return (NVFalse);
+
+  QMutexLocker locker (&clm->mutex);
+
+  if (fflush (clm->fp) || fseek (clm->fp, 0, SEEK_END)) return (NVFalse);
+
+  int64_t end = ftell (clm->fp);
+  if (clm->align > 1 && end % clm->align) end += clm->align - end % clm->align;
+
+  clm->fd = fileno (clm->fp);
+  clm->end.storeRelease (end);
+  clm->unordered = NVTrue;
+
+  return (NVTrue);
+
+#endif
+}
+
+
+
+//!  Index of the one-degree block whose southwest corner is at lat, lon.
+
+int32_t clm_block_index (int32_t lat, int32_t lon)
+{
+  return ((lat + 90) * 360 + (lon + 180));
+}
+
+
+
+/*!
+  - Returns the map entry (CLM_UNDEFINED, CLM_ALL_LAND, CLM_ALL_WATER, or the address of the compressed block)
+    for the one-degree block whose southwest corner is at lat, lon.  If size is not NULL the compressed block
+    size is placed in it.
+*/
+
+uint32_t clm_block_address (CLM_FILE *clm, int32_t lat, int32_t lon, uint32_t *size)
+{
+  uint8_t *mapbuf = &clm->map[clm_block_index (lat, lon) * CLM_MAP_RECORD_SIZE];
+
+  if (size != NULL) *size = bit_unpack (mapbuf, 32, 24);
+
+  return (bit_unpack (mapbuf, 0, 32));
+}
+
+
+
+/*!
+  - Read the compressed bytes of the one-degree block whose southwest corner is at lat, lon.  Returns a malloc'ed
+    buffer (size is set to the number of bytes) or NULL if the block is uniform or can't be read.  Safe to call
+    from multiple threads.
+*/
+
+uint8_t *clm_read_raw (CLM_FILE *clm, int32_t lat, int32_t lon, uint32_t *size)
+{
+  uint32_t address = clm_block_address (clm, lat, lon, size);
+
+  if (address <= CLM_ALL_WATER) return (NULL);
+
+
+  uint8_t *buf = (uint8_t *) malloc (*size);
+  if (buf == NULL) return (NULL);
+
+
+  clm->mutex.lock ();
+
+  fseek (clm->fp, address, SEEK_SET);
+  size_t n = fread (buf, *size, 1, clm->fp);
+
+  clm->mutex.unlock ();
+
+
+  if (n != 1)
+    {
+      free (buf);
+      return (NULL);
+    }
+
+  return (buf);
+}
+
+
+
+/*!
+  - Read and uncompress the one-degree block whose southwest corner is at lat, lon into bits (which must be at
+    least clm->bit_size bytes).  Returns CLM_UNDEFINED, CLM_ALL_LAND, or CLM_ALL_WATER (bits is not touched) for
+    uniform blocks, CLM_MIXED if bits was filled, or -1 on error.  Safe to call from multiple threads.
+*/
+
+int32_t clm_read_block (CLM_FILE *clm, int32_t lat, int32_t lon, uint8_t *bits)
+{
+  uint32_t size;
+
+
+  uint32_t address = clm_block_address (clm, lat, lon, &size);
+
+  if (address <= CLM_ALL_WATER) return ((int32_t) address);
+
+
+  uint8_t *buf = clm_read_raw (clm, lat, lon, &size);
+  if (buf == NULL) return (-1);
+
+
+  uLongf out_size = clm->bit_size;
+  int32_t status = uncompress (bits, &out_size, buf, size);
+  free (buf);
+
+  if (status != Z_OK || out_size != (uLongf) clm->bit_size) return (-1);
+
+  return (CLM_MIXED);
+}
+
+
+
+/*!
+  - Append an already compressed block to the file and point the map entry for the one-degree block whose
+    southwest corner is at lat, lon at it.  Returns CLM_MIXED or -1 on error.  Safe to call from multiple threads
+    (blocks are appended in whatever order they arrive, without locking if clm_set_unordered has been called).
+*/
+
+int32_t clm_write_raw (CLM_FILE *clm, int32_t lat, int32_t lon, uint8_t *buf, uint32_t size)
+{
+  if (size >= (1 << 24)) return (-1);
+
+
+#ifdef CLM_UNORDERED
+
+  //  Unordered writes.  Reserve whole multiples of the alignment so that every block starts aligned (the gaps
+  //  are never written and read back as zeros).
+
+  if (clm->unordered)
+    {
+      int64_t length = size;
+      if (clm->align > 1 && length % clm->align) length += clm->align - length % clm->align;
+
+      int64_t address = clm->end.fetchAndAddOrdered (length);
+
+      if (address + size > 0xffffffffLL) return (-1);
+
+      for (uint32_t done = 0 ; done < size ; )
+        {
+          ssize_t n = pwrite (clm->fd, buf + done, size - done, (off_t) (address + done));
+          if (n <= 0)
+            {
+              if (n < 0 && errno == EINTR) continue;
+              return (-1);
+            }
+          done += n;
+        }
+
+      uint8_t *mapbuf = &clm->map[clm_block_index (lat, lon) * CLM_MAP_RECORD_SIZE];
+      bit_pack (mapbuf, 0, 32, (uint32_t) address);
+      bit_pack (mapbuf, 32, 24, size);
+
+      return (CLM_MIXED);
+    }
+
+#endif
+
+
+  QMutexLocker locker (&clm->mutex);
+
+  fseek (clm->fp, 0, SEEK_END);
+  int64_t block_address = ftell (clm->fp);
+
+
+  //  Pad to the block alignment.
+
+  if (clm->align > 1 && block_address % clm->align)
+    {
+      uint8_t zero[4096];
+      memset (zero, 0, sizeof (zero));
+
+      int64_t pad = clm->align - block_address % clm->align;
+      while (pad > 0)
+        {
+          int64_t n = qMin (pad, (int64_t) sizeof (zero));
+          if (fwrite (zero, n, 1, clm->fp) != 1) return (-1);
+          pad -= n;
+        }
+
+      block_address = ftell (clm->fp);
+    }
+
+  if (block_address > 0xffffffffLL || fwrite (buf, size, 1, clm->fp) != 1) return (-1);
+
+  uint8_t *mapbuf = &clm->map[clm_block_index (lat, lon) * CLM_MAP_RECORD_SIZE];
+  bit_pack (mapbuf, 0, 32, (uint32_t) block_address);
+  bit_pack (mapbuf, 32, 24, size);
+
+  return (CLM_MIXED);
+}
+
+
+
+//!  CLM_ALL_LAND or CLM_ALL_WATER if every cell of an uncompressed block is the same, otherwise CLM_MIXED.
+
+int32_t clm_block_code (CLM_FILE *clm, uint8_t *bits)
+{
+  int32_t land = 0, water = 0;
+  for (int32_t i = 0 ; i < clm->bit_size ; i++)
+    {
+      if (bits[i] == 0xff)
+        {
+          land++;
+        }
+      else if (bits[i] == 0x00)
+        {
+          water++;
+        }
+      else
+        {
+          break;
+        }
+
+      if (land && water) break;
+    }
+
+  if (land == clm->bit_size) return (CLM_ALL_LAND);
+  if (water == clm->bit_size) return (CLM_ALL_WATER);
+
+  return (CLM_MIXED);
+}
+
+
+
+/*!
+  - Compress an uncompressed block with zlib at "level" (0 to 9) using zlib "strategy" (Z_DEFAULT_STRATEGY,
+    Z_FILTERED, Z_HUFFMAN_ONLY, or Z_RLE).  The result is a normal zlib stream so it is read with uncompress no
+    matter how it was made.  Returns a malloc'ed buffer (and sets size) or NULL on error.
+*/
+
+uint8_t *clm_compress_block (CLM_FILE *clm, uint8_t *bits, int32_t level, int32_t strategy, uint32_t *size)
+{
+  z_stream stream;
+
+  memset (&stream, 0, sizeof (stream));
+  if (deflateInit2 (&stream, level, Z_DEFLATED, 15, 8, strategy) != Z_OK) return (NULL);
+
+  uLong out_size = deflateBound (&stream, clm->bit_size);
+  uint8_t *out_buf = (uint8_t *) malloc (out_size);
+  if (out_buf == NULL)
+    {
+      deflateEnd (&stream);
+      return (NULL);
+    }
+
+  stream.next_in = bits;
+  stream.avail_in = clm->bit_size;
+  stream.next_out = out_buf;
+  stream.avail_out = out_size;
+
+  int32_t status = deflate (&stream, Z_FINISH);
+  *size = stream.total_out;
+  deflateEnd (&stream);
+
+  if (status != Z_STREAM_END)
+    {
+      free (out_buf);
+      return (NULL);
+    }
+
+  return (out_buf);
+}
+
+
+
+/*!
+  - Write the packed block in bits to the one-degree block whose southwest corner is at lat, lon.  Blocks that
+    are all land or all water are stored as map codes, anything else is compressed (zlib level 9) and appended
+    to the file.  Returns the map code used (CLM_ALL_LAND, CLM_ALL_WATER, or CLM_MIXED) or -1 on error.
+    Safe to call from multiple threads.
+*/
+
+int32_t clm_write_block (CLM_FILE *clm, int32_t lat, int32_t lon, uint8_t *bits)
+{
+  //  Check for uniform blocks.
+
+  int32_t code = clm_block_code (clm, bits);
+
+  if (code != CLM_MIXED)
+    {
+      clm_set_code (clm, lat, lon, code);
+      return (code);
+    }
+
+
+  //  Compress using zlib.
+
+  uint32_t out_size;
+  uint8_t *out_buf = clm_compress_block (clm, bits, 9, Z_DEFAULT_STRATEGY, &out_size);
+  if (out_buf == NULL) return (-1);
+
+  int32_t status = clm_write_raw (clm, lat, lon, out_buf, out_size);
+
+  free (out_buf);
+
+  return (status);
+}
+
+
+
+//!  Set the map entry for the one-degree block whose southwest corner is at lat, lon to a uniform code.
+
+void clm_set_code (CLM_FILE *clm, int32_t lat, int32_t lon, uint32_t code)
+{
+  QMutexLocker locker (&clm->mutex);
+
+  uint8_t *mapbuf = &clm->map[clm_block_index (lat, lon) * CLM_MAP_RECORD_SIZE];
+  memset (mapbuf, 0, CLM_MAP_RECORD_SIZE);
+  bit_pack (mapbuf, 0, 32, code);
+}
+
+
+
+//!  Fill a packed block with all land (CLM_ALL_LAND) or all water (anything else).
+
+void clm_fill_block (CLM_FILE *clm, uint8_t *bits, int32_t code)
+{
+  memset (bits, (code == CLM_ALL_LAND) ? 0xff : 0x00, clm->bit_size);
+}
+
+
+
+/*!
+  - Extract count bits of a packed bit set, starting at bit start, into (count + 63) / 64 64 bit words.  The first
+    bit is the most significant bit of words[0].  Bits past count are set to zero.  The start doesn't have to be
+    byte aligned (rows aren't at 60 seconds) so we shift as we go.
+*/
+
+void clm_get_bits (uint8_t *bits, int64_t start, int32_t count, uint64_t *words)
+{
+  int64_t byte = start >> 3;
+  int32_t shift = start & 7;
+  int32_t nbytes = (count + shift + 7) >> 3;
+  int32_t num_words = (count + 63) >> 6;
+
+
+  for (int32_t w = 0 ; w < num_words ; w++)
+    {
+      uint64_t x = 0;
+
+      for (int32_t k = 0 ; k < 8 ; k++)
+        {
+          int32_t b = w * 8 + k;
+          uint8_t v = 0;
+
+          if (b < nbytes)
+            {
+              v = (uint8_t) (bits[byte + b] << shift);
+              if (shift && b + 1 < nbytes) v |= bits[byte + b + 1] >> (8 - shift);
+            }
+
+          x = (x << 8) | v;
+        }
+
+      words[w] = x;
+    }
+
+
+  int32_t tail = count & 63;
+  if (tail) words[num_words - 1] &= ~0ULL << (64 - tail);
+}
+
+
+
+/*!
+  - Extract row "row" (0 is the southern row) of a packed block into clm->row_words 64 bit words.  The first
+    cell of the row is the most significant bit of words[0].  Bits past the end of the row are set to zero.
+*/
+
+void clm_get_row (CLM_FILE *clm, uint8_t *bits, int32_t row, uint64_t *words)
+{
+  clm_get_bits (bits, (int64_t) row * clm->point_count, clm->point_count, words);
+}
+
+
+
+//!  Store count bits (laid out as by clm_get_bits) into a packed bit set starting at bit start.
+
+void clm_put_bits (uint8_t *bits, int64_t start, int32_t count, uint64_t *words)
+{
+  int64_t byte = start >> 3;
+  int32_t shift = start & 7;
+  int32_t nbytes = (count + shift + 7) >> 3;
+  int32_t num_words = (count + 63) >> 6;
+
+
+  for (int32_t i = 0 ; i < nbytes ; i++)
+    {
+      //  Position of the most significant bit of this byte relative to start.
+
+      int32_t rel = i * 8 - shift;
+      uint64_t v;
+
+      if (rel < 0)
+        {
+          v = words[0] >> -rel;
+        }
+      else
+        {
+          int32_t w = rel >> 6, o = rel & 63;
+          v = words[w] << o;
+          if (o > 56 && w + 1 < num_words) v |= words[w + 1] >> (64 - o);
+        }
+
+      uint8_t src = (uint8_t) (v >> 56);
+
+
+      //  Only replace the bits of this byte that are in the range.
+
+      int32_t lo = rel < 0 ? -rel : 0;
+      int32_t hi = count - rel < 8 ? count - rel : 8;
+      uint8_t mask = (uint8_t) ((0xff >> lo) & (0xff << (8 - hi)));
+
+      bits[byte + i] = (bits[byte + i] & ~mask) | (src & mask);
+    }
+}
+
+
+
+//!  Store clm->row_words 64 bit words (laid out as by clm_get_row) into row "row" of a packed block.
+
+void clm_put_row (CLM_FILE *clm, uint8_t *bits, int32_t row, uint64_t *words)
+{
+  clm_put_bits (bits, (int64_t) row * clm->point_count, clm->point_count, words);
+}
+
+
+
+/*!
+  - Returns the position of the first bit at or after "from" in a row of "count" bits that is set to "value"
+    (1 for land, 0 for water), or count if there is none.  Skips 64 cells at a time.
+*/
+
+int32_t clm_next_bit (uint64_t *words, int32_t count, int32_t from, int32_t value)
+{
+  if (from >= count) return (count);
+
+
+  int32_t nwords = (count + 63) >> 6;
+  int32_t w = from >> 6;
+  uint64_t x = value ? words[w] : ~words[w];
+  x &= ~0ULL >> (from & 63);
+
+  while (1)
+    {
+      if (x)
+        {
+          int32_t pos = (w << 6) + __builtin_clzll (x);
+          return (pos < count ? pos : count);
+        }
+
+      if (++w >= nwords) return (count);
+
+      x = value ? words[w] : ~words[w];
+    }
+}
+
+
+
+//!  Returns the position of the last bit at or before "from" that is set to "value", or -1 if there is none.
+
+int32_t clm_prev_bit (uint64_t *words, int32_t from, int32_t value)
+{
+  if (from < 0) return (-1);
+
+
+  int32_t w = from >> 6;
+  uint64_t x = value ? words[w] : ~words[w];
+  x &= ~0ULL << (63 - (from & 63));
+
+  while (1)
+    {
+      if (x) return ((w << 6) + 63 - __builtin_ctzll (x));
+
+      if (--w < 0) return (-1);
+
+      x = value ? words[w] : ~words[w];
+    }
+}
+
+
+
+//!  Set (value = 1) or clear (value = 0) bits start through end - 1 of a row held in 64 bit words.
+
+void clm_fill_bits (uint64_t *words, int32_t start, int32_t end, int32_t value)
+{
+  while (start < end)
+    {
+      int32_t w = start >> 6, o = start & 63;
+      int32_t n = 64 - o;
+      if (n > end - start) n = end - start;
+
+      uint64_t mask = (n == 64) ? ~0ULL : (((1ULL << n) - 1) << (64 - o - n));
+
+      if (value)
+        {
+          words[w] |= mask;
+        }
+      else
+        {
+          words[w] &= ~mask;
+        }
+
+      start += n;
+    }
+}
+
+
+
+//!  Number of set bits from start through end - 1 of a row held in 64 bit words.
+
+int32_t clm_count_bits (uint64_t *words, int32_t start, int32_t end)
+{
+  int32_t count = 0;
+
+  while (start < end)
+    {
+      int32_t w = start >> 6, o = start & 63;
+      int32_t n = 64 - o;
+      if (n > end - start) n = end - start;
+
+      uint64_t mask = (n == 64) ? ~0ULL : (((1ULL << n) - 1) << (64 - o - n));
+
+      count += __builtin_popcountll (words[w] & mask);
+
+      start += n;
+    }
+
+  return (count);
+}
+
+
+
+//!  Copy "count" bits starting at bit src_start of src to dst starting at bit dst_start (rows as in clm_get_row).
+
+void clm_copy_bits (uint64_t *dst, int32_t dst_start, uint64_t *src, int32_t src_start, int32_t count)
+{
+  while (count > 0)
+    {
+      int32_t dw = dst_start >> 6, doff = dst_start & 63;
+      int32_t n = 64 - doff;
+      if (n > count) n = count;
+
+
+      //  Get the next n bits of the source into the top of v.
+
+      int32_t sw = src_start >> 6, soff = src_start & 63;
+      uint64_t v = src[sw] << soff;
+      if (soff + n > 64) v |= src[sw + 1] >> (64 - soff);
+
+
+      uint64_t mask = (n == 64) ? ~0ULL : (((1ULL << n) - 1) << (64 - n));
+
+      dst[dw] = (dst[dw] & ~(mask >> doff)) | ((v & mask) >> doff);
+
+      dst_start += n;
+      src_start += n;
+      count -= n;
+    }
+}
+
+
+
+//!  Area, in square kilometers, of a single cell in row "row" of the one-degree block whose south edge is at lat.
+
+double clm_cell_area (CLM_FILE *clm, int32_t lat, int32_t row)
+{
+  double cell = 1.0 / (double) clm->point_count;
+  double south = ((double) lat + (double) row * cell) * NV_DEG_TO_RAD;
+  double north = ((double) lat + (double) (row + 1) * cell) * NV_DEG_TO_RAD;
+
+  return (CLM_EARTH_RADIUS * CLM_EARTH_RADIUS * cell * NV_DEG_TO_RAD * (sin (north) - sin (south)));
+}
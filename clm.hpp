@@ -0,0 +1,153 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef CLM_H
+#define CLM_H
+
+
+#include <QtCore>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <zlib.h>
+
+
+#include "nvutility.h"
+#include "nvutility.hpp"
+
+
+#define SWBD_MASK_HEADER_SIZE        16384
+
+
+//  Number of entries in the one-degree map and the size of a single map record.
+
+#define CLM_BLOCKS                   64800
+#define CLM_MAP_RECORD_SIZE          7
+
+
+//  Unordered writes (see clm_set_unordered) need pwrite and a 64 bit QAtomicInteger (Qt 5.3 and later).  Without
+//  them every write goes through the mutex.
+
+#if !defined (NVWIN3X) && QT_VERSION >= 0x050300
+#define CLM_UNORDERED
+#endif
+
+
+//  One-degree map codes.  Anything larger than CLM_ALL_WATER in the map is the address of a compressed block.
+//  CLM_MIXED is never stored in the map, it is only returned by clm_read_block to say that the bits were filled.
+
+#define CLM_UNDEFINED                0
+#define CLM_ALL_LAND                 1
+#define CLM_ALL_WATER                2
+#define CLM_MIXED                    3
+
+
+//  Maximum number of worker threads for any of the block based processing modes.
+
+#define CLM_MAX_THREADS              64
+
+
+//  Number of 64 bit words needed to hold a single row of a 1 second block.
+
+#define CLM_MAX_ROW_WORDS            57
+
+
+//  Mean earth radius in kilometers (used for cell areas and distances).
+
+#define CLM_EARTH_RADIUS             6371.0087714
+
+
+/*!
+  - Compressed land mask file.  The one-degree map is held in memory.  When the file is opened for writing
+    the map is written back to the file by clm_close.  The mutex serializes access to the FILE pointer so that
+    many threads may read from (or append blocks to) the same file.
+*/
+
+typedef struct
+{
+  FILE            *fp;
+  char            path[512];
+  uint8_t         write;                                  //!<  NVTrue if created with clm_create
+  int32_t         resolution;                             //!<  Resolution in seconds (1, 3, 10, 30, or 60)
+  int32_t         point_count;                            //!<  Number of cells along one side of a one-degree block
+  int32_t         bit_size;                               //!<  Size, in bytes, of an uncompressed (packed) block
+  int32_t         row_words;                              //!<  Number of 64 bit words needed to hold one row of a block
+  int32_t         align;                                  //!<  Start new blocks on multiples of this many bytes (0 or 1 for none)
+  uint8_t         unordered;                              //!<  NVTrue if blocks are appended with pwrite (see clm_set_unordered)
+#ifdef CLM_UNORDERED
+  int32_t         fd;                                     //!<  File descriptor of fp (unordered writes only)
+  QAtomicInteger<qint64> end;                             //!<  Next free byte in the file (unordered writes only)
+#endif
+  uint8_t         map[CLM_BLOCKS * CLM_MAP_RECORD_SIZE];  //!<  One-degree map
+  QMutex          mutex;
+} CLM_FILE;
+
+
+CLM_FILE *clm_open (const char *path);
+CLM_FILE *clm_create (const char *path, int32_t resolution, const char *extra_header);
+void clm_close (CLM_FILE *clm);
+int32_t clm_set_unordered (CLM_FILE *clm);
+
+int32_t clm_block_index (int32_t lat, int32_t lon);
+uint32_t clm_block_address (CLM_FILE *clm, int32_t lat, int32_t lon, uint32_t *size);
+uint8_t *clm_read_raw (CLM_FILE *clm, int32_t lat, int32_t lon, uint32_t *size);
+int32_t clm_read_block (CLM_FILE *clm, int32_t lat, int32_t lon, uint8_t *bits);
+int32_t clm_write_raw (CLM_FILE *clm, int32_t lat, int32_t lon, uint8_t *buf, uint32_t size);
+int32_t clm_write_block (CLM_FILE *clm, int32_t lat, int32_t lon, uint8_t *bits);
+int32_t clm_block_code (CLM_FILE *clm, uint8_t *bits);
+uint8_t *clm_compress_block (CLM_FILE *clm, uint8_t *bits, int32_t level, int32_t strategy, uint32_t *size);
+void clm_set_code (CLM_FILE *clm, int32_t lat, int32_t lon, uint32_t code);
+void clm_fill_block (CLM_FILE *clm, uint8_t *bits, int32_t code);
+
+void clm_get_bits (uint8_t *bits, int64_t start, int32_t count, uint64_t *words);
+void clm_get_row (CLM_FILE *clm, uint8_t *bits, int32_t row, uint64_t *words);
+void clm_put_bits (uint8_t *bits, int64_t start, int32_t count, uint64_t *words);
+void clm_put_row (CLM_FILE *clm, uint8_t *bits, int32_t row, uint64_t *words);
+int32_t clm_next_bit (uint64_t *words, int32_t count, int32_t from, int32_t value);
+int32_t clm_prev_bit (uint64_t *words, int32_t from, int32_t value);
+void clm_fill_bits (uint64_t *words, int32_t start, int32_t end, int32_t value);
+int32_t clm_count_bits (uint64_t *words, int32_t start, int32_t end);
+void clm_copy_bits (uint64_t *dst, int32_t dst_start, uint64_t *src, int32_t src_start, int32_t count);
+
+double clm_cell_area (CLM_FILE *clm, int32_t lat, int32_t row);
+
+
+#endif
@@ -0,0 +1,457 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "combine.hpp"
+
+
+/*!
+  - Union, intersection, difference, or exclusive or of the land in two or more .clm files of the same
+    resolution.  Each one-degree block is handled on its own (in parallel).  As much as possible is decided from
+    the map codes (for instance, one all land input makes the union all land) and from comparing the compressed
+    blocks (identical blocks are only used once, or cancel for exclusive or).  If only one mixed block is left it
+    is copied without being uncompressed.  Otherwise the mixed blocks are uncompressed and combined 64 bits at a
+    time.  Undefined inputs are ignored (except for the first input of a difference, which makes the result
+    undefined).  The output is undefined if all of the inputs are.
+*/
+
+
+combineThread::combineThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+combineThread::~combineThread ()
+{
+}
+
+
+
+void combineThread::combine (CLM_FILE **in, int32_t ni, CLM_FILE *out, int32_t o, QAtomicInt *n)
+{
+  QMutexLocker locker (&mutex);
+
+  l_in = in;
+  l_num_inputs = ni;
+  l_out = out;
+  l_operation = o;
+  l_next = n;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+void combineThread::run ()
+{
+  mutex.lock ();
+
+  CLM_FILE **in = l_in;
+  int32_t num_inputs = l_num_inputs;
+  CLM_FILE *out = l_out;
+  int32_t operation = l_operation;
+  QAtomicInt *next = l_next;
+
+  mutex.unlock ();
+
+
+  int32_t num_words = (in[0]->bit_size + 7) / 8;
+
+  uint64_t *result = (uint64_t *) calloc (num_words, sizeof (uint64_t));
+  uint64_t *bits = (uint64_t *) calloc (num_words, sizeof (uint64_t));
+  int32_t *code = (int32_t *) malloc (num_inputs * sizeof (int32_t));
+  uint32_t *size = (uint32_t *) malloc (num_inputs * sizeof (uint32_t));
+  uint8_t **raw = (uint8_t **) calloc (num_inputs, sizeof (uint8_t *));
+
+  if (result == NULL || bits == NULL || code == NULL || size == NULL || raw == NULL)
+    {
+      perror ("Allocating memory in combineThread");
+      exit (-1);
+    }
+
+
+  int32_t i;
+  while ((i = next->fetchAndAddOrdered (1)) < CLM_BLOCKS)
+    {
+      int32_t lat = i / 360 - 90;
+      int32_t lon = i % 360 - 180;
+
+
+      if (!(i % 648))
+        {
+          fprintf (stderr, "%03d%% processed\r", i / 648);
+          fflush (stderr);
+        }
+
+
+      int32_t num_defined = 0, num_land = 0, num_water = 0;
+
+      for (int32_t j = 0 ; j < num_inputs ; j++)
+        {
+          uint32_t address = clm_block_address (in[j], lat, lon, &size[j]);
+
+          code[j] = (address <= CLM_ALL_WATER) ? (int32_t) address : CLM_MIXED;
+
+          if (code[j] != CLM_UNDEFINED) num_defined++;
+
+          if (j || operation != COMBINE_DIFFERENCE)
+            {
+              if (code[j] == CLM_ALL_LAND) num_land++;
+              if (code[j] == CLM_ALL_WATER) num_water++;
+            }
+        }
+
+
+      //  Everything that can be decided from the map codes.
+
+      int32_t uniform = -1;
+
+      if (!num_defined || (operation == COMBINE_DIFFERENCE && code[0] == CLM_UNDEFINED)) continue;
+
+      switch (operation)
+        {
+        case COMBINE_UNION:
+          if (num_land) uniform = CLM_ALL_LAND;
+          break;
+
+        case COMBINE_INTERSECTION:
+          if (num_water) uniform = CLM_ALL_WATER;
+          break;
+
+        case COMBINE_DIFFERENCE:
+          if (code[0] == CLM_ALL_WATER || num_land) uniform = CLM_ALL_WATER;
+          break;
+        }
+
+      if (uniform >= 0)
+        {
+          clm_set_code (out, lat, lon, uniform);
+          continue;
+        }
+
+
+      //  Read the compressed mixed blocks (uniform inputs that are left don't change the result, except all land
+      //  inputs which flip an exclusive or and all land at the start of a difference).
+
+      int32_t num_mixed = 0, flip = (operation == COMBINE_XOR) ? (num_land & 1) : 0;
+
+      for (int32_t j = 0 ; j < num_inputs ; j++)
+        {
+          raw[j] = NULL;
+
+          if (code[j] == CLM_MIXED)
+            {
+              if ((raw[j] = clm_read_raw (in[j], lat, lon, &size[j])) == NULL)
+                {
+                  fprintf (stderr, "\nError reading block %d %d from %s\n", lat, lon, in[j]->path);
+                  exit (-1);
+                }
+
+              num_mixed++;
+            }
+        }
+
+
+      //  Drop repeated compressed blocks.  A repeat cancels out for exclusive or and a repeat of the first
+      //  input of a difference leaves nothing.
+
+      for (int32_t j = 0 ; j < num_inputs ; j++)
+        {
+          if (raw[j] == NULL) continue;
+
+          for (int32_t k = j + 1 ; k < num_inputs ; k++)
+            {
+              if (raw[k] == NULL || size[k] != size[j] || memcmp (raw[j], raw[k], size[j])) continue;
+
+              if (operation == COMBINE_DIFFERENCE && !j)
+                {
+                  uniform = CLM_ALL_WATER;
+                }
+
+              free (raw[k]);
+              raw[k] = NULL;
+              num_mixed--;
+
+              if (operation == COMBINE_XOR)
+                {
+                  free (raw[j]);
+                  raw[j] = NULL;
+                  num_mixed--;
+                  break;
+                }
+            }
+        }
+
+
+      if (uniform < 0)
+        {
+          //  Nothing mixed left.
+
+          if (!num_mixed)
+            {
+              switch (operation)
+                {
+                case COMBINE_UNION:
+                  uniform = CLM_ALL_WATER;
+                  break;
+
+                case COMBINE_INTERSECTION:
+                  uniform = CLM_ALL_LAND;
+                  break;
+
+                case COMBINE_DIFFERENCE:
+                  uniform = code[0];
+                  break;
+
+                case COMBINE_XOR:
+                  uniform = flip ? CLM_ALL_LAND : CLM_ALL_WATER;
+                  break;
+                }
+            }
+
+
+          //  A single mixed block that is used as is.
+
+          else if (num_mixed == 1 && !flip && (operation != COMBINE_DIFFERENCE || raw[0] != NULL))
+            {
+              for (int32_t j = 0 ; j < num_inputs ; j++)
+                {
+                  if (raw[j] != NULL && clm_write_raw (out, lat, lon, raw[j], size[j]) < 0)
+                    {
+                      fprintf (stderr, "\nError writing block %d %d to %s\n", lat, lon, out->path);
+                      exit (-1);
+                    }
+                }
+            }
+
+
+          //  Uncompress and combine.
+
+          else
+            {
+              uint8_t first = NVTrue;
+
+              if (operation == COMBINE_DIFFERENCE && code[0] == CLM_ALL_LAND)
+                {
+                  memset (result, 0xff, num_words * sizeof (uint64_t));
+                  first = NVFalse;
+                }
+
+              for (int32_t j = 0 ; j < num_inputs ; j++)
+                {
+                  if (raw[j] == NULL) continue;
+
+                  uLongf out_size = in[j]->bit_size;
+                  if (uncompress ((uint8_t *) (first ? result : bits), &out_size, raw[j], size[j]) != Z_OK ||
+                      out_size != (uLongf) in[j]->bit_size)
+                    {
+                      fprintf (stderr, "\nError uncompressing block %d %d from %s\n", lat, lon, in[j]->path);
+                      exit (-1);
+                    }
+
+                  if (first)
+                    {
+                      first = NVFalse;
+                      continue;
+                    }
+
+                  switch (operation)
+                    {
+                    case COMBINE_UNION:
+                      for (int32_t w = 0 ; w < num_words ; w++) result[w] |= bits[w];
+                      break;
+
+                    case COMBINE_INTERSECTION:
+                      for (int32_t w = 0 ; w < num_words ; w++) result[w] &= bits[w];
+                      break;
+
+                    case COMBINE_DIFFERENCE:
+                      for (int32_t w = 0 ; w < num_words ; w++) result[w] &= ~bits[w];
+                      break;
+
+                    case COMBINE_XOR:
+                      for (int32_t w = 0 ; w < num_words ; w++) result[w] ^= bits[w];
+                      break;
+                    }
+                }
+
+              if (flip)
+                {
+                  for (int32_t w = 0 ; w < num_words ; w++) result[w] = ~result[w];
+                }
+
+              if (clm_write_block (out, lat, lon, (uint8_t *) result) < 0)
+                {
+                  fprintf (stderr, "\nError writing block %d %d to %s\n", lat, lon, out->path);
+                  exit (-1);
+                }
+            }
+        }
+
+      if (uniform >= 0) clm_set_code (out, lat, lon, uniform);
+
+      for (int32_t j = 0 ; j < num_inputs ; j++)
+        {
+          if (raw[j] != NULL) free (raw[j]);
+        }
+    }
+
+
+  free (result);
+  free (bits);
+  free (code);
+  free (size);
+  free (raw);
+}
+
+
+
+static void combine_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask combine -o OPERATION [-u] [-t NUM_THREADS] OUTPUT_CLM INPUT_CLM INPUT_CLM [INPUT_CLM ...]\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-o OPERATION = union, intersection, difference, or xor of the land in the input files\n");
+  fprintf (stderr, "\t               (difference is the land in the first input that isn't land in any of the others)\n");
+  fprintf (stderr, "\t-u = unordered, threads write blocks with pwrite as they finish them, without locking\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of compute threads (1 to %d, default 4)\n\n", CLM_MAX_THREADS);
+  fprintf (stderr, "All of the input files must have the same resolution.\n\n");
+  exit (-1);
+}
+
+
+
+/*!
+  - Combine two or more existing .clm files.
+*/
+
+int32_t combine (int32_t argc, char **argv)
+{
+  int32_t           num_threads = 4, operation = -1, c;
+  uint8_t           unordered = NVFalse;
+  char              extra_header[SWBD_MASK_HEADER_SIZE / 2];
+  static const char *operation_name[4] = {"union", "intersection", "difference", "xor"};
+  combineThread     combine_thread[CLM_MAX_THREADS];
+
+
+  while ((c = getopt (argc, argv, "o:ut:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'o':
+          for (int32_t i = 0 ; i < 4 ; i++)
+            {
+              if (!strcmp (optarg, operation_name[i])) operation = i;
+            }
+          break;
+
+        case 'u':
+          unordered = NVTrue;
+          break;
+
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          combine_usage ();
+          break;
+        }
+    }
+
+
+  int32_t num_inputs = argc - optind - 1;
+
+  if (num_inputs < 2 || operation < 0 || num_threads < 1 || num_threads > CLM_MAX_THREADS) combine_usage ();
+
+
+  CLM_FILE **in = (CLM_FILE **) malloc (num_inputs * sizeof (CLM_FILE *));
+  if (in == NULL)
+    {
+      perror ("Allocating input file memory");
+      exit (-1);
+    }
+
+  sprintf (extra_header, "[OPERATION] = %s\n", operation_name[operation]);
+
+  for (int32_t i = 0 ; i < num_inputs ; i++)
+    {
+      if ((in[i] = clm_open (argv[optind + 1 + i])) == NULL)
+        {
+          perror (argv[optind + 1 + i]);
+          exit (-1);
+        }
+
+      if (in[i]->resolution != in[0]->resolution)
+        {
+          fprintf (stderr, "%s does not have the same resolution as %s\n\n", in[i]->path, in[0]->path);
+          exit (-1);
+        }
+
+      if (strlen (extra_header) + strlen (in[i]->path) + 32 < sizeof (extra_header))
+        sprintf (&extra_header[strlen (extra_header)], "[SOURCE MASK] = %s\n", in[i]->path);
+    }
+
+
+  CLM_FILE *out = clm_create (argv[optind], in[0]->resolution, extra_header);
+  if (out == NULL)
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+
+  //  With -u the threads write blocks without locking (see clm_set_unordered).
+
+  if (unordered && !clm_set_unordered (out)) fprintf (stderr, "Unordered writes aren't supported here, writing in order\n");
+
+
+  QAtomicInt next (0);
+
+  for (int32_t i = 0 ; i < num_threads ; i++) combine_thread[i].combine (in, num_inputs, out, operation, &next);
+  for (int32_t i = 0 ; i < num_threads ; i++) combine_thread[i].wait ();
+
+
+  clm_close (out);
+  for (int32_t i = 0 ; i < num_inputs ; i++) clm_close (in[i]);
+  free (in);
+
+
+  fprintf (stderr, "100%% processed                         \n\n");
+  fflush (stderr);
+
+  return (0);
+}
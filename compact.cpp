@@ -0,0 +1,271 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "compact.hpp"
+
+
+/*!
+  - Fold an overlay (see patch) into a new .clm file.  The threads work through the blocks in parallel.  Blocks
+    that the overlay doesn't touch are copied without uncompressing them.  The others are read, corrected,
+    checked for being all land or all water, and re-compressed.  With -u blocks are written unordered (see
+    clm_set_unordered).
+*/
+
+
+compactThread::compactThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+compactThread::~compactThread ()
+{
+}
+
+
+
+void compactThread::compact (CLM_FILE *in, CLM_OVERLAY *ov, CLM_FILE *out, QAtomicInt *n)
+{
+  QMutexLocker locker (&mutex);
+
+  l_in = in;
+  l_overlay = ov;
+  l_out = out;
+  l_next = n;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+void compactThread::run ()
+{
+  mutex.lock ();
+
+  CLM_FILE *in = l_in;
+  CLM_OVERLAY *overlay = l_overlay;
+  CLM_FILE *out = l_out;
+  QAtomicInt *next = l_next;
+
+  mutex.unlock ();
+
+
+  uint8_t *bits = (uint8_t *) malloc (in->bit_size);
+  uint8_t *work = (uint8_t *) malloc (2 * overlay->bit_size);
+  if (bits == NULL || work == NULL)
+    {
+      perror ("Allocating memory in compactThread");
+      exit (-1);
+    }
+
+
+  int32_t i;
+  while ((i = next->fetchAndAddOrdered (1)) < CLM_BLOCKS)
+    {
+      int32_t lat = i / 360 - 90;
+      int32_t lon = i % 360 - 180;
+
+
+      if (!(i % 648))
+        {
+          fprintf (stderr, "%03d%% processed\r", i / 648);
+          fflush (stderr);
+        }
+
+
+      //  Not touched by the overlay, copy it as is.
+
+      if (!clm_overlay_code (overlay, lat, lon))
+        {
+          uint32_t size;
+          uint32_t address = clm_block_address (in, lat, lon, &size);
+
+          if (address == CLM_UNDEFINED) continue;
+
+          if (address <= CLM_ALL_WATER)
+            {
+              clm_set_code (out, lat, lon, address);
+              continue;
+            }
+
+          uint8_t *raw = clm_read_raw (in, lat, lon, &size);
+
+          if (raw == NULL || clm_write_raw (out, lat, lon, raw, size) < 0)
+            {
+              fprintf (stderr, "\nError copying block %d %d from %s\n", lat, lon, in->path);
+              exit (-1);
+            }
+
+          free (raw);
+          continue;
+        }
+
+
+      int32_t code = clm_read_block (in, lat, lon, bits);
+
+      if (code >= 0) code = clm_overlay_apply (overlay, lat, lon, code, bits, work);
+
+      if (code < 0)
+        {
+          fprintf (stderr, "\nError reading block %d %d from %s or %s\n", lat, lon, in->path, overlay->path);
+          exit (-1);
+        }
+
+      if (code == CLM_MIXED)
+        {
+          if (clm_write_block (out, lat, lon, bits) < 0)
+            {
+              perror (out->path);
+              exit (-1);
+            }
+        }
+      else if (code != CLM_UNDEFINED)
+        {
+          clm_set_code (out, lat, lon, code);
+        }
+    }
+
+
+  free (bits);
+  free (work);
+}
+
+
+
+static void compact_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask compact [-u] [-t NUM_THREADS] INPUT_CLM OVERLAY OUTPUT_CLM\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-u = unordered, threads write blocks with pwrite as they finish them, without locking\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of compute threads (1 to %d, default 4)\n\n", CLM_MAX_THREADS);
+  exit (-1);
+}
+
+
+
+/*!
+  - Apply an overlay to a .clm file and write the result to a new .clm file.
+*/
+
+int32_t compact (int32_t argc, char **argv)
+{
+  int32_t           num_threads = 4, c;
+  uint8_t           unordered = NVFalse;
+  char              extra_header[SWBD_MASK_HEADER_SIZE / 2];
+  compactThread     compact_thread[CLM_MAX_THREADS];
+
+
+  while ((c = getopt (argc, argv, "ut:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'u':
+          unordered = NVTrue;
+          break;
+
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          compact_usage ();
+          break;
+        }
+    }
+
+
+  if (optind + 3 != argc || num_threads < 1 || num_threads > CLM_MAX_THREADS) compact_usage ();
+
+
+  CLM_FILE *in = clm_open (argv[optind]);
+  if (in == NULL)
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+  CLM_OVERLAY *overlay = clm_overlay_open (argv[optind + 1], NVFalse);
+  if (overlay == NULL)
+    {
+      perror (argv[optind + 1]);
+      exit (-1);
+    }
+
+  if (overlay->resolution != in->resolution)
+    {
+      fprintf (stderr, "\n\n%s is %d second, %s is %d second\n\n", overlay->path, overlay->resolution, in->path, in->resolution);
+      exit (-1);
+    }
+
+
+  snprintf (extra_header, sizeof (extra_header), "[SOURCE MASK] = %s\n[SOURCE OVERLAY] = %s\n", in->path, overlay->path);
+
+  CLM_FILE *out = clm_create (argv[optind + 2], in->resolution, extra_header);
+  if (out == NULL)
+    {
+      perror (argv[optind + 2]);
+      exit (-1);
+    }
+
+
+  //  With -u the threads write blocks without locking (see clm_set_unordered).
+
+  if (unordered && !clm_set_unordered (out)) fprintf (stderr, "Unordered writes aren't supported here, writing in order\n");
+
+
+  QElapsedTimer timer;
+  timer.start ();
+
+  QAtomicInt next (0);
+
+  for (int32_t i = 0 ; i < num_threads ; i++) compact_thread[i].compact (in, overlay, out, &next);
+  for (int32_t i = 0 ; i < num_threads ; i++) compact_thread[i].wait ();
+
+
+  int32_t patched = 0;
+  for (int32_t i = 0 ; i < CLM_BLOCKS ; i++) patched += (clm_overlay_code (overlay, i / 360 - 90, i % 360 - 180) != 0);
+
+  clm_close (out);
+  clm_overlay_close (overlay);
+  clm_close (in);
+
+
+  fprintf (stderr, "100%% processed, %d blocks corrected, %.3f seconds\n\n", patched, (double) timer.elapsed () / 1000.0);
+  fflush (stderr);
+
+  return (0);
+}
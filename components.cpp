@@ -0,0 +1,616 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "components.hpp"
+#include "version.h"
+
+
+/*!
+  - Connected component labeling of the water cells of a .clm file.  Each one-degree block is labeled
+    independently (in parallel) using run based union-find (4-connected).  The water runs along the edges
+    of each block are saved and the blocks are then stitched together across the one-degree seams
+    (including the 180 degree seam) with a global union-find.  The largest water body is taken to be the
+    ocean.  Undefined blocks are treated as barriers.  A second parallel pass relabels each block and writes
+    the output mask.
+*/
+
+
+static int32_t find_root (int32_t *parent, int32_t i)
+{
+  while (parent[i] != i)
+    {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+
+  return (i);
+}
+
+
+
+static void join (int32_t *parent, int32_t a, int32_t b)
+{
+  a = find_root (parent, a);
+  b = find_root (parent, b);
+
+
+  //  Always link to the lower index so that a root is never greater than any of its members.
+
+  if (a < b)
+    {
+      parent[b] = a;
+    }
+  else if (b < a)
+    {
+      parent[a] = b;
+    }
+}
+
+
+
+/*!
+  - Find all of the water runs in a mixed block (row by row, south to north) and label them with local
+    component numbers (0 to count - 1).  Returns the number of components.  Labels are assigned in run order
+    so the same block always gets the same labels.
+*/
+
+int32_t label_water_runs (CLM_FILE *clm, uint8_t *bits, std::vector<WATER_RUN> &runs, std::vector<int32_t> &label)
+{
+  int32_t pc = clm->point_count;
+  uint64_t words[CLM_MAX_ROW_WORDS];
+  std::vector<int32_t> row_start (pc + 1);
+
+
+  runs.clear ();
+
+  for (int32_t row = 0 ; row < pc ; row++)
+    {
+      row_start[row] = runs.size ();
+
+      clm_get_row (clm, bits, row, words);
+
+      int32_t col = 0;
+      while ((col = clm_next_bit (words, pc, col, 0)) < pc)
+        {
+          WATER_RUN run;
+
+          run.row = row;
+          run.start = col;
+          run.end = col = clm_next_bit (words, pc, col, 1);
+
+          runs.push_back (run);
+        }
+    }
+
+  row_start[pc] = runs.size ();
+
+
+  //  Union each run with the overlapping runs in the row below it.
+
+  int32_t count = runs.size ();
+  label.resize (count);
+  for (int32_t i = 0 ; i < count ; i++) label[i] = i;
+
+  for (int32_t row = 1 ; row < pc ; row++)
+    {
+      int32_t a = row_start[row - 1], b = row_start[row];
+
+      while (a < row_start[row] && b < row_start[row + 1])
+        {
+          if (runs[a].start < runs[b].end && runs[b].start < runs[a].end) join (label.data (), a, b);
+
+          if (runs[a].end < runs[b].end)
+            {
+              a++;
+            }
+          else
+            {
+              b++;
+            }
+        }
+    }
+
+
+  //  Point every run directly at its root.  Roots always come before their members (and a compacted label is
+  //  never larger than the index of its root) so we can compact the labels in place in a single pass.
+
+  for (int32_t i = 0 ; i < count ; i++) label[i] = find_root (label.data (), i);
+
+  int32_t num = 0;
+  for (int32_t i = 0 ; i < count ; i++)
+    {
+      if (label[i] == i)
+        {
+          label[i] = num++;
+        }
+      else
+        {
+          label[i] = label[label[i]];
+        }
+    }
+
+  return (num);
+}
+
+
+
+//!  Add a run along the west or east edge of a block (rows run south to north), merging with the previous one if possible.
+
+static void add_edge_row (std::vector<EDGE_RUN> &edge, int32_t row, int32_t label)
+{
+  if (!edge.empty () && edge.back ().end == row && edge.back ().label == label)
+    {
+      edge.back ().end = row + 1;
+    }
+  else
+    {
+      EDGE_RUN er = {row, row + 1, label};
+      edge.push_back (er);
+    }
+}
+
+
+
+//!  Join the components of two blocks that touch along a seam.
+
+static void join_edges (int32_t *parent, COMP_BLOCK *a, int32_t a_edge, COMP_BLOCK *b, int32_t b_edge)
+{
+  std::vector<EDGE_RUN> &ea = a->edge[a_edge];
+  std::vector<EDGE_RUN> &eb = b->edge[b_edge];
+  uint32_t i = 0, j = 0;
+
+  while (i < ea.size () && j < eb.size ())
+    {
+      if (ea[i].start < eb[j].end && eb[j].start < ea[i].end) join (parent, a->base + ea[i].label, b->base + eb[j].label);
+
+      if (ea[i].end < eb[j].end)
+        {
+          i++;
+        }
+      else
+        {
+          j++;
+        }
+    }
+}
+
+
+
+componentsThread::componentsThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+componentsThread::~componentsThread ()
+{
+}
+
+
+
+void componentsThread::label (CLM_FILE *in, CLM_FILE *out, COMP_BLOCK *cb, uint8_t *k, QAtomicInt *n, int32_t p)
+{
+  QMutexLocker locker (&mutex);
+
+  l_in = in;
+  l_out = out;
+  l_blocks = cb;
+  l_keep = k;
+  l_next = n;
+  l_pass = p;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+void componentsThread::run ()
+{
+  mutex.lock ();
+
+  CLM_FILE *in = l_in;
+  CLM_FILE *out = l_out;
+  COMP_BLOCK *blocks = l_blocks;
+  uint8_t *keep = l_keep;
+  QAtomicInt *next = l_next;
+  int32_t pass = l_pass;
+
+  mutex.unlock ();
+
+
+  int32_t pc = in->point_count;
+  std::vector<WATER_RUN> runs;
+  std::vector<int32_t> label;
+  std::vector<double> cell_area (pc);
+  uint64_t words[CLM_MAX_ROW_WORDS];
+
+
+  uint8_t *bits = (uint8_t *) malloc (in->bit_size);
+  if (bits == NULL)
+    {
+      perror ("Allocating bits memory in componentsThread");
+      exit (-1);
+    }
+
+
+  int32_t i;
+  while ((i = next->fetchAndAddOrdered (1)) < CLM_BLOCKS)
+    {
+      int32_t lat = i / 360 - 90;
+      int32_t lon = i % 360 - 180;
+      COMP_BLOCK *cb = &blocks[i];
+
+
+      if (!(i % 648))
+        {
+          fprintf (stderr, "Pass %d - %03d%% processed\r", pass, i / 648);
+          fflush (stderr);
+        }
+
+
+      int32_t code = clm_read_block (in, lat, lon, bits);
+
+      if (code < 0)
+        {
+          fprintf (stderr, "\nError reading block %d %d from %s\n", lat, lon, in->path);
+          exit (-1);
+        }
+
+
+      //  Pass 1 - label the block and save the edges.
+
+      if (pass == 1)
+        {
+          cb->count = 0;
+
+          if (code == CLM_ALL_WATER || code == CLM_MIXED)
+            {
+              for (int32_t row = 0 ; row < pc ; row++) cell_area[row] = clm_cell_area (in, lat, row);
+
+              if (code == CLM_ALL_WATER)
+                {
+                  runs.clear ();
+                  label.clear ();
+
+                  for (int32_t row = 0 ; row < pc ; row++)
+                    {
+                      WATER_RUN run = {row, 0, pc};
+                      runs.push_back (run);
+                      label.push_back (0);
+                    }
+
+                  cb->count = 1;
+                }
+              else
+                {
+                  cb->count = label_water_runs (in, bits, runs, label);
+                }
+
+
+              cb->area.assign (cb->count, 0.0);
+
+              for (uint32_t r = 0 ; r < runs.size () ; r++)
+                {
+                  WATER_RUN *run = &runs[r];
+
+                  cb->area[label[r]] += (double) (run->end - run->start) * cell_area[run->row];
+
+                  if (run->row == 0)
+                    {
+                      EDGE_RUN er = {run->start, run->end, label[r]};
+                      cb->edge[COMP_SOUTH].push_back (er);
+                    }
+
+                  if (run->row == pc - 1)
+                    {
+                      EDGE_RUN er = {run->start, run->end, label[r]};
+                      cb->edge[COMP_NORTH].push_back (er);
+                    }
+
+                  if (run->start == 0) add_edge_row (cb->edge[COMP_WEST], run->row, label[r]);
+
+                  if (run->end == pc) add_edge_row (cb->edge[COMP_EAST], run->row, label[r]);
+                }
+            }
+        }
+
+
+      //  Pass 2 - write the output block.
+
+      else
+        {
+          switch (code)
+            {
+            case CLM_UNDEFINED:
+              break;
+
+            case CLM_ALL_LAND:
+              clm_set_code (out, lat, lon, CLM_ALL_LAND);
+              break;
+
+            case CLM_ALL_WATER:
+              clm_set_code (out, lat, lon, keep[cb->base] ? CLM_ALL_WATER : CLM_ALL_LAND);
+              break;
+
+            case CLM_MIXED:
+              label_water_runs (in, bits, runs, label);
+
+
+              //  Turn every run that we're not keeping into land.
+
+              for (uint32_t r = 0 ; r < runs.size () ; )
+                {
+                  int32_t row = runs[r].row;
+                  uint8_t modified = NVFalse;
+
+                  clm_get_row (in, bits, row, words);
+
+                  for ( ; r < runs.size () && runs[r].row == row ; r++)
+                    {
+                      if (!keep[cb->base + label[r]])
+                        {
+                          clm_fill_bits (words, runs[r].start, runs[r].end, 1);
+                          modified = NVTrue;
+                        }
+                    }
+
+                  if (modified) clm_put_row (in, bits, row, words);
+                }
+
+              if (clm_write_block (out, lat, lon, bits) < 0)
+                {
+                  fprintf (stderr, "\nError writing block %d %d to %s\n", lat, lon, out->path);
+                  exit (-1);
+                }
+              break;
+            }
+        }
+    }
+
+
+  free (bits);
+}
+
+
+
+static void components_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask components [-i] [-a MIN_AREA] [-u] [-t NUM_THREADS] INPUT_CLM OUTPUT_CLM\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-i = keep inland water bodies (default is to keep only ocean connected water)\n");
+  fprintf (stderr, "\t-a MIN_AREA = with -i, turn inland water bodies smaller than MIN_AREA square kilometers into land\n");
+  fprintf (stderr, "\t-u = unordered, threads write blocks with pwrite as they finish them, without locking\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of compute threads (1 to %d, default 4)\n\n", CLM_MAX_THREADS);
+  fprintf (stderr, "The largest connected water body in INPUT_CLM is considered to be the ocean.\n\n");
+  exit (-1);
+}
+
+
+
+/*!
+  - Build an ocean connected water mask (or remove small water bodies) from an existing .clm file.
+*/
+
+int32_t components (int32_t argc, char **argv)
+{
+  int32_t           num_threads = 4, c;
+  uint8_t           inland = NVFalse, unordered = NVFalse;
+  double            min_area = 0.0;
+  char              extra_header[2048];
+  componentsThread  comp_thread[CLM_MAX_THREADS];
+
+
+  while ((c = getopt (argc, argv, "ia:ut:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'i':
+          inland = NVTrue;
+          break;
+
+        case 'a':
+          sscanf (optarg, "%lf", &min_area);
+          break;
+
+        case 'u':
+          unordered = NVTrue;
+          break;
+
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          components_usage ();
+          break;
+        }
+    }
+
+
+  if (optind + 2 != argc || num_threads < 1 || num_threads > CLM_MAX_THREADS || min_area < 0.0) components_usage ();
+
+  if (inland && min_area == 0.0)
+    {
+      fprintf (stderr, "Keeping inland water without a minimum area would just copy the input file.\n\n");
+      components_usage ();
+    }
+
+
+  CLM_FILE *in = clm_open (argv[optind]);
+  if (in == NULL)
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+
+  COMP_BLOCK *blocks = new COMP_BLOCK[CLM_BLOCKS];
+
+
+  //  Pass 1 - label all of the blocks.
+
+  QAtomicInt next (0);
+
+  for (int32_t i = 0 ; i < num_threads ; i++) comp_thread[i].label (in, NULL, blocks, NULL, &next, 1);
+  for (int32_t i = 0 ; i < num_threads ; i++) comp_thread[i].wait ();
+
+
+  //  Assign global ids.
+
+  int64_t total = 0;
+  for (int32_t i = 0 ; i < CLM_BLOCKS ; i++)
+    {
+      blocks[i].base = (int32_t) total;
+      total += blocks[i].count;
+    }
+
+  if (total > 0x7fffffffLL)
+    {
+      fprintf (stderr, "\nToo many water components (%lld)\n", (long long) total);
+      exit (-1);
+    }
+
+  fprintf (stderr, "\n%lld local water components\n", (long long) total);
+
+
+  int32_t *parent = (int32_t *) malloc ((total + 1) * sizeof (int32_t));
+  uint8_t *keep = (uint8_t *) calloc (total + 1, sizeof (uint8_t));
+  double *area = (double *) calloc (total + 1, sizeof (double));
+  if (parent == NULL || keep == NULL || area == NULL)
+    {
+      perror ("Allocating component memory");
+      exit (-1);
+    }
+
+  for (int32_t i = 0 ; i < total ; i++) parent[i] = i;
+
+
+  //  Stitch the blocks together across the seams.  The east edge of 179E wraps to the west edge of 180W.
+
+  for (int32_t lat = -90 ; lat < 90 ; lat++)
+    {
+      for (int32_t lon = -180 ; lon < 180 ; lon++)
+        {
+          COMP_BLOCK *cb = &blocks[clm_block_index (lat, lon)];
+
+          if (!cb->count) continue;
+
+          join_edges (parent, cb, COMP_EAST, &blocks[clm_block_index (lat, (lon == 179) ? -180 : lon + 1)], COMP_WEST);
+
+          if (lat < 89) join_edges (parent, cb, COMP_NORTH, &blocks[clm_block_index (lat + 1, lon)], COMP_SOUTH);
+        }
+    }
+
+
+  //  Sum the areas of the global components and find the ocean.
+
+  for (int32_t i = 0 ; i < CLM_BLOCKS ; i++)
+    {
+      for (int32_t j = 0 ; j < blocks[i].count ; j++) area[find_root (parent, blocks[i].base + j)] += blocks[i].area[j];
+
+      blocks[i].area.clear ();
+      for (int32_t j = 0 ; j < 4 ; j++) std::vector<EDGE_RUN> ().swap (blocks[i].edge[j]);
+    }
+
+  int32_t ocean = -1, num_bodies = 0, num_removed = 0;
+  double removed_area = 0.0;
+  for (int32_t i = 0 ; i < total ; i++)
+    {
+      if (parent[i] == i)
+        {
+          num_bodies++;
+          if (ocean < 0 || area[i] > area[ocean]) ocean = i;
+        }
+    }
+
+  for (int32_t i = 0 ; i < total ; i++)
+    {
+      int32_t root = find_root (parent, i);
+
+      keep[i] = (root == ocean || (inland && area[root] >= min_area));
+
+      if (root == i && !keep[i])
+        {
+          num_removed++;
+          removed_area += area[i];
+        }
+    }
+
+  if (ocean >= 0)
+    {
+      fprintf (stderr, "%d water bodies, ocean area = %.1f km2, %d water bodies (%.1f km2) removed\n", num_bodies, area[ocean],
+               num_removed, removed_area);
+    }
+
+
+  //  Pass 2 - relabel the blocks and write the output file.
+
+  sprintf (extra_header, "[SOURCE MASK] = %s\n[OCEAN CONNECTED WATER ONLY] = %s\n[MINIMUM WATER AREA] = %.3f\n", in->path,
+           inland ? "no" : "yes", min_area);
+
+  CLM_FILE *out = clm_create (argv[optind + 1], in->resolution, extra_header);
+  if (out == NULL)
+    {
+      perror (argv[optind + 1]);
+      exit (-1);
+    }
+
+
+  //  With -u the threads write blocks without locking (see clm_set_unordered).
+
+  if (unordered && !clm_set_unordered (out)) fprintf (stderr, "Unordered writes aren't supported here, writing in order\n");
+
+  next.fetchAndStoreOrdered (0);
+
+  for (int32_t i = 0 ; i < num_threads ; i++) comp_thread[i].label (in, out, blocks, keep, &next, 2);
+  for (int32_t i = 0 ; i < num_threads ; i++) comp_thread[i].wait ();
+
+
+  clm_close (out);
+  clm_close (in);
+
+  free (parent);
+  free (keep);
+  free (area);
+  delete[] blocks;
+
+
+  fprintf (stderr, "100%% processed                         \n\n");
+  fflush (stderr);
+
+  return (0);
+}
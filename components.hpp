@@ -0,0 +1,128 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+
+#include <vector>
+
+#include "clm.hpp"
+
+
+//!  A run of water cells [start, end) in a single row of a block (or along one edge of a block).
+
+typedef struct
+{
+  int32_t          row;
+  int32_t          start;
+  int32_t          end;
+} WATER_RUN;
+
+
+//!  A run of cells along a block edge and the local component label it belongs to.
+
+typedef struct
+{
+  int32_t          start;
+  int32_t          end;
+  int32_t          label;
+} EDGE_RUN;
+
+
+#define COMP_SOUTH                   0
+#define COMP_NORTH                   1
+#define COMP_WEST                    2
+#define COMP_EAST                    3
+
+
+//!  Per block results of the first (labeling) pass.
+
+typedef struct
+{
+  int32_t                count;         //!<  Number of local water components
+  int32_t                base;          //!<  Global id of local component 0
+  std::vector<double>    area;          //!<  Area (square kilometers) of each local component
+  std::vector<EDGE_RUN>  edge[4];       //!<  Water runs along the south, north, west, and east edges
+} COMP_BLOCK;
+
+
+int32_t label_water_runs (CLM_FILE *clm, uint8_t *bits, std::vector<WATER_RUN> &runs, std::vector<int32_t> &label);
+int32_t components (int32_t argc, char **argv);
+
+
+class componentsThread:public QThread
+{
+  Q_OBJECT 
+
+
+public:
+
+  componentsThread (QObject *parent = 0);
+  ~componentsThread ();
+
+  void label (CLM_FILE *in = NULL, CLM_FILE *out = NULL, COMP_BLOCK *cb = NULL, uint8_t *k = NULL, QAtomicInt *n = NULL,
+              int32_t p = 0);
+
+
+signals:
+
+
+protected:
+
+
+  QMutex           mutex;
+
+  CLM_FILE         *l_in, *l_out;
+
+  COMP_BLOCK       *l_blocks;
+
+  uint8_t          *l_keep;
+
+  QAtomicInt       *l_next;
+
+  int32_t          l_pass;
+
+
+  void             run ();
+
+
+protected slots:
+
+private:
+};
+
+#endif
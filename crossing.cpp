@@ -0,0 +1,469 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "crossing.hpp"
+
+
+/*!
+  - Land crossing query for straight segments (straight in latitude and longitude, the way they're drawn on a
+    plate carree chart, not great circles).  Segments go the short way around the earth so a segment from 179E to
+    179W crosses the 180 degree meridian.  The one-degree blocks along the segment are walked with a DDA
+    (Amanatides and Woo) traversal.  All water and undefined blocks are skipped in one step and an all land block
+    is hit where the segment enters it.  In mixed blocks we figure out which columns the segment covers in each
+    row that it passes through and look for the first land bit in that span 64 bits at a time.  Blocks are read
+    through a shared block cache so batches of segments can be run on as many threads as you like.
+*/
+
+
+#define CROSSING_BATCH               1000000
+#define CROSSING_CHUNK               256
+
+
+//!  Look for land in block (lat, lon) between segment parameters t_in and t_out.  Returns the hit parameter or -1.0.
+
+static double block_crossing (CLM_CACHE *cache, uint64_t *words, int32_t lat, int32_t lon, double x0, double y0,
+                              double dx, double dy, double t_in, double t_out)
+{
+  uint8_t *bits;
+
+  int32_t ilon = ((lon + 180) % 360 + 360) % 360 - 180;
+
+  int32_t code = clm_cache_get (cache, lat, ilon, &bits);
+
+  if (code == CLM_ALL_LAND) return (t_in);
+
+  if (code != CLM_MIXED) return (-1.0);
+
+
+  //  Block local cell coordinates (u across, v up).
+
+  int32_t pc = cache->clm->point_count;
+  double u0 = (x0 - (double) lon) * (double) pc, du = dx * (double) pc;
+  double v0 = (y0 - (double) lat) * (double) pc, dv = dy * (double) pc;
+
+  int32_t row = (int32_t) floor (v0 + t_in * dv);
+  int32_t end_row = (int32_t) floor (v0 + t_out * dv);
+  row = qMax (0, qMin (pc - 1, row));
+  end_row = qMax (0, qMin (pc - 1, end_row));
+
+  int32_t step = (end_row < row) ? -1 : 1;
+  double hit = -1.0;
+
+  for ( ; ; row += step)
+    {
+      //  The part of the segment that is in this row.
+
+      double ra = t_in, rb = t_out;
+
+      if (dv != 0.0)
+        {
+          double ta = ((double) row - v0) / dv, tb = ((double) (row + 1) - v0) / dv;
+          ra = qMax (t_in, qMin (ta, tb));
+          rb = qMin (t_out, qMax (ta, tb));
+        }
+
+      if (ra <= rb)
+        {
+          double ua = u0 + ra * du, ub = u0 + rb * du;
+          int32_t cmin = qMax (0, qMin (pc - 1, (int32_t) floor (qMin (ua, ub))));
+          int32_t cmax = qMax (0, qMin (pc - 1, (int32_t) floor (qMax (ua, ub))));
+
+          clm_get_row (cache->clm, bits, row, words);
+
+
+          //  First land cell in the direction of travel.
+
+          int32_t col;
+          if (du >= 0.0)
+            {
+              col = clm_next_bit (words, pc, cmin, 1);
+              if (col > cmax) col = -1;
+            }
+          else
+            {
+              col = clm_prev_bit (words, cmax, 1);
+              if (col < cmin) col = -1;
+            }
+
+          if (col >= 0)
+            {
+              hit = ra;
+              if (du > 0.0) hit = qMax (ra, ((double) col - u0) / du);
+              if (du < 0.0) hit = qMax (ra, ((double) (col + 1) - u0) / du);
+              break;
+            }
+        }
+
+      if (row == end_row) break;
+    }
+
+  clm_cache_release (cache, lat, ilon);
+
+  return (hit);
+}
+
+
+
+/*!
+  - Find the first place that the segment from lat0, lon0 to lat1, lon1 crosses land.  Returns 1 (and sets
+    hit_lat and hit_lon) if it does, 0 if it doesn't, or -1 if the segment is outside of the world (or has a NaN end).
+*/
+
+int32_t segment_crossing (CLM_CACHE *cache, double lat0, double lon0, double lat1, double lon1, double *hit_lat,
+                          double *hit_lon)
+{
+  if (!(lat0 >= -90.0 && lat0 <= 90.0 && lat1 >= -90.0 && lat1 <= 90.0 && fabs (lon0) <= 360.0 &&
+        fabs (lon1) <= 360.0)) return (-1);
+
+
+  //  Go the short way around.
+
+  double x0 = lon0, y0 = lat0, dy = lat1 - lat0;
+  double dx = fmod (lon1 - lon0, 360.0);
+  if (dx > 180.0) dx -= 360.0;
+  if (dx < -180.0) dx += 360.0;
+
+
+  //  DDA through the one-degree blocks.
+
+  int32_t bx = (int32_t) floor (x0), by = qMin (89, (int32_t) floor (y0));
+  int32_t step_x = (dx > 0.0) ? 1 : -1, step_y = (dy > 0.0) ? 1 : -1;
+  double t_max_x = 2.0, t_max_y = 2.0, t_delta_x = 0.0, t_delta_y = 0.0;
+
+  if (dx != 0.0)
+    {
+      t_max_x = ((double) (dx > 0.0 ? bx + 1 : bx) - x0) / dx;
+      t_delta_x = 1.0 / fabs (dx);
+    }
+
+  if (dy != 0.0)
+    {
+      t_max_y = ((double) (dy > 0.0 ? by + 1 : by) - y0) / dy;
+      t_delta_y = 1.0 / fabs (dy);
+    }
+
+
+  uint64_t words[CLM_MAX_ROW_WORDS];
+  double t_in = 0.0;
+
+  while (1)
+    {
+      double t_out = qMin (1.0, qMin (t_max_x, t_max_y));
+
+      double t = block_crossing (cache, words, by, bx, x0, y0, dx, dy, t_in, t_out);
+
+      if (t >= 0.0)
+        {
+          *hit_lat = y0 + t * dy;
+          *hit_lon = x0 + t * dx;
+          while (*hit_lon < -180.0) *hit_lon += 360.0;
+          while (*hit_lon >= 180.0) *hit_lon -= 360.0;
+          return (1);
+        }
+
+      if (t_out >= 1.0) break;
+
+      if (t_max_x < t_max_y)
+        {
+          bx += step_x;
+          t_in = t_max_x;
+          t_max_x += t_delta_x;
+        }
+      else
+        {
+          by += step_y;
+          t_in = t_max_y;
+          t_max_y += t_delta_y;
+        }
+
+      if (by < -90 || by > 89) break;
+    }
+
+  return (0);
+}
+
+
+
+crossingThread::crossingThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+crossingThread::~crossingThread ()
+{
+}
+
+
+
+void crossingThread::crossing (CLM_CACHE *c, CROSSING_SEGMENT *s, int32_t ns, QAtomicInt *n)
+{
+  QMutexLocker locker (&mutex);
+
+  l_cache = c;
+  l_segment = s;
+  l_num_segments = ns;
+  l_next = n;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+void crossingThread::run ()
+{
+  mutex.lock ();
+
+  CLM_CACHE *cache = l_cache;
+  CROSSING_SEGMENT *segment = l_segment;
+  int32_t num_segments = l_num_segments;
+  QAtomicInt *next = l_next;
+
+  mutex.unlock ();
+
+
+  //  Segments are handed out in chunks so the threads aren't fighting over the counter.
+
+  int32_t start;
+  while ((start = next->fetchAndAddOrdered (CROSSING_CHUNK)) < num_segments)
+    {
+      int32_t end = qMin (num_segments, start + CROSSING_CHUNK);
+
+      for (int32_t i = start ; i < end ; i++)
+        {
+          CROSSING_SEGMENT *s = &segment[i];
+
+          s->land = segment_crossing (cache, s->lat[0], s->lon[0], s->lat[1], s->lon[1], &s->hit_lat, &s->hit_lon);
+        }
+    }
+}
+
+
+
+static void crossing_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask crossing [-m CACHE_MB] [-s SHM_NAME] [-o OVERLAY] [-t NUM_THREADS] INPUT_CLM [SEGMENT_FILE]\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-m CACHE_MB = megabytes of uncompressed blocks to cache (default 256)\n");
+  fprintf (stderr, "\t-s SHM_NAME = keep the cache in POSIX shared memory SHM_NAME (e.g. /swbd_01) so that it\n");
+  fprintf (stderr, "\t              is shared with other processes using the same name and .clm file\n");
+  fprintf (stderr, "\t-o OVERLAY = apply the corrections in overlay file OVERLAY (see patch, not with -s)\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of compute threads (1 to %d, default 4)\n\n", CLM_MAX_THREADS);
+  fprintf (stderr, "Each line of SEGMENT_FILE (or standard input) is LAT0 LON0 LAT1 LON1.  For each segment one\n");
+  fprintf (stderr, "line is written to standard output.  It is either LAND LAT LON (the first land crossing),\n");
+  fprintf (stderr, "WATER, or INVALID.\n\n");
+  exit (-1);
+}
+
+
+
+/*!
+  - Land crossing of segments in a file (or standard input).  Segments are read and run in batches of
+    CROSSING_BATCH so that memory stays bounded no matter how many there are.  Results are written in input order.
+*/
+
+int32_t crossing (int32_t argc, char **argv)
+{
+  int32_t           num_threads = 4, cache_mb = 256, c;
+  char              string[1024], *shm_name = NULL, *overlay_name = NULL;
+  crossingThread    crossing_thread[CLM_MAX_THREADS];
+
+
+  while ((c = getopt (argc, argv, "m:s:o:t:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'm':
+          sscanf (optarg, "%d", &cache_mb);
+          break;
+
+        case 's':
+          shm_name = optarg;
+          break;
+
+        case 'o':
+          overlay_name = optarg;
+          break;
+
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          crossing_usage ();
+          break;
+        }
+    }
+
+
+  if (optind >= argc || cache_mb < 1 || num_threads < 1 || num_threads > CLM_MAX_THREADS) crossing_usage ();
+
+
+  CLM_FILE *clm = clm_open (argv[optind]);
+  if (clm == NULL)
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+
+  FILE *fp = stdin;
+  if (optind + 1 < argc && (fp = fopen (argv[optind + 1], "r")) == NULL)
+    {
+      perror (argv[optind + 1]);
+      exit (-1);
+    }
+
+
+  CLM_CACHE *cache;
+  if (shm_name != NULL)
+    {
+      if ((cache = clm_cache_create_shared (clm, shm_name, (int64_t) cache_mb * 1048576)) == NULL)
+        {
+          perror (shm_name);
+          exit (-1);
+        }
+    }
+  else
+    {
+      cache = clm_cache_create (clm, (int64_t) cache_mb * 1048576);
+    }
+
+  CROSSING_SEGMENT *segment = (CROSSING_SEGMENT *) malloc (CROSSING_BATCH * sizeof (CROSSING_SEGMENT));
+
+  if (cache == NULL || segment == NULL)
+    {
+      perror ("Allocating crossing memory");
+      exit (-1);
+    }
+
+
+  //  Corrections from an overlay file are applied as blocks are read into the cache.
+
+  CLM_OVERLAY *overlay = NULL;
+  if (overlay_name != NULL)
+    {
+      if ((overlay = clm_overlay_open (overlay_name, NVFalse)) == NULL)
+        {
+          perror (overlay_name);
+          exit (-1);
+        }
+
+      if (!clm_cache_set_overlay (cache, overlay))
+        {
+          fprintf (stderr, "\n\nOverlay %s can't be used with %s (different resolution or a shared cache)\n\n", overlay_name,
+                   clm->path);
+          exit (-1);
+        }
+    }
+
+
+  int64_t total = 0, num_land = 0;
+  int32_t eof = NVFalse;
+
+  while (!eof)
+    {
+      int32_t num_segments = 0;
+
+      while (num_segments < CROSSING_BATCH)
+        {
+          if (fgets (string, sizeof (string), fp) == NULL)
+            {
+              eof = NVTrue;
+              break;
+            }
+
+          CROSSING_SEGMENT *s = &segment[num_segments];
+
+          if (sscanf (string, "%lf %lf %lf %lf", &s->lat[0], &s->lon[0], &s->lat[1], &s->lon[1]) != 4)
+            {
+              //  Keep one output line per input line (blank lines and comments are passed through).
+
+              s->lat[0] = 999.0;
+            }
+
+          num_segments++;
+        }
+
+      if (!num_segments) break;
+
+
+      QAtomicInt next (0);
+
+      for (int32_t i = 0 ; i < num_threads ; i++) crossing_thread[i].crossing (cache, segment, num_segments, &next);
+      for (int32_t i = 0 ; i < num_threads ; i++) crossing_thread[i].wait ();
+
+
+      for (int32_t i = 0 ; i < num_segments ; i++)
+        {
+          switch (segment[i].land)
+            {
+            case 1:
+              fprintf (stdout, "LAND %.9f %.9f\n", segment[i].hit_lat, segment[i].hit_lon);
+              num_land++;
+              break;
+
+            case 0:
+              fprintf (stdout, "WATER\n");
+              break;
+
+            default:
+              fprintf (stdout, "INVALID\n");
+              break;
+            }
+        }
+
+      total += num_segments;
+
+      fprintf (stderr, "%lld segments processed\r", (long long) total);
+      fflush (stderr);
+    }
+
+
+  fprintf (stderr, "%lld segments processed, %lld cross land, %lld cache misses\n\n", (long long) total,
+           (long long) num_land, (long long) cache->misses);
+  fflush (stderr);
+
+
+  if (fp != stdin) fclose (fp);
+  free (segment);
+  clm_cache_destroy (cache);
+  clm_overlay_close (overlay);
+  clm_close (clm);
+
+  return (0);
+}
@@ -0,0 +1,99 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef CROSSING_H
+#define CROSSING_H
+
+
+#include "cache.hpp"
+
+
+//!  One segment of a crossing batch.
+
+typedef struct
+{
+  double           lat[2];                  //!<  Segment end point latitudes
+  double           lon[2];                  //!<  Segment end point longitudes
+  int32_t          land;                    //!<  1 if the segment crosses land, 0 if not, -1 if the segment is invalid
+  double           hit_lat;                 //!<  First land crossing latitude
+  double           hit_lon;                 //!<  First land crossing longitude
+} CROSSING_SEGMENT;
+
+
+int32_t crossing (int32_t argc, char **argv);
+int32_t segment_crossing (CLM_CACHE *cache, double lat0, double lon0, double lat1, double lon1, double *hit_lat,
+                          double *hit_lon);
+
+
+class crossingThread:public QThread
+{
+  Q_OBJECT 
+
+
+public:
+
+  crossingThread (QObject *parent = 0);
+  ~crossingThread ();
+
+  void crossing (CLM_CACHE *c = NULL, CROSSING_SEGMENT *s = NULL, int32_t ns = 0, QAtomicInt *n = NULL);
+
+
+signals:
+
+
+protected:
+
+
+  QMutex           mutex;
+
+  CLM_CACHE        *l_cache;
+
+  CROSSING_SEGMENT *l_segment;
+
+  int32_t          l_num_segments;
+
+  QAtomicInt       *l_next;
+
+
+  void             run ();
+
+
+protected slots:
+
+private:
+};
+
+#endif
@@ -0,0 +1,939 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "daemon.hpp"
+#include "async.hpp"
+
+#ifndef NVWIN3X
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#endif
+
+
+/*!
+  - Local land/water query daemon.  One process opens the .clm files and keeps a single cache of uncompressed
+    blocks (cache.cpp) that all of its connections share.  Each of the daemon threads accepts connections on the
+    Unix domain socket and answers the requests on them in order.  Responses are buffered and only written when
+    the buffer fills or there are no more requests waiting to be read, so pipelined requests are answered with
+    very few system calls.  The "bench" mode is a client that measures the latency and throughput of the daemon
+    (or, with -l, of the non-blocking queries in async.cpp on a local file).
+    Unix domain sockets aren't used on Windows so neither mode is available there.
+*/
+
+
+#ifndef NVWIN3X
+
+//  Buffered connection.
+
+typedef struct
+{
+  int32_t          fd;
+  uint8_t          in[DAEMON_BUFFER_SIZE];
+  int32_t          in_pos, in_len;
+  uint8_t          out[DAEMON_BUFFER_SIZE];
+  int32_t          out_len;
+} DAEMON_STREAM;
+
+
+
+static int32_t stream_flush (DAEMON_STREAM *s)
+{
+  int32_t pos = 0;
+
+  while (pos < s->out_len)
+    {
+      ssize_t n = send (s->fd, &s->out[pos], s->out_len - pos, MSG_NOSIGNAL);
+
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return (-1);
+
+      pos += n;
+    }
+
+  s->out_len = 0;
+
+  return (0);
+}
+
+
+
+static int32_t stream_write (DAEMON_STREAM *s, void *data, int32_t size)
+{
+  uint8_t *d = (uint8_t *) data;
+
+  while (size)
+    {
+      if (s->out_len == DAEMON_BUFFER_SIZE && stream_flush (s)) return (-1);
+
+      int32_t n = qMin (size, DAEMON_BUFFER_SIZE - s->out_len);
+
+      memcpy (&s->out[s->out_len], d, n);
+      s->out_len += n;
+      d += n;
+      size -= n;
+    }
+
+  return (0);
+}
+
+
+
+//!  Read exactly size bytes.  Anything waiting to be written is flushed before we block.
+
+static int32_t stream_read (DAEMON_STREAM *s, void *data, int32_t size)
+{
+  uint8_t *d = (uint8_t *) data;
+
+  while (size)
+    {
+      if (s->in_pos == s->in_len)
+        {
+          if (s->out_len && stream_flush (s)) return (-1);
+
+          ssize_t n = recv (s->fd, s->in, DAEMON_BUFFER_SIZE, 0);
+
+          if (n < 0 && errno == EINTR) continue;
+          if (n <= 0) return (-1);
+
+          s->in_pos = 0;
+          s->in_len = n;
+        }
+
+      int32_t n = qMin (size, s->in_len - s->in_pos);
+
+      memcpy (d, &s->in[s->in_pos], n);
+      s->in_pos += n;
+      d += n;
+      size -= n;
+    }
+
+  return (0);
+}
+
+
+
+//!  Header only response to a point or box request with coordinates that aren't on the earth.
+
+static int32_t bad_coordinates (DAEMON_STREAM *s, DAEMON_HEADER *header)
+{
+  header->status = DAEMON_BAD_COORDINATES;
+  header->count = 0;
+
+  return (stream_write (s, header, sizeof (DAEMON_HEADER)));
+}
+
+
+
+//!  Answer requests on one connection until it is closed, goes idle, or a bad request is received.
+
+static void serve_connection (DAEMON_STREAM *s, CLM_CACHE **cache, int32_t num_files)
+{
+  DAEMON_HEADER header;
+  double point[2 * 4096], lat[4096], lon[4096], box[4];
+  int8_t result[4096];
+  uint64_t order[4096];
+  int64_t cells[3];
+  double area[3];
+
+
+  while (!stream_read (s, &header, sizeof (DAEMON_HEADER)))
+    {
+      int32_t bad = (header.file >= num_files);
+
+      switch (header.type)
+        {
+        case DAEMON_POINT:
+          if (stream_read (s, point, 2 * sizeof (double))) return;
+          if (bad) break;
+
+          if (!(point[0] >= -90.0 && point[0] <= 90.0 && point[1] >= -360.0 && point[1] <= 360.0))
+            {
+              if (bad_coordinates (s, &header)) return;
+              continue;
+            }
+
+          result[0] = (int8_t) clm_cache_point (cache[header.file], point[0], point[1]);
+
+          header.status = DAEMON_OK;
+          if (stream_write (s, &header, sizeof (DAEMON_HEADER)) || stream_write (s, result, 1)) return;
+          continue;
+
+        case DAEMON_BATCH:
+          if (header.count > DAEMON_MAX_BATCH) bad = NVTrue;
+
+          header.status = bad ? DAEMON_BAD_REQUEST : DAEMON_OK;
+          if (!bad && stream_write (s, &header, sizeof (DAEMON_HEADER))) return;
+
+
+          //  Points are read and answered 4096 at a time (sorted by block) so memory doesn't depend on the batch
+          //  size.
+
+          for (uint32_t i = 0 ; i < header.count && !bad ; i += 4096)
+            {
+              int32_t n = (int32_t) qMin (header.count - i, (uint32_t) 4096);
+
+              if (stream_read (s, point, n * 2 * sizeof (double))) return;
+
+              for (int32_t j = 0 ; j < n ; j++)
+                {
+                  lat[j] = point[2 * j];
+                  lon[j] = point[2 * j + 1];
+                }
+
+              clm_cache_points (cache[header.file], n, lat, lon, result, order);
+
+              if (stream_write (s, result, n)) return;
+            }
+
+          if (bad) break;
+          continue;
+
+        case DAEMON_BOX:
+          if (stream_read (s, box, 4 * sizeof (double))) return;
+          if (bad) break;
+
+          if (!(box[0] >= -90.0 && box[0] <= 90.0 && box[2] >= -90.0 && box[2] <= 90.0 && box[1] >= -360.0 &&
+                box[1] <= 360.0 && box[3] >= -360.0 && box[3] <= 360.0))
+            {
+              if (bad_coordinates (s, &header)) return;
+              continue;
+            }
+
+          clm_cache_box (cache[header.file], box[0], box[1], box[2], box[3], cells, area);
+
+          header.status = DAEMON_OK;
+          if (stream_write (s, &header, sizeof (DAEMON_HEADER)) || stream_write (s, cells, sizeof (cells)) ||
+              stream_write (s, area, sizeof (area))) return;
+          continue;
+        }
+
+
+      //  We can't find the next request after a bad one so we tell the client and hang up.
+
+      header.status = DAEMON_BAD_REQUEST;
+      header.count = 0;
+      stream_write (s, &header, sizeof (DAEMON_HEADER));
+      stream_flush (s);
+      return;
+    }
+}
+
+#endif
+
+
+
+daemonThread::daemonThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+daemonThread::~daemonThread ()
+{
+}
+
+
+
+void daemonThread::serve (int32_t fd, CLM_CACHE **c, int32_t nf)
+{
+  QMutexLocker locker (&mutex);
+
+  l_listen_fd = fd;
+  l_cache = c;
+  l_num_files = nf;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+void daemonThread::run ()
+{
+  mutex.lock ();
+
+  int32_t listen_fd = l_listen_fd;
+  CLM_CACHE **cache = l_cache;
+  int32_t num_files = l_num_files;
+
+  mutex.unlock ();
+
+
+#ifndef NVWIN3X
+
+  DAEMON_STREAM *s = (DAEMON_STREAM *) malloc (sizeof (DAEMON_STREAM));
+  if (s == NULL)
+    {
+      perror ("Allocating connection memory");
+      exit (-1);
+    }
+
+
+  while (1)
+    {
+      int32_t fd = accept (listen_fd, NULL, NULL);
+
+      if (fd < 0)
+        {
+          if (errno == EINTR || errno == ECONNABORTED) continue;
+
+          perror ("accept");
+          break;
+        }
+
+      //  Don't let an idle (or stalled) client keep this thread to itself.
+
+      struct timeval timeout = {DAEMON_IDLE_TIMEOUT, 0};
+      setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+      setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+
+      s->fd = fd;
+      s->in_pos = s->in_len = s->out_len = 0;
+
+      serve_connection (s, cache, num_files);
+
+      close (fd);
+    }
+
+  free (s);
+
+#endif
+}
+
+
+
+static void serve_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask serve [-m CACHE_MB] [-r] [-s SHM_NAME] [-t NUM_THREADS] SOCKET_PATH INPUT_CLM [INPUT_CLM ...]\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-m CACHE_MB = megabytes of uncompressed blocks to cache, shared by all of the files\n");
+  fprintf (stderr, "\t              (default 1024)\n");
+  fprintf (stderr, "\t-r = hold the cached blocks in run-length form (many more blocks fit in CACHE_MB, not with -s)\n");
+  fprintf (stderr, "\t-s SHM_NAME = keep the caches in POSIX shared memory SHM_NAME_0, SHM_NAME_1, ... (one per\n");
+  fprintf (stderr, "\t              file) so that other processes can share them\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of connections served at once (1 to %d, default 4)\n\n", CLM_MAX_THREADS);
+  fprintf (stderr, "Serves point, batch, and box queries (see daemon.hpp) on a Unix domain socket until it is\n");
+  fprintf (stderr, "killed.  Requests select a file by its position in the list (0 is the first).\n\n");
+  exit (-1);
+}
+
+
+
+/*!
+  - Run the query daemon.
+*/
+
+int32_t serve (int32_t argc, char **argv)
+{
+#ifdef NVWIN3X
+
+  fprintf (stderr, "The query daemon is not available on Windows\n\n");
+  return (-1);
+
+#else
+
+  int32_t           num_threads = 4, cache_mb = 1024, c;
+  uint8_t           runs = NVFalse;
+  char              *shm_name = NULL, name[512];
+  CLM_FILE          *clm[DAEMON_MAX_FILES];
+  CLM_CACHE         *cache[DAEMON_MAX_FILES];
+  daemonThread      daemon_thread[CLM_MAX_THREADS];
+
+
+  while ((c = getopt (argc, argv, "m:rs:t:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'm':
+          sscanf (optarg, "%d", &cache_mb);
+          break;
+
+        case 'r':
+          runs = NVTrue;
+          break;
+
+        case 's':
+          shm_name = optarg;
+          break;
+
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          serve_usage ();
+          break;
+        }
+    }
+
+
+  int32_t num_files = argc - optind - 1;
+
+  if (num_files < 1 || num_files > DAEMON_MAX_FILES || cache_mb < 1 || num_threads < 1 ||
+      num_threads > CLM_MAX_THREADS || (runs && shm_name != NULL)) serve_usage ();
+
+
+  for (int32_t i = 0 ; i < num_files ; i++)
+    {
+      if ((clm[i] = clm_open (argv[optind + 1 + i])) == NULL)
+        {
+          perror (argv[optind + 1 + i]);
+          exit (-1);
+        }
+
+      if (shm_name != NULL)
+        {
+          snprintf (name, sizeof (name), "%s_%d", shm_name, i);
+
+          if ((cache[i] = clm_cache_create_shared (clm[i], name, (int64_t) cache_mb * 1048576 / num_files)) == NULL)
+            {
+              perror (name);
+              exit (-1);
+            }
+        }
+      else if ((cache[i] = runs ? clm_cache_create_runs (clm[i], (int64_t) cache_mb * 1048576 / num_files) :
+                clm_cache_create (clm[i], (int64_t) cache_mb * 1048576 / num_files)) == NULL)
+        {
+          perror ("Allocating cache memory");
+          exit (-1);
+        }
+    }
+
+
+  struct sockaddr_un addr;
+  char *path = argv[optind];
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+
+  if (strlen (path) >= sizeof (addr.sun_path))
+    {
+      fprintf (stderr, "Socket path %s is too long\n\n", path);
+      exit (-1);
+    }
+
+  strcpy (addr.sun_path, path);
+
+
+  //  Remove a socket left over from a previous run (but nothing else).
+
+  struct stat st;
+  if (!lstat (path, &st) && S_ISSOCK (st.st_mode)) unlink (path);
+
+
+  int32_t fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || bind (fd, (struct sockaddr *) &addr, sizeof (addr)) || listen (fd, 128))
+    {
+      perror (path);
+      exit (-1);
+    }
+
+  fprintf (stderr, "Serving %d file(s) on %s\n\n", num_files, path);
+  fflush (stderr);
+
+
+  for (int32_t i = 0 ; i < num_threads ; i++) daemon_thread[i].serve (fd, cache, num_files);
+  for (int32_t i = 0 ; i < num_threads ; i++) daemon_thread[i].wait ();
+
+
+  close (fd);
+  unlink (path);
+
+  for (int32_t i = 0 ; i < num_files ; i++)
+    {
+      clm_cache_destroy (cache[i]);
+      clm_close (clm[i]);
+    }
+
+  return (0);
+
+#endif
+}
+
+
+
+#ifndef NVWIN3X
+
+static double bench_time ()
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ((double) ts.tv_sec + (double) ts.tv_nsec * 1.0e-9);
+}
+
+
+
+static int32_t compare_doubles (const void *a, const void *b)
+{
+  double da = *(double *) a, db = *(double *) b;
+
+  return ((da > db) - (da < db));
+}
+
+
+
+//!  Completion callback for bench_local (counts the queries that were answered).
+
+static void bench_callback (CLM_QUERY *, void *data)
+{
+  ((QAtomicInt *) data)->fetchAndAddOrdered (1);
+}
+
+
+
+static void bench_report (int32_t num_requests, int32_t batch, int32_t depth, double elapsed, int64_t num_land,
+                          double *latency)
+{
+  qsort (latency, num_requests, sizeof (double), compare_doubles);
+
+  fprintf (stdout, "%d requests of %d point(s) with pipeline depth %d in %.3f seconds\n", num_requests, batch, depth,
+           elapsed);
+  fprintf (stdout, "%.0f requests/second, %.0f points/second, %.3f%% land\n", (double) num_requests / elapsed,
+           (double) num_requests * (double) batch / elapsed,
+           100.0 * (double) num_land / ((double) num_requests * (double) batch));
+  fprintf (stdout, "Latency (microseconds): min %.1f, median %.1f, 99%% %.1f, max %.1f\n", latency[0] * 1.0e6,
+           latency[num_requests / 2] * 1.0e6, latency[(int32_t) ((double) num_requests * 0.99)] * 1.0e6,
+           latency[num_requests - 1] * 1.0e6);
+}
+
+
+
+/*!
+  - The same benchmark on a local .clm file through the non-blocking queries (async.hpp), with PIPELINE_DEPTH
+    queries outstanding.  Queries are waited for in the order they were submitted.  Every result is checked
+    against clm_cache_point on a second, private cache (not counted in the times) and the callbacks are counted,
+    so this also tests that every query is answered exactly once with the right result.  The pool statistics show
+    how many queries were answered without a read and how many waits joined a read that was already queued.
+*/
+
+static void bench_local (char *path, int32_t num_requests, int32_t batch, int32_t depth, int32_t cache_mb,
+                         int32_t num_threads, double south, double west, double north, double east)
+{
+  CLM_FILE *clm = clm_open (path);
+  CLM_FILE *check_clm = clm_open (path);
+  if (clm == NULL || check_clm == NULL)
+    {
+      perror (path);
+      exit (-1);
+    }
+
+  CLM_CACHE *cache = clm_cache_create (clm, (int64_t) cache_mb * 1048576);
+  CLM_CACHE *check = clm_cache_create (check_clm, (int64_t) cache_mb * 1048576);
+  if (cache == NULL || check == NULL)
+    {
+      perror ("Allocating cache memory");
+      exit (-1);
+    }
+
+  CLM_ASYNC *async = clm_async_create (cache, num_threads);
+
+
+  //  Each pipeline slot has its own points and results since they have to stay put until the query is done.
+
+  CLM_QUERY **query = (CLM_QUERY **) malloc (depth * sizeof (CLM_QUERY *));
+  double *lat = (double *) malloc ((int64_t) depth * batch * sizeof (double));
+  double *lon = (double *) malloc ((int64_t) depth * batch * sizeof (double));
+  int8_t *result = (int8_t *) malloc ((int64_t) depth * batch);
+  double *sent = (double *) malloc (num_requests * sizeof (double));
+  double *latency = (double *) malloc (num_requests * sizeof (double));
+
+  if (query == NULL || lat == NULL || lon == NULL || result == NULL || sent == NULL || latency == NULL)
+    {
+      perror ("Allocating benchmark memory");
+      exit (-1);
+    }
+
+
+  QAtomicInt answered (0);
+  int64_t num_land = 0, wrong = 0;
+  int32_t num_sent = 0, num_received = 0;
+  double checking = 0.0;
+
+  srand (1);
+
+  double start = bench_time ();
+
+  while (num_received < num_requests)
+    {
+      while (num_sent < num_requests && num_sent - num_received < depth)
+        {
+          int32_t slot = num_sent % depth;
+          double *la = &lat[(int64_t) slot * batch], *lo = &lon[(int64_t) slot * batch];
+
+          for (int32_t i = 0 ; i < batch ; i++)
+            {
+              la[i] = south + (north - south) * ((double) rand () / ((double) RAND_MAX + 1.0));
+              lo[i] = west + (east - west) * ((double) rand () / ((double) RAND_MAX + 1.0));
+            }
+
+          sent[num_sent] = bench_time ();
+
+          if (batch > 1)
+            {
+              query[slot] = clm_async_batch (async, batch, la, lo, &result[(int64_t) slot * batch], bench_callback,
+                                             &answered);
+            }
+          else
+            {
+              query[slot] = clm_async_point (async, la[0], lo[0], bench_callback, &answered);
+            }
+
+          num_sent++;
+        }
+
+
+      int32_t slot = num_received % depth;
+
+      clm_query_wait (async, query[slot]);
+
+      latency[num_received] = bench_time () - sent[num_received];
+
+
+      double begin = bench_time ();
+
+      for (int32_t i = 0 ; i < batch ; i++)
+        {
+          int64_t k = (int64_t) slot * batch + i;
+          int32_t value = (batch > 1) ? result[k] : query[slot]->result;
+
+          if (value != clm_cache_point (check, lat[k], lon[k])) wrong++;
+          if (value == 1) num_land++;
+        }
+
+      checking += bench_time () - begin;
+
+      clm_query_free (query[slot]);
+      num_received++;
+    }
+
+  double elapsed = bench_time () - start - checking;
+
+
+  bench_report (num_requests, batch, depth, elapsed, num_land, latency);
+
+  fprintf (stdout, "%lld answered when submitted, %lld block reads, %lld waits joined a queued read\n",
+           (long long) async->immediate, (long long) async->block_reads, (long long) async->coalesced);
+  fprintf (stdout, "%d callbacks, %lld wrong results\n", answered.fetchAndAddOrdered (0), (long long) wrong);
+
+  clm_async_destroy (async);
+  clm_cache_destroy (cache);
+  clm_cache_destroy (check);
+  clm_close (clm);
+  clm_close (check_clm);
+
+  free (query);
+  free (lat);
+  free (lon);
+  free (result);
+  free (sent);
+  free (latency);
+
+  if (wrong || answered.fetchAndAddOrdered (0) != num_requests)
+    {
+      fprintf (stderr, "Non-blocking query results don't match\n\n");
+      exit (-1);
+    }
+}
+
+#endif
+
+
+
+static void bench_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask bench [-n NUM_REQUESTS] [-b BATCH_SIZE] [-p PIPELINE_DEPTH] [-f FILE]\n");
+  fprintf (stderr, "                       [-a SOUTH,WEST,NORTH,EAST] SOCKET_PATH\n\n");
+  fprintf (stderr, "   or: swbd_mask bench -l [-m CACHE_MB] [-t NUM_THREADS] [-n NUM_REQUESTS] [-b BATCH_SIZE]\n");
+  fprintf (stderr, "                       [-p PIPELINE_DEPTH] [-a SOUTH,WEST,NORTH,EAST] INPUT_CLM\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-n NUM_REQUESTS = number of requests to send (default 100000)\n");
+  fprintf (stderr, "\t-b BATCH_SIZE = points per request (default 1, more than 1 sends batch requests)\n");
+  fprintf (stderr, "\t-p PIPELINE_DEPTH = requests sent before waiting for a response (default 1)\n");
+  fprintf (stderr, "\t-f FILE = index of the file to query (default 0)\n");
+  fprintf (stderr, "\t-a SOUTH,WEST,NORTH,EAST = area to pick random points from (default the whole world)\n");
+  fprintf (stderr, "\t-l = query INPUT_CLM in this process with the non-blocking queries instead of the daemon\n");
+  fprintf (stderr, "\t-m CACHE_MB = block cache size in megabytes with -l (default 1024)\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of read threads with -l (1 to %d, default 4)\n\n", CLM_MAX_THREADS);
+  exit (-1);
+}
+
+
+
+/*!
+  - Latency and throughput benchmark client for the query daemon.  Random points are sent as point (or batch)
+    requests keeping PIPELINE_DEPTH requests outstanding.  The time from sending each request to getting its
+    response is recorded.
+*/
+
+int32_t bench (int32_t argc, char **argv)
+{
+#ifdef NVWIN3X
+
+  fprintf (stderr, "The query daemon is not available on Windows\n\n");
+  return (-1);
+
+#else
+
+  int32_t           num_requests = 100000, batch = 1, depth = 1, file = 0, cache_mb = 1024, num_threads = 4, c;
+  double            south = -90.0, west = -180.0, north = 90.0, east = 180.0;
+  uint8_t           local = NVFalse;
+
+
+  while ((c = getopt (argc, argv, "n:b:p:f:a:lm:t:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'n':
+          sscanf (optarg, "%d", &num_requests);
+          break;
+
+        case 'b':
+          sscanf (optarg, "%d", &batch);
+          break;
+
+        case 'p':
+          sscanf (optarg, "%d", &depth);
+          break;
+
+        case 'f':
+          sscanf (optarg, "%d", &file);
+          break;
+
+        case 'a':
+          if (sscanf (optarg, "%lf,%lf,%lf,%lf", &south, &west, &north, &east) != 4) bench_usage ();
+          break;
+
+        case 'l':
+          local = NVTrue;
+          break;
+
+        case 'm':
+          sscanf (optarg, "%d", &cache_mb);
+          break;
+
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          bench_usage ();
+          break;
+        }
+    }
+
+
+  if (optind + 1 != argc || num_requests < 1 || batch < 1 || batch > DAEMON_MAX_BATCH || depth < 1 || file < 0 ||
+      file >= DAEMON_MAX_FILES || south >= north || west >= east || cache_mb < 1 || num_threads < 1 ||
+      num_threads > CLM_MAX_THREADS) bench_usage ();
+
+
+  if (local)
+    {
+      bench_local (argv[optind], num_requests, batch, depth, cache_mb, num_threads, south, west, north, east);
+      return (0);
+    }
+
+
+  struct sockaddr_un addr;
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strncpy (addr.sun_path, argv[optind], sizeof (addr.sun_path) - 1);
+
+  DAEMON_STREAM *s = (DAEMON_STREAM *) calloc (1, sizeof (DAEMON_STREAM));
+  double *sent = (double *) malloc (num_requests * sizeof (double));
+  double *latency = (double *) malloc (num_requests * sizeof (double));
+  double *point = (double *) malloc (batch * 2 * sizeof (double));
+
+  if (s == NULL || sent == NULL || latency == NULL || point == NULL)
+    {
+      perror ("Allocating benchmark memory");
+      exit (-1);
+    }
+
+  s->fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (s->fd < 0 || connect (s->fd, (struct sockaddr *) &addr, sizeof (addr)))
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+
+  //  Requests are appended to "out" and responses are collected in "response" as the socket allows, so that a deep
+  //  pipeline of big batches can't fill both socket buffers and leave us and the daemon waiting on each other.
+
+  int32_t request_size = sizeof (DAEMON_HEADER) + batch * 2 * sizeof (double);
+  int32_t response_size = sizeof (DAEMON_HEADER) + batch;
+  int32_t out_size = qMax (request_size, DAEMON_BUFFER_SIZE);
+  uint8_t *out = (uint8_t *) malloc (out_size);
+  uint8_t *response = (uint8_t *) malloc (response_size);
+
+  if (out == NULL || response == NULL)
+    {
+      perror ("Allocating benchmark memory");
+      exit (-1);
+    }
+
+
+  DAEMON_HEADER header;
+  int64_t num_land = 0;
+  int32_t num_sent = 0, num_received = 0, out_pos = 0, out_len = 0, response_pos = 0;
+
+  srand (1);
+
+  double start = bench_time ();
+
+  while (num_received < num_requests)
+    {
+      //  Keep the pipeline full (as far as the output buffer goes).
+
+      if (out_pos == out_len) out_pos = out_len = 0;
+
+      while (num_sent < num_requests && num_sent - num_received < depth && out_len + request_size <= out_size)
+        {
+          header.type = (batch > 1) ? DAEMON_BATCH : DAEMON_POINT;
+          header.file = file;
+          header.status = 0;
+          header.id = num_sent;
+          header.count = batch;
+
+          for (int32_t i = 0 ; i < batch ; i++)
+            {
+              point[2 * i] = south + (north - south) * ((double) rand () / ((double) RAND_MAX + 1.0));
+              point[2 * i + 1] = west + (east - west) * ((double) rand () / ((double) RAND_MAX + 1.0));
+            }
+
+          memcpy (&out[out_len], &header, sizeof (DAEMON_HEADER));
+          memcpy (&out[out_len + sizeof (DAEMON_HEADER)], point, batch * 2 * sizeof (double));
+          out_len += request_size;
+
+          sent[num_sent++] = bench_time ();
+        }
+
+
+      struct pollfd pfd;
+
+      pfd.fd = s->fd;
+      pfd.events = POLLIN | ((out_pos < out_len) ? POLLOUT : 0);
+      pfd.revents = 0;
+
+      if (poll (&pfd, 1, -1) < 0)
+        {
+          if (errno == EINTR) continue;
+
+          perror ("Waiting for the daemon");
+          exit (-1);
+        }
+
+      if (pfd.revents & POLLOUT)
+        {
+          ssize_t n = send (s->fd, &out[out_pos], out_len - out_pos, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+          if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+              perror ("Sending request");
+              exit (-1);
+            }
+
+          if (n > 0) out_pos += n;
+        }
+
+      if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+
+      ssize_t n = recv (s->fd, s->in, DAEMON_BUFFER_SIZE, MSG_DONTWAIT);
+
+      if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+
+      if (n <= 0)
+        {
+          perror ("Reading response");
+          exit (-1);
+        }
+
+
+      //  Pick the responses out of what we got (they may be split across reads).
+
+      for (int32_t pos = 0 ; pos < n ; )
+        {
+          int32_t count = qMin ((int32_t) n - pos, response_size - response_pos);
+
+          memcpy (&response[response_pos], &s->in[pos], count);
+          response_pos += count;
+          pos += count;
+
+          if (response_pos < response_size) break;
+
+          response_pos = 0;
+
+          memcpy (&header, response, sizeof (DAEMON_HEADER));
+
+          if (header.status != DAEMON_OK || header.id != (uint32_t) num_received)
+            {
+              fprintf (stderr, "Bad response to request %d (status %d, ID %d)\n\n", num_received, header.status, header.id);
+              exit (-1);
+            }
+
+          latency[num_received] = bench_time () - sent[num_received];
+          num_received++;
+
+          for (int32_t i = 0 ; i < batch ; i++) if ((int8_t) response[sizeof (DAEMON_HEADER) + i] == 1) num_land++;
+        }
+    }
+
+  double elapsed = bench_time () - start;
+
+
+  bench_report (num_requests, batch, depth, elapsed, num_land, latency);
+
+
+  close (s->fd);
+  free (s);
+  free (out);
+  free (response);
+  free (sent);
+  free (latency);
+  free (point);
+
+  return (0);
+
+#endif
+}
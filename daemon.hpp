@@ -0,0 +1,125 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+
+#include "cache.hpp"
+
+
+/*!
+  - Query daemon protocol.  Every request and response starts with a DAEMON_HEADER followed by the payload.
+    Everything is in host byte order since the daemon only listens on a local (Unix domain) socket.  Requests may
+    be pipelined (sent without waiting for the responses), responses come back in the order of the requests.
+
+    <pre>
+    Type            Request payload                         Response payload
+    DAEMON_POINT    double lat, lon                         int8_t result
+    DAEMON_BATCH    count * (double lat, lon)               count * int8_t result
+    DAEMON_BOX      double south, west, north, east        int64_t cells[3], double area[3]
+    </pre>
+
+    Point results are 1 for land, 0 for water, and -1 for undefined.  Box cells and areas (square kilometers)
+    are land, water, and undefined (see clm_cache_box).  A point or box with a latitude outside -90 to 90 or a
+    longitude outside -360 to 360 (or NaN) gets a DAEMON_BAD_COORDINATES header with no payload and the connection
+    stays open (batch points like that are just undefined).  Anything else that's wrong gets DAEMON_BAD_REQUEST
+    and the connection is closed.  Connections that are idle for DAEMON_IDLE_TIMEOUT seconds are closed.
+*/
+
+#define DAEMON_POINT                 1
+#define DAEMON_BATCH                 2
+#define DAEMON_BOX                   3
+
+#define DAEMON_OK                    0
+#define DAEMON_BAD_REQUEST           1
+#define DAEMON_BAD_COORDINATES       2
+
+#define DAEMON_MAX_FILES             16
+#define DAEMON_MAX_BATCH             16777216
+#define DAEMON_BUFFER_SIZE           65536
+#define DAEMON_IDLE_TIMEOUT          30
+
+
+typedef struct
+{
+  uint8_t          type;                    //!<  DAEMON_POINT, DAEMON_BATCH, or DAEMON_BOX
+  uint8_t          file;                    //!<  Index of the .clm file (in the order they were given to serve)
+  uint16_t         status;                  //!<  Response only, DAEMON_OK, DAEMON_BAD_REQUEST, or DAEMON_BAD_COORDINATES
+  uint32_t         id;                      //!<  Caller's request ID (returned in the response)
+  uint32_t         count;                   //!<  Number of points for DAEMON_BATCH, otherwise 1
+} DAEMON_HEADER;
+
+
+int32_t serve (int32_t argc, char **argv);
+int32_t bench (int32_t argc, char **argv);
+
+
+class daemonThread:public QThread
+{
+  Q_OBJECT 
+
+
+public:
+
+  daemonThread (QObject *parent = 0);
+  ~daemonThread ();
+
+  void serve (int32_t fd = -1, CLM_CACHE **c = NULL, int32_t nf = 0);
+
+
+signals:
+
+
+protected:
+
+
+  QMutex           mutex;
+
+  int32_t          l_listen_fd, l_num_files;
+
+  CLM_CACHE        **l_cache;
+
+
+  void             run ();
+
+
+protected slots:
+
+private:
+};
+
+#endif
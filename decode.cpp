@@ -0,0 +1,223 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "decode.hpp"
+
+
+/*!
+  - Expand uncompressed blocks into byte, float, or packed bit grids without calling bit_unpack for every cell.
+    Whole bytes of the block (eight cells) are expanded at once from a 256 entry table of eight 0/1 bytes which
+    is then turned into the land/water values with one 64 bit multiply-add.  Float grids fill runs of eight land
+    or eight water cells directly.  Bit grids are copied 64 bits at a time.  Only the cells before the first byte
+    boundary and after the last one are done one at a time.  Any row, part of a row, or sub-rectangle of a block can
+    be decoded.
+*/
+
+
+//!  Each possible byte expanded to eight 0/1 bytes (most significant bit first).
+
+static uint8_t expand[256][8];
+
+static int32_t build_expand ()
+{
+  for (int32_t i = 0 ; i < 256 ; i++)
+    {
+      for (int32_t k = 0 ; k < 8 ; k++) expand[i][k] = (i >> (7 - k)) & 1;
+    }
+
+  return (0);
+}
+
+static int32_t expand_built = build_expand ();
+
+
+
+//!  Number of uint64_t words in one row of a CLM_GRID_BITS grid that is cols wide.
+
+int32_t clm_grid_words (int32_t cols)
+{
+  return ((cols + 63) >> 6);
+}
+
+
+
+//!  Fill count cells of out with one value (code is CLM_ALL_LAND, CLM_ALL_WATER, or CLM_UNDEFINED).
+
+static void decode_fill (int32_t code, int32_t count, CLM_GRID *grid, void *out)
+{
+  double value = (code == CLM_ALL_LAND) ? grid->land : ((code == CLM_ALL_WATER) ? grid->water : grid->undefined);
+
+  switch (grid->type)
+    {
+    case CLM_GRID_BYTE:
+      memset (out, (uint8_t) value, count);
+      break;
+
+    case CLM_GRID_FLOAT:
+      for (int32_t i = 0 ; i < count ; i++) ((float *) out)[i] = (float) value;
+      break;
+
+    case CLM_GRID_BITS:
+      memset (out, 0, clm_grid_words (count) * sizeof (uint64_t));
+      if (code == CLM_ALL_LAND) clm_fill_bits ((uint64_t *) out, 0, count, 1);
+      break;
+    }
+}
+
+
+
+/*!
+  - Decode count cells of row "row" of a block, starting at column col, into out.  code is the value returned by
+    clm_read_block (bits is only used if it is CLM_MIXED).
+*/
+
+void clm_decode_row (CLM_FILE *clm, int32_t code, uint8_t *bits, int32_t row, int32_t col, int32_t count, CLM_GRID *grid,
+                     void *out)
+{
+  if (code != CLM_MIXED)
+    {
+      decode_fill (code, count, grid, out);
+      return;
+    }
+
+
+  if (grid->type == CLM_GRID_BITS)
+    {
+      uint64_t words[CLM_MAX_ROW_WORDS];
+      uint64_t *dst = (uint64_t *) out;
+
+      clm_get_row (clm, bits, row, words);
+
+      memset (dst, 0, clm_grid_words (count) * sizeof (uint64_t));
+      clm_copy_bits (dst, 0, words, col, count);
+
+      return;
+    }
+
+
+  int64_t pos = (int64_t) row * clm->point_count + col;
+  int64_t end = pos + count;
+  int32_t i = 0;
+
+
+  if (grid->type == CLM_GRID_BYTE)
+    {
+      uint8_t *dst = (uint8_t *) out;
+      uint8_t land = (uint8_t) grid->land, water = (uint8_t) grid->water;
+
+
+      //  Leading cells up to a byte boundary.
+
+      for ( ; pos < end && (pos & 7) ; pos++, i++) dst[i] = ((bits[pos >> 3] >> (7 - (pos & 7))) & 1) ? land : water;
+
+
+      //  Eight cells at a time.  Every byte of x is 0 or 1 so neither product can carry into the next byte.
+
+      const uint64_t ones = 0x0101010101010101ULL;
+
+      for ( ; pos + 8 <= end ; pos += 8, i += 8)
+        {
+          uint64_t x;
+
+          memcpy (&x, expand[bits[pos >> 3]], 8);
+          x = x * land + (ones - x) * water;
+          memcpy (&dst[i], &x, 8);
+        }
+
+      for ( ; pos < end ; pos++, i++) dst[i] = ((bits[pos >> 3] >> (7 - (pos & 7))) & 1) ? land : water;
+    }
+  else
+    {
+      float *dst = (float *) out;
+      float value[2] = {(float) grid->water, (float) grid->land};
+
+      for ( ; pos < end && (pos & 7) ; pos++, i++) dst[i] = value[(bits[pos >> 3] >> (7 - (pos & 7))) & 1];
+
+      for ( ; pos + 8 <= end ; pos += 8, i += 8)
+        {
+          uint8_t b = bits[pos >> 3];
+
+          if (b == 0x00 || b == 0xff)
+            {
+              float v = value[b & 1];
+              for (int32_t k = 0 ; k < 8 ; k++) dst[i + k] = v;
+            }
+          else
+            {
+              for (int32_t k = 0 ; k < 8 ; k++) dst[i + k] = value[expand[b][k]];
+            }
+        }
+
+      for ( ; pos < end ; pos++, i++) dst[i] = value[(bits[pos >> 3] >> (7 - (pos & 7))) & 1];
+    }
+}
+
+
+
+/*!
+  - Decode rows row to row + rows - 1 and columns col to col + cols - 1 of a block.  Block row row goes to
+    grid->data, the next one to grid->data + grid->stride, and so on.
+*/
+
+void clm_decode_rect (CLM_FILE *clm, int32_t code, uint8_t *bits, int32_t row, int32_t col, int32_t rows, int32_t cols,
+                      CLM_GRID *grid)
+{
+  int32_t size = (grid->type == CLM_GRID_BYTE) ? 1 : ((grid->type == CLM_GRID_FLOAT) ? sizeof (float) : sizeof (uint64_t));
+
+  for (int32_t r = 0 ; r < rows ; r++)
+    {
+      uint8_t *out = (uint8_t *) grid->data + (int64_t) r * grid->stride * size;
+
+      clm_decode_row (clm, code, bits, row + r, col, cols, grid, out);
+    }
+}
+
+
+
+/*!
+  - Read the block at lat, lon (bits must hold clm->bit_size bytes) and decode all of it.  Returns the code from
+    clm_read_block.
+*/
+
+int32_t clm_decode_block (CLM_FILE *clm, int32_t lat, int32_t lon, uint8_t *bits, CLM_GRID *grid)
+{
+  int32_t code = clm_read_block (clm, lat, lon, bits);
+  if (code < 0) return (code);
+
+  clm_decode_rect (clm, code, bits, 0, 0, clm->point_count, clm->point_count, grid);
+
+  return (code);
+}
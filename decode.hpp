@@ -0,0 +1,75 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef DECODE_H
+#define DECODE_H
+
+
+#include "clm.hpp"
+
+
+//  Output grid types.
+
+#define CLM_GRID_BYTE                0          //  One uint8_t per cell
+#define CLM_GRID_FLOAT               1          //  One float per cell
+#define CLM_GRID_BITS                2          //  Packed bits (most significant first, 1 for land), rows start on a uint64_t
+
+
+/*!
+  - Where and how to decode cells.  data points to the first output row and stride is the distance from one
+    output row to the next in bytes, floats, or uint64_t words (depending on type).  Block rows run south to north
+    so a negative stride (with data pointing at the last row) gives a north up grid.  land, water, and undefined
+    are the values stored for those cells in byte and float grids (undefined cells are 0 in a bit grid).
+*/
+
+typedef struct
+{
+  int32_t          type;
+  double           land, water, undefined;
+  void             *data;
+  int64_t          stride;
+} CLM_GRID;
+
+
+int32_t clm_grid_words (int32_t cols);
+void clm_decode_row (CLM_FILE *clm, int32_t code, uint8_t *bits, int32_t row, int32_t col, int32_t count, CLM_GRID *grid,
+                     void *out);
+void clm_decode_rect (CLM_FILE *clm, int32_t code, uint8_t *bits, int32_t row, int32_t col, int32_t rows, int32_t cols,
+                      CLM_GRID *grid);
+int32_t clm_decode_block (CLM_FILE *clm, int32_t lat, int32_t lon, uint8_t *bits, CLM_GRID *grid);
+
+
+#endif
@@ -0,0 +1,641 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "distance.hpp"
+#include "version.h"
+
+
+/*!
+  - Distance to the nearest land for every cell of a .clm file.  Each one-degree block is processed on its own
+    (in parallel) using a window made up of the block and a halo, taken from its eight neighbors, that is just
+    wide enough to hold anything within the maximum distance.  The distance transform is the linear time,
+    separable, Euclidean distance transform of Felzenszwalb and Huttenlocher.  The column pass counts rows to
+    the nearest land (rows are all the same height) and the row pass finds the lower envelope of the parabolas
+    using the east-west cell size at the latitude of the row (that is, a local equirectangular approximation).
+    Distances past the maximum are set to the maximum.  Undefined neighbors are treated as water.  Only the
+    windows for the blocks that are being worked on are in memory.
+
+
+  - Description of the compressed distance map (.cdm) file format
+
+
+    <pre>
+
+        Header - 16384 bytes, ASCII
+
+        [HEADER SIZE] = 16384
+        [VERSION] = 
+        [ZLIB VERSION] =
+        [CREATION DATE] = 
+        [RESOLUTION] = 1, 3, 10, 30, or 60
+        [SOURCE MASK] = 
+        [MAXIMUM DISTANCE] = maximum distance in meters
+        [END OF HEADER]
+
+
+        One-degree map - 64800 * 12 bytes, binary, stored as unsigned characters.
+
+            Single record (12 bytes) :
+
+                64 bits - 0 = undefined, 1 = all land (0 meters), 2 = all water farther than the maximum
+                          distance, otherwise the address of the compressed tile
+                32 bits - 0 or the size of the compressed tile
+
+            Records are in the same order as in the .clm file.
+
+
+        Data
+
+            The tiles are one-degree squares of 16 bit, big endian, unsigned distances in meters (the same
+            number of cells and the same order as a .clm block) compressed with zlib.
+
+    </pre>
+*/
+
+
+//!  Create the .cdm file and write the header and an empty map.
+
+static CDM_FILE *cdm_create (const char *path, CLM_FILE *in, int32_t max_distance)
+{
+  CDM_FILE *cdm = new CDM_FILE;
+
+  strcpy (cdm->path, path);
+
+  if ((cdm->fp = fopen (path, "wb+")) == NULL)
+    {
+      delete cdm;
+      return (NULL);
+    }
+
+
+  time_t t = time (&t);
+  struct tm *cur_tm = gmtime (&t);
+
+  fprintf (cdm->fp, "[HEADER SIZE] = %d\n", SWBD_MASK_HEADER_SIZE);
+  fprintf (cdm->fp, "[VERSION] = %s\n", VERSION);
+  fprintf (cdm->fp, "[ZLIB VERSION] = %s\n", zlibVersion ());
+  fprintf (cdm->fp, "[CREATION DATE] = %s", asctime (cur_tm));
+  fprintf (cdm->fp, "[RESOLUTION] = %d\n", in->resolution);
+  fprintf (cdm->fp, "[SOURCE MASK] = %s\n", in->path);
+  fprintf (cdm->fp, "[MAXIMUM DISTANCE] = %d\n", max_distance);
+  fprintf (cdm->fp, "[END OF HEADER]\n");
+
+
+  memset (cdm->map, 0, sizeof (cdm->map));
+
+  uint8_t zero = 0;
+  int32_t j = ftell (cdm->fp);
+  for (int32_t i = j ; i < SWBD_MASK_HEADER_SIZE ; i++) fwrite (&zero, 1, 1, cdm->fp);
+
+  fwrite (cdm->map, sizeof (cdm->map), 1, cdm->fp);
+
+  return (cdm);
+}
+
+
+
+//!  Set the map record for a tile.
+
+static void cdm_set_map (CDM_FILE *cdm, int32_t lat, int32_t lon, int64_t address, uint32_t size)
+{
+  uint8_t *mapbuf = &cdm->map[clm_block_index (lat, lon) * CDM_MAP_RECORD_SIZE];
+
+  bit_pack (mapbuf, 0, 32, (uint32_t) (address >> 32));
+  bit_pack (mapbuf, 32, 32, (uint32_t) (address & 0xffffffff));
+  bit_pack (mapbuf, 64, 32, size);
+}
+
+
+
+//!  Compress and append a tile (pc * pc big endian 16 bit distances).
+
+static void cdm_write_tile (CDM_FILE *cdm, int32_t lat, int32_t lon, uint8_t *tile, int32_t tile_size)
+{
+  uLongf out_size = compressBound (tile_size);
+  uint8_t *out_buf = (uint8_t *) malloc (out_size);
+
+  if (out_buf == NULL)
+    {
+      perror ("Allocating out_buf in cdm_write_tile");
+      exit (-1);
+    }
+
+  int32_t n = compress2 (out_buf, &out_size, tile, tile_size, 9);
+  if (n)
+    {
+      fprintf (stderr, "Error %d compressing tile\n", n);
+      exit (-1);
+    }
+
+
+  QMutexLocker locker (&cdm->mutex);
+
+  fseek (cdm->fp, 0, SEEK_END);
+  int64_t address = ftell (cdm->fp);
+
+  if (fwrite (out_buf, out_size, 1, cdm->fp) != 1)
+    {
+      perror (cdm->path);
+      exit (-1);
+    }
+
+  cdm_set_map (cdm, lat, lon, address, out_size);
+
+  free (out_buf);
+}
+
+
+
+//!  Write the map and close the .cdm file.
+
+static void cdm_close (CDM_FILE *cdm)
+{
+  fseek (cdm->fp, SWBD_MASK_HEADER_SIZE, SEEK_SET);
+  if (fwrite (cdm->map, sizeof (cdm->map), 1, cdm->fp) != 1) perror (cdm->path);
+
+  fclose (cdm->fp);
+
+  delete cdm;
+}
+
+
+
+distanceThread::distanceThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+distanceThread::~distanceThread ()
+{
+}
+
+
+
+void distanceThread::distance (CLM_FILE *in, CDM_FILE *out, int32_t m, QAtomicInt *n)
+{
+  QMutexLocker locker (&mutex);
+
+  l_in = in;
+  l_out = out;
+  l_max_distance = m;
+  l_next = n;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+void distanceThread::run ()
+{
+  mutex.lock ();
+
+  CLM_FILE *in = l_in;
+  CDM_FILE *out = l_out;
+  int32_t max_distance = l_max_distance;
+  QAtomicInt *next = l_next;
+
+  mutex.unlock ();
+
+
+  int32_t pc = in->point_count;
+  double cell = 1.0 / (double) pc;
+  uint64_t words[CLM_MAX_ROW_WORDS];
+
+
+  //  Height of a cell (meters) and the number of halo rows needed to reach the maximum distance.
+
+  double cell_height = CLM_EARTH_RADIUS * 1000.0 * cell * NV_DEG_TO_RAD;
+  int32_t halo_y = (int32_t) ceil ((double) max_distance / cell_height);
+  if (halo_y > pc) halo_y = pc;
+
+
+  uint8_t *bits[3][3];
+  int32_t code[3][3];
+
+  for (int32_t i = 0 ; i < 3 ; i++)
+    {
+      for (int32_t j = 0 ; j < 3 ; j++)
+        {
+          if ((bits[i][j] = (uint8_t *) malloc (in->bit_size)) == NULL)
+            {
+              perror ("Allocating bits memory in distanceThread");
+              exit (-1);
+            }
+        }
+    }
+
+
+  int32_t tile_size = pc * pc * 2;
+  uint8_t *tile = (uint8_t *) malloc (tile_size);
+  if (tile == NULL)
+    {
+      perror ("Allocating tile memory in distanceThread");
+      exit (-1);
+    }
+
+
+  //  The window can be up to three blocks on a side.  The rest depends on the halo width which changes with
+  //  latitude so they get reallocated as needed.
+
+  uint64_t *win = (uint64_t *) malloc ((size_t) 3 * pc * ((3 * pc + 63) / 64) * sizeof (uint64_t));
+  if (win == NULL)
+    {
+      perror ("Allocating window memory in distanceThread");
+      exit (-1);
+    }
+
+  int32_t alloc_cols = 0;
+  uint16_t *g = NULL;
+  int32_t *last = NULL, *v = NULL;
+  double *f = NULL, *z = NULL;
+
+
+  int32_t i;
+  while ((i = next->fetchAndAddOrdered (1)) < CLM_BLOCKS)
+    {
+      int32_t lat = i / 360 - 90;
+      int32_t lon = i % 360 - 180;
+
+
+      if (!(i % 648))
+        {
+          fprintf (stderr, "%03d%% processed\r", i / 648);
+          fflush (stderr);
+        }
+
+
+      uint8_t land = NVFalse;
+
+      for (int32_t dy = -1 ; dy <= 1 ; dy++)
+        {
+          for (int32_t dx = -1 ; dx <= 1 ; dx++)
+            {
+              int32_t nlat = lat + dy;
+              int32_t nlon = lon + dx;
+              if (nlon < -180) nlon += 360;
+              if (nlon > 179) nlon -= 360;
+
+              if (nlat < -90 || nlat > 89)
+                {
+                  code[dy + 1][dx + 1] = CLM_UNDEFINED;
+                }
+              else
+                {
+                  uint32_t address = clm_block_address (in, nlat, nlon, NULL);
+                  code[dy + 1][dx + 1] = (address <= CLM_ALL_WATER) ? (int32_t) address : CLM_MIXED;
+                }
+
+              if (code[dy + 1][dx + 1] == CLM_ALL_LAND || code[dy + 1][dx + 1] == CLM_MIXED) land = NVTrue;
+            }
+        }
+
+
+      //  Blocks that don't need any work.
+
+      if (code[1][1] == CLM_UNDEFINED) continue;
+
+      if (code[1][1] == CLM_ALL_LAND)
+        {
+          cdm_set_map (out, lat, lon, CDM_ALL_LAND, 0);
+          continue;
+        }
+
+      if (!land)
+        {
+          cdm_set_map (out, lat, lon, CDM_ALL_FAR, 0);
+          continue;
+        }
+
+
+      //  Width of a cell at the poleward edge of the block (the narrowest) and the number of halo columns needed.
+
+      double edge_lat = (lat >= 0) ? (double) (lat + 1) : (double) lat;
+      double cos_edge = cos (edge_lat * NV_DEG_TO_RAD);
+      int32_t halo_x = pc;
+      if (cos_edge > 0.0)
+        {
+          double hx = ceil ((double) max_distance / (cell_height * cos_edge));
+          if (hx < (double) pc) halo_x = (int32_t) hx;
+        }
+
+
+      int32_t rows = pc + 2 * halo_y;
+      int32_t cols = pc + 2 * halo_x;
+      int32_t win_words = (cols + 63) / 64;
+
+      if (cols > alloc_cols)
+        {
+          alloc_cols = cols;
+          g = (uint16_t *) realloc (g, (size_t) pc * alloc_cols * sizeof (uint16_t));
+          last = (int32_t *) realloc (last, alloc_cols * sizeof (int32_t));
+          v = (int32_t *) realloc (v, alloc_cols * sizeof (int32_t));
+          f = (double *) realloc (f, alloc_cols * sizeof (double));
+          z = (double *) realloc (z, (alloc_cols + 1) * sizeof (double));
+
+          if (g == NULL || last == NULL || v == NULL || f == NULL || z == NULL)
+            {
+              perror ("Allocating window memory in distanceThread");
+              exit (-1);
+            }
+        }
+
+
+      for (int32_t dy = -1 ; dy <= 1 ; dy++)
+        {
+          for (int32_t dx = -1 ; dx <= 1 ; dx++)
+            {
+              if (code[dy + 1][dx + 1] == CLM_MIXED)
+                {
+                  int32_t nlon = lon + dx;
+                  if (nlon < -180) nlon += 360;
+                  if (nlon > 179) nlon -= 360;
+
+                  if (clm_read_block (in, lat + dy, nlon, bits[dy + 1][dx + 1]) < 0)
+                    {
+                      fprintf (stderr, "\nError reading block %d %d from %s\n", lat + dy, nlon, in->path);
+                      exit (-1);
+                    }
+                }
+            }
+        }
+
+
+      //  Build the window (land = 1).
+
+      for (int32_t wr = 0 ; wr < rows ; wr++)
+        {
+          int32_t row = wr - halo_y, dy = 0;
+
+          if (row < 0)
+            {
+              row += pc;
+              dy = -1;
+            }
+          else if (row >= pc)
+            {
+              row -= pc;
+              dy = 1;
+            }
+
+          uint64_t *w = &win[(size_t) wr * win_words];
+
+          for (int32_t dx = -1 ; dx <= 1 ; dx++)
+            {
+              int32_t c = code[dy + 1][dx + 1];
+
+              int32_t src_start = (dx < 0) ? pc - halo_x : 0;
+              int32_t dst_start = (dx < 0) ? 0 : (dx == 0) ? halo_x : halo_x + pc;
+              int32_t count = dx ? halo_x : pc;
+
+              if (c == CLM_MIXED)
+                {
+                  clm_get_row (in, bits[dy + 1][dx + 1], row, words);
+                  clm_copy_bits (w, dst_start, words, src_start, count);
+                }
+              else
+                {
+                  clm_fill_bits (w, dst_start, dst_start + count, (c == CLM_ALL_LAND));
+                }
+            }
+        }
+
+
+      //  Column pass.  Number of rows from each center row cell to the nearest land in the same column (0xffff
+      //  if there isn't any in the window), first looking south and then north.
+
+      for (int32_t c = 0 ; c < cols ; c++) last[c] = -0x10000;
+
+      for (int32_t wr = 0 ; wr < rows ; wr++)
+        {
+          uint64_t *w = &win[(size_t) wr * win_words];
+
+          for (int32_t c = 0 ; c < cols ; c++)
+            {
+              if ((w[c >> 6] >> (63 - (c & 63))) & 1) last[c] = wr;
+            }
+
+          if (wr >= halo_y && wr < halo_y + pc)
+            {
+              uint16_t *gr = &g[(size_t) (wr - halo_y) * cols];
+
+              for (int32_t c = 0 ; c < cols ; c++) gr[c] = (wr - last[c] < 0xffff) ? wr - last[c] : 0xffff;
+            }
+        }
+
+      for (int32_t c = 0 ; c < cols ; c++) last[c] = 0x20000;
+
+      for (int32_t wr = rows - 1 ; wr >= halo_y ; wr--)
+        {
+          uint64_t *w = &win[(size_t) wr * win_words];
+
+          for (int32_t c = 0 ; c < cols ; c++)
+            {
+              if ((w[c >> 6] >> (63 - (c & 63))) & 1) last[c] = wr;
+            }
+
+          if (wr < halo_y + pc)
+            {
+              uint16_t *gr = &g[(size_t) (wr - halo_y) * cols];
+
+              for (int32_t c = 0 ; c < cols ; c++)
+                {
+                  if (last[c] - wr < gr[c]) gr[c] = last[c] - wr;
+                }
+            }
+        }
+
+
+      //  Row pass.  Lower envelope of the parabolas (q - c)^2 + f[c] in units of the cell width for this row.
+
+      for (int32_t row = 0 ; row < pc ; row++)
+        {
+          uint16_t *gr = &g[(size_t) row * cols];
+          double cell_width = cell_height * cos (((double) lat + ((double) row + 0.5) * cell) * NV_DEG_TO_RAD);
+          double ratio = cell_height / cell_width;
+          int32_t k = -1;
+
+          for (int32_t q = 0 ; q < cols ; q++)
+            {
+              if (gr[q] == 0xffff) continue;
+
+              f[q] = (gr[q] * ratio) * (gr[q] * ratio);
+
+              if (k < 0)
+                {
+                  k = 0;
+                  v[0] = q;
+                  z[0] = -1.0e30;
+                  z[1] = 1.0e30;
+                  continue;
+                }
+
+              double s;
+              while (1)
+                {
+                  s = ((f[q] + (double) q * q) - (f[v[k]] + (double) v[k] * v[k])) / (2.0 * (q - v[k]));
+                  if (s > z[k] || k == 0) break;
+                  k--;
+                }
+
+              k++;
+              v[k] = q;
+              z[k] = s;
+              z[k + 1] = 1.0e30;
+            }
+
+
+          int32_t kk = 0;
+          for (int32_t col = 0 ; col < pc ; col++)
+            {
+              int32_t q = col + halo_x;
+              double dist = (double) max_distance;
+
+              if (k >= 0)
+                {
+                  while (z[kk + 1] < (double) q) kk++;
+
+                  double d = cell_width * sqrt ((double) (q - v[kk]) * (q - v[kk]) + f[v[kk]]);
+                  if (d < dist) dist = d;
+                }
+
+              uint16_t value = (uint16_t) NINT (dist);
+              int32_t pos = (row * pc + col) * 2;
+
+              tile[pos] = value >> 8;
+              tile[pos + 1] = value & 0xff;
+            }
+        }
+
+
+      cdm_write_tile (out, lat, lon, tile, tile_size);
+    }
+
+
+  for (int32_t i = 0 ; i < 3 ; i++)
+    {
+      for (int32_t j = 0 ; j < 3 ; j++) free (bits[i][j]);
+    }
+
+  free (tile);
+  free (win);
+  free (g);
+  free (last);
+  free (v);
+  free (f);
+  free (z);
+}
+
+
+
+static void distance_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask distance [-m MAX_DISTANCE] [-t NUM_THREADS] INPUT_CLM OUTPUT_CDM\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-m MAX_DISTANCE = maximum distance to land in meters (1 to 65535, default 10000)\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of compute threads (1 to %d, default 4)\n\n", CLM_MAX_THREADS);
+  fprintf (stderr, "The halo is limited to one block so distances are only guaranteed out to one degree.\n\n");
+  exit (-1);
+}
+
+
+
+/*!
+  - Build a compressed distance map (.cdm) file holding the distance to the nearest land from an existing
+    .clm file.
+*/
+
+int32_t distance (int32_t argc, char **argv)
+{
+  int32_t           num_threads = 4, max_distance = 10000, c;
+  distanceThread    distance_thread[CLM_MAX_THREADS];
+
+
+  while ((c = getopt (argc, argv, "m:t:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'm':
+          sscanf (optarg, "%d", &max_distance);
+          break;
+
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          distance_usage ();
+          break;
+        }
+    }
+
+
+  if (optind + 2 != argc || num_threads < 1 || num_threads > CLM_MAX_THREADS || max_distance < 1 || max_distance > 65535)
+    distance_usage ();
+
+
+  CLM_FILE *in = clm_open (argv[optind]);
+  if (in == NULL)
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+
+  CDM_FILE *out = cdm_create (argv[optind + 1], in, max_distance);
+  if (out == NULL)
+    {
+      perror (argv[optind + 1]);
+      exit (-1);
+    }
+
+
+  QAtomicInt next (0);
+
+  for (int32_t i = 0 ; i < num_threads ; i++) distance_thread[i].distance (in, out, max_distance, &next);
+  for (int32_t i = 0 ; i < num_threads ; i++) distance_thread[i].wait ();
+
+
+  cdm_close (out);
+  clm_close (in);
+
+
+  fprintf (stderr, "100%% processed                         \n\n");
+  fflush (stderr);
+
+  return (0);
+}
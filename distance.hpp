@@ -0,0 +1,106 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef DISTANCE_H
+#define DISTANCE_H
+
+
+#include "clm.hpp"
+
+
+#define CDM_MAP_RECORD_SIZE          12
+
+
+//  One-degree map codes for the compressed distance map (anything else is the address of a compressed tile).
+
+#define CDM_UNDEFINED                0
+#define CDM_ALL_LAND                 1
+#define CDM_ALL_FAR                  2
+
+
+//!  Compressed distance map (.cdm) output file.
+
+typedef struct
+{
+  FILE            *fp;
+  char            path[512];
+  uint8_t         map[CLM_BLOCKS * CDM_MAP_RECORD_SIZE];
+  QMutex          mutex;
+} CDM_FILE;
+
+
+int32_t distance (int32_t argc, char **argv);
+
+
+class distanceThread:public QThread
+{
+  Q_OBJECT 
+
+
+public:
+
+  distanceThread (QObject *parent = 0);
+  ~distanceThread ();
+
+  void distance (CLM_FILE *in = NULL, CDM_FILE *out = NULL, int32_t m = 0, QAtomicInt *n = NULL);
+
+
+signals:
+
+
+protected:
+
+
+  QMutex           mutex;
+
+  CLM_FILE         *l_in;
+
+  CDM_FILE         *l_out;
+
+  int32_t          l_max_distance;
+
+  QAtomicInt       *l_next;
+
+
+  void             run ();
+
+
+protected slots:
+
+private:
+};
+
+#endif
@@ -0,0 +1,436 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#include "edgefile.hpp"
+#include "version.h"
+
+
+/*!
+  - Edge file header (same size as a .clm header):
+
+    <pre>
+
+        [HEADER SIZE] = 16384
+        [VERSION] = 
+        [ZLIB VERSION] =
+        [CREATION DATE] = 
+        [RESOLUTION] = 1, 3, 10, 30, or 60
+        [EDGES] = tiles/edges/boundary
+        [END OF HEADER]
+
+    </pre>
+*/
+
+
+//  Number of uint32_t tile start indices at the beginning of a block (padded so the edges are 8 byte aligned).
+
+#define EDGE_INDEX_COUNT             (CLM_EDGE_TILES * CLM_EDGE_TILES + 2)
+
+
+/*!
+  - Open an existing edge file for reading.  Returns NULL on failure (errno will be set if the failure was a
+    system error).
+*/
+
+CLM_EDGES *clm_edges_open (const char *path)
+{
+  char header[SWBD_MASK_HEADER_SIZE + 1];
+  uint8_t tagged = NVFalse;
+
+
+  CLM_EDGES *edges = new CLM_EDGES;
+
+  edges->write = NVFalse;
+  edges->resolution = 0;
+  strcpy (edges->path, path);
+
+  if ((edges->fp = fopen (path, "rb")) == NULL)
+    {
+      delete edges;
+      return (NULL);
+    }
+
+  if (fread (header, SWBD_MASK_HEADER_SIZE, 1, edges->fp) != 1 ||
+      fread (edges->map, sizeof (edges->map), 1, edges->fp) != 1)
+    {
+      fclose (edges->fp);
+      delete edges;
+      errno = EINVAL;
+      return (NULL);
+    }
+
+  header[SWBD_MASK_HEADER_SIZE] = 0;
+
+
+  char *line = header;
+  while (line != NULL && *line)
+    {
+      if (!strncmp (line, "[RESOLUTION] = ", 15)) sscanf (&line[15], "%d", &edges->resolution);
+
+      if (!strncmp (line, "[EDGES] = ", 10)) tagged = NVTrue;
+
+      if (!strncmp (line, "[END OF HEADER]", 15)) break;
+
+      if ((line = strchr (line, '\n')) != NULL) line++;
+    }
+
+
+  if (!tagged || (edges->resolution != 1 && edges->resolution != 3 && edges->resolution != 10 &&
+                  edges->resolution != 30 && edges->resolution != 60))
+    {
+      fclose (edges->fp);
+      delete edges;
+      errno = EINVAL;
+      return (NULL);
+    }
+
+  edges->point_count = 3600 / edges->resolution;
+  edges->bit_size = (edges->point_count * edges->point_count) / 8;
+
+  return (edges);
+}
+
+
+
+//!  Create an empty edge file.  extra_header (may be NULL) is added to the header.  Returns NULL on failure.
+
+CLM_EDGES *clm_edges_create (const char *path, int32_t resolution, const char *extra_header)
+{
+  CLM_EDGES *edges = new CLM_EDGES;
+
+  edges->write = NVTrue;
+  edges->resolution = resolution;
+  edges->point_count = 3600 / resolution;
+  edges->bit_size = (edges->point_count * edges->point_count) / 8;
+  strcpy (edges->path, path);
+
+  if ((edges->fp = fopen (path, "wb+")) == NULL)
+    {
+      delete edges;
+      return (NULL);
+    }
+
+
+  time_t t = time (&t);
+  struct tm *cur_tm = gmtime (&t);
+
+  fprintf (edges->fp, "[HEADER SIZE] = %d\n", SWBD_MASK_HEADER_SIZE);
+  fprintf (edges->fp, "[VERSION] = %s\n", VERSION);
+  fprintf (edges->fp, "[ZLIB VERSION] = %s\n", zlibVersion ());
+  fprintf (edges->fp, "[CREATION DATE] = %s", asctime (cur_tm));
+  fprintf (edges->fp, "[RESOLUTION] = %d\n", resolution);
+  fprintf (edges->fp, "[EDGES] = tiles/edges/boundary\n");
+  if (extra_header != NULL) fprintf (edges->fp, "%s", extra_header);
+  fprintf (edges->fp, "[END OF HEADER]\n");
+
+
+  memset (edges->map, 0, sizeof (edges->map));
+
+  uint8_t zero = 0;
+  int32_t j = ftell (edges->fp);
+  for (int32_t i = j ; i < SWBD_MASK_HEADER_SIZE ; i++) fwrite (&zero, 1, 1, edges->fp);
+
+  if (fwrite (edges->map, sizeof (edges->map), 1, edges->fp) != 1)
+    {
+      fclose (edges->fp);
+      delete edges;
+      return (NULL);
+    }
+
+  return (edges);
+}
+
+
+
+//!  Close an edge file (writing the map back if it was created).
+
+void clm_edges_close (CLM_EDGES *edges)
+{
+  if (edges == NULL) return;
+
+  if (edges->write)
+    {
+      fseek (edges->fp, SWBD_MASK_HEADER_SIZE, SEEK_SET);
+      if (fwrite (edges->map, sizeof (edges->map), 1, edges->fp) != 1) perror (edges->path);
+    }
+
+  fclose (edges->fp);
+
+  delete edges;
+}
+
+
+
+/*!
+  - Store the boundary bits, tile start indices (CLM_EDGE_TILES * CLM_EDGE_TILES + 1 of them), and edges of the
+    block at lat, lon.  Returns 0 on success or -1 on error (EFBIG if the compressed block is over the 16MB that
+    the map can hold).  Safe to call from multiple threads.
+*/
+
+int32_t clm_edges_write (CLM_EDGES *edges, int32_t lat, int32_t lon, uint8_t *bits, uint32_t *tile_start, double *edge)
+{
+  uint32_t num_edges = tile_start[CLM_EDGE_TILES * CLM_EDGE_TILES];
+  uLong in_size = EDGE_INDEX_COUNT * sizeof (uint32_t) + (uLong) num_edges * 4 * sizeof (double) + edges->bit_size;
+
+
+  uint8_t *in_buf = (uint8_t *) calloc (in_size, 1);
+  uLongf out_size = compressBound (in_size);
+  uint8_t *out_buf = (uint8_t *) malloc (out_size + 4);
+  if (in_buf == NULL || out_buf == NULL)
+    {
+      free (in_buf);
+      free (out_buf);
+      return (-1);
+    }
+
+  memcpy (in_buf, tile_start, (CLM_EDGE_TILES * CLM_EDGE_TILES + 1) * sizeof (uint32_t));
+  memcpy (&in_buf[EDGE_INDEX_COUNT * sizeof (uint32_t)], edge, (size_t) num_edges * 4 * sizeof (double));
+  memcpy (&in_buf[in_size - edges->bit_size], bits, edges->bit_size);
+
+  int32_t status = compress2 (&out_buf[4], &out_size, in_buf, in_size, 9);
+  free (in_buf);
+
+  if (status != Z_OK || out_size + 4 >= (1 << 24) || in_size > 0xffffffffUL)
+    {
+      free (out_buf);
+      if (status == Z_OK) errno = EFBIG;
+      return (-1);
+    }
+
+  bit_pack (out_buf, 0, 32, (uint32_t) in_size);
+  uint32_t size = out_size + 4;
+
+
+  QMutexLocker locker (&edges->mutex);
+
+  fseek (edges->fp, 0, SEEK_END);
+  int64_t address = ftell (edges->fp);
+
+  if (address > 0xffffffffLL || fwrite (out_buf, size, 1, edges->fp) != 1)
+    {
+      free (out_buf);
+      return (-1);
+    }
+
+  free (out_buf);
+
+  uint8_t *mapbuf = &edges->map[clm_block_index (lat, lon) * CLM_MAP_RECORD_SIZE];
+  bit_pack (mapbuf, 0, 32, (uint32_t) address);
+  bit_pack (mapbuf, 32, 24, size);
+
+  return (0);
+}
+
+
+
+/*!
+  - Read the block at lat, lon into block (whose buffer is reused from call to call, start with it zeroed and
+    index -1).  Returns 1 if the block has boundary pixels, 0 if it doesn't, or -1 on error.  Safe to call from
+    multiple threads as long as each has its own block.
+*/
+
+int32_t clm_edges_read (CLM_EDGES *edges, int32_t lat, int32_t lon, CLM_EDGE_BLOCK *block)
+{
+  uint8_t *mapbuf = &edges->map[clm_block_index (lat, lon) * CLM_MAP_RECORD_SIZE];
+  uint32_t address = bit_unpack (mapbuf, 0, 32);
+  uint32_t size = bit_unpack (mapbuf, 32, 24);
+
+
+  block->index = -1;
+  block->boundary = NVFalse;
+
+  if (!address)
+    {
+      block->index = clm_block_index (lat, lon);
+      return (0);
+    }
+
+
+  uint8_t *raw = (uint8_t *) malloc (size);
+  if (raw == NULL || size < 4) 
+    {
+      free (raw);
+      return (-1);
+    }
+
+  edges->mutex.lock ();
+
+  fseek (edges->fp, address, SEEK_SET);
+  size_t n = fread (raw, size, 1, edges->fp);
+
+  edges->mutex.unlock ();
+
+
+  uLongf in_size = bit_unpack (raw, 0, 32);
+  uLong fixed = EDGE_INDEX_COUNT * sizeof (uint32_t) + edges->bit_size;
+
+  if (n != 1 || in_size < fixed)
+    {
+      free (raw);
+      return (-1);
+    }
+
+  if (in_size > block->buf_size)
+    {
+      uint8_t *buf = (uint8_t *) realloc (block->buf, in_size);
+      if (buf == NULL)
+        {
+          free (raw);
+          return (-1);
+        }
+
+      block->buf = buf;
+      block->buf_size = in_size;
+    }
+
+  uLongf out_size = in_size;
+  int32_t status = uncompress (block->buf, &out_size, &raw[4], size - 4);
+  free (raw);
+
+  block->tile_start = (uint32_t *) block->buf;
+
+  uint32_t num_edges = block->tile_start[CLM_EDGE_TILES * CLM_EDGE_TILES];
+
+  if (status != Z_OK || out_size != in_size || (in_size - fixed) != (uLong) num_edges * 4 * sizeof (double)) return (-1);
+
+  block->edge = (double *) &block->buf[EDGE_INDEX_COUNT * sizeof (uint32_t)];
+  block->bits = &block->buf[in_size - edges->bit_size];
+  block->boundary = NVTrue;
+  block->index = clm_block_index (lat, lon);
+
+  return (1);
+}
+
+
+
+void clm_edges_free_block (CLM_EDGE_BLOCK *block)
+{
+  free (block->buf);
+
+  block->buf = NULL;
+  block->buf_size = 0;
+  block->index = -1;
+  block->boundary = NVFalse;
+}
+
+
+
+//!  Twice the signed area of triangle a, b, c (positive if counterclockwise).
+
+static inline double edge_orient (double ax, double ay, double bx, double by, double cx, double cy)
+{
+  return ((bx - ax) * (cy - ay) - (by - ay) * (cx - ax));
+}
+
+
+
+/*!
+  - Land (1), water (0), or undefined (-1) at lat, lon, exact to the SWBD polygon edges.  code and bits are the
+    mask block holding the point (from clm_read_block or clm_cache_get).  block is re-read from the edge file if
+    it doesn't hold the point's block (and only when the raster block is mixed).  Points in pixels that no edge
+    passes through get the raster value.  In a boundary pixel the raster value (the pixel center, see maskThread)
+    is flipped for each edge crossed by the segment from the center to the point.  A vertex lying exactly on that
+    segment is treated as being just to its right so that the two edges that share it are counted consistently.
+    *vector is set if the edges were used.  Points with a NaN or out of range (beyond -360 to 360 longitude)
+    coordinate are undefined.  Returns -2 if the edge block can't be read.
+*/
+
+int32_t clm_edges_point (CLM_EDGES *edges, CLM_EDGE_BLOCK *block, int32_t code, uint8_t *bits, double lat, double lon,
+                         uint8_t *vector)
+{
+  *vector = NVFalse;
+
+  if (!(lat >= -90.0 && lat <= 90.0 && lon >= -360.0 && lon <= 360.0)) return (-1);
+
+  if (lon < -180.0) lon += 360.0;
+  if (lon >= 180.0) lon -= 360.0;
+
+  switch (code)
+    {
+    case CLM_UNDEFINED:
+      return (-1);
+
+    case CLM_ALL_LAND:
+      return (1);
+
+    case CLM_ALL_WATER:
+      return (0);
+    }
+
+
+  int32_t pc = edges->point_count;
+  int32_t ilat = (int32_t) floor (lat);
+  int32_t ilon = (int32_t) floor (lon);
+  if (ilat > 89) ilat = 89;
+
+  int32_t row = (int32_t) ((lat - (double) ilat) * (double) pc);
+  int32_t col = (int32_t) ((lon - (double) ilon) * (double) pc);
+  if (row >= pc) row = pc - 1;
+  if (col >= pc) col = pc - 1;
+
+  int32_t pos = row * pc + col;
+  int32_t land = (bits[pos >> 3] >> (7 - (pos & 7))) & 1;
+
+
+  if (block->index != clm_block_index (ilat, ilon) && clm_edges_read (edges, ilat, ilon, block) < 0) return (-2);
+
+  if (!block->boundary || !((block->bits[pos >> 3] >> (7 - (pos & 7))) & 1)) return (land);
+
+
+  //  Count the edges in the pixel's tile that cross the segment from the pixel center to the point.
+
+  double cy = (double) ilat + ((double) row + 0.5) / (double) pc;
+  double cx = (double) ilon + ((double) col + 0.5) / (double) pc;
+  int32_t tile_size = pc / CLM_EDGE_TILES;
+  int32_t tile = (row / tile_size) * CLM_EDGE_TILES + col / tile_size;
+  int32_t crossings = 0;
+
+  for (uint32_t i = block->tile_start[tile] ; i < block->tile_start[tile + 1] ; i++)
+    {
+      double *e = &block->edge[i * 4];
+
+      if ((edge_orient (cx, cy, lon, lat, e[0], e[1]) > 0.0) == (edge_orient (cx, cy, lon, lat, e[2], e[3]) > 0.0)) continue;
+
+      if ((edge_orient (e[0], e[1], e[2], e[3], cx, cy) > 0.0) == (edge_orient (e[0], e[1], e[2], e[3], lon, lat) > 0.0)) continue;
+
+      crossings++;
+    }
+
+  *vector = NVTrue;
+
+  return (land ^ (crossings & 1));
+}
@@ -0,0 +1,100 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#ifndef EDGEFILE_H
+#define EDGEFILE_H
+
+
+#include "clm.hpp"
+
+
+//  Number of tiles along one side of a one-degree block in an edge file (one arc minute tiles).  This divides
+//  the point count at every resolution.
+
+#define CLM_EDGE_TILES               60
+
+
+/*!
+  - Edge file for a .clm file built from the SWBD shapefiles (see the edges mode).  For each mixed block it holds
+    the boundary pixels (pixels that an SWBD polygon edge passes through) and the polygon edges themselves, listed
+    by the tiles that they pass through.  A pixel that isn't a boundary pixel is all land or all water so the
+    raster answer is exact.  For a boundary pixel the answer is the raster value at the pixel center flipped once
+    for every edge crossed on the way from the center to the point (see clm_edges_point).  The layout is the same
+    as a .clm file (header, 64800 * 7 byte map, blocks) but a block is a 4 byte uncompressed size followed by a
+    zlib stream of CLM_EDGE_TILES * CLM_EDGE_TILES + 2 tile start indices (uint32_t, the last one is padding),
+    the edges (lon, lat, lon, lat doubles), and the boundary bits.  The numbers are in host byte order.  0 in the
+    map means the block has no boundary pixels.
+*/
+
+typedef struct
+{
+  FILE            *fp;
+  char            path[512];
+  uint8_t         write;                                  //!<  NVTrue if created with clm_edges_create
+  int32_t         resolution;
+  int32_t         point_count;
+  int32_t         bit_size;                               //!<  Size, in bytes, of the boundary bits of a block
+  uint8_t         map[CLM_BLOCKS * CLM_MAP_RECORD_SIZE];
+  QMutex          mutex;
+} CLM_EDGES;
+
+
+//!  One block of an edge file (see clm_edges_read).
+
+typedef struct
+{
+  int32_t         index;                                  //!<  clm_block_index of the block held, -1 for none
+  int32_t         boundary;                               //!<  NVFalse if the block has no boundary pixels
+  uint8_t         *bits;                                  //!<  Boundary bits (1 for a boundary pixel)
+  uint32_t        *tile_start;                            //!<  Edges of tile t are tile_start[t] to tile_start[t + 1] - 1
+  double          *edge;                                  //!<  4 doubles (lon, lat, lon, lat) per edge
+  uint8_t         *buf;
+  uint32_t        buf_size;
+} CLM_EDGE_BLOCK;
+
+
+CLM_EDGES *clm_edges_open (const char *path);
+CLM_EDGES *clm_edges_create (const char *path, int32_t resolution, const char *extra_header);
+void clm_edges_close (CLM_EDGES *edges);
+int32_t clm_edges_write (CLM_EDGES *edges, int32_t lat, int32_t lon, uint8_t *bits, uint32_t *tile_start, double *edge);
+int32_t clm_edges_read (CLM_EDGES *edges, int32_t lat, int32_t lon, CLM_EDGE_BLOCK *block);
+void clm_edges_free_block (CLM_EDGE_BLOCK *block);
+int32_t clm_edges_point (CLM_EDGES *edges, CLM_EDGE_BLOCK *block, int32_t code, uint8_t *bits, double lat, double lon,
+                         uint8_t *vector);
+
+
+#endif
@@ -0,0 +1,335 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#include "edges.hpp"
+
+
+/*!
+  - Build the edge file (see edgefile.hpp) for a .clm file that was built from the SWBD shapefiles.  The
+    shapefiles for the mixed blocks are read ahead (see swbd_prefetch_start) and every polygon edge is walked
+    through the pixels and the tiles that it passes through.  The pixels are flagged as boundary pixels and the
+    edge is added to the edge list of the tiles.  Edges are only kept where they are needed so the file holds a
+    small part of the shapefiles.  The mask has to have been built with the even-odd rule (the default) from the
+    same shapefiles.
+*/
+
+
+//  Slop, in grid cells, added around each edge so that rounding can't leave a pixel that an edge touches (or a
+//  query that rounds into the next pixel) without its edges.
+
+#define EDGES_EPS                    1.0e-6
+
+
+/*!
+  - Rows and columns of an n by n grid over the block at lat, lon that the edge e (lon, lat, lon, lat) passes
+    through.  span is filled with row, first column, last column triples (at most n of them).  Returns the number
+    of rows.
+*/
+
+static int32_t edge_cover (double *e, int32_t lat, int32_t lon, int32_t n, int32_t *span)
+{
+  double x0 = (e[0] - (double) lon) * (double) n, y0 = (e[1] - (double) lat) * (double) n;
+  double x1 = (e[2] - (double) lon) * (double) n, y1 = (e[3] - (double) lat) * (double) n;
+  double ymin = qMin (y0, y1) - EDGES_EPS, ymax = qMax (y0, y1) + EDGES_EPS;
+  int32_t count = 0;
+
+
+  if (ymax < 0.0 || ymin > (double) n || qMax (x0, x1) + EDGES_EPS < 0.0 || qMin (x0, x1) - EDGES_EPS > (double) n)
+    return (0);
+
+  int32_t first = qMax (0, (int32_t) floor (ymin));
+  int32_t last = qMin (n - 1, (int32_t) floor (ymax));
+
+  for (int32_t row = first ; row <= last ; row++)
+    {
+      double xmin, xmax;
+
+
+      //  The part of the edge in this row (all of it if it's horizontal).
+
+      if (fabs (y1 - y0) < EDGES_EPS)
+        {
+          xmin = qMin (x0, x1);
+          xmax = qMax (x0, x1);
+        }
+      else
+        {
+          double ta = (qMax (ymin, (double) row) - y0) / (y1 - y0);
+          double tb = (qMin (ymax, (double) (row + 1)) - y0) / (y1 - y0);
+          ta = qMax (0.0, qMin (1.0, ta));
+          tb = qMax (0.0, qMin (1.0, tb));
+
+          double xa = x0 + ta * (x1 - x0), xb = x0 + tb * (x1 - x0);
+          xmin = qMin (xa, xb);
+          xmax = qMax (xa, xb);
+        }
+
+      int32_t c0 = qMax (0, (int32_t) floor (xmin - EDGES_EPS));
+      int32_t c1 = qMin (n - 1, (int32_t) floor (xmax + EDGES_EPS));
+
+      if (c0 > c1) continue;
+
+      span[count * 3] = row;
+      span[count * 3 + 1] = c0;
+      span[count * 3 + 2] = c1;
+      count++;
+    }
+
+  return (count);
+}
+
+
+
+static void edges_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask edges INPUT_CLM OUTPUT_EDGES\n\n");
+  fprintf (stderr, "Build the boundary pixel and polygon edge file used by the exact mode for INPUT_CLM.\n");
+  fprintf (stderr, "INPUT_CLM must have been built from the SWBD shapefiles in ABE_DATA (even-odd rule).\n\n");
+  exit (-1);
+}
+
+
+
+int32_t edges (int32_t argc, char **argv)
+{
+  char              dirname[512], extra_header[SWBD_MASK_HEADER_SIZE / 2];
+
+
+  if (argc != 3) edges_usage ();
+
+
+  if (getenv ("ABE_DATA") == NULL)
+    {
+      fprintf (stderr, "\n\nEnvironment variable ABE_DATA is not set\n\n");
+      fflush (stderr);
+      exit (-1);
+    }
+
+  sprintf (dirname, "%s", getenv ("ABE_DATA"));
+
+
+  CLM_FILE *clm = clm_open (argv[1]);
+  if (clm == NULL)
+    {
+      perror (argv[1]);
+      exit (-1);
+    }
+
+  snprintf (extra_header, sizeof (extra_header), "[SOURCE MASK] = %s\n[TILES] = %d\n", clm->path, CLM_EDGE_TILES);
+
+  CLM_EDGES *out = clm_edges_create (argv[2], clm->resolution, extra_header);
+  if (out == NULL)
+    {
+      perror (argv[2]);
+      exit (-1);
+    }
+
+
+  //  Only the mixed blocks have boundary pixels.
+
+  int32_t *mixed = (int32_t *) malloc (CLM_BLOCKS * sizeof (int32_t));
+  if (mixed == NULL)
+    {
+      perror ("Allocating cell list memory");
+      exit (-1);
+    }
+
+  int32_t num_mixed = 0;
+  for (int32_t i = 0 ; i < CLM_BLOCKS ; i++)
+    {
+      if (clm_block_address (clm, i / 360 - 90, i % 360 - 180, NULL) > CLM_ALL_WATER) mixed[num_mixed++] = i;
+    }
+
+
+  int32_t pc = out->point_count, num_tiles = CLM_EDGE_TILES * CLM_EDGE_TILES;
+
+  uint8_t *bits = (uint8_t *) malloc (out->bit_size);
+  uint32_t *tile_start = (uint32_t *) malloc ((num_tiles + 1) * sizeof (uint32_t));
+  uint32_t *tile_next = (uint32_t *) malloc (num_tiles * sizeof (uint32_t));
+  int32_t *span = (int32_t *) malloc (3 * pc * sizeof (int32_t));
+  if (bits == NULL || tile_start == NULL || tile_next == NULL || span == NULL)
+    {
+      perror ("Allocating edge memory");
+      exit (-1);
+    }
+
+
+  SWBD_SOURCE *source = swbd_open (dirname);
+  SWBD_PREFETCH *prefetch = swbd_prefetch_start (source, num_mixed, mixed, SWBD_READ_THREADS, SWBD_READ_WINDOW);
+
+  QElapsedTimer timer;
+  timer.start ();
+
+  int32_t blocks = 0, no_shapefile = 0;
+  int64_t total_edges = 0, total_boundary = 0;
+
+
+  for (int32_t m = 0 ; m < num_mixed ; m++)
+    {
+      int32_t lat = mixed[m] / 360 - 90;
+      int32_t lon = mixed[m] % 360 - 180;
+
+
+      fprintf (stderr, "%03d%% processed\r", (int32_t) ((int64_t) m * 100 / num_mixed));
+      fflush (stderr);
+
+
+      SWBD_CELL *cell = swbd_prefetch_get (prefetch, m);
+
+      if (cell == NULL)
+        {
+          no_shapefile++;
+          continue;
+        }
+
+
+      //  Pass 1 flags the boundary pixels and counts the edges in each tile, pass 2 fills the tile lists.  The
+      //  edges are the same ones that inside_polygon2 uses (including the one from the last vertex to the first).
+
+      memset (bits, 0, out->bit_size);
+      memset (tile_start, 0, (num_tiles + 1) * sizeof (uint32_t));
+
+      double *edge = NULL;
+
+      for (int32_t pass = 0 ; pass < 2 ; pass++)
+        {
+          for (int32_t k = 0 ; k < cell->num_poly ; k++)
+            {
+              int32_t n = cell->poly_count[k];
+              double *px = cell->poly_x[k], *py = cell->poly_y[k];
+
+              for (int32_t i = 0, j = n - 1 ; i < n ; j = i++)
+                {
+                  double e[4] = {px[j], py[j], px[i], py[i]};
+
+                  if (e[0] == e[2] && e[1] == e[3]) continue;
+
+                  int32_t rows;
+
+                  if (!pass)
+                    {
+                      rows = edge_cover (e, lat, lon, pc, span);
+
+                      for (int32_t r = 0 ; r < rows ; r++)
+                        {
+                          int64_t start = (int64_t) span[r * 3] * pc;
+
+                          for (int64_t pos = start + span[r * 3 + 1] ; pos <= start + span[r * 3 + 2] ; pos++)
+                            bits[pos >> 3] |= 0x80 >> (pos & 7);
+                        }
+                    }
+
+                  rows = edge_cover (e, lat, lon, CLM_EDGE_TILES, span);
+
+                  for (int32_t r = 0 ; r < rows ; r++)
+                    {
+                      for (int32_t c = span[r * 3 + 1] ; c <= span[r * 3 + 2] ; c++)
+                        {
+                          int32_t tile = span[r * 3] * CLM_EDGE_TILES + c;
+
+                          if (!pass)
+                            {
+                              tile_start[tile + 1]++;
+                            }
+                          else
+                            {
+                              memcpy (&edge[tile_next[tile]++ * 4], e, sizeof (e));
+                            }
+                        }
+                    }
+                }
+            }
+
+
+          if (!pass)
+            {
+              for (int32_t t = 0 ; t < num_tiles ; t++) tile_start[t + 1] += tile_start[t];
+
+              memcpy (tile_next, tile_start, num_tiles * sizeof (uint32_t));
+
+              edge = (double *) malloc (qMax ((uint32_t) 1, tile_start[num_tiles]) * 4 * sizeof (double));
+              if (edge == NULL)
+                {
+                  perror ("Allocating edge memory");
+                  exit (-1);
+                }
+            }
+        }
+
+
+      if (clm_edges_write (out, lat, lon, bits, tile_start, edge) < 0)
+        {
+          fprintf (stderr, "\nError writing the edges of %s to %s : %s\n", cell->path, out->path, strerror (errno));
+          exit (-1);
+        }
+
+      for (int32_t i = 0 ; i < out->bit_size ; i++)
+        {
+          uint8_t b = bits[i];
+          for ( ; b ; b &= b - 1) total_boundary++;
+        }
+
+      total_edges += tile_start[num_tiles];
+      blocks++;
+
+      free (edge);
+      swbd_free_cell (cell);
+    }
+
+
+  swbd_prefetch_stop (prefetch);
+  swbd_close (source);
+
+  clm_edges_close (out);
+  clm_close (clm);
+
+  free (mixed);
+  free (bits);
+  free (tile_start);
+  free (tile_next);
+  free (span);
+
+
+  fprintf (stderr, "100%% processed, %d blocks, %lld boundary pixels, %lld tile edges, %.3f seconds\n", blocks,
+           (long long) total_boundary, (long long) total_edges, (double) timer.elapsed () / 1000.0);
+  if (no_shapefile) fprintf (stderr, "%d mixed blocks have no shapefile (they will be answered from the raster)\n",
+                             no_shapefile);
+  fprintf (stderr, "\n");
+  fflush (stderr);
+
+  return (0);
+}
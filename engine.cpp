@@ -0,0 +1,462 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#include "engine.hpp"
+#include "version.h"
+
+
+/*!
+  - Per cell selection of the rasterization engine for the main build.  The cost of each engine is predicted from
+    the cell's features (vertex and ring counts, bounding box coverage, and resolution) with a linear model whose
+    constants are measured on this machine by timing both engines on synthetic cells (clm_engine_calibrate).  The
+    constants are saved in $ABE_DATA/land_mask/swbd_mask_engine.cal so that the calibration only has to be run once
+    (or again with the calibrate mode after moving to a different machine).
+*/
+
+
+const char *clm_engine_name[CLM_ENGINE_COUNT] = {"brute", "scanline"};
+
+
+//  Calibration cells.  Pixels times (rings + covered vertices) above ENGINE_BRUTE_LIMIT aren't timed with the
+//  brute force engine (they would take minutes at 10 seconds).
+
+#define ENGINE_BRUTE_LIMIT           4.0e7
+#define ENGINE_MIN_NSECS             20000000
+
+static const int32_t engine_resolution[] = {60, 30, 10};
+static const int32_t engine_vertices[] = {8, 64, 512, 4096};
+static const int32_t engine_rings[] = {1, 16};
+
+#define ENGINE_RESOLUTIONS           ((int32_t) (sizeof (engine_resolution) / sizeof (int32_t)))
+#define ENGINE_VERTICES              ((int32_t) (sizeof (engine_vertices) / sizeof (int32_t)))
+#define ENGINE_RINGS                 ((int32_t) (sizeof (engine_rings) / sizeof (int32_t)))
+
+
+
+void clm_engine_features (int32_t num_poly, int32_t *poly_count, double **poly_x, double **poly_y, int32_t lat, int32_t lon,
+                          int32_t resolution, CLM_ENGINE_FEATURES *features)
+{
+  features->vertices = 0;
+  features->rings = num_poly;
+  features->rows = 3600 / resolution;
+  features->pixels = (int64_t) features->rows * features->rows;
+  features->covered = 0.0;
+
+  for (int32_t k = 0 ; k < num_poly ; k++)
+    {
+      if (!poly_count[k]) continue;
+
+      double min_x = poly_x[k][0], max_x = poly_x[k][0], min_y = poly_y[k][0], max_y = poly_y[k][0];
+
+      for (int32_t m = 1 ; m < poly_count[k] ; m++)
+        {
+          min_x = qMin (min_x, poly_x[k][m]);
+          max_x = qMax (max_x, poly_x[k][m]);
+          min_y = qMin (min_y, poly_y[k][m]);
+          max_y = qMax (max_y, poly_y[k][m]);
+        }
+
+
+      //  Fraction of the cell covered by the (clipped) bounding box.
+
+      double width = qMin (max_x, (double) (lon + 1)) - qMax (min_x, (double) lon);
+      double height = qMin (max_y, (double) (lat + 1)) - qMax (min_y, (double) lat);
+
+      features->vertices += poly_count[k];
+      if (width > 0.0 && height > 0.0) features->covered += (double) poly_count[k] * width * height;
+    }
+}
+
+
+
+void clm_engine_cost (CLM_ENGINE_MODEL *model, CLM_ENGINE_FEATURES *features, double *cost)
+{
+  double pixels = (double) features->pixels;
+
+  cost[CLM_ENGINE_BRUTE] = model->ring * pixels * (double) features->rings + model->vertex * pixels * features->covered;
+  cost[CLM_ENGINE_SCANLINE] = model->edge * (double) features->rows * (double) features->vertices + model->pixel * pixels;
+}
+
+
+
+int32_t clm_engine_select (CLM_ENGINE_MODEL *model, CLM_ENGINE_FEATURES *features)
+{
+  double cost[CLM_ENGINE_COUNT];
+
+  clm_engine_cost (model, features, cost);
+
+  if (cost[CLM_ENGINE_BRUTE] < cost[CLM_ENGINE_SCANLINE]) return (CLM_ENGINE_BRUTE);
+
+  return (CLM_ENGINE_SCANLINE);
+}
+
+
+
+//!  Calibration file path in path (at least 512 bytes).  Returns -1 if ABE_DATA isn't set.
+
+int32_t clm_engine_path (char *path)
+{
+  if (getenv ("ABE_DATA") == NULL) return (-1);
+
+  snprintf (path, 512, "%s%1cland_mask%1c%s", getenv ("ABE_DATA"), (char) SEPARATOR, (char) SEPARATOR, CLM_ENGINE_FILE);
+
+  return (0);
+}
+
+
+
+//!  Read the model constants.  Returns -1 if the file can't be opened or is missing any of them.
+
+int32_t clm_engine_load (char *path, CLM_ENGINE_MODEL *model)
+{
+  char              line[512];
+  int32_t           found = 0;
+
+
+  FILE *fp = fopen (path, "r");
+  if (fp == NULL) return (-1);
+
+  while (fgets (line, sizeof (line), fp))
+    {
+      if (!strncmp (line, "[RING] = ", 9) && sscanf (&line[9], "%lf", &model->ring) == 1) found |= 1;
+      if (!strncmp (line, "[VERTEX] = ", 11) && sscanf (&line[11], "%lf", &model->vertex) == 1) found |= 2;
+      if (!strncmp (line, "[EDGE] = ", 9) && sscanf (&line[9], "%lf", &model->edge) == 1) found |= 4;
+      if (!strncmp (line, "[PIXEL] = ", 10) && sscanf (&line[10], "%lf", &model->pixel) == 1) found |= 8;
+    }
+
+  fclose (fp);
+
+  if (found != 15) return (-1);
+
+  return (0);
+}
+
+
+
+int32_t clm_engine_save (char *path, CLM_ENGINE_MODEL *model)
+{
+  FILE *fp = fopen (path, "w");
+  if (fp == NULL) return (-1);
+
+  time_t t = time (&t);
+  struct tm *cur_tm = gmtime (&t);
+
+  fprintf (fp, "[VERSION] = %s\n", VERSION);
+  fprintf (fp, "[CREATION DATE] = %s", asctime (cur_tm));
+  fprintf (fp, "[RING] = %.6e\n", model->ring);
+  fprintf (fp, "[VERTEX] = %.6e\n", model->vertex);
+  fprintf (fp, "[EDGE] = %.6e\n", model->edge);
+  fprintf (fp, "[PIXEL] = %.6e\n", model->pixel);
+
+  if (fclose (fp)) return (-1);
+
+  return (0);
+}
+
+
+
+/*!
+  - Synthetic calibration cell at 0,0.  The rings are stars (alternating outer and inner radius) on a square grid
+    so that their bounding boxes don't overlap and the total vertex count is spread evenly over them.
+*/
+
+static void engine_cell (int32_t vertices, int32_t rings, int32_t *poly_count, double **poly_x, double **poly_y)
+{
+  int32_t side = NINT (sqrt ((double) rings));
+  double spacing = 1.0 / (double) side;
+  double radius = 0.4 * spacing;
+
+  for (int32_t k = 0 ; k < rings ; k++)
+    {
+      double cx = ((double) (k % side) + 0.5) * spacing;
+      double cy = ((double) (k / side) + 0.5) * spacing;
+
+      poly_count[k] = vertices / rings;
+
+      for (int32_t m = 0 ; m < poly_count[k] ; m++)
+        {
+          double angle = 2.0 * M_PI * (double) m / (double) poly_count[k];
+          double r = (m % 2) ? 0.6 * radius : radius;
+
+          poly_x[k][m] = cx + r * cos (angle);
+          poly_y[k][m] = cy + r * sin (angle);
+        }
+    }
+}
+
+
+
+//!  Average time of one single threaded maskThread run over the cell (repeated for at least ENGINE_MIN_NSECS).
+
+static double engine_time (int32_t engine, int32_t resolution, int32_t rings, int32_t *poly_count, double **poly_x, double **poly_y,
+                           uint8_t *block)
+{
+  maskThread        mask_thread;
+  uint8_t           complete = NVFalse;
+  int32_t           runs = 0;
+
+
+  FILL_POLYGON *fill = NULL;
+
+  QElapsedTimer timer;
+  timer.start ();
+
+  do
+    {
+      if (engine == CLM_ENGINE_SCANLINE)
+        {
+          fill = fill_create (rings, poly_count, poly_x, poly_y);
+          if (fill == NULL)
+            {
+              perror ("Allocating fill memory");
+              exit (-1);
+            }
+        }
+
+      mask_thread.mask (block, resolution, rings, poly_count, poly_y, poly_x, 0.0, 0.0, &complete, 1, 0, NVFalse, fill);
+      mask_thread.wait ();
+
+      if (fill != NULL) fill_destroy (fill);
+      fill = NULL;
+
+      runs++;
+    } while (timer.nsecsElapsed () < ENGINE_MIN_NSECS);
+
+  return ((double) timer.nsecsElapsed () / 1.0e9 / (double) runs);
+}
+
+
+
+/*!
+  - Least squares fit of t = a * x1 + b * x2 with a and b >= 0 (if the unconstrained fit makes one of them
+    negative it's set to zero and the other is fitted alone).
+*/
+
+static void engine_fit (int32_t n, double *x1, double *x2, double *t, double *a, double *b)
+{
+  double s11 = 0.0, s12 = 0.0, s22 = 0.0, s1t = 0.0, s2t = 0.0;
+
+  for (int32_t i = 0 ; i < n ; i++)
+    {
+      s11 += x1[i] * x1[i];
+      s12 += x1[i] * x2[i];
+      s22 += x2[i] * x2[i];
+      s1t += x1[i] * t[i];
+      s2t += x2[i] * t[i];
+    }
+
+  double det = s11 * s22 - s12 * s12;
+
+  *a = *b = -1.0;
+
+  if (det > 0.0)
+    {
+      *a = (s1t * s22 - s2t * s12) / det;
+      *b = (s2t * s11 - s1t * s12) / det;
+    }
+
+  if (*a < 0.0 || *b < 0.0)
+    {
+      double a1 = s11 > 0.0 ? qMax (0.0, s1t / s11) : 0.0;
+      double b2 = s22 > 0.0 ? qMax (0.0, s2t / s22) : 0.0;
+
+
+      //  Keep whichever single term leaves the smaller residual.
+
+      double r1 = 0.0, r2 = 0.0;
+
+      for (int32_t i = 0 ; i < n ; i++)
+        {
+          r1 += (t[i] - a1 * x1[i]) * (t[i] - a1 * x1[i]);
+          r2 += (t[i] - b2 * x2[i]) * (t[i] - b2 * x2[i]);
+        }
+
+      *a = (r1 <= r2) ? a1 : 0.0;
+      *b = (r1 <= r2) ? 0.0 : b2;
+    }
+}
+
+
+
+/*!
+  - Time both engines (single threaded, so that the constants don't depend on the thread count) on the synthetic
+    cells and fit the model.  Each measurement is printed to fp if it isn't NULL.  The weighting of the fit is by
+    relative error (each row is divided by its time) so that the small cells, where the choice is closest, count as
+    much as the big ones.
+*/
+
+void clm_engine_calibrate (CLM_ENGINE_MODEL *model, FILE *fp)
+{
+  int32_t           max_vertices = engine_vertices[ENGINE_VERTICES - 1];
+  int32_t           max_rings = engine_rings[ENGINE_RINGS - 1];
+  int32_t           n_brute = 0, n_scan = 0;
+  int32_t           max_runs = ENGINE_RESOLUTIONS * ENGINE_VERTICES * ENGINE_RINGS;
+  int32_t           poly_count[16];
+  double            *poly_x[16], *poly_y[16];
+  double            bx1[24], bx2[24], bt[24], sx1[24], sx2[24], st[24];
+
+
+  //  The fixed arrays above are sized for the tables.
+
+  if (max_rings > 16 || max_runs > 24)
+    {
+      fprintf (stderr, "\n\nToo many calibration cells\n\n");
+      exit (-1);
+    }
+
+  for (int32_t k = 0 ; k < max_rings ; k++)
+    {
+      poly_x[k] = (double *) malloc (max_vertices * sizeof (double));
+      poly_y[k] = (double *) malloc (max_vertices * sizeof (double));
+
+      if (poly_x[k] == NULL || poly_y[k] == NULL)
+        {
+          perror ("Allocating calibration polygon memory");
+          exit (-1);
+        }
+    }
+
+  int32_t max_rows = 3600 / engine_resolution[ENGINE_RESOLUTIONS - 1];
+
+  uint8_t *block = (uint8_t *) malloc ((size_t) max_rows * max_rows);
+  if (block == NULL)
+    {
+      perror ("Allocating calibration block memory");
+      exit (-1);
+    }
+
+
+  if (fp != NULL) fprintf (fp, "  res  vertices  rings   coverage     brute (ms)   scanline (ms)\n");
+
+  for (int32_t r = 0 ; r < ENGINE_RESOLUTIONS ; r++)
+    {
+      for (int32_t v = 0 ; v < ENGINE_VERTICES ; v++)
+        {
+          for (int32_t g = 0 ; g < ENGINE_RINGS ; g++)
+            {
+              int32_t rings = engine_rings[g];
+
+              if (engine_vertices[v] < 4 * rings) continue;
+
+              engine_cell (engine_vertices[v], rings, poly_count, poly_x, poly_y);
+
+              CLM_ENGINE_FEATURES features;
+              clm_engine_features (rings, poly_count, poly_x, poly_y, 0, 0, engine_resolution[r], &features);
+
+              double pixels = (double) features.pixels;
+              double brute = -1.0;
+
+
+              //  Each row of the fit is divided by its time (relative error).
+
+              if (pixels * ((double) rings + features.covered) <= ENGINE_BRUTE_LIMIT)
+                {
+                  brute = engine_time (CLM_ENGINE_BRUTE, engine_resolution[r], rings, poly_count, poly_x, poly_y, block);
+
+                  bx1[n_brute] = pixels * (double) rings / brute;
+                  bx2[n_brute] = pixels * features.covered / brute;
+                  bt[n_brute] = 1.0;
+                  n_brute++;
+                }
+
+              double scan = engine_time (CLM_ENGINE_SCANLINE, engine_resolution[r], rings, poly_count, poly_x, poly_y, block);
+
+              sx1[n_scan] = (double) features.rows * (double) features.vertices / scan;
+              sx2[n_scan] = pixels / scan;
+              st[n_scan] = 1.0;
+              n_scan++;
+
+              if (fp != NULL)
+                {
+                  if (brute < 0.0)
+                    {
+                      fprintf (fp, "  %3d  %8d  %5d  %9.3f   %12s  %14.3f\n", engine_resolution[r], features.vertices, rings,
+                               features.covered / (double) features.vertices, "skipped", scan * 1000.0);
+                    }
+                  else
+                    {
+                      fprintf (fp, "  %3d  %8d  %5d  %9.3f   %12.3f  %14.3f\n", engine_resolution[r], features.vertices, rings,
+                               features.covered / (double) features.vertices, brute * 1000.0, scan * 1000.0);
+                    }
+                  fflush (fp);
+                }
+            }
+        }
+    }
+
+
+  engine_fit (n_brute, bx1, bx2, bt, &model->ring, &model->vertex);
+  engine_fit (n_scan, sx1, sx2, st, &model->edge, &model->pixel);
+
+
+  free (block);
+
+  for (int32_t k = 0 ; k < max_rings ; k++)
+    {
+      free (poly_x[k]);
+      free (poly_y[k]);
+    }
+}
+
+
+
+/*!
+  - Load the model for the main build, calibrating (and saving the result) if there isn't a calibration file.  If
+    it can't be saved the calibration is just used for this run.
+*/
+
+void clm_engine_setup (CLM_ENGINE_MODEL *model)
+{
+  char              path[512] = CLM_ENGINE_FILE;
+
+
+  if (clm_engine_path (path) || clm_engine_load (path, model))
+    {
+      fprintf (stderr, "Calibrating the rasterization engines (see the calibrate mode)\n\n");
+      fflush (stderr);
+
+      clm_engine_calibrate (model, stderr);
+
+      if (clm_engine_path (path) || clm_engine_save (path, model))
+        {
+          fprintf (stderr, "\nUnable to save the calibration to %s\n", path);
+        }
+
+      fprintf (stderr, "\n");
+      fflush (stderr);
+    }
+}
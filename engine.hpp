@@ -0,0 +1,105 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+
+#include "clm.hpp"
+#include "maskThread.hpp"
+
+
+//  Rasterization engines (see maskThread::run).
+
+#define CLM_ENGINE_BRUTE             0          //  Point in polygon test of every bin (rings rejected by bounding box)
+#define CLM_ENGINE_SCANLINE          1          //  Edge table scanline fill (fill.cpp)
+#define CLM_ENGINE_COUNT             2
+
+
+//  Calibration file name (in $ABE_DATA/land_mask).
+
+#define CLM_ENGINE_FILE              "swbd_mask_engine.cal"
+
+
+/*!
+  - Cheap features of one cell's polygons, computed before rasterizing it.  covered is the sum, over the rings, of
+    the ring's vertex count times the fraction of the cell that its bounding box covers.  That's the average number
+    of vertices that the brute force engine has to test for each bin.
+*/
+
+typedef struct
+{
+  int32_t         vertices;                 //!<  Total number of vertices
+  int32_t         rings;                    //!<  Number of rings
+  int32_t         rows;                     //!<  Rows (and columns) in the block
+  int64_t         pixels;                   //!<  Bins in the block
+  double          covered;                  //!<  Vertices weighted by bounding box coverage
+} CLM_ENGINE_FEATURES;
+
+
+/*!
+  - Cost model for the engines, in seconds:
+        - brute = ring * pixels * rings + vertex * pixels * covered
+        - scanline = edge * rows * vertices + pixel * pixels
+  - The scanline engine bands edges by one degree of latitude so every row of a cell crosses all of the cell's
+    edges.  The constants depend on the machine and are measured by clm_engine_calibrate.
+*/
+
+typedef struct
+{
+  double          ring;                     //!<  Bounding box test of one ring for one bin
+  double          vertex;                   //!<  One covered vertex for one bin
+  double          edge;                     //!<  One edge for one row
+  double          pixel;                    //!<  Filling one bin
+} CLM_ENGINE_MODEL;
+
+
+extern const char *clm_engine_name[CLM_ENGINE_COUNT];
+
+
+void clm_engine_features (int32_t num_poly, int32_t *poly_count, double **poly_x, double **poly_y, int32_t lat, int32_t lon,
+                          int32_t resolution, CLM_ENGINE_FEATURES *features);
+void clm_engine_cost (CLM_ENGINE_MODEL *model, CLM_ENGINE_FEATURES *features, double *cost);
+int32_t clm_engine_select (CLM_ENGINE_MODEL *model, CLM_ENGINE_FEATURES *features);
+int32_t clm_engine_path (char *path);
+int32_t clm_engine_load (char *path, CLM_ENGINE_MODEL *model);
+int32_t clm_engine_save (char *path, CLM_ENGINE_MODEL *model);
+void clm_engine_calibrate (CLM_ENGINE_MODEL *model, FILE *fp);
+void clm_engine_setup (CLM_ENGINE_MODEL *model);
+
+
+#endif
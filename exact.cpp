@@ -0,0 +1,212 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#include "exact.hpp"
+
+
+/*!
+  - Land/water for points, exact to the SWBD polygon edges near the coastlines.  Points are answered from the
+    packed raster (through a block cache) unless they fall in a boundary pixel, in which case the edges stored for
+    the pixel's tile in the edge file (see the edges mode) are used.  The last EXACT_EDGE_BLOCKS edge blocks that
+    were read are kept (first in, first out) so that the edges of a block are usually only read once.
+*/
+
+
+//  Number of decoded edge blocks kept.
+
+#define EXACT_EDGE_BLOCKS            64
+
+
+static void exact_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask exact [-m CACHE_MB] INPUT_CLM EDGE_FILE [POINT_FILE]\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-m CACHE_MB = block cache size in megabytes (default 256)\n");
+  fprintf (stderr, "\tEDGE_FILE = built from INPUT_CLM with the edges mode\n");
+  fprintf (stderr, "\tPOINT_FILE = LAT LON points, one per line (default standard input)\n\n");
+  fprintf (stderr, "Output is the point followed by 1 (land), 0 (water), or -1 (undefined).\n\n");
+  exit (-1);
+}
+
+
+
+int32_t exact (int32_t argc, char **argv)
+{
+  int32_t           cache_mb = 256, c;
+  char              string[1024];
+
+
+  while ((c = getopt (argc, argv, "m:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'm':
+          sscanf (optarg, "%d", &cache_mb);
+          break;
+
+        default:
+          exact_usage ();
+          break;
+        }
+    }
+
+
+  if (optind + 2 > argc || optind + 3 < argc || cache_mb < 1) exact_usage ();
+
+
+  CLM_FILE *clm = clm_open (argv[optind]);
+  if (clm == NULL)
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+  CLM_EDGES *edges = clm_edges_open (argv[optind + 1]);
+  if (edges == NULL)
+    {
+      perror (argv[optind + 1]);
+      exit (-1);
+    }
+
+  if (edges->resolution != clm->resolution)
+    {
+      fprintf (stderr, "\n\n%s is %d second, %s is %d second\n\n", edges->path, edges->resolution, clm->path, clm->resolution);
+      exit (-1);
+    }
+
+
+  FILE *fp = stdin;
+  if (optind + 2 < argc && (fp = fopen (argv[optind + 2], "r")) == NULL)
+    {
+      perror (argv[optind + 2]);
+      exit (-1);
+    }
+
+
+  CLM_CACHE *cache = clm_cache_create (clm, (int64_t) cache_mb * 1048576);
+  if (cache == NULL)
+    {
+      perror ("Allocating cache memory");
+      exit (-1);
+    }
+
+  CLM_EDGE_BLOCK block[EXACT_EDGE_BLOCKS];
+  memset (block, 0, sizeof (block));
+  for (int32_t i = 0 ; i < EXACT_EDGE_BLOCKS ; i++) block[i].index = -1;
+
+  int32_t *slot = (int32_t *) malloc (CLM_BLOCKS * sizeof (int32_t));
+  if (slot == NULL)
+    {
+      perror ("Allocating slot memory");
+      exit (-1);
+    }
+
+  for (int32_t i = 0 ; i < CLM_BLOCKS ; i++) slot[i] = -1;
+
+  int32_t victim = 0;
+
+
+  QElapsedTimer timer;
+  timer.start ();
+
+  int64_t count = 0, vector = 0;
+
+  while (fgets (string, sizeof (string), fp) != NULL)
+    {
+      double lat, lon;
+
+      if (sscanf (string, "%lf %lf", &lat, &lon) != 2 || !(lat >= -90.0 && lat <= 90.0 && lon >= -360.0 && lon <= 360.0))
+        {
+          fprintf (stdout, "INVALID\n");
+          continue;
+        }
+
+      double wlon = lon;
+      if (wlon < -180.0) wlon += 360.0;
+      if (wlon >= 180.0) wlon -= 360.0;
+
+      int32_t ilat = (int32_t) floor (lat);
+      int32_t ilon = (int32_t) floor (wlon);
+      if (ilat > 89) ilat = 89;
+
+
+      uint8_t *bits = NULL, used;
+      int32_t code = clm_cache_get (cache, ilat, ilon, &bits);
+      int32_t index = clm_block_index (ilat, ilon);
+
+
+      //  Pick the slot for the block's edges (clm_edges_point reads them if the slot holds another block).
+
+      if (code == CLM_MIXED && slot[index] < 0)
+        {
+          if (block[victim].index >= 0) slot[block[victim].index] = -1;
+
+          slot[index] = victim;
+          victim = (victim + 1) % EXACT_EDGE_BLOCKS;
+        }
+
+      int32_t land = clm_edges_point (edges, &block[qMax (0, slot[index])], code, bits, lat, wlon, &used);
+
+      if (code == CLM_MIXED) clm_cache_release (cache, ilat, ilon);
+
+      if (land == -2)
+        {
+          fprintf (stderr, "\nError reading block %d %d from %s\n", ilat, ilon, edges->path);
+          exit (-1);
+        }
+
+      fprintf (stdout, "%.9f %.9f %d\n", lat, lon, land);
+
+      count++;
+      vector += used;
+    }
+
+
+  fprintf (stderr, "%lld points, %lld answered from the edges, %.3f seconds\n\n", (long long) count, (long long) vector,
+           (double) timer.elapsed () / 1000.0);
+  fflush (stderr);
+
+
+  if (fp != stdin) fclose (fp);
+  for (int32_t i = 0 ; i < EXACT_EDGE_BLOCKS ; i++) clm_edges_free_block (&block[i]);
+  free (slot);
+  clm_cache_destroy (cache);
+  clm_edges_close (edges);
+  clm_close (clm);
+
+  return (0);
+}
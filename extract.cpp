@@ -0,0 +1,420 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "extract.hpp"
+
+
+/*!
+  - Extract an area of a .clm file at its own resolution as a north up raw grid of bytes, floats, or bits with an
+    ESRI .hdr file (so GDAL and most GIS packages can read it).  A cell is in the area if its center is.  The
+    output is built one one-degree band at a time.  The threads take the blocks in the band, uncompress them, and
+    decode the part that is in the area straight into the band buffer with clm_decode_rect (rows flipped with a
+    negative stride).  Bit grids are decoded per block and then shifted into place when the band is written
+    since neighboring blocks can share a word.
+*/
+
+
+static const char *type_name[3] = {"byte", "float", "bits"};
+
+
+extractThread::extractThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+extractThread::~extractThread ()
+{
+}
+
+
+
+void extractThread::extract (CLM_FILE *in, CLM_GRID *g, EXTRACT_BAND *b, QAtomicInt *n)
+{
+  QMutexLocker locker (&mutex);
+
+  l_in = in;
+  l_grid = g;
+  l_band = b;
+  l_next = n;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+void extractThread::run ()
+{
+  mutex.lock ();
+
+  CLM_FILE *in = l_in;
+  CLM_GRID grid = *l_grid;
+  EXTRACT_BAND *band = l_band;
+  QAtomicInt *next = l_next;
+
+  mutex.unlock ();
+
+
+  int32_t pc = in->point_count;
+
+  uint8_t *bits = (uint8_t *) malloc (in->bit_size);
+  if (bits == NULL)
+    {
+      perror ("Allocating memory in extractThread");
+      exit (-1);
+    }
+
+
+  int32_t i;
+  while ((i = next->fetchAndAddOrdered (1)) < band->num_blocks)
+    {
+      int32_t k = band->first_block + i;
+      int32_t lon = k - 180;
+
+
+      //  Columns of this block that are in the output and where they go.
+
+      int64_t start = qMax (band->col0, (int64_t) k * pc);
+      int64_t end = qMin (band->col1, (int64_t) k * pc + pc - 1);
+      int32_t col = (int32_t) (start - (int64_t) k * pc);
+      int32_t cols = (int32_t) (end - start + 1);
+
+
+      int32_t code = clm_read_block (in, band->lat, lon, bits);
+      if (code < 0)
+        {
+          fprintf (stderr, "\nError reading block %d %d from %s\n", band->lat, lon, in->path);
+          exit (-1);
+        }
+
+
+      //  The last (northernmost) block row goes to the first band row.
+
+      switch (grid.type)
+        {
+        case CLM_GRID_BYTE:
+          grid.data = (uint8_t *) band->data + (band->rows - 1) * band->cols + (start - band->col0);
+          grid.stride = -band->cols;
+          break;
+
+        case CLM_GRID_FLOAT:
+          grid.data = (float *) band->data + (band->rows - 1) * band->cols + (start - band->col0);
+          grid.stride = -band->cols;
+          break;
+
+        case CLM_GRID_BITS:
+          grid.data = (uint64_t *) band->data + ((int64_t) i * band->rows + band->rows - 1) * band->block_words;
+          grid.stride = -band->block_words;
+          break;
+        }
+
+      clm_decode_rect (in, code, bits, band->row, col, band->rows, cols, &grid);
+    }
+
+
+  free (bits);
+}
+
+
+
+static void extract_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask extract -a S,W,N,E [-f FORMAT] [-l LAND] [-w WATER] [-u UNDEFINED] [-t NUM_THREADS]\n");
+  fprintf (stderr, "                         INPUT_CLM OUTPUT\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-a S,W,N,E = area in degrees (W < E, -180 to 180)\n");
+  fprintf (stderr, "\t-f FORMAT = byte, float, or bits (default byte)\n");
+  fprintf (stderr, "\t-l LAND = value for land cells (default 1)\n");
+  fprintf (stderr, "\t-w WATER = value for water cells (default 0)\n");
+  fprintf (stderr, "\t-u UNDEFINED = value for undefined cells (default 255 or -9999, always 0 for bits)\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of compute threads (1 to %d, default 4)\n", CLM_MAX_THREADS);
+  fprintf (stderr, "\tOUTPUT = output raw grid (OUTPUT.hdr is also written)\n\n");
+  exit (-1);
+}
+
+
+
+/*!
+  - Extract an area of a .clm file as a raw grid.
+*/
+
+int32_t extract (int32_t argc, char **argv)
+{
+  int32_t           num_threads = 4, type = CLM_GRID_BYTE, c;
+  double            land = 1.0, water = 0.0, undefined = 0.0, south = 0.0, west = 0.0, north = 0.0, east = 0.0;
+  uint8_t           undefined_set = NVFalse;
+  char              hdr_name[1024];
+  FILE              *fp;
+  extractThread     extract_thread[CLM_MAX_THREADS];
+
+
+  while ((c = getopt (argc, argv, "a:f:l:w:u:t:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'a':
+          sscanf (optarg, "%lf,%lf,%lf,%lf", &south, &west, &north, &east);
+          break;
+
+        case 'f':
+          type = -1;
+          for (int32_t i = 0 ; i < 3 ; i++)
+            {
+              if (!strcmp (optarg, type_name[i])) type = i;
+            }
+          break;
+
+        case 'l':
+          sscanf (optarg, "%lf", &land);
+          break;
+
+        case 'w':
+          sscanf (optarg, "%lf", &water);
+          break;
+
+        case 'u':
+          sscanf (optarg, "%lf", &undefined);
+          undefined_set = NVTrue;
+          break;
+
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          extract_usage ();
+          break;
+        }
+    }
+
+
+  if (optind + 2 != argc || type < 0 || num_threads < 1 || num_threads > CLM_MAX_THREADS || south < -90.0 || north > 90.0 ||
+      south >= north || west < -180.0 || east > 180.0 || west >= east) extract_usage ();
+
+  if (!undefined_set && type == CLM_GRID_BYTE) undefined = 255.0;
+  if (!undefined_set && type == CLM_GRID_FLOAT) undefined = -9999.0;
+
+
+  CLM_FILE *in = clm_open (argv[optind]);
+  if (in == NULL)
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+  int32_t pc = in->point_count;
+
+
+  //  Global rows (from the south pole) and columns (from 180W) of the cells whose centers are in the area.
+
+  int64_t row0 = (int64_t) ceil ((south + 90.0) * pc - 0.5);
+  int64_t row1 = (int64_t) ceil ((north + 90.0) * pc - 0.5) - 1;
+  int64_t col0 = (int64_t) ceil ((west + 180.0) * pc - 0.5);
+  int64_t col1 = (int64_t) ceil ((east + 180.0) * pc - 0.5) - 1;
+
+  if (row1 < row0 || col1 < col0)
+    {
+      fprintf (stderr, "\n\nThe area doesn't contain any %d second cells\n\n", in->resolution);
+      exit (-1);
+    }
+
+  int64_t rows = row1 - row0 + 1, cols = col1 - col0 + 1;
+
+
+  //  Bands hold up to pc rows.  Bit grids are kept per block in the band (and need one output row to put them
+  //  together).
+
+  EXTRACT_BAND band;
+  int32_t max_blocks = (int32_t) (col1 / pc - col0 / pc + 1);
+  int32_t block_words = clm_grid_words (pc), row_words = clm_grid_words ((int32_t) cols);
+  size_t band_size;
+
+  switch (type)
+    {
+    case CLM_GRID_BYTE:
+      band_size = (size_t) pc * cols;
+      break;
+
+    case CLM_GRID_FLOAT:
+      band_size = (size_t) pc * cols * sizeof (float);
+      break;
+
+    default:
+      band_size = (size_t) max_blocks * pc * block_words * sizeof (uint64_t);
+      break;
+    }
+
+  band.data = malloc (band_size);
+  uint64_t *out_words = (uint64_t *) malloc (row_words * sizeof (uint64_t));
+  uint8_t *out_bytes = (uint8_t *) malloc (row_words * sizeof (uint64_t));
+  if (band.data == NULL || out_words == NULL || out_bytes == NULL)
+    {
+      perror ("Allocating band memory");
+      exit (-1);
+    }
+
+
+  if ((fp = fopen (argv[optind + 1], "wb")) == NULL)
+    {
+      perror (argv[optind + 1]);
+      exit (-1);
+    }
+
+
+  CLM_GRID grid;
+  grid.type = type;
+  grid.land = land;
+  grid.water = water;
+  grid.undefined = undefined;
+
+  band.col0 = col0;
+  band.col1 = col1;
+  band.cols = cols;
+  band.first_block = (int32_t) (col0 / pc);
+  band.num_blocks = max_blocks;
+  band.block_words = block_words;
+
+  int32_t row_bytes = (int32_t) ((cols + 7) / 8);
+
+
+  QElapsedTimer timer;
+  timer.start ();
+
+
+  //  North to south.
+
+  for (int64_t b = row1 / pc ; b >= row0 / pc ; b--)
+    {
+      int64_t first = qMax (row0, b * pc);
+      int64_t last = qMin (row1, b * pc + pc - 1);
+
+      band.lat = (int32_t) b - 90;
+      band.row = (int32_t) (first - b * pc);
+      band.rows = (int32_t) (last - first + 1);
+
+
+      QAtomicInt next (0);
+
+      for (int32_t i = 0 ; i < num_threads ; i++) extract_thread[i].extract (in, &grid, &band, &next);
+      for (int32_t i = 0 ; i < num_threads ; i++) extract_thread[i].wait ();
+
+
+      if (type == CLM_GRID_BITS)
+        {
+          for (int32_t r = 0 ; r < band.rows ; r++)
+            {
+              memset (out_words, 0, row_words * sizeof (uint64_t));
+
+              for (int32_t i = 0 ; i < band.num_blocks ; i++)
+                {
+                  int64_t k = band.first_block + i;
+                  int64_t start = qMax (col0, k * pc);
+                  int64_t end = qMin (col1, k * pc + pc - 1);
+
+                  clm_copy_bits (out_words, (int32_t) (start - col0), (uint64_t *) band.data + ((int64_t) i * band.rows + r) * block_words,
+                                 0, (int32_t) (end - start + 1));
+                }
+
+
+              //  Most significant bit first, whatever the byte order.
+
+              for (int32_t j = 0 ; j < row_bytes ; j++) out_bytes[j] = (uint8_t) (out_words[j >> 3] >> (56 - 8 * (j & 7)));
+
+              fwrite (out_bytes, row_bytes, 1, fp);
+            }
+        }
+      else
+        {
+          fwrite (band.data, (type == CLM_GRID_BYTE) ? 1 : sizeof (float), (size_t) band.rows * cols, fp);
+        }
+
+
+      fprintf (stderr, "%03d%% processed\r", (int32_t) ((row1 / pc - b) * 100 / (row1 / pc - row0 / pc + 1)));
+      fflush (stderr);
+    }
+
+
+  if (fclose (fp))
+    {
+      perror (argv[optind + 1]);
+      exit (-1);
+    }
+
+
+  //  ESRI header.
+
+  sprintf (hdr_name, "%s.hdr", argv[optind + 1]);
+
+  if ((fp = fopen (hdr_name, "w")) == NULL)
+    {
+      perror (hdr_name);
+      exit (-1);
+    }
+
+  uint16_t one = 1;
+  double dim = 1.0 / (double) pc;
+
+  fprintf (fp, "BYTEORDER      %s\n", *(uint8_t *) &one ? "I" : "M");
+  fprintf (fp, "LAYOUT         BIL\n");
+  fprintf (fp, "NROWS          %lld\n", (long long) rows);
+  fprintf (fp, "NCOLS          %lld\n", (long long) cols);
+  fprintf (fp, "NBANDS         1\n");
+  fprintf (fp, "NBITS          %d\n", (type == CLM_GRID_BYTE) ? 8 : ((type == CLM_GRID_FLOAT) ? 32 : 1));
+  if (type == CLM_GRID_BITS) fprintf (fp, "BANDROWBYTES   %d\nTOTALROWBYTES  %d\n", row_bytes, row_bytes);
+  fprintf (fp, "PIXELTYPE      %s\n", (type == CLM_GRID_FLOAT) ? "FLOAT" : "UNSIGNEDINT");
+  fprintf (fp, "ULXMAP         %.12f\n", -180.0 + ((double) col0 + 0.5) * dim);
+  fprintf (fp, "ULYMAP         %.12f\n", -90.0 + ((double) row1 + 0.5) * dim);
+  fprintf (fp, "XDIM           %.12f\n", dim);
+  fprintf (fp, "YDIM           %.12f\n", dim);
+  if (type != CLM_GRID_BITS) fprintf (fp, "NODATA         %g\n", undefined);
+
+  fclose (fp);
+
+
+  clm_close (in);
+
+  free (band.data);
+  free (out_words);
+  free (out_bytes);
+
+
+  fprintf (stderr, "100%% processed, %lld x %lld cells, %.3f seconds\n\n", (long long) cols, (long long) rows,
+           (double) timer.elapsed () / 1000.0);
+  fflush (stderr);
+
+  return (0);
+}
@@ -0,0 +1,100 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef EXTRACT_H
+#define EXTRACT_H
+
+
+#include "decode.hpp"
+
+
+//!  One one-degree band of the output grid.
+
+typedef struct
+{
+  int32_t          lat;                     //!<  Latitude of the band's blocks
+  int32_t          row, rows;               //!<  First block row and number of rows in the band
+  int32_t          first_block;             //!<  Longitude index (0 to 359) of the first block
+  int32_t          num_blocks;
+  int64_t          col0, col1;              //!<  First and last global column of the output
+  int64_t          cols;                    //!<  Width of the output
+  int32_t          block_words;             //!<  Words per row of one block's bit grid (CLM_GRID_BITS)
+  void             *data;                   //!<  Band buffer (bit grids are kept per block)
+} EXTRACT_BAND;
+
+
+int32_t extract (int32_t argc, char **argv);
+
+
+class extractThread:public QThread
+{
+  Q_OBJECT 
+
+
+public:
+
+  extractThread (QObject *parent = 0);
+  ~extractThread ();
+
+  void extract (CLM_FILE *in = NULL, CLM_GRID *g = NULL, EXTRACT_BAND *b = NULL, QAtomicInt *n = NULL);
+
+
+signals:
+
+
+protected:
+
+
+  QMutex           mutex;
+
+  CLM_FILE         *l_in;
+
+  CLM_GRID         *l_grid;
+
+  EXTRACT_BAND     *l_band;
+
+  QAtomicInt       *l_next;
+
+
+  void             run ();
+
+
+protected slots:
+
+private:
+};
+
+#endif
@@ -0,0 +1,320 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "fill.hpp"
+
+
+/*!
+  - Scanline polygon fill.  A cell is inside if its center is inside the polygons using the same even-odd rule
+    as inside_polygon2 (a point is inside if a ray from it crosses an odd number of edges, counting all of the
+    polygons together, so holes and overlaps cancel).  Instead of testing every cell center against every edge we
+    compute where each scanline (row of cell centers) crosses the edges, sort the crossings, and turn them into
+    spans of columns.
+  - With fill->rule set to FILL_NONZERO a point is inside if the signed crossings (edges going north minus edges
+    going south) don't add up to zero.  Overlapping or duplicated rings then stay filled instead of punching holes.
+    It costs the same as even-odd (the crossing direction rides along with x in the sort).
+*/
+
+
+FILL_POLYGON *fill_create (int32_t num_poly, int32_t *poly_count, double **poly_x, double **poly_y)
+{
+  FILL_POLYGON *fill = (FILL_POLYGON *) calloc (1, sizeof (FILL_POLYGON));
+  if (fill == NULL) return (NULL);
+
+  fill->min_x = fill->min_y = 999999.0;
+  fill->max_x = fill->max_y = -999999.0;
+
+  for (int32_t i = 0 ; i < num_poly ; i++)
+    {
+      for (int32_t j = 0 ; j < poly_count[i] ; j++)
+        {
+          fill->min_x = qMin (fill->min_x, poly_x[i][j]);
+          fill->max_x = qMax (fill->max_x, poly_x[i][j]);
+          fill->min_y = qMin (fill->min_y, poly_y[i][j]);
+          fill->max_y = qMax (fill->max_y, poly_y[i][j]);
+        }
+    }
+
+  if (fill->min_y > fill->max_y) return (fill);
+
+
+  fill->south = (int32_t) floor (fill->min_y);
+  fill->num_bands = (int32_t) floor (fill->max_y) - fill->south + 1;
+
+  fill->count = (int32_t *) calloc (fill->num_bands, sizeof (int32_t));
+  fill->edge = (FILL_EDGE **) calloc (fill->num_bands, sizeof (FILL_EDGE *));
+  if (fill->count == NULL || fill->edge == NULL)
+    {
+      perror ("Allocating fill band memory");
+      exit (-1);
+    }
+
+
+  //  Each ring is closed (last point back to first) whether the first point is repeated or not.
+
+  for (int32_t i = 0 ; i < num_poly ; i++)
+    {
+      for (int32_t j = 0, k = poly_count[i] - 1 ; j < poly_count[i] ; k = j++)
+        {
+          if (poly_y[i][j] == poly_y[i][k]) continue;
+
+          FILL_EDGE e;
+
+          if (poly_y[i][k] < poly_y[i][j])
+            {
+              e.x0 = poly_x[i][k];
+              e.y0 = poly_y[i][k];
+              e.x1 = poly_x[i][j];
+              e.y1 = poly_y[i][j];
+              e.dir = 1;
+            }
+          else
+            {
+              e.x0 = poly_x[i][j];
+              e.y0 = poly_y[i][j];
+              e.x1 = poly_x[i][k];
+              e.y1 = poly_y[i][k];
+              e.dir = -1;
+            }
+
+          int32_t first = (int32_t) floor (e.y0) - fill->south;
+          int32_t last = (int32_t) floor (e.y1) - fill->south;
+
+          for (int32_t b = first ; b <= last ; b++)
+            {
+              fill->edge[b] = (FILL_EDGE *) realloc (fill->edge[b], (fill->count[b] + 1) * sizeof (FILL_EDGE));
+              if (fill->edge[b] == NULL)
+                {
+                  perror ("Allocating fill edge memory");
+                  exit (-1);
+                }
+
+              fill->edge[b][fill->count[b]] = e;
+              fill->count[b]++;
+
+              fill->max_count = qMax (fill->max_count, fill->count[b]);
+            }
+        }
+    }
+
+  return (fill);
+}
+
+
+
+void fill_destroy (FILL_POLYGON *fill)
+{
+  if (fill == NULL) return;
+
+  for (int32_t b = 0 ; b < fill->num_bands ; b++)
+    {
+      if (fill->edge[b] != NULL) free (fill->edge[b]);
+    }
+
+  if (fill->count != NULL) free (fill->count);
+  if (fill->edge != NULL) free (fill->edge);
+  free (fill);
+}
+
+
+
+static int32_t compare_doubles (const void *a, const void *b)
+{
+  double da = *(double *) a, db = *(double *) b;
+
+  return ((da > db) - (da < db));
+}
+
+
+
+/*!
+  - fill_spans for the nonzero winding rule.  The crossings are stored as x/direction pairs so that they can be
+    sorted together.  Spans are written over the pairs (a span is never written past the crossing that ends it).
+*/
+
+static int32_t fill_spans_nonzero (FILL_POLYGON *fill, int32_t b, double y, double west, double east, double *spans)
+{
+  //  Crossings west of the window only matter for their sum.
+
+  int32_t n = 0, winding = 0;
+
+  for (int32_t i = 0 ; i < fill->count[b] ; i++)
+    {
+      FILL_EDGE *e = &fill->edge[b][i];
+
+      if (y < e->y0 || y >= e->y1) continue;
+
+      double x = e->x0 + (e->x1 - e->x0) * (y - e->y0) / (e->y1 - e->y0);
+
+      if (x < west)
+        {
+          winding += e->dir;
+        }
+      else if (x < east)
+        {
+          spans[2 * n] = x;
+          spans[2 * n + 1] = (double) e->dir;
+          n++;
+        }
+    }
+
+  qsort (spans, n, 2 * sizeof (double), compare_doubles);
+
+
+  int32_t num_spans = 0;
+  double start = west;
+
+  for (int32_t i = 0 ; i < n ; i++)
+    {
+      double x = spans[2 * i];
+      int32_t next = winding + (int32_t) spans[2 * i + 1];
+
+      if (!winding && next)
+        {
+          start = x;
+        }
+      else if (winding && !next)
+        {
+          spans[2 * num_spans] = start;
+          spans[2 * num_spans + 1] = x;
+          num_spans++;
+        }
+
+      winding = next;
+    }
+
+  if (winding)
+    {
+      spans[2 * num_spans] = start;
+      spans[2 * num_spans + 1] = east;
+      num_spans++;
+    }
+
+  return (num_spans);
+}
+
+
+
+/*!
+  - Compute the inside spans of the scanline at latitude y between west and east.  Spans are stored as start/end
+    pairs in "spans" (which must hold 2 * (fill->max_count + 1) doubles) and the number of spans is returned.  A
+    point x is inside a span if start <= x < end.
+*/
+
+int32_t fill_spans (FILL_POLYGON *fill, double y, double west, double east, double *spans)
+{
+  if (y < fill->min_y || y >= fill->max_y) return (0);
+
+  int32_t b = (int32_t) floor (y) - fill->south;
+  if (b < 0 || b >= fill->num_bands) return (0);
+
+
+  if (fill->rule == FILL_NONZERO) return (fill_spans_nonzero (fill, b, y, west, east, spans));
+
+
+  //  Crossings west of the window only matter for their parity.
+
+  int32_t n = 0, inside = 0;
+
+  for (int32_t i = 0 ; i < fill->count[b] ; i++)
+    {
+      FILL_EDGE *e = &fill->edge[b][i];
+
+      if (y < e->y0 || y >= e->y1) continue;
+
+      double x = e->x0 + (e->x1 - e->x0) * (y - e->y0) / (e->y1 - e->y0);
+
+      if (x < west)
+        {
+          inside ^= 1;
+        }
+      else if (x < east)
+        {
+          spans[n++] = x;
+        }
+    }
+
+  qsort (spans, n, sizeof (double), compare_doubles);
+
+
+  //  Turn the crossings into spans in place (there is room for one more at the west end).
+
+  int32_t num_spans = 0;
+  double start = west;
+
+  if (inside)
+    {
+      memmove (&spans[1], spans, n * sizeof (double));
+      spans[0] = west;
+      n++;
+    }
+
+  for (int32_t i = 0 ; i < n ; i++)
+    {
+      if (i & 1)
+        {
+          spans[2 * num_spans] = start;
+          spans[2 * num_spans + 1] = spans[i];
+          num_spans++;
+        }
+      else
+        {
+          start = spans[i];
+        }
+    }
+
+  if (n & 1)
+    {
+      spans[2 * num_spans] = start;
+      spans[2 * num_spans + 1] = east;
+      num_spans++;
+    }
+
+  return (num_spans);
+}
+
+
+
+/*!
+  - Convert a span to the first and last columns (of point_count columns starting at west) whose cell centers
+    are in the span.  last < first if there are none.
+*/
+
+void fill_span_cells (double start, double end, double west, int32_t point_count, int32_t *first, int32_t *last)
+{
+  *first = qMax (0, (int32_t) ceil ((start - west) * (double) point_count - 0.5));
+  *last = qMin (point_count - 1, (int32_t) ceil ((end - west) * (double) point_count - 0.5) - 1);
+}
@@ -0,0 +1,82 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef FILL_H
+#define FILL_H
+
+
+#include "clm.hpp"
+
+
+//  Fill rules.
+
+#define FILL_EVEN_ODD                0
+#define FILL_NONZERO                 1
+
+
+//!  One polygon edge with y0 < y1 (horizontal edges are dropped).
+
+typedef struct
+{
+  double           x0, y0, x1, y1;
+  int32_t          dir;                     //!<  1 if the edge went north, -1 if it went south
+} FILL_EDGE;
+
+
+/*!
+  - Polygon edges sorted into one-degree latitude bands so that the crossings of a scanline only have to be
+    computed for the edges in its band.
+*/
+
+typedef struct
+{
+  int32_t          south;                   //!<  Latitude of the south edge of band 0
+  int32_t          num_bands;
+  int32_t          *count;                  //!<  Number of edges in each band
+  FILL_EDGE        **edge;                  //!<  Edges in each band
+  int32_t          max_count;               //!<  Largest band count (for sizing span buffers)
+  int32_t          rule;                    //!<  FILL_EVEN_ODD (set by fill_create) or FILL_NONZERO
+  double           min_x, max_x, min_y, max_y;
+} FILL_POLYGON;
+
+
+FILL_POLYGON *fill_create (int32_t num_poly, int32_t *poly_count, double **poly_x, double **poly_y);
+void fill_destroy (FILL_POLYGON *fill);
+int32_t fill_spans (FILL_POLYGON *fill, double y, double west, double east, double *spans);
+void fill_span_cells (double start, double end, double west, int32_t point_count, int32_t *first, int32_t *last);
+
+
+#endif
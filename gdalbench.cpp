@@ -0,0 +1,353 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "gdalbench.hpp"
+
+
+/*!
+  - Benchmark swbd_mask's rasterization against GDAL.  Each SWBD cell is rasterized on the same grid (cell
+    centers at (i + 0.5) / point_count) with:
+        - scanline - the edge table scanline fill from fill.cpp (used by zonal and resample)
+        - gdal - GDALRasterizeGeometries into a MEM dataset (ALL_TOUCHED off, so GDAL also uses pixel centers)
+        - mask - maskThread, the point in polygon test that the main program uses to build .clm files
+          (optional since it is very slow at 1 and 3 seconds)
+  - All of the rings of a cell go into one OGR polygon.  GDAL fills polygons with the even-odd rule across all of
+    their rings so this is the same polygon set that maskThread sees.  The result of each engine is a byte grid
+    (1 for land, rows south to north as in a .clm block).  The differences against the scanline engine and the
+    average time per cell are reported.
+  - With -w the scanline and mask engines use the nonzero winding rule.  GDAL always uses even-odd so, for cells
+    with overlapping rings, the GDAL differences show what the winding rule changed.
+*/
+
+
+static const char *engine_name[GDALBENCH_ENGINES] = {"scanline", "gdal", "mask"};
+
+
+
+//!  Scanline fill into grid.
+
+static void rasterize_scanline (SWBD_CELL *cell, int32_t lat, int32_t lon, int32_t pc, int32_t rule, uint8_t *grid)
+{
+  FILL_POLYGON *fill = fill_create (cell->num_poly, cell->poly_count, cell->poly_x, cell->poly_y);
+  double *spans = (double *) malloc ((fill ? 2 * (fill->max_count + 1) : 0) * sizeof (double));
+  if (fill == NULL || spans == NULL)
+    {
+      perror ("Allocating fill memory");
+      exit (-1);
+    }
+
+  fill->rule = rule;
+
+
+  memset (grid, 1, (size_t) pc * pc);
+
+  for (int32_t row = 0 ; row < pc ; row++)
+    {
+      double y = (double) lat + ((double) row + 0.5) / (double) pc;
+
+      int32_t num_spans = fill_spans (fill, y, (double) lon, (double) (lon + 1), spans);
+
+      for (int32_t s = 0 ; s < num_spans ; s++)
+        {
+          int32_t first, last;
+
+          fill_span_cells (spans[2 * s], spans[2 * s + 1], (double) lon, pc, &first, &last);
+          if (last >= first) memset (&grid[(size_t) row * pc + first], 0, last - first + 1);
+        }
+    }
+
+
+  free (spans);
+  fill_destroy (fill);
+}
+
+
+
+//!  GDALRasterizeGeometries into a MEM dataset, then flip the rows into grid.
+
+static void rasterize_gdal (SWBD_CELL *cell, int32_t lat, int32_t lon, int32_t pc, uint8_t *grid, uint8_t *buf)
+{
+  GDALDriverH driver = GDALGetDriverByName ("MEM");
+  GDALDatasetH ds;
+
+  if (driver == NULL || (ds = GDALCreate (driver, "", pc, pc, 1, GDT_Byte, NULL)) == NULL)
+    {
+      fprintf (stderr, "\n\nUnable to create GDAL MEM dataset\n\n");
+      exit (-1);
+    }
+
+
+  //  North up, row 0 is the north edge.
+
+  double transform[6] = {(double) lon, 1.0 / (double) pc, 0.0, (double) (lat + 1), 0.0, -1.0 / (double) pc};
+  GDALSetGeoTransform (ds, transform);
+
+  GDALRasterBandH band = GDALGetRasterBand (ds, 1);
+  GDALFillRaster (band, 1.0, 0.0);
+
+
+  OGRGeometryH poly = OGR_G_CreateGeometry (wkbPolygon);
+
+  for (int32_t i = 0 ; i < cell->num_poly ; i++)
+    {
+      OGRGeometryH ring = OGR_G_CreateGeometry (wkbLinearRing);
+
+      for (int32_t j = 0 ; j < cell->poly_count[i] ; j++) OGR_G_AddPoint_2D (ring, cell->poly_x[i][j], cell->poly_y[i][j]);
+
+      OGR_G_AddGeometryDirectly (poly, ring);
+    }
+
+
+  int32_t band_list = 1;
+  double burn = 0.0;
+
+  if (GDALRasterizeGeometries (ds, 1, &band_list, 1, &poly, NULL, NULL, &burn, NULL, NULL, NULL) != CE_None ||
+      GDALRasterIO (band, GF_Read, 0, 0, pc, pc, buf, pc, pc, GDT_Byte, 0, 0) != CE_None)
+    {
+      fprintf (stderr, "\n\nGDAL rasterization of %s failed\n\n", cell->path);
+      exit (-1);
+    }
+
+  for (int32_t row = 0 ; row < pc ; row++) memcpy (&grid[(size_t) row * pc], &buf[(size_t) (pc - 1 - row) * pc], pc);
+
+
+  OGR_G_DestroyGeometry (poly);
+  GDALClose (ds);
+}
+
+
+
+//!  maskThread (4 threads, as in the main program).
+
+static void rasterize_mask (SWBD_CELL *cell, int32_t lat, int32_t lon, int32_t resolution, int32_t rule, uint8_t *grid)
+{
+  maskThread        mask_thread[4];
+  uint8_t           complete[4];
+
+
+  memset (grid, 0, (size_t) (3600 / resolution) * (3600 / resolution));
+  memset (complete, 0, sizeof (complete));
+
+  for (int32_t i = 0 ; i < 4 ; i++)
+    mask_thread[i].mask (grid, resolution, cell->num_poly, cell->poly_count, cell->poly_y, cell->poly_x, (double) lat, (double) lon,
+                         complete, 4, i, rule == FILL_NONZERO);
+
+  for (int32_t i = 0 ; i < 4 ; i++) mask_thread[i].wait ();
+}
+
+
+
+static void gdalbench_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask gdalbench [-r RESOLUTION] [-i ITERATIONS] [-p] [-w] LAT,LON [LAT,LON...]\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-r RESOLUTION = resolution in seconds (1, 3, 10, 30, or 60, default 3)\n");
+  fprintf (stderr, "\t-i ITERATIONS = number of times to rasterize each cell for timing (default 3)\n");
+  fprintf (stderr, "\t-p = also run the point in polygon engine that the main program uses (slow)\n");
+  fprintf (stderr, "\t-w = use the nonzero winding rule instead of even-odd (not for GDAL)\n");
+  fprintf (stderr, "\tLAT,LON = southwest corner of an SWBD cell (requires ABE_DATA)\n\n");
+  exit (-1);
+}
+
+
+
+/*!
+  - Rasterize SWBD cells with swbd_mask's engines and with GDAL and compare the results and the times.
+*/
+
+int32_t gdalbench (int32_t argc, char **argv)
+{
+  int32_t           resolution = 3, iterations = 3, rule = FILL_EVEN_ODD, c;
+  uint8_t           point = NVFalse;
+  char              dirname[512];
+
+
+  while ((c = getopt (argc, argv, "r:i:pw")) != EOF)
+    {
+      switch (c)
+        {
+        case 'r':
+          sscanf (optarg, "%d", &resolution);
+          break;
+
+        case 'i':
+          sscanf (optarg, "%d", &iterations);
+          break;
+
+        case 'p':
+          point = NVTrue;
+          break;
+
+        case 'w':
+          rule = FILL_NONZERO;
+          break;
+
+        default:
+          gdalbench_usage ();
+          break;
+        }
+    }
+
+
+  if (optind >= argc || iterations < 1 ||
+      (resolution != 1 && resolution != 3 && resolution != 10 && resolution != 30 && resolution != 60)) gdalbench_usage ();
+
+
+  if (getenv ("ABE_DATA") == NULL)
+    {
+      fprintf (stderr, "\n\nEnvironment variable ABE_DATA is not set\n\n");
+      fflush (stderr);
+      exit (-1);
+    }
+
+  sprintf (dirname, "%s", getenv ("ABE_DATA"));
+
+  SWBD_SOURCE *source = swbd_open (dirname);
+
+
+  GDALAllRegister ();
+
+  fprintf (stderr, "%s, %d second cells, %s rule\n\n", GDALVersionInfo ("--version"), resolution,
+           (rule == FILL_NONZERO) ? "nonzero winding" : "even-odd");
+
+
+  int32_t pc = 3600 / resolution;
+  size_t size = (size_t) pc * pc;
+  uint8_t *grid[GDALBENCH_ENGINES];
+  uint8_t *buf = (uint8_t *) malloc (size);
+
+  for (int32_t e = 0 ; e < GDALBENCH_ENGINES ; e++) grid[e] = (uint8_t *) malloc (size);
+
+  if (buf == NULL || grid[GDALBENCH_SCANLINE] == NULL || grid[GDALBENCH_GDAL] == NULL || grid[GDALBENCH_MASK] == NULL)
+    {
+      perror ("Allocating grid memory");
+      exit (-1);
+    }
+
+
+  int32_t num_engines = point ? GDALBENCH_ENGINES : GDALBENCH_MASK, cells = 0;
+  double total_time[GDALBENCH_ENGINES] = {0.0, 0.0, 0.0};
+  int64_t total_differ[GDALBENCH_ENGINES] = {0, 0, 0}, total_pixels = 0;
+
+  for (int32_t a = optind ; a < argc ; a++)
+    {
+      int32_t lat, lon;
+
+      if (sscanf (argv[a], "%d,%d", &lat, &lon) != 2 || lat < -90 || lat > 89 || lon < -180 || lon > 179) gdalbench_usage ();
+
+
+      SWBD_CELL *cell = swbd_read_cell (source, lat, lon);
+      if (cell == NULL)
+        {
+          fprintf (stderr, "No SWBD shapefile for %d,%d\n", lat, lon);
+          continue;
+        }
+
+      int32_t vertices = 0;
+      for (int32_t i = 0 ; i < cell->num_poly ; i++) vertices += cell->poly_count[i];
+
+      fprintf (stderr, "%s - %d rings, %d vertices\n", cell->path, cell->num_poly, vertices);
+
+
+      for (int32_t e = 0 ; e < num_engines ; e++)
+        {
+          QElapsedTimer timer;
+          timer.start ();
+
+          for (int32_t i = 0 ; i < iterations ; i++)
+            {
+              switch (e)
+                {
+                case GDALBENCH_SCANLINE:
+                  rasterize_scanline (cell, lat, lon, pc, rule, grid[e]);
+                  break;
+
+                case GDALBENCH_GDAL:
+                  rasterize_gdal (cell, lat, lon, pc, grid[e], buf);
+                  break;
+
+                case GDALBENCH_MASK:
+                  rasterize_mask (cell, lat, lon, resolution, rule, grid[e]);
+                  break;
+                }
+            }
+
+          double ms = (double) timer.nsecsElapsed () / 1.0e6 / (double) iterations;
+
+
+          int64_t differ = 0;
+          for (size_t p = 0 ; p < size ; p++) differ += (grid[e][p] != grid[GDALBENCH_SCANLINE][p]);
+
+          total_time[e] += ms;
+          total_differ[e] += differ;
+
+          fprintf (stderr, "\t%-8s %10.3f ms", engine_name[e], ms);
+          if (e != GDALBENCH_SCANLINE) fprintf (stderr, ", %lld of %lld pixels differ from scanline", (long long) differ, (long long) size);
+          fprintf (stderr, "\n");
+        }
+
+      fflush (stderr);
+
+      total_pixels += size;
+      cells++;
+
+      swbd_free_cell (cell);
+    }
+
+
+  if (cells)
+    {
+      fprintf (stderr, "\n%d cells, average time per cell:\n", cells);
+
+      for (int32_t e = 0 ; e < num_engines ; e++)
+        {
+          fprintf (stderr, "\t%-8s %10.3f ms", engine_name[e], total_time[e] / (double) cells);
+          if (e != GDALBENCH_SCANLINE) fprintf (stderr, ", %.6f%% of pixels differ from scanline",
+                                                100.0 * (double) total_differ[e] / (double) total_pixels);
+          fprintf (stderr, "\n");
+        }
+
+      fprintf (stderr, "\n");
+    }
+
+
+  for (int32_t e = 0 ; e < GDALBENCH_ENGINES ; e++) free (grid[e]);
+  free (buf);
+
+  swbd_close (source);
+
+  return (0);
+}
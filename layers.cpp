@@ -0,0 +1,447 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#include "layers.hpp"
+#include "version.h"
+
+
+/*!
+  - Multi-layer file header (same size as a .clm header):
+
+    <pre>
+
+        [HEADER SIZE] = 16384
+        [VERSION] = 
+        [ZLIB VERSION] =
+        [CREATION DATE] = 
+        [RESOLUTION] = 1, 3, 10, 30, or 60
+        [LAYERS] = number of layers
+        [LAYER 0] = source of layer 0
+        ...
+        [END OF HEADER]
+
+    </pre>
+*/
+
+
+static void layers_sizes (CLM_LAYERS *layers)
+{
+  layers->point_count = 3600 / layers->resolution;
+  layers->bit_size = (layers->point_count * layers->point_count) / 8;
+  layers->block_size = layers->bit_size * layers->num_layers;
+  layers->row_words = (layers->point_count + 63) / 64;
+}
+
+
+
+/*!
+  - Open an existing multi-layer file for reading.  Returns NULL on failure (errno will be set if the failure was
+    a system error).
+*/
+
+CLM_LAYERS *clm_layers_open (const char *path)
+{
+  char header[SWBD_MASK_HEADER_SIZE + 1];
+
+
+  CLM_LAYERS *layers = new CLM_LAYERS;
+
+  layers->write = NVFalse;
+  layers->resolution = 0;
+  layers->num_layers = 0;
+  memset (layers->name, 0, sizeof (layers->name));
+  strcpy (layers->path, path);
+
+  if ((layers->fp = fopen (path, "rb")) == NULL)
+    {
+      delete layers;
+      return (NULL);
+    }
+
+  if (fread (header, SWBD_MASK_HEADER_SIZE, 1, layers->fp) != 1 ||
+      fread (layers->map, sizeof (layers->map), 1, layers->fp) != 1)
+    {
+      fclose (layers->fp);
+      delete layers;
+      errno = EINVAL;
+      return (NULL);
+    }
+
+  header[SWBD_MASK_HEADER_SIZE] = 0;
+
+
+  char *line = header;
+  while (line != NULL && *line)
+    {
+      int32_t layer;
+
+      if (!strncmp (line, "[RESOLUTION] = ", 15)) sscanf (&line[15], "%d", &layers->resolution);
+
+      if (!strncmp (line, "[LAYERS] = ", 11)) sscanf (&line[11], "%d", &layers->num_layers);
+
+      if (sscanf (line, "[LAYER %d] = ", &layer) == 1 && layer >= 0 && layer < CLM_MAX_LAYERS)
+        {
+          char *value = strstr (line, "] = ") + 4;
+          int32_t len = strcspn (value, "\n");
+
+          if (len > 511) len = 511;
+          strncpy (layers->name[layer], value, len);
+        }
+
+      if (!strncmp (line, "[END OF HEADER]", 15)) break;
+
+      if ((line = strchr (line, '\n')) != NULL) line++;
+    }
+
+
+  if (layers->num_layers < 1 || layers->num_layers > CLM_MAX_LAYERS ||
+      (layers->resolution != 1 && layers->resolution != 3 && layers->resolution != 10 && layers->resolution != 30 &&
+       layers->resolution != 60))
+    {
+      fclose (layers->fp);
+      delete layers;
+      errno = EINVAL;
+      return (NULL);
+    }
+
+  layers_sizes (layers);
+
+  return (layers);
+}
+
+
+
+//!  Create an empty multi-layer file with num_layers layers.  names (may be NULL) are the sources of the layers.
+
+CLM_LAYERS *clm_layers_create (const char *path, int32_t resolution, int32_t num_layers, char **names)
+{
+  if (num_layers < 1 || num_layers > CLM_MAX_LAYERS)
+    {
+      errno = EINVAL;
+      return (NULL);
+    }
+
+
+  CLM_LAYERS *layers = new CLM_LAYERS;
+
+  layers->write = NVTrue;
+  layers->resolution = resolution;
+  layers->num_layers = num_layers;
+  memset (layers->name, 0, sizeof (layers->name));
+  strcpy (layers->path, path);
+  layers_sizes (layers);
+
+  if ((layers->fp = fopen (path, "wb+")) == NULL)
+    {
+      delete layers;
+      return (NULL);
+    }
+
+
+  time_t t = time (&t);
+  struct tm *cur_tm = gmtime (&t);
+
+  fprintf (layers->fp, "[HEADER SIZE] = %d\n", SWBD_MASK_HEADER_SIZE);
+  fprintf (layers->fp, "[VERSION] = %s\n", VERSION);
+  fprintf (layers->fp, "[ZLIB VERSION] = %s\n", zlibVersion ());
+  fprintf (layers->fp, "[CREATION DATE] = %s", asctime (cur_tm));
+  fprintf (layers->fp, "[RESOLUTION] = %d\n", resolution);
+  fprintf (layers->fp, "[LAYERS] = %d\n", num_layers);
+
+
+  //  Long names are cut off so that 32 of them will fit in the header.
+
+  for (int32_t i = 0 ; names != NULL && i < num_layers ; i++)
+    {
+      snprintf (layers->name[i], 400, "%s", names[i]);
+      fprintf (layers->fp, "[LAYER %d] = %s\n", i, layers->name[i]);
+    }
+
+  fprintf (layers->fp, "[END OF HEADER]\n");
+
+
+  memset (layers->map, 0, sizeof (layers->map));
+
+  uint8_t zero = 0;
+  int32_t j = ftell (layers->fp);
+  for (int32_t i = j ; i < SWBD_MASK_HEADER_SIZE ; i++) fwrite (&zero, 1, 1, layers->fp);
+
+  if (fwrite (layers->map, sizeof (layers->map), 1, layers->fp) != 1)
+    {
+      fclose (layers->fp);
+      delete layers;
+      return (NULL);
+    }
+
+  return (layers);
+}
+
+
+
+//!  Close a multi-layer file (writing the map back if it was created).
+
+void clm_layers_close (CLM_LAYERS *layers)
+{
+  if (layers == NULL) return;
+
+  if (layers->write)
+    {
+      fseek (layers->fp, SWBD_MASK_HEADER_SIZE, SEEK_SET);
+      if (fwrite (layers->map, sizeof (layers->map), 1, layers->fp) != 1) perror (layers->path);
+    }
+
+  fclose (layers->fp);
+
+  delete layers;
+}
+
+
+
+/*!
+  - Read every layer of the block whose southwest corner is at lat, lon with a single decode.  codes (num_layers
+    bytes) is always filled with the code of each layer.  bits (block_size bytes) is only filled if at least one of
+    the layers is CLM_MIXED.  Returns the code if every layer has the same uniform code, CLM_MIXED otherwise, or -1
+    on error.  Use clm_layers_cell and clm_layers_get_row to get at the layers.  Safe to call from multiple threads.
+*/
+
+int32_t clm_layers_read_block (CLM_LAYERS *layers, int32_t lat, int32_t lon, uint8_t *codes, uint8_t *bits)
+{
+  uint8_t *mapbuf = &layers->map[clm_block_index (lat, lon) * CLM_MAP_RECORD_SIZE];
+  uint32_t address = bit_unpack (mapbuf, 0, 32);
+  uint32_t size = bit_unpack (mapbuf, 32, 24);
+
+
+  if (address <= CLM_ALL_WATER)
+    {
+      memset (codes, address, layers->num_layers);
+
+      return ((int32_t) address);
+    }
+
+
+  uint8_t *buf = (uint8_t *) malloc (size);
+  if (buf == NULL) return (-1);
+
+  layers->mutex.lock ();
+
+  fseek (layers->fp, address, SEEK_SET);
+  size_t n = fread (buf, size, 1, layers->fp);
+
+  layers->mutex.unlock ();
+
+  if (n != 1)
+    {
+      free (buf);
+      return (-1);
+    }
+
+
+  //  The codes and the bit planes are compressed together.
+
+  z_stream stream;
+  memset (&stream, 0, sizeof (stream));
+
+  if (inflateInit (&stream) != Z_OK)
+    {
+      free (buf);
+      return (-1);
+    }
+
+  stream.next_in = buf;
+  stream.avail_in = size;
+  stream.next_out = codes;
+  stream.avail_out = layers->num_layers;
+
+  int32_t status = inflate (&stream, Z_SYNC_FLUSH);
+  uint8_t mixed = NVFalse, planes = NVFalse;
+
+  for (int32_t i = 0 ; i < layers->num_layers ; i++) if (codes[i] == CLM_MIXED) mixed = NVTrue;
+
+  if (status == Z_OK && !stream.avail_out && mixed)
+    {
+      stream.next_out = bits;
+      stream.avail_out = layers->block_size;
+
+      status = inflate (&stream, Z_FINISH);
+      planes = NVTrue;
+    }
+
+  inflateEnd (&stream);
+  free (buf);
+
+  if (stream.avail_out) return (-1);
+
+  if (mixed ? (!planes || status != Z_STREAM_END) : (status != Z_OK && status != Z_STREAM_END)) return (-1);
+
+  return (CLM_MIXED);
+}
+
+
+
+/*!
+  - Store every layer of the block at lat, lon.  codes holds the code of each layer.  If any of them is
+    CLM_MIXED, bits holds the bit planes of all of the layers (see CLM_LAYERS) with the uniform layers filled
+    with their value.  Returns CLM_MIXED if the block was written, the map code if every layer had the same
+    uniform code, or -1 on error.  Safe to call from multiple threads.
+*/
+
+int32_t clm_layers_write_block (CLM_LAYERS *layers, int32_t lat, int32_t lon, uint8_t *codes, uint8_t *bits)
+{
+  uint8_t *mapbuf = &layers->map[clm_block_index (lat, lon) * CLM_MAP_RECORD_SIZE];
+  uint8_t same = NVTrue, mixed = NVFalse;
+
+
+  for (int32_t i = 0 ; i < layers->num_layers ; i++)
+    {
+      if (codes[i] != codes[0]) same = NVFalse;
+      if (codes[i] == CLM_MIXED) mixed = NVTrue;
+    }
+
+  if (same && !mixed)
+    {
+      QMutexLocker locker (&layers->mutex);
+
+      memset (mapbuf, 0, CLM_MAP_RECORD_SIZE);
+      bit_pack (mapbuf, 0, 32, codes[0]);
+
+      return (codes[0]);
+    }
+
+
+  z_stream stream;
+  memset (&stream, 0, sizeof (stream));
+  if (deflateInit (&stream, 9) != Z_OK) return (-1);
+
+  uLong out_size = deflateBound (&stream, layers->num_layers + (mixed ? layers->block_size : 0));
+  uint8_t *out_buf = (uint8_t *) malloc (out_size);
+  if (out_buf == NULL)
+    {
+      deflateEnd (&stream);
+      return (-1);
+    }
+
+  stream.next_out = out_buf;
+  stream.avail_out = out_size;
+  stream.next_in = codes;
+  stream.avail_in = layers->num_layers;
+
+  int32_t status = deflate (&stream, mixed ? Z_NO_FLUSH : Z_FINISH);
+
+  if (status == Z_OK && mixed)
+    {
+      stream.next_in = bits;
+      stream.avail_in = layers->block_size;
+
+      status = deflate (&stream, Z_FINISH);
+    }
+
+  uint32_t size = stream.total_out;
+  deflateEnd (&stream);
+
+  if (status != Z_STREAM_END || size >= (1 << 24))
+    {
+      free (out_buf);
+      return (-1);
+    }
+
+
+  QMutexLocker locker (&layers->mutex);
+
+  fseek (layers->fp, 0, SEEK_END);
+  int64_t address = ftell (layers->fp);
+
+  if (address > 0xffffffffLL || fwrite (out_buf, size, 1, layers->fp) != 1)
+    {
+      free (out_buf);
+      return (-1);
+    }
+
+  free (out_buf);
+
+  bit_pack (mapbuf, 0, 32, (uint32_t) address);
+  bit_pack (mapbuf, 32, 24, size);
+
+  return (CLM_MIXED);
+}
+
+
+
+/*!
+  - All of the layers for the cell at row, col (row 0 is the southern row) of a block read with
+    clm_layers_read_block.  Bit i of the return is set if the cell is land in layer i.  Bit i of defined is set if
+    layer i is defined for the block.
+*/
+
+uint32_t clm_layers_cell (CLM_LAYERS *layers, uint8_t *codes, uint8_t *bits, int32_t row, int32_t col, uint32_t *defined)
+{
+  uint32_t land = 0;
+  int64_t pos = (int64_t) row * layers->num_layers * layers->point_count + col;
+
+
+  *defined = 0;
+
+  for (int32_t i = 0 ; i < layers->num_layers ; i++, pos += layers->point_count)
+    {
+      if (codes[i] == CLM_UNDEFINED) continue;
+
+      *defined |= 1U << i;
+
+      if (codes[i] == CLM_ALL_LAND || (codes[i] == CLM_MIXED && (bits[pos >> 3] & (0x80 >> (pos & 7))))) land |= 1U << i;
+    }
+
+  return (land);
+}
+
+
+
+/*!
+  - Extract row "row" of one layer of a block read with clm_layers_read_block into layers->row_words 64 bit words
+    (laid out as by clm_get_row, so the clm_*_bits row functions can be used on it).  Undefined layers are water.
+*/
+
+void clm_layers_get_row (CLM_LAYERS *layers, uint8_t *codes, uint8_t *bits, int32_t row, int32_t layer, uint64_t *words)
+{
+  if (codes[layer] == CLM_MIXED)
+    {
+      clm_get_bits (bits, ((int64_t) row * layers->num_layers + layer) * layers->point_count, layers->point_count, words);
+    }
+  else
+    {
+      memset (words, 0, layers->row_words * sizeof (uint64_t));
+      if (codes[layer] == CLM_ALL_LAND) clm_fill_bits (words, 0, layers->point_count, 1);
+    }
+}
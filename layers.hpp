@@ -0,0 +1,86 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#ifndef LAYERS_H
+#define LAYERS_H
+
+
+#include "clm.hpp"
+
+
+//  Maximum number of masks in a multi-layer file (one bit per layer in the value returned by clm_layers_cell).
+
+#define CLM_MAX_LAYERS               32
+
+
+/*!
+  - Multi-layer land mask file.  Several aligned masks (SWBD, SRTM, etc. at the same resolution) are stored
+    together so that one block decode gives every layer for a point or a row.  The layout is the same as a .clm
+    file (header, 64800 * 7 byte map, zlib blocks) but a block holds one code byte per layer (CLM_UNDEFINED,
+    CLM_ALL_LAND, CLM_ALL_WATER, or CLM_MIXED) followed, if any of the layers is mixed, by the bit planes of all
+    of the layers interleaved by row (row 0 of layer 0, row 0 of layer 1, ... row 1 of layer 0, ...).  Uniform
+    layers are filled with their value in the planes (undefined is water).  The map codes CLM_UNDEFINED,
+    CLM_ALL_LAND, and CLM_ALL_WATER mean that every layer has that code.
+*/
+
+typedef struct
+{
+  FILE            *fp;
+  char            path[512];
+  uint8_t         write;                                  //!<  NVTrue if created with clm_layers_create
+  int32_t         resolution;
+  int32_t         point_count;
+  int32_t         num_layers;
+  int32_t         bit_size;                               //!<  Size, in bytes, of one layer of a block
+  int32_t         block_size;                             //!<  Size, in bytes, of the bit planes of all of the layers
+  int32_t         row_words;                              //!<  Number of 64 bit words needed to hold one row of a layer
+  char            name[CLM_MAX_LAYERS][512];              //!<  Source of each layer
+  uint8_t         map[CLM_BLOCKS * CLM_MAP_RECORD_SIZE];
+  QMutex          mutex;
+} CLM_LAYERS;
+
+
+CLM_LAYERS *clm_layers_open (const char *path);
+CLM_LAYERS *clm_layers_create (const char *path, int32_t resolution, int32_t num_layers, char **names);
+void clm_layers_close (CLM_LAYERS *layers);
+int32_t clm_layers_read_block (CLM_LAYERS *layers, int32_t lat, int32_t lon, uint8_t *codes, uint8_t *bits);
+int32_t clm_layers_write_block (CLM_LAYERS *layers, int32_t lat, int32_t lon, uint8_t *codes, uint8_t *bits);
+uint32_t clm_layers_cell (CLM_LAYERS *layers, uint8_t *codes, uint8_t *bits, int32_t row, int32_t col, uint32_t *defined);
+void clm_layers_get_row (CLM_LAYERS *layers, uint8_t *codes, uint8_t *bits, int32_t row, int32_t layer, uint64_t *words);
+
+
+#endif
@@ -47,9 +47,54 @@
                         creates a world (or as much as is covered) land mask.
 
   - Arguments:          argv[1]         -   resolution (in seconds - 1, 3, 10, 30, or 60)
-
-  - Caveats:            You must have all of the uncompressed SWBD files in a single
-                        directory in order to run this.  You must also have the dummy
+                        argv[2]         -   optional number of compute threads (4 or 16)
+                        -p              -   optional, after the other arguments, profile the build
+                                            stages with the hardware counters (see perf.hpp)
+                        -w              -   optional, after the other arguments, use the nonzero
+                                            winding rule instead of even-odd (overlapping polygons
+                                            don't cancel)
+                        -u              -   optional, after the other arguments, append blocks with
+                                            pwrite at atomically reserved offsets (see clm_set_unordered)
+
+                        or, to work on an existing .clm file:
+
+                        argv[1]         -   mode, one of
+                                            components - ocean connected water mask and/or
+                                                         removal of small water bodies
+                                            morph      - dilation or erosion of the land (coastline
+                                                         buffers)
+                                            distance   - distance to the nearest land (.cdm file)
+                                            vectorize  - land/water boundaries to a polygon
+                                                         shapefile
+                                            combine    - union, intersection, difference, or xor
+                                                         of two or more .clm files
+                                            crossing   - first land crossing of straight segments
+                                            zonal      - land, water, and undefined area inside
+                                                         area of interest polygons
+                                            serve      - local query daemon (Unix domain socket)
+                                            bench      - latency benchmark client for serve (or, with -l,
+                                                         for non-blocking queries on a local .clm)
+                                            tiles      - local HTTP XYZ (Web Mercator) tile server
+                                            classify   - flag or filter XYZ/LAS points on land
+                                            transcode  - re-compress a .clm (zlib level, strategy, alignment)
+                                            resample   - coarser .clm from a finer one (center, majority, any land/water)
+                                            gdalbench  - time and compare rasterization against GDAL
+                                            extract    - raw byte, float, or bit grid of an area (ESRI .hdr)
+                                            patch      - edit an overlay of corrections (box or polygons) for a .clm
+                                            compact    - new .clm with an overlay folded in
+                                            stack      - build a multi-layer file from several masks
+                                                         or look points up in every layer at once
+                                            edges      - boundary pixels and SWBD polygon edges for the exact mode
+                                            exact      - land/water for points, exact near coastlines (raster + edges)
+                                            calibrate  - time the rasterization engines for the per cell
+                                                         engine selection of the main build
+                        argv[2...]      -   mode arguments (run the mode with no arguments
+                                            to get the usage message)
+
+  - Caveats:            You must have all of the SWBD files in a single directory
+                        in order to run this.  They can be uncompressed or left in the
+                        .zip archives that they are distributed in (nothing is extracted
+                        to disk).  You must also have the dummy
                         *.wtr and *.lnd files for the cells that don't have associated
                         shape files.  Make sure that the ABE_DATA environment variable points
                         to the directory that holds the SWBD directory and the land_mask
@@ -118,17 +163,62 @@
 #include "version.h"
 
 #include "maskThread.hpp"
-
-
-#define SWBD_MASK_HEADER_SIZE        16384
+#include "clm.hpp"
+#include "components.hpp"
+#include "morph.hpp"
+#include "distance.hpp"
+#include "vectorize.hpp"
+#include "combine.hpp"
+#include "crossing.hpp"
+#include "zonal.hpp"
+#include "daemon.hpp"
+#include "tiles.hpp"
+#include "classify.hpp"
+#include "transcode.hpp"
+#include "resample.hpp"
+#include "gdalbench.hpp"
+#include "extract.hpp"
+#include "swbd.hpp"
+#include "patch.hpp"
+#include "compact.hpp"
+#include "stack.hpp"
+#include "edges.hpp"
+#include "exact.hpp"
+#include "perf.hpp"
+#include "calibrate.hpp"
+#include "engine.hpp"
 
 
 void usage (char *string)
 {
-  fprintf (stderr, "Usage: %s RESOLUTION [NUM_THREADS]\n\n", string);
+  fprintf (stderr, "Usage: %s RESOLUTION [NUM_THREADS] [-p] [-w] [-u]\n\n", string);
   fprintf (stderr, "Where\n");
   fprintf (stderr, "\tRESOLUTION = resolution of mask in seconds (1, 3, 10, 30, or 60)\n");
-  fprintf (stderr, "\tNUM_THREADS = number of compute threads (4[default] or 16)\n\n");
+  fprintf (stderr, "\tNUM_THREADS = number of compute threads (4[default] or 16)\n");
+  fprintf (stderr, "\t-p = report hardware counters (IPC, cache and branch misses) for each build stage\n");
+  fprintf (stderr, "\t-w = use the nonzero winding rule (overlapping polygons don't cancel)\n");
+  fprintf (stderr, "\t-u = unordered, append blocks with pwrite instead of seeking on the file (block order may change)\n\n");
+  fprintf (stderr, "   or: %s components [-i] [-a MIN_AREA] [-u] [-t NUM_THREADS] INPUT_CLM OUTPUT_CLM\n\n", string);
+  fprintf (stderr, "   or: %s morph -d | -e -n RADIUS [-u] [-t NUM_THREADS] INPUT_CLM OUTPUT_CLM\n\n", string);
+  fprintf (stderr, "   or: %s distance [-m MAX_DISTANCE] [-t NUM_THREADS] INPUT_CLM OUTPUT_CDM\n\n", string);
+  fprintf (stderr, "   or: %s vectorize [-t NUM_THREADS] INPUT_CLM OUTPUT_SHAPEFILE\n\n", string);
+  fprintf (stderr, "   or: %s combine -o OPERATION [-u] [-t NUM_THREADS] OUTPUT_CLM INPUT_CLM INPUT_CLM [...]\n\n", string);
+  fprintf (stderr, "   or: %s crossing [-m CACHE_MB] [-s SHM_NAME] [-o OVERLAY] [-t NUM_THREADS] INPUT_CLM [SEGMENT_FILE]\n\n", string);
+  fprintf (stderr, "   or: %s zonal [-w] [-t NUM_THREADS] INPUT_CLM AOI_SHAPEFILE\n\n", string);
+  fprintf (stderr, "   or: %s serve [-m CACHE_MB] [-r] [-s SHM_NAME] [-t NUM_THREADS] SOCKET_PATH INPUT_CLM [...]\n\n", string);
+  fprintf (stderr, "   or: %s bench [-l [-m CACHE_MB] [-t NUM_THREADS]] [-n NUM] [-b BATCH] [-p DEPTH] [-f FILE] [-a AREA] SOCKET_PATH | INPUT_CLM\n\n", string);
+  fprintf (stderr, "   or: %s tiles [-p PORT] [-m CACHE_MB] [-d CACHE_DIR] [-t NUM_THREADS] INPUT_CLM\n\n", string);
+  fprintf (stderr, "   or: %s classify [-f] [-l] [-y] [-m CACHE_MB] [-r] [-s SHM_NAME] [-o OVERLAY] [-t NUM_THREADS] INPUT_CLM INPUT OUTPUT\n\n", string);
+  fprintf (stderr, "   or: %s transcode [-l LEVEL] [-s STRATEGY] [-a ALIGNMENT] [-u] [-t NUM_THREADS] INPUT_CLM OUTPUT_CLM\n\n", string);
+  fprintf (stderr, "   or: %s resample [-r RULE] [-c NUM_CELLS] [-u] [-t NUM_THREADS] INPUT_CLM RESOLUTION OUTPUT_CLM\n\n", string);
+  fprintf (stderr, "   or: %s gdalbench [-r RESOLUTION] [-i ITERATIONS] [-p] [-w] LAT,LON [LAT,LON...]\n\n", string);
+  fprintf (stderr, "   or: %s extract -a S,W,N,E [-f FORMAT] [-l LAND] [-w WATER] [-u UNDEFINED] [-t NUM_THREADS] INPUT_CLM OUTPUT\n\n", string);
+  fprintf (stderr, "   or: %s patch -l | -w | -c -a S,W,N,E | -p SHAPEFILE [-r RESOLUTION] OVERLAY\n\n", string);
+  fprintf (stderr, "   or: %s compact [-u] [-t NUM_THREADS] INPUT_CLM OVERLAY OUTPUT_CLM\n\n", string);
+  fprintf (stderr, "   or: %s stack [-t NUM_THREADS] OUTPUT INPUT_CLM INPUT_CLM [...] | -q LAYER_FILE [POINT_FILE]\n\n", string);
+  fprintf (stderr, "   or: %s edges INPUT_CLM OUTPUT_EDGES\n\n", string);
+  fprintf (stderr, "   or: %s exact [-m CACHE_MB] INPUT_CLM EDGE_FILE [POINT_FILE]\n\n", string);
+  fprintf (stderr, "   or: %s calibrate [-o FILE]\n\n", string);
   exit (-1);
 }
 
@@ -136,10 +226,9 @@ void usage (char *string)
 
 int32_t main (int32_t argc, char **argv)
 {
-  int32_t           type, numShapes, resolution = 0, total_blocks = 0, num_threads = 4;
-  double            minBounds[4], maxBounds[4], total_block_size = 0.0;
-  char              dirname[512], shpname[512], lathem, lonhem, dataset[7] = {'a', 'e', 'f', 'i', 'n', 's', 'x'};
-  FILE              *ofp;
+  int32_t           resolution = 0, total_blocks = 0, num_threads = 4;
+  double            total_block_size = 0.0;
+  char              dirname[512];
   char              ofile[512];
   maskThread        mask_thread[16];
 
@@ -150,6 +239,31 @@ int32_t main (int32_t argc, char **argv)
   if (argc < 2) usage (argv[0]);
 
 
+  //  Check for one of the modes that work on an existing .clm file.
+
+  if (!strcmp (argv[1], "components")) return (components (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "morph")) return (morph (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "distance")) return (distance (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "vectorize")) return (vectorize (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "combine")) return (combine (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "crossing")) return (crossing (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "zonal")) return (zonal (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "serve")) return (serve (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "bench")) return (bench (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "tiles")) return (tiles (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "classify")) return (classify (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "transcode")) return (transcode (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "resample")) return (resample (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "gdalbench")) return (gdalbench (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "extract")) return (extract (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "patch")) return (patch (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "compact")) return (compact (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "stack")) return (stack (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "edges")) return (edges (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "exact")) return (exact (argc - 1, &argv[1]));
+  if (!strcmp (argv[1], "calibrate")) return (calibrate (argc - 1, &argv[1]));
+
+
   //  Check for ABE_DATA environment variable.
 
   if (getenv ("ABE_DATA") == NULL)
@@ -174,7 +288,27 @@ int32_t main (int32_t argc, char **argv)
   if (resolution != 1 && resolution != 3 && resolution != 10 && resolution != 30 && resolution != 60) usage (argv[0]);
 
 
-  if (argc == 3) sscanf (argv[2], "%d", &num_threads);
+  uint8_t profile = NVFalse, nonzero = NVFalse, unordered = NVFalse;
+
+  for (int32_t i = 2 ; i < argc ; i++)
+    {
+      if (!strcmp (argv[i], "-p"))
+        {
+          profile = NVTrue;
+        }
+      else if (!strcmp (argv[i], "-w"))
+        {
+          nonzero = NVTrue;
+        }
+      else if (!strcmp (argv[i], "-u"))
+        {
+          unordered = NVTrue;
+        }
+      else
+        {
+          sscanf (argv[i], "%d", &num_threads);
+        }
+    }
 
 
   if (num_threads != 4 && num_threads != 16) usage (argv[1]);
@@ -184,126 +318,74 @@ int32_t main (int32_t argc, char **argv)
 
   sprintf (ofile, "%s%1cland_mask%1cswbd_mask_%02d_second.clm", dirname, (char) SEPARATOR, (char) SEPARATOR, resolution);
 
-  if ((ofp = fopen (ofile, "wb+")) == NULL)
+  CLM_FILE *out = clm_create (ofile, resolution, NULL);
+  if (out == NULL)
     {
       perror (ofile);
       exit (-1);
     }
 
 
-  //  Write the (minimalist) ASCII header.
+  //  With -u blocks are appended with pwrite at offsets reserved from an atomic counter and the map is only written
+  //  once, by clm_close, instead of seeking back and forth on a single FILE pointer for every cell.
 
-  time_t t = time (&t);
-  struct tm *cur_tm = gmtime (&t);
+  if (unordered && !clm_set_unordered (out)) fprintf (stderr, "Unordered writes aren't supported here, writing in order\n");
 
-  fprintf (ofp, "[HEADER SIZE] = %d\n", SWBD_MASK_HEADER_SIZE);
-  fprintf (ofp, "[VERSION] = %s\n", VERSION);
-  fprintf (ofp, "[ZLIB VERSION] = %s\n", zlibVersion ());
-  fprintf (ofp, "[CREATION DATE] = %s", asctime (cur_tm));
-  fprintf (ofp, "[RESOLUTION] = %d\n", resolution);
-  fprintf (ofp, "[END OF HEADER]\n");
 
+  //  Each cell is rasterized with whichever engine the calibrated cost model predicts is faster (see engine.hpp).
+  //  This has to come before profiling is turned on since it may run the calibration (with its own mask threads).
 
-  //  Zero out the remainder of the header.
+  CLM_ENGINE_MODEL engine_model;
+  clm_engine_setup (&engine_model);
 
-  uint8_t zero = 0;
-  int32_t j = ftell (ofp);
-  for (int32_t i = j ; i < SWBD_MASK_HEADER_SIZE ; i++) fwrite (&zero, 1, 1, ofp);
 
+  //  Profiling has to be turned on before any of the worker threads start (they open their own counters).
 
-  //  Set the default for all map addresses to 0 (undefined).
+  clm_perf_enable (profile);
 
-  uint8_t mapbuf[7];
-  memset (mapbuf, 0, 7);
+  CLM_PERF perf;
+  clm_perf_open (&perf);
 
-  for (int32_t i = -90 ; i < 90 ; i++)
-    {
-      for (int32_t j = -180 ; j < 180 ; j++)
-        {
-          fwrite (mapbuf, 7, 1, ofp);
-        }
-    }
+  int32_t engine_count[CLM_ENGINE_COUNT] = {0, 0};
 
 
-  double **poly_x = NULL;
-  double **poly_y = NULL;
-  int32_t *poly_count = NULL;
   uint8_t *block = NULL;
   uint8_t *bit_block = NULL;
-  SHPHandle shpHandle;
-  SHPObject *shape = NULL;
-  FILE *tfp = NULL;
-
-  for (int32_t lat = -90 ; lat < 90 ; lat++)
-    {
-      if (lat < 0)
-        {
-          lathem = 's';
-        }
-      else
-        {
-          lathem = 'n';
-        }
-
-      int32_t lt = abs (lat);
 
 
-      for (int32_t lon = -180 ; lon < 180 ; lon++)
-        {
-          //if (lat == 10 && lon == 124){
-          uint32_t map_address = SWBD_MASK_HEADER_SIZE + ((lat + 90) * 360 + (lon +180)) * 7;
+  //  Read the shapefiles (uncompressed or straight out of the SWBD .zip archives) ahead of the mask threads, in
+  //  the order that we process the cells.
 
+  SWBD_SOURCE *source = swbd_open (dirname);
 
-          if (lon < 0)
-            {
-              lonhem = 'w';
-            }
-          else
-            {
-              lonhem = 'e';
-            }
-
-
-          int32_t ln = abs (lon);
-
-
-          //  Initialize variables
-
-          int32_t num_poly = -1;
-          uint8_t file_check = NVFalse;
-          int32_t file_ext = 0;
-
-
-          //  Check to make sure we have a valid file before we open the output file.
+  int32_t *cells = (int32_t *) malloc (CLM_BLOCKS * sizeof (int32_t));
+  if (cells == NULL)
+    {
+      perror ("Allocating cell list memory");
+      exit (-1);
+    }
 
-          for (int32_t ds = 0 ; ds < 6 ; ds++)
-            {
-              sprintf (shpname, "%s%1cSWBD%1c%1c%03d%1c%02d%1c.shp", dirname, (char) SEPARATOR, (char) SEPARATOR, lonhem, ln, lathem, lt, dataset[ds]);
+  for (int32_t i = 0 ; i < CLM_BLOCKS ; i++) cells[i] = i;
 
+  SWBD_PREFETCH *prefetch = swbd_prefetch_start (source, CLM_BLOCKS, cells, SWBD_READ_THREADS, SWBD_READ_WINDOW);
 
-              //  Make sure the file exists before we try to open it with the shape library.
 
-              if ((tfp = fopen (shpname, "rb")) != NULL)
-                {
-                  file_check = NVTrue;
-                  file_ext = ds;
-                  fclose (tfp);
-                  break;
-                }
-            }
+  for (int32_t lat = -90 ; lat < 90 ; lat++)
+    {
+      for (int32_t lon = -180 ; lon < 180 ; lon++)
+        {
+          SWBD_CELL *cell = swbd_prefetch_get (prefetch, (lat + 90) * 360 + (lon + 180));
 
 
           //  If we didn't find a file, check SRTM3 for all water or land, or, if we're outside of 57S to 60N, set to undefined.
 
-          if (!file_check)
+          if (cell == NULL)
             {
               //  Undefined
 
               if (lat < -57 || lat > 59)
                 {
-                  memset (mapbuf, 0, 7);
-                  fseek (ofp, map_address, SEEK_SET);
-                  fwrite (mapbuf, 7, 1, ofp);
+                  clm_set_code (out, lat, lon, CLM_UNDEFINED);
                 }
               else
                 {
@@ -317,10 +399,7 @@ int32_t main (int32_t argc, char **argv)
 
                   if (lnd == 0)
                     {
-                      memset (mapbuf, 0, 7);
-                      bit_pack (mapbuf, 0, 32, 2);
-                      fseek (ofp, map_address, SEEK_SET);
-                      fwrite (mapbuf, 7, 1, ofp);
+                      clm_set_code (out, lat, lon, CLM_ALL_WATER);
                     }
 
 
@@ -328,159 +407,16 @@ int32_t main (int32_t argc, char **argv)
 
                   else
                     {
-                      memset (mapbuf, 0, 7);
-                      bit_pack (mapbuf, 0, 32, 1);
-                      fseek (ofp, map_address, SEEK_SET);
-                      fwrite (mapbuf, 7, 1, ofp);
+                      clm_set_code (out, lat, lon, CLM_ALL_LAND);
                     }
                 }
             }
           else
             {
-              //  If we have a shape file, define the name and process it.
-
-              sprintf (shpname, "%s%1cSWBD%1c%1c%03d%1c%02d%1c.shp", dirname, (char) SEPARATOR, (char) SEPARATOR, lonhem, ln, lathem, lt, dataset[file_ext]);
-
-
-              //  Open shape file
-
-              shpHandle = SHPOpen (shpname, "rb");
-
-              if (shpHandle == NULL)
-                {
-                  perror (shpname);
-                  exit (-1);
-                }
-
-
-              fprintf (stderr,"Reading %s                        \n", shpname);
+              fprintf (stderr,"Reading %s                        \n", cell->path);
               fflush (stderr);
 
-
-              //  Get shape file header info
-
-              SHPGetInfo (shpHandle, &numShapes, &type, minBounds, maxBounds);
-
-
-              //  Read all shapes
-
-              for (int32_t i = 0 ; i < numShapes ; i++)
-                {
-                  shape = SHPReadObject (shpHandle, i);
-
-
-                  //  Get all vertices
-
-                  if (shape->nVertices >= 2)
-                    {
-                      for (int32_t j = 0, numParts = 1 ; j < shape->nVertices ; j++)
-                        {
-                          uint8_t start_segment = NVFalse;
-
-
-                          //  Check for start of a new segment.
-
-                          if (!j && shape->nParts > 0) start_segment = NVTrue;
-
-
-                          //  Check for the start of a new segment inside a larger group of points (this would be a "Ring" point).
-
-                          if (numParts < shape->nParts && shape->panPartStart[numParts] == j)
-                            {
-                              start_segment = NVTrue;
-                              numParts++;
-                            }
-
-
-                          //  Start a new segment
-
-                          if (start_segment)
-                            {
-                              //  Since num_poly starts at -1 this is perfectly cool.
-
-                              num_poly++;
-
-
-                              //  Allocate the count array.
-
-                              poly_count = (int32_t *) realloc (poly_count, (num_poly + 1) * sizeof (int32_t));
-                              if (poly_count == NULL)
-                                {
-                                  perror ("Allocating poly_count memory");
-                                  exit (-1);
-                                }
-
-
-                              //  Set the count for the new arrays to zero.
-
-                              poly_count[num_poly] = 0;
-
-
-                              //  Allocate the polygon arrays.
-
-                              poly_x = (double **) realloc (poly_x, (num_poly + 1) * sizeof (double *));
-                              if (poly_x == NULL)
-                                {
-                                  perror ("Allocating poly_x memory");
-                                  exit (-1);
-                                }
-                              poly_x[num_poly] = NULL;
-
-
-                              poly_y = (double **) realloc (poly_y, (num_poly + 1) * sizeof (double *));
-                              if (poly_y == NULL)
-                                {
-                                  perror ("Allocating poly_y memory");
-                                  exit (-1);
-                                }
-                              poly_y[num_poly] = NULL;
-                            }
-
-
-                          //  Allocate memory for the new point.
-
-                          poly_x[num_poly] = (double *) realloc (poly_x[num_poly], (poly_count[num_poly] + 1) * sizeof (double));
-                          if (poly_x[num_poly] == NULL)
-                            {
-                              perror ("Allocating poly_x[num_poly] memory");
-                              exit (-1);
-                            }
-
-                          poly_y[num_poly] = (double *) realloc (poly_y[num_poly], (poly_count[num_poly] + 1) * sizeof (double));
-                          if (poly_y[num_poly] == NULL)
-                            {
-                              perror ("Allocating poly_y[num_poly] memory");
-                              exit (-1);
-                            }
-
-
-                          //  Add point to current segment
-
-                          poly_x[num_poly][poly_count[num_poly]] = shape->padfX[j];
-                          poly_y[num_poly][poly_count[num_poly]] = shape->padfY[j];
-
-
-                          //  Increment the point counter.
-
-                          poly_count[num_poly]++;
-                        }
-                    }
-
-
-                  //  Destroy the shape object.
-
-                  SHPDestroyObject (shape);
-                }
-
-
-              //  Increment num_poly to account for the last polygon.
-
-              num_poly++;
-
-
-              //  Close the input file.
-
-              SHPClose (shpHandle);
+              clm_perf_pixels (CLM_PERF_INGEST, (int64_t) (3600 / resolution) * (3600 / resolution));
 
 
               //  Allocate the uint8_t block for the threads to put the land/water flags into.
@@ -511,9 +447,29 @@ int32_t main (int32_t argc, char **argv)
               double slat = (double) lat;
               double slon = (double) lon;
 
+              CLM_ENGINE_FEATURES features;
+              clm_engine_features (cell->num_poly, cell->poly_count, cell->poly_x, cell->poly_y, lat, lon, resolution, &features);
+
+              int32_t engine = clm_engine_select (&engine_model, &features);
+              engine_count[engine]++;
+
+              FILL_POLYGON *fill = NULL;
+              if (engine == CLM_ENGINE_SCANLINE)
+                {
+                  fill = fill_create (cell->num_poly, cell->poly_count, cell->poly_x, cell->poly_y);
+                  if (fill == NULL)
+                    {
+                      perror ("Allocating fill memory");
+                      exit (-1);
+                    }
+
+                  fill->rule = nonzero ? FILL_NONZERO : FILL_EVEN_ODD;
+                }
+
               for (int32_t i = 0 ; i < num_threads ; i++)
                 {
-                  mask_thread[i].mask (block, resolution, num_poly, poly_count, poly_y, poly_x, slat, slon, complete, num_threads, i);
+                  mask_thread[i].mask (block, resolution, cell->num_poly, cell->poly_count, cell->poly_y, cell->poly_x, slat, slon, complete,
+                                       num_threads, i, nonzero, fill);
                 }
 
 
@@ -524,6 +480,8 @@ int32_t main (int32_t argc, char **argv)
                   mask_thread[i].wait ();
                 }
 
+              if (fill != NULL) fill_destroy (fill);
+
 
               int32_t size = (point_count * point_count) / 8;
               if ((point_count * point_count) % 8) size++;
@@ -540,6 +498,8 @@ int32_t main (int32_t argc, char **argv)
 
               //  Copy the uint8_t block to the bit_block.
 
+              clm_perf_begin (&perf);
+
               int32_t block_size = point_count * point_count;
               for (int32_t pos = 0 ; pos < block_size ; pos++)
                 {
@@ -553,6 +513,8 @@ int32_t main (int32_t argc, char **argv)
                     }
                 }
 
+              clm_perf_end (&perf, CLM_PERF_PACK, block_size);
+
 
               //  Compress using zlib.
 
@@ -567,7 +529,12 @@ int32_t main (int32_t argc, char **argv)
                 }
 
 
+              clm_perf_begin (&perf);
+
               int32_t n = compress2 (out_buf, &out_size, bit_block, size, 9);
+
+              clm_perf_end (&perf, CLM_PERF_COMPRESS, block_size);
+
               if (n)
                 {
                   fprintf (stderr, "Error %d compressing record\n", n);
@@ -575,21 +542,17 @@ int32_t main (int32_t argc, char **argv)
                 }
 
 
-              //  Write the block address and the block size to the map.
-
-              fseek (ofp, 0, SEEK_END);
-              int32_t block_address = ftell (ofp);
-              bit_pack (mapbuf, 0, 32, block_address);
-              bit_pack (mapbuf, 32, 24, out_size);
-              fseek (ofp, map_address, SEEK_SET);
-              fwrite (mapbuf, 7, 1, ofp);
+              //  Write the block and point the map at it.
 
-              if (lat == 10 && lon == 124) fprintf (stderr,"%s %s %d %d %ld %ld\n",NVFFL,block_address,out_size,in_size);
+              clm_perf_begin (&perf);
 
-              //  Now write the block.
+              if (clm_write_raw (out, lat, lon, out_buf, out_size) < 0)
+                {
+                  perror (ofile);
+                  exit (-1);
+                }
 
-              fseek (ofp, block_address, SEEK_SET);
-              fwrite (out_buf, out_size, 1, ofp);
+              clm_perf_end (&perf, CLM_PERF_WRITE, block_size);
 
 
               total_blocks++;
@@ -604,8 +567,8 @@ int32_t main (int32_t argc, char **argv)
 
               in_size = (point_count * point_count) / 8 + 2000;
 
-              fseek (ofp, block_address, SEEK_SET);
-              fread (out_buf, out_size, 1, ofp);
+              fseek (out->fp, clm_block_address (out, lat, lon, NULL), SEEK_SET);
+              fread (out_buf, out_size, 1, out->fp);
 
               uint8_t *bit_box = (uint8_t *) calloc (in_size, sizeof (uint8_t));
               if (bit_box == NULL)
@@ -638,32 +601,26 @@ int32_t main (int32_t argc, char **argv)
               free (block);
 
 
-              //  Free all of the polygon memory.
-
-              for (int32_t i = 0 ; i < num_poly ; i++)
-                {
-                  if (poly_x[i] != NULL) free (poly_x[i]);
-                  if (poly_y[i] != NULL) free (poly_y[i]);
-                }
-
-
-              if (poly_x != NULL) free (poly_x);
-              if (poly_y != NULL) free (poly_y);
-              if (poly_count != NULL) free (poly_count);
-              poly_x = NULL;
-              poly_y = NULL;
-              poly_count = NULL;
+              swbd_free_cell (cell);
             }
         }
-      //}
     }
 
 
-  fclose (ofp);
+  swbd_prefetch_stop (prefetch);
+  swbd_close (source);
+  free (cells);
+
+  clm_close (out);
 
 
   fprintf (stderr, "100%% processed                         \n\n");
+  fprintf (stderr, "Cells rasterized with the %s engine : %d\n", clm_engine_name[CLM_ENGINE_BRUTE], engine_count[CLM_ENGINE_BRUTE]);
+  fprintf (stderr, "Cells rasterized with the %s engine : %d\n\n", clm_engine_name[CLM_ENGINE_SCANLINE], engine_count[CLM_ENGINE_SCANLINE]);
   fflush (stderr);
 
+  clm_perf_close (&perf);
+  clm_perf_report (stderr);
+
   return (0);
 }
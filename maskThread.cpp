@@ -36,6 +36,28 @@
 
 
 #include "maskThread.hpp"
+#include "perf.hpp"
+
+
+/*!
+  - Winding number of polygon px, py around x, y (edges crossing the ray to the east of the point going north
+    count 1, going south count -1).  Uses the same half open crossing test as inside_polygon2.
+*/
+
+static int32_t polygon_winding (double *px, double *py, int32_t n, double x, double y)
+{
+  int32_t winding = 0;
+
+  for (int32_t i = 0, j = n - 1 ; i < n ; j = i++)
+    {
+      if ((py[i] > y) != (py[j] > y) && x < (px[j] - px[i]) * (y - py[i]) / (py[j] - py[i]) + px[i])
+        winding += (py[i] > py[j]) ? 1 : -1;
+    }
+
+  return (winding);
+}
+
+
 
 maskThread::maskThread (QObject *parent)
   : QThread(parent)
@@ -51,7 +73,7 @@ maskThread::~maskThread ()
 
 
 void maskThread::mask (uint8_t *bl, int32_t r, int32_t np, int32_t *pc, double **py, double **px, double slt, double sln, uint8_t *c, int32_t nt,
-                       int32_t p)
+                       int32_t p, uint8_t nz, FILL_POLYGON *f)
 {
   QMutexLocker locker (&mutex);
 
@@ -66,6 +88,8 @@ void maskThread::mask (uint8_t *bl, int32_t r, int32_t np, int32_t *pc, double *
   l_complete = c;
   l_num_threads = nt;
   l_pass = p;
+  l_nonzero = nz;
+  l_fill = f;
 
   if (!isRunning ()) start ();
 }
@@ -87,12 +111,22 @@ void maskThread::run ()
   uint8_t *complete = l_complete;
   int32_t num_threads = l_num_threads;
   int32_t pass = l_pass;
+  uint8_t nonzero = l_nonzero;
+  FILL_POLYGON *fill = l_fill;
 
   mutex.unlock ();
 
 
   //qDebug () << __LINE__ << pass;
 
+
+  //  Each pass is one rasterize task when profiling (see perf.hpp).
+
+  CLM_PERF perf;
+  clm_perf_open (&perf);
+  clm_perf_begin (&perf);
+
+
   int32_t point_count = 3600 / resolution;
   int32_t percent = 0, old_percent = -1;
   int32_t block_count = NINT (sqrt ((double) num_threads));
@@ -134,6 +168,88 @@ void maskThread::run ()
   double new_pc_double = (double) pass_point_count;
 
 
+  //  Scanline engine (see engine.hpp).  The spans of a row (fill.cpp) cover the whole row so, instead of each
+  //  pass working on a sub-block, pass p fills rows p, p + num_threads, ... across the whole block and every row's
+  //  spans are only computed once.  The fill rule was set by the caller (the fill is shared, we only read it).
+  //  Cell centers are the same as below so the only differences from the point in polygon test are centers that
+  //  fall exactly on an edge.
+
+  if (fill != NULL)
+    {
+      double *spans = (double *) malloc (2 * (fill->max_count + 1) * sizeof (double));
+      if (spans == NULL)
+        {
+          perror ("Allocating spans memory");
+          exit (-1);
+        }
+
+      int32_t rows = 0;
+
+      for (int32_t i = pass ; i < point_count ; i += num_threads)
+        {
+          double slat = (double) sw_lat + (double) (i + 0.5) / pc_double;
+
+          memset (&block[i * point_count], NVTrue, point_count);
+
+          int32_t num_spans = fill_spans (fill, slat, sw_lon, sw_lon + 1.0, spans);
+
+          for (int32_t k = 0 ; k < num_spans ; k++)
+            {
+              int32_t first, last;
+
+              fill_span_cells (spans[2 * k], spans[2 * k + 1], sw_lon, point_count, &first, &last);
+
+              if (last >= first) memset (&block[i * point_count + first], NVFalse, last - first + 1);
+            }
+
+          rows++;
+        }
+
+      free (spans);
+
+      clm_perf_end (&perf, CLM_PERF_RASTERIZE, (int64_t) rows * point_count);
+      clm_perf_close (&perf);
+
+      complete[pass] = NVTrue;
+      return;
+    }
+
+
+  //  Brute force engine.  A point outside of a ring's bounding box can't be inside of it (or be wound by it) so
+  //  the rings whose boxes miss the bin are skipped.  This is what makes the bounding box coverage feature in
+  //  engine.hpp a good predictor of the cost.
+
+  double *box = (double *) malloc (4 * num_poly * sizeof (double));
+  if (box == NULL && num_poly)
+    {
+      perror ("Allocating ring box memory");
+      exit (-1);
+    }
+
+  for (int32_t k = 0 ; k < num_poly ; k++)
+    {
+      double *bk = &box[4 * k];
+
+      if (!poly_count[k])
+        {
+          bk[0] = bk[1] = 1.0;
+          bk[2] = bk[3] = -1.0;
+          continue;
+        }
+
+      bk[0] = bk[2] = poly_x[k][0];
+      bk[1] = bk[3] = poly_y[k][0];
+
+      for (int32_t m = 1 ; m < poly_count[k] ; m++)
+        {
+          bk[0] = qMin (bk[0], poly_x[k][m]);
+          bk[1] = qMin (bk[1], poly_y[k][m]);
+          bk[2] = qMax (bk[2], poly_x[k][m]);
+          bk[3] = qMax (bk[3], poly_y[k][m]);
+        }
+    }
+
+
   //  Latitude loop.
 
   for (int32_t i = start_y ; i < end_y ; i++)
@@ -155,11 +271,32 @@ void maskThread::run ()
           int32_t inside_count = 0;
 
 
-          //  Check against all polygons.
+          //  Check against all polygons.  With the nonzero winding rule inside_count is the winding number and
+          //  overlapping polygons don't cancel.
 
-          for (int32_t k = 0 ; k < num_poly ; k++)
+          if (nonzero)
             {
-              if (inside_polygon2 (poly_x[k], poly_y[k], poly_count[k], slon, slat)) inside_count++;
+              for (int32_t k = 0 ; k < num_poly ; k++)
+                {
+                  double *bk = &box[4 * k];
+
+                  if (slon < bk[0] || slat < bk[1] || slon > bk[2] || slat > bk[3]) continue;
+
+                  inside_count += polygon_winding (poly_x[k], poly_y[k], poly_count[k], slon, slat);
+                }
+
+              if (inside_count) inside_count = 1;
+            }
+          else
+            {
+              for (int32_t k = 0 ; k < num_poly ; k++)
+                {
+                  double *bk = &box[4 * k];
+
+                  if (slon < bk[0] || slat < bk[1] || slon > bk[2] || slat > bk[3]) continue;
+
+                  if (inside_polygon2 (poly_x[k], poly_y[k], poly_count[k], slon, slat)) inside_count++;
+                }
             }
 
 
@@ -186,7 +323,13 @@ void maskThread::run ()
     }
 
 
+  free (box);
+
+
   //qDebug () << __LINE__ << pass;
 
+  clm_perf_end (&perf, CLM_PERF_RASTERIZE, (int64_t) pass_point_count * pass_point_count);
+  clm_perf_close (&perf);
+
   complete[pass] = NVTrue;
 }
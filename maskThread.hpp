@@ -57,6 +57,8 @@
 #include "nvutility.h"
 #include "nvutility.hpp"
 
+#include "fill.hpp"
+
 
 class maskThread:public QThread
 {
@@ -69,7 +71,8 @@ public:
   ~maskThread ();
 
   void mask (uint8_t *bl = NULL, int32_t r = 0, int32_t np = 0, int32_t *pc = NULL, double **py = NULL, double **px = NULL,
-             double slt = 0.0, double sln = 0.0, uint8_t *c = NULL, int32_t nt = 0, int32_t p = -1);
+             double slt = 0.0, double sln = 0.0, uint8_t *c = NULL, int32_t nt = 0, int32_t p = -1, uint8_t nz = NVFalse,
+             FILL_POLYGON *f = NULL);
 
 
 signals:
@@ -80,12 +83,14 @@ protected:
 
   QMutex           mutex;
 
-  uint8_t          *l_block, *l_complete;
+  uint8_t          *l_block, *l_complete, l_nonzero;
 
   int32_t          l_resolution, l_num_poly, *l_poly_count, l_num_threads, l_pass;
 
   double           **l_poly_y, **l_poly_x, l_sw_lat, l_sw_lon;
 
+  FILL_POLYGON     *l_fill;
+
 
   void             run ();
 
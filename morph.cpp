@@ -0,0 +1,454 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "morph.hpp"
+
+
+/*!
+  - Morphological dilation or erosion of the land in a .clm file using a square (2 * radius + 1 cells on a side)
+    structuring element.  Each one-degree block is processed on its own (in parallel) using a window made up of
+    the block and a radius cell wide halo taken from its eight neighbors (wrapping at 180 degrees).  Erosion is
+    done as a dilation of the water.  Undefined neighbors (and anything past the poles) never affect the result.
+    The dilation is separable.  Each window row is dilated horizontally with word wide shifts and ORs (doubling
+    the covered width each step) and then the rows are combined vertically with the van Herk/Gil-Werman
+    running OR so the cost doesn't depend on the radius.
+*/
+
+
+//!  dst |= src shifted toward column 0 by k bits (that is, dst[c] |= src[c + k]).  dst may be the same as src.
+
+static void or_pulled (uint64_t *dst, uint64_t *src, int32_t nwords, int32_t k)
+{
+  int32_t q = k >> 6, r = k & 63;
+
+  for (int32_t w = 0 ; w + q < nwords ; w++)
+    {
+      uint64_t v = src[w + q] << r;
+      if (r && w + q + 1 < nwords) v |= src[w + q + 1] >> (64 - r);
+
+      dst[w] |= v;
+    }
+}
+
+
+
+morphThread::morphThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+morphThread::~morphThread ()
+{
+}
+
+
+
+void morphThread::morph (CLM_FILE *in, CLM_FILE *out, int32_t o, int32_t r, QAtomicInt *n)
+{
+  QMutexLocker locker (&mutex);
+
+  l_in = in;
+  l_out = out;
+  l_operation = o;
+  l_radius = r;
+  l_next = n;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+void morphThread::run ()
+{
+  mutex.lock ();
+
+  CLM_FILE *in = l_in;
+  CLM_FILE *out = l_out;
+  int32_t operation = l_operation;
+  int32_t radius = l_radius;
+  QAtomicInt *next = l_next;
+
+  mutex.unlock ();
+
+
+  int32_t pc = in->point_count;
+  int32_t width = 2 * radius + 1;
+  int32_t win_size = pc + 2 * radius;
+  int32_t win_words = (win_size + 63) / 64;
+  int32_t row_words = in->row_words;
+  uint64_t words[CLM_MAX_ROW_WORDS];
+
+
+  //  The land value that can't change the result (used for undefined blocks and past the poles).
+
+  int32_t neutral = (operation == MORPH_ERODE) ? 1 : 0;
+
+
+  //  Neighboring blocks (index [dy + 1][dx + 1]), the window row, and the horizontally dilated rows with their
+  //  van Herk prefix and suffix ORs.
+
+  uint8_t *bits[3][3];
+  int32_t code[3][3];
+
+  for (int32_t i = 0 ; i < 3 ; i++)
+    {
+      for (int32_t j = 0 ; j < 3 ; j++)
+        {
+          if ((bits[i][j] = (uint8_t *) malloc (in->bit_size)) == NULL)
+            {
+              perror ("Allocating bits memory in morphThread");
+              exit (-1);
+            }
+        }
+    }
+
+  uint64_t *win = (uint64_t *) calloc (win_words, sizeof (uint64_t));
+  uint64_t *hrow = (uint64_t *) calloc ((size_t) win_size * row_words, sizeof (uint64_t));
+  uint64_t *pre = (uint64_t *) calloc ((size_t) win_size * row_words, sizeof (uint64_t));
+  uint64_t *suf = (uint64_t *) calloc ((size_t) win_size * row_words, sizeof (uint64_t));
+  uint8_t *out_bits = (uint8_t *) calloc (in->bit_size, sizeof (uint8_t));
+
+  if (win == NULL || hrow == NULL || pre == NULL || suf == NULL || out_bits == NULL)
+    {
+      perror ("Allocating window memory in morphThread");
+      exit (-1);
+    }
+
+
+  int32_t i;
+  while ((i = next->fetchAndAddOrdered (1)) < CLM_BLOCKS)
+    {
+      int32_t lat = i / 360 - 90;
+      int32_t lon = i % 360 - 180;
+
+
+      if (!(i % 648))
+        {
+          fprintf (stderr, "%03d%% processed\r", i / 648);
+          fflush (stderr);
+        }
+
+
+      //  Get the map codes for the block and its neighbors.
+
+      uint8_t uniform = NVTrue;
+
+      for (int32_t dy = -1 ; dy <= 1 ; dy++)
+        {
+          for (int32_t dx = -1 ; dx <= 1 ; dx++)
+            {
+              int32_t nlat = lat + dy;
+              int32_t nlon = lon + dx;
+              if (nlon < -180) nlon += 360;
+              if (nlon > 179) nlon -= 360;
+
+              if (nlat < -90 || nlat > 89)
+                {
+                  code[dy + 1][dx + 1] = CLM_UNDEFINED;
+                }
+              else
+                {
+                  uint32_t address = clm_block_address (in, nlat, nlon, NULL);
+                  code[dy + 1][dx + 1] = (address <= CLM_ALL_WATER) ? (int32_t) address : CLM_MIXED;
+                }
+
+              if (code[dy + 1][dx + 1] != code[1][1] && code[dy + 1][dx + 1] != CLM_UNDEFINED) uniform = NVFalse;
+            }
+        }
+
+
+      //  Blocks that can't change.
+
+      if (code[1][1] == CLM_UNDEFINED) continue;
+
+      if ((code[1][1] == CLM_ALL_LAND || code[1][1] == CLM_ALL_WATER) &&
+          (uniform || (operation == MORPH_DILATE && code[1][1] == CLM_ALL_LAND) ||
+           (operation == MORPH_ERODE && code[1][1] == CLM_ALL_WATER)))
+        {
+          clm_set_code (out, lat, lon, code[1][1]);
+          continue;
+        }
+
+
+      //  Read the mixed blocks.
+
+      for (int32_t dy = -1 ; dy <= 1 ; dy++)
+        {
+          for (int32_t dx = -1 ; dx <= 1 ; dx++)
+            {
+              if (code[dy + 1][dx + 1] == CLM_MIXED)
+                {
+                  int32_t nlon = lon + dx;
+                  if (nlon < -180) nlon += 360;
+                  if (nlon > 179) nlon -= 360;
+
+                  if (clm_read_block (in, lat + dy, nlon, bits[dy + 1][dx + 1]) < 0)
+                    {
+                      fprintf (stderr, "\nError reading block %d %d from %s\n", lat + dy, nlon, in->path);
+                      exit (-1);
+                    }
+                }
+            }
+        }
+
+
+      //  Build each window row (land = 1, inverted for erosion) and dilate it horizontally.  Window column c is
+      //  center block column c - radius so after the dilation hrow column c is the OR of window columns c
+      //  through c + 2 * radius.
+
+      for (int32_t wr = 0 ; wr < win_size ; wr++)
+        {
+          int32_t row = wr - radius, dy = 0;
+
+          if (row < 0)
+            {
+              row += pc;
+              dy = -1;
+            }
+          else if (row >= pc)
+            {
+              row -= pc;
+              dy = 1;
+            }
+
+
+          for (int32_t dx = -1 ; dx <= 1 ; dx++)
+            {
+              int32_t c = code[dy + 1][dx + 1];
+
+              int32_t src_start = (dx < 0) ? pc - radius : 0;
+              int32_t dst_start = (dx < 0) ? 0 : (dx == 0) ? radius : radius + pc;
+              int32_t count = dx ? radius : pc;
+
+              if (c == CLM_MIXED)
+                {
+                  clm_get_row (in, bits[dy + 1][dx + 1], row, words);
+                  clm_copy_bits (win, dst_start, words, src_start, count);
+                }
+              else
+                {
+                  int32_t value = (c == CLM_ALL_LAND) ? 1 : (c == CLM_ALL_WATER) ? 0 : neutral;
+                  clm_fill_bits (win, dst_start, dst_start + count, value);
+                }
+            }
+
+          if (operation == MORPH_ERODE)
+            {
+              for (int32_t w = 0 ; w < win_words ; w++) win[w] = ~win[w];
+              if (win_size & 63) win[win_words - 1] &= ~0ULL << (64 - (win_size & 63));
+            }
+
+
+          int32_t covered = 1;
+          while (covered * 2 <= width)
+            {
+              or_pulled (win, win, win_words, covered);
+              covered *= 2;
+            }
+
+          if (covered < width) or_pulled (win, win, win_words, width - covered);
+
+
+          uint64_t *h = &hrow[(size_t) wr * row_words];
+          for (int32_t w = 0 ; w < row_words ; w++) h[w] = win[w];
+          if (pc & 63) h[row_words - 1] &= ~0ULL << (64 - (pc & 63));
+        }
+
+
+      //  Van Herk/Gil-Werman vertical pass.  Prefix ORs run forward from the start of each "width" row segment
+      //  and suffix ORs run backward from the end of each segment so that the OR of rows r through
+      //  r + width - 1 is suf[r] | pre[r + width - 1].
+
+      for (int32_t wr = 0 ; wr < win_size ; wr++)
+        {
+          uint64_t *h = &hrow[(size_t) wr * row_words];
+          uint64_t *p = &pre[(size_t) wr * row_words];
+
+          for (int32_t w = 0 ; w < row_words ; w++) p[w] = (wr % width) ? p[w - row_words] | h[w] : h[w];
+        }
+
+      for (int32_t wr = win_size - 1 ; wr >= 0 ; wr--)
+        {
+          uint64_t *h = &hrow[(size_t) wr * row_words];
+          uint64_t *s = &suf[(size_t) wr * row_words];
+
+          for (int32_t w = 0 ; w < row_words ; w++)
+            s[w] = (wr % width == width - 1 || wr == win_size - 1) ? h[w] : s[w + row_words] | h[w];
+        }
+
+      for (int32_t row = 0 ; row < pc ; row++)
+        {
+          uint64_t *s = &suf[(size_t) row * row_words];
+          uint64_t *p = &pre[(size_t) (row + width - 1) * row_words];
+
+          for (int32_t w = 0 ; w < row_words ; w++)
+            {
+              words[w] = s[w] | p[w];
+              if (operation == MORPH_ERODE) words[w] = ~words[w];
+            }
+
+          clm_put_row (out, out_bits, row, words);
+        }
+
+
+      if (clm_write_block (out, lat, lon, out_bits) < 0)
+        {
+          fprintf (stderr, "\nError writing block %d %d to %s\n", lat, lon, out->path);
+          exit (-1);
+        }
+    }
+
+
+  for (int32_t i = 0 ; i < 3 ; i++)
+    {
+      for (int32_t j = 0 ; j < 3 ; j++) free (bits[i][j]);
+    }
+
+  free (win);
+  free (hrow);
+  free (pre);
+  free (suf);
+  free (out_bits);
+}
+
+
+
+static void morph_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask morph -d | -e -n RADIUS [-u] [-t NUM_THREADS] INPUT_CLM OUTPUT_CLM\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-d = dilate the land (water in OUTPUT_CLM is at least RADIUS + 1 cells from land)\n");
+  fprintf (stderr, "\t-e = erode the land\n");
+  fprintf (stderr, "\t-n RADIUS = radius of the square structuring element in cells (1 to cells per degree)\n");
+  fprintf (stderr, "\t-u = unordered, threads write blocks with pwrite as they finish them, without locking\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of compute threads (1 to %d, default 4)\n\n", CLM_MAX_THREADS);
+  exit (-1);
+}
+
+
+
+/*!
+  - Dilate or erode the land in an existing .clm file.
+*/
+
+int32_t morph (int32_t argc, char **argv)
+{
+  int32_t           num_threads = 4, operation = -1, radius = 0, c;
+  uint8_t           unordered = NVFalse;
+  char              extra_header[2048];
+  morphThread       morph_thread[CLM_MAX_THREADS];
+
+
+  while ((c = getopt (argc, argv, "den:ut:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'd':
+          operation = MORPH_DILATE;
+          break;
+
+        case 'e':
+          operation = MORPH_ERODE;
+          break;
+
+        case 'n':
+          sscanf (optarg, "%d", &radius);
+          break;
+
+        case 'u':
+          unordered = NVTrue;
+          break;
+
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          morph_usage ();
+          break;
+        }
+    }
+
+
+  if (optind + 2 != argc || operation < 0 || num_threads < 1 || num_threads > CLM_MAX_THREADS) morph_usage ();
+
+
+  CLM_FILE *in = clm_open (argv[optind]);
+  if (in == NULL)
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+
+  //  The halo comes from the immediate neighbors only.
+
+  if (radius < 1 || radius > in->point_count) morph_usage ();
+
+
+  sprintf (extra_header, "[SOURCE MASK] = %s\n[MORPHOLOGY] = %s land, %d cell radius\n", in->path,
+           (operation == MORPH_DILATE) ? "dilate" : "erode", radius);
+
+  CLM_FILE *out = clm_create (argv[optind + 1], in->resolution, extra_header);
+  if (out == NULL)
+    {
+      perror (argv[optind + 1]);
+      exit (-1);
+    }
+
+
+  //  With -u the threads write blocks without locking (see clm_set_unordered).
+
+  if (unordered && !clm_set_unordered (out)) fprintf (stderr, "Unordered writes aren't supported here, writing in order\n");
+
+
+  QAtomicInt next (0);
+
+  for (int32_t i = 0 ; i < num_threads ; i++) morph_thread[i].morph (in, out, operation, radius, &next);
+  for (int32_t i = 0 ; i < num_threads ; i++) morph_thread[i].wait ();
+
+
+  clm_close (out);
+  clm_close (in);
+
+
+  fprintf (stderr, "100%% processed                         \n\n");
+  fflush (stderr);
+
+  return (0);
+}
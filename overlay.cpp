@@ -0,0 +1,434 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "overlay.hpp"
+#include "version.h"
+
+
+/*!
+  - Overlay file header (same size as a .clm header):
+
+    <pre>
+
+        [HEADER SIZE] = 16384
+        [VERSION] = 
+        [ZLIB VERSION] =
+        [CREATION DATE] = 
+        [RESOLUTION] = 1, 3, 10, 30, or 60
+        [OVERLAY] = mask/value
+        [END OF HEADER]
+
+    </pre>
+*/
+
+
+static CLM_OVERLAY *overlay_read_header (CLM_OVERLAY *overlay)
+{
+  char header[SWBD_MASK_HEADER_SIZE + 1];
+  uint8_t tagged = NVFalse;
+
+
+  if (fread (header, SWBD_MASK_HEADER_SIZE, 1, overlay->fp) != 1 ||
+      fread (overlay->map, sizeof (overlay->map), 1, overlay->fp) != 1)
+    {
+      fclose (overlay->fp);
+      delete overlay;
+      errno = EINVAL;
+      return (NULL);
+    }
+
+  header[SWBD_MASK_HEADER_SIZE] = 0;
+
+
+  char *line = header;
+  while (line != NULL && *line)
+    {
+      if (!strncmp (line, "[RESOLUTION] = ", 15)) sscanf (&line[15], "%d", &overlay->resolution);
+
+      if (!strncmp (line, "[OVERLAY] = ", 12)) tagged = NVTrue;
+
+      if (!strncmp (line, "[END OF HEADER]", 15)) break;
+
+      if ((line = strchr (line, '\n')) != NULL) line++;
+    }
+
+
+  if (!tagged || (overlay->resolution != 1 && overlay->resolution != 3 && overlay->resolution != 10 &&
+                  overlay->resolution != 30 && overlay->resolution != 60))
+    {
+      fclose (overlay->fp);
+      delete overlay;
+      errno = EINVAL;
+      return (NULL);
+    }
+
+  overlay->point_count = 3600 / overlay->resolution;
+  overlay->bit_size = (overlay->point_count * overlay->point_count) / 8;
+
+  return (overlay);
+}
+
+
+
+/*!
+  - Open an existing overlay file.  If update is set it may be edited (the map is written back by
+    clm_overlay_close).  Returns NULL on failure (errno will be set if the failure was a system error).
+*/
+
+CLM_OVERLAY *clm_overlay_open (const char *path, uint8_t update)
+{
+  CLM_OVERLAY *overlay = new CLM_OVERLAY;
+
+  overlay->write = update;
+  overlay->resolution = 0;
+  strcpy (overlay->path, path);
+
+  if ((overlay->fp = fopen (path, update ? "rb+" : "rb")) == NULL)
+    {
+      delete overlay;
+      return (NULL);
+    }
+
+  return (overlay_read_header (overlay));
+}
+
+
+
+//!  Create an empty overlay file.  Returns NULL on failure.
+
+CLM_OVERLAY *clm_overlay_create (const char *path, int32_t resolution)
+{
+  CLM_OVERLAY *overlay = new CLM_OVERLAY;
+
+  overlay->write = NVTrue;
+  overlay->resolution = resolution;
+  overlay->point_count = 3600 / resolution;
+  overlay->bit_size = (overlay->point_count * overlay->point_count) / 8;
+  strcpy (overlay->path, path);
+
+  if ((overlay->fp = fopen (path, "wb+")) == NULL)
+    {
+      delete overlay;
+      return (NULL);
+    }
+
+
+  time_t t = time (&t);
+  struct tm *cur_tm = gmtime (&t);
+
+  fprintf (overlay->fp, "[HEADER SIZE] = %d\n", SWBD_MASK_HEADER_SIZE);
+  fprintf (overlay->fp, "[VERSION] = %s\n", VERSION);
+  fprintf (overlay->fp, "[ZLIB VERSION] = %s\n", zlibVersion ());
+  fprintf (overlay->fp, "[CREATION DATE] = %s", asctime (cur_tm));
+  fprintf (overlay->fp, "[RESOLUTION] = %d\n", resolution);
+  fprintf (overlay->fp, "[OVERLAY] = mask/value\n");
+  fprintf (overlay->fp, "[END OF HEADER]\n");
+
+
+  memset (overlay->map, 0, sizeof (overlay->map));
+
+  uint8_t zero = 0;
+  int32_t j = ftell (overlay->fp);
+  for (int32_t i = j ; i < SWBD_MASK_HEADER_SIZE ; i++) fwrite (&zero, 1, 1, overlay->fp);
+
+  if (fwrite (overlay->map, sizeof (overlay->map), 1, overlay->fp) != 1)
+    {
+      fclose (overlay->fp);
+      delete overlay;
+      return (NULL);
+    }
+
+  return (overlay);
+}
+
+
+
+//!  Close an overlay file (writing the map back if it was opened for update or created).
+
+void clm_overlay_close (CLM_OVERLAY *overlay)
+{
+  if (overlay == NULL) return;
+
+  if (overlay->write)
+    {
+      fseek (overlay->fp, SWBD_MASK_HEADER_SIZE, SEEK_SET);
+      if (fwrite (overlay->map, sizeof (overlay->map), 1, overlay->fp) != 1) perror (overlay->path);
+    }
+
+  fclose (overlay->fp);
+
+  delete overlay;
+}
+
+
+
+/*!
+  - 0 if there is no override for the one-degree block whose southwest corner is at lat, lon, CLM_ALL_LAND or
+    CLM_ALL_WATER if the whole block is overridden, otherwise CLM_MIXED.  This is just a map lookup.
+*/
+
+int32_t clm_overlay_code (CLM_OVERLAY *overlay, int32_t lat, int32_t lon)
+{
+  uint32_t address = bit_unpack (&overlay->map[clm_block_index (lat, lon) * CLM_MAP_RECORD_SIZE], 0, 32);
+
+  if (address <= CLM_ALL_WATER) return ((int32_t) address);
+
+  return (CLM_MIXED);
+}
+
+
+
+/*!
+  - Read the override for the block at lat, lon into mask and value (each overlay->bit_size bytes).  Returns the
+    clm_overlay_code for the block (mask and value are filled for all of them) or -1 on error.  Safe to call from
+    multiple threads.
+*/
+
+int32_t clm_overlay_read (CLM_OVERLAY *overlay, int32_t lat, int32_t lon, uint8_t *mask, uint8_t *value)
+{
+  uint8_t *mapbuf = &overlay->map[clm_block_index (lat, lon) * CLM_MAP_RECORD_SIZE];
+  uint32_t address = bit_unpack (mapbuf, 0, 32);
+  uint32_t size = bit_unpack (mapbuf, 32, 24);
+
+
+  if (address <= CLM_ALL_WATER)
+    {
+      memset (mask, address ? 0xff : 0x00, overlay->bit_size);
+      memset (value, (address == CLM_ALL_LAND) ? 0xff : 0x00, overlay->bit_size);
+
+      return ((int32_t) address);
+    }
+
+
+  uint8_t *buf = (uint8_t *) malloc (size);
+  if (buf == NULL) return (-1);
+
+  overlay->mutex.lock ();
+
+  fseek (overlay->fp, address, SEEK_SET);
+  size_t n = fread (buf, size, 1, overlay->fp);
+
+  overlay->mutex.unlock ();
+
+  if (n != 1)
+    {
+      free (buf);
+      return (-1);
+    }
+
+
+  //  The mask and the value are compressed together.
+
+  z_stream stream;
+  memset (&stream, 0, sizeof (stream));
+
+  if (inflateInit (&stream) != Z_OK)
+    {
+      free (buf);
+      return (-1);
+    }
+
+  stream.next_in = buf;
+  stream.avail_in = size;
+  stream.next_out = mask;
+  stream.avail_out = overlay->bit_size;
+
+  int32_t status = inflate (&stream, Z_SYNC_FLUSH);
+
+  if (status == Z_OK && !stream.avail_out)
+    {
+      stream.next_out = value;
+      stream.avail_out = overlay->bit_size;
+
+      status = inflate (&stream, Z_FINISH);
+    }
+
+  inflateEnd (&stream);
+  free (buf);
+
+  if (status != Z_STREAM_END || stream.avail_out) return (-1);
+
+  return (CLM_MIXED);
+}
+
+
+
+/*!
+  - Replace the override for the block at lat, lon.  An empty mask removes the override and a full mask with a
+    uniform value is stored as a map code.  Bits of value outside of mask are cleared before it is stored.  Returns
+    the new clm_overlay_code for the block or -1 on error.
+*/
+
+int32_t clm_overlay_write (CLM_OVERLAY *overlay, int32_t lat, int32_t lon, uint8_t *mask, uint8_t *value)
+{
+  uint8_t set = NVFalse, full = NVTrue, land = NVTrue, water = NVTrue;
+
+  for (int32_t i = 0 ; i < overlay->bit_size ; i++)
+    {
+      value[i] &= mask[i];
+
+      if (mask[i]) set = NVTrue;
+      if (mask[i] != 0xff) full = NVFalse;
+      if (value[i] != 0xff) land = NVFalse;
+      if (value[i]) water = NVFalse;
+    }
+
+
+  uint8_t *mapbuf = &overlay->map[clm_block_index (lat, lon) * CLM_MAP_RECORD_SIZE];
+  int32_t code = CLM_MIXED;
+
+  if (!set)
+    {
+      code = 0;
+    }
+  else if (full && land)
+    {
+      code = CLM_ALL_LAND;
+    }
+  else if (full && water)
+    {
+      code = CLM_ALL_WATER;
+    }
+
+  if (code != CLM_MIXED)
+    {
+      QMutexLocker locker (&overlay->mutex);
+
+      memset (mapbuf, 0, CLM_MAP_RECORD_SIZE);
+      bit_pack (mapbuf, 0, 32, code);
+
+      return (code);
+    }
+
+
+  //  Compress the mask and the value as one stream.
+
+  z_stream stream;
+  memset (&stream, 0, sizeof (stream));
+  if (deflateInit (&stream, 9) != Z_OK) return (-1);
+
+  uLong out_size = deflateBound (&stream, 2 * overlay->bit_size);
+  uint8_t *out_buf = (uint8_t *) malloc (out_size);
+  if (out_buf == NULL)
+    {
+      deflateEnd (&stream);
+      return (-1);
+    }
+
+  stream.next_out = out_buf;
+  stream.avail_out = out_size;
+  stream.next_in = mask;
+  stream.avail_in = overlay->bit_size;
+
+  int32_t status = deflate (&stream, Z_NO_FLUSH);
+
+  if (status == Z_OK)
+    {
+      stream.next_in = value;
+      stream.avail_in = overlay->bit_size;
+
+      status = deflate (&stream, Z_FINISH);
+    }
+
+  uint32_t size = stream.total_out;
+  deflateEnd (&stream);
+
+  if (status != Z_STREAM_END || size >= (1 << 24))
+    {
+      free (out_buf);
+      return (-1);
+    }
+
+
+  QMutexLocker locker (&overlay->mutex);
+
+  fseek (overlay->fp, 0, SEEK_END);
+  int64_t address = ftell (overlay->fp);
+
+  if (address > 0xffffffffLL || fwrite (out_buf, size, 1, overlay->fp) != 1)
+    {
+      free (out_buf);
+      return (-1);
+    }
+
+  free (out_buf);
+
+  bit_pack (mapbuf, 0, 32, (uint32_t) address);
+  bit_pack (mapbuf, 32, 24, size);
+
+  return (CLM_MIXED);
+}
+
+
+
+/*!
+  - Apply the overlay to a base block.  code is what clm_read_block returned for the block (bits only has to hold
+    the block if code is CLM_MIXED).  Returns the code of the corrected block, CLM_MIXED if bits was filled with the
+    corrected block.  A uniform base block that is partly overridden is expanded into bits.  Undefined blocks stay
+    undefined unless the whole block is overridden.  work must be at least 2 * overlay->bit_size bytes.  Returns -1
+    if the overlay can't be read.
+*/
+
+int32_t clm_overlay_apply (CLM_OVERLAY *overlay, int32_t lat, int32_t lon, int32_t code, uint8_t *bits, uint8_t *work)
+{
+  int32_t override = clm_overlay_code (overlay, lat, lon);
+
+  if (!override) return (code);
+
+  if (override != CLM_MIXED) return (override);
+
+  if (code == CLM_UNDEFINED) return (code);
+
+
+  uint8_t *mask = work;
+  uint8_t *value = &work[overlay->bit_size];
+
+  if (clm_overlay_read (overlay, lat, lon, mask, value) < 0) return (-1);
+
+  if (code != CLM_MIXED) memset (bits, (code == CLM_ALL_LAND) ? 0xff : 0x00, overlay->bit_size);
+
+
+  //  bits = (bits & ~mask) | value (value is already limited to the mask).  Eight bytes at a time.
+
+  int32_t words = overlay->bit_size / 8;
+  uint64_t *b = (uint64_t *) bits, *m = (uint64_t *) mask, *v = (uint64_t *) value;
+
+  for (int32_t i = 0 ; i < words ; i++) b[i] = (b[i] & ~m[i]) | v[i];
+
+  for (int32_t i = words * 8 ; i < overlay->bit_size ; i++) bits[i] = (bits[i] & ~mask[i]) | value[i];
+
+  return (CLM_MIXED);
+}
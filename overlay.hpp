@@ -0,0 +1,79 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+
+#include "clm.hpp"
+
+
+/*!
+  - Overlay (patch) file for a .clm file.  An overlay holds corrections (new breakwaters, reclaimed land, etc.)
+    that are applied on top of a base mask when it is read (see clm_cache_set_overlay) so small areas can be fixed
+    without rebuilding the mask.  The compact mode folds an overlay into a new .clm file.  The layout is the same
+    as a .clm file (header, 64800 * 7 byte map, zlib blocks) but an overlay block is two packed bit sets, the mask
+    (1 where the overlay overrides the base) followed by the value (1 for land) for the overridden cells.
+    CLM_ALL_LAND or CLM_ALL_WATER in the map overrides the whole one-degree block, 0 means no override.  An edited
+    block is appended and the map is pointed at the new copy (the old copy is left in the file until the overlay is
+    compacted or rebuilt).
+*/
+
+typedef struct
+{
+  FILE            *fp;
+  char            path[512];
+  uint8_t         write;                                  //!<  NVTrue if opened for update or created
+  int32_t         resolution;
+  int32_t         point_count;
+  int32_t         bit_size;                               //!<  Size of one bit set (same as a .clm block)
+  uint8_t         map[CLM_BLOCKS * CLM_MAP_RECORD_SIZE];
+  QMutex          mutex;
+} CLM_OVERLAY;
+
+
+CLM_OVERLAY *clm_overlay_open (const char *path, uint8_t update);
+CLM_OVERLAY *clm_overlay_create (const char *path, int32_t resolution);
+void clm_overlay_close (CLM_OVERLAY *overlay);
+int32_t clm_overlay_code (CLM_OVERLAY *overlay, int32_t lat, int32_t lon);
+int32_t clm_overlay_read (CLM_OVERLAY *overlay, int32_t lat, int32_t lon, uint8_t *mask, uint8_t *value);
+int32_t clm_overlay_write (CLM_OVERLAY *overlay, int32_t lat, int32_t lon, uint8_t *mask, uint8_t *value);
+int32_t clm_overlay_apply (CLM_OVERLAY *overlay, int32_t lat, int32_t lon, int32_t code, uint8_t *bits, uint8_t *work);
+
+
+#endif
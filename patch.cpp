@@ -0,0 +1,443 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "patch.hpp"
+
+
+/*!
+  - Edit an overlay file (see overlay.hpp).  The cells whose centers are in a box, or in the polygons of a
+    shapefile, are set to land or water, or have their corrections removed.  Polygons are rasterized with the
+    same point in polygon engine (maskThread, even-odd rule) that builds the mask so a correction drawn from the
+    same kind of data lines up with the rest of the mask.  Each one-degree block that is touched is read from the
+    overlay, edited, and written back.  The overlay file is created if it doesn't exist.
+*/
+
+
+static const char *operation_name[3] = {"land", "water", "clear"};
+
+
+//!  Set bits start through end - 1 of a packed (most significant bit first) bit set.
+
+static void set_bits (uint8_t *bits, int64_t start, int64_t end)
+{
+  for ( ; start < end && (start & 7) ; start++) bits[start >> 3] |= 0x80 >> (start & 7);
+
+  if (end - start >= 8)
+    {
+      memset (&bits[start >> 3], 0xff, (end - start) >> 3);
+      start += ((end - start) >> 3) << 3;
+    }
+
+  for ( ; start < end ; start++) bits[start >> 3] |= 0x80 >> (start & 7);
+}
+
+
+
+//!  Apply the operation to the cells set in area for the block at lat, lon.
+
+static int32_t patch_block (CLM_OVERLAY *overlay, int32_t lat, int32_t lon, int32_t operation, uint8_t *area, uint8_t *mask,
+                            uint8_t *value)
+{
+  if (clm_overlay_read (overlay, lat, lon, mask, value) < 0)
+    {
+      fprintf (stderr, "\nError reading block %d %d from %s\n", lat, lon, overlay->path);
+      exit (-1);
+    }
+
+
+  int64_t count = 0;
+
+  for (int32_t i = 0 ; i < overlay->bit_size ; i++)
+    {
+      if (!area[i]) continue;
+
+      switch (operation)
+        {
+        case PATCH_LAND:
+          mask[i] |= area[i];
+          value[i] |= area[i];
+          break;
+
+        case PATCH_WATER:
+          mask[i] |= area[i];
+          value[i] &= ~area[i];
+          break;
+
+        case PATCH_CLEAR:
+          mask[i] &= ~area[i];
+          break;
+        }
+
+      count += __builtin_popcount (area[i]);
+    }
+
+
+  if (clm_overlay_write (overlay, lat, lon, mask, value) < 0)
+    {
+      perror (overlay->path);
+      exit (-1);
+    }
+
+  return (count > 0);
+}
+
+
+
+static void patch_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask patch -l | -w | -c -a S,W,N,E | -p SHAPEFILE [-r RESOLUTION] OVERLAY\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-l = set the cells to land\n");
+  fprintf (stderr, "\t-w = set the cells to water\n");
+  fprintf (stderr, "\t-c = remove the corrections for the cells (back to the base mask)\n");
+  fprintf (stderr, "\t-a S,W,N,E = the cells whose centers are in the box (W > E crosses 180)\n");
+  fprintf (stderr, "\t-p SHAPEFILE = the cells whose centers are in the polygons of SHAPEFILE (even-odd rule)\n");
+  fprintf (stderr, "\t-r RESOLUTION = resolution in seconds (1, 3, 10, 30, or 60) if OVERLAY is being created\n\n");
+  fprintf (stderr, "Apply the overlay with -o in crossing or classify, or fold it into a new mask with compact.\n\n");
+  exit (-1);
+}
+
+
+
+/*!
+  - Edit (or create) an overlay file.
+*/
+
+int32_t patch (int32_t argc, char **argv)
+{
+  int32_t           operation = -1, resolution = 0, c, type, numShapes;
+  double            box[4], minBounds[4], maxBounds[4];
+  uint8_t           have_box = NVFalse;
+  char              *shpname = NULL;
+  maskThread        mask_thread[4];
+
+
+  while ((c = getopt (argc, argv, "lwca:p:r:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'l':
+          operation = PATCH_LAND;
+          break;
+
+        case 'w':
+          operation = PATCH_WATER;
+          break;
+
+        case 'c':
+          operation = PATCH_CLEAR;
+          break;
+
+        case 'a':
+          if (sscanf (optarg, "%lf,%lf,%lf,%lf", &box[0], &box[1], &box[2], &box[3]) != 4) patch_usage ();
+          have_box = NVTrue;
+          break;
+
+        case 'p':
+          shpname = optarg;
+          break;
+
+        case 'r':
+          sscanf (optarg, "%d", &resolution);
+          break;
+
+        default:
+          patch_usage ();
+          break;
+        }
+    }
+
+
+  if (optind + 1 != argc || operation < 0 || have_box == (shpname != NULL)) patch_usage ();
+
+  if (have_box && (box[0] >= box[2] || box[0] < -90.0 || box[2] > 90.0 || box[1] < -180.0 || box[1] > 180.0 ||
+                   box[3] < -180.0 || box[3] > 180.0 || box[1] == box[3])) patch_usage ();
+
+
+  //  Open the overlay (or create it).
+
+  CLM_OVERLAY *overlay = clm_overlay_open (argv[optind], NVTrue);
+
+  if (overlay == NULL)
+    {
+      if (errno != ENOENT)
+        {
+          perror (argv[optind]);
+          exit (-1);
+        }
+
+      if (resolution != 1 && resolution != 3 && resolution != 10 && resolution != 30 && resolution != 60) patch_usage ();
+
+      if ((overlay = clm_overlay_create (argv[optind], resolution)) == NULL)
+        {
+          perror (argv[optind]);
+          exit (-1);
+        }
+    }
+  else if (resolution && resolution != overlay->resolution)
+    {
+      fprintf (stderr, "\n\n%s is %d second\n\n", overlay->path, overlay->resolution);
+      exit (-1);
+    }
+
+
+  int32_t pc = overlay->point_count, blocks = 0;
+
+  uint8_t *area = (uint8_t *) malloc (overlay->bit_size);
+  uint8_t *mask = (uint8_t *) malloc (overlay->bit_size);
+  uint8_t *value = (uint8_t *) malloc (overlay->bit_size);
+  if (area == NULL || mask == NULL || value == NULL)
+    {
+      perror ("Allocating patch memory");
+      exit (-1);
+    }
+
+
+  if (have_box)
+    {
+      //  Split a box that crosses 180 into two.
+
+      double west[2] = {box[1], -180.0}, east[2] = {box[3], box[3]};
+      int32_t parts = 1;
+
+      if (box[1] > box[3])
+        {
+          east[0] = 180.0;
+          parts = 2;
+        }
+
+      for (int32_t p = 0 ; p < parts ; p++)
+        {
+          for (int32_t lat = (int32_t) floor (box[0]) ; lat <= qMin (89, (int32_t) floor (box[2])) ; lat++)
+            {
+              //  Rows and columns whose centers are in the box (as in clm_cache_box).
+
+              int32_t first_row = qMax (0, (int32_t) ceil ((box[0] - (double) lat) * (double) pc - 0.5));
+              int32_t last_row = qMin (pc - 1, (int32_t) ceil ((box[2] - (double) lat) * (double) pc - 0.5) - 1);
+
+              for (int32_t lon = (int32_t) floor (west[p]) ; lon <= qMin (179, (int32_t) floor (east[p])) ; lon++)
+                {
+                  int32_t first_col = qMax (0, (int32_t) ceil ((west[p] - (double) lon) * (double) pc - 0.5));
+                  int32_t last_col = qMin (pc - 1, (int32_t) ceil ((east[p] - (double) lon) * (double) pc - 0.5) - 1);
+
+                  if (last_row < first_row || last_col < first_col) continue;
+
+                  memset (area, 0, overlay->bit_size);
+
+                  for (int32_t row = first_row ; row <= last_row ; row++)
+                    set_bits (area, (int64_t) row * pc + first_col, (int64_t) row * pc + last_col + 1);
+
+                  blocks += patch_block (overlay, lat, lon, operation, area, mask, value);
+                }
+            }
+        }
+    }
+  else
+    {
+      SHPHandle shpHandle = SHPOpen (shpname, "rb");
+      if (shpHandle == NULL)
+        {
+          perror (shpname);
+          exit (-1);
+        }
+
+      SHPGetInfo (shpHandle, &numShapes, &type, minBounds, maxBounds);
+
+
+      //  All of the rings of all of the shapes (with their bounding boxes).
+
+      int32_t num_poly = 0;
+      int32_t *poly_count = NULL;
+      double **poly_x = NULL, **poly_y = NULL, *ring_box = NULL;
+
+      for (int32_t i = 0 ; i < numShapes ; i++)
+        {
+          SHPObject *shape = SHPReadObject (shpHandle, i);
+          if (shape == NULL) continue;
+
+          int32_t parts = qMax (1, shape->nParts);
+
+          if (shape->nVertices >= 3)
+            {
+              poly_count = (int32_t *) realloc (poly_count, (num_poly + parts) * sizeof (int32_t));
+              poly_x = (double **) realloc (poly_x, (num_poly + parts) * sizeof (double *));
+              poly_y = (double **) realloc (poly_y, (num_poly + parts) * sizeof (double *));
+              ring_box = (double *) realloc (ring_box, (num_poly + parts) * 4 * sizeof (double));
+              if (poly_count == NULL || poly_x == NULL || poly_y == NULL || ring_box == NULL)
+                {
+                  perror ("Allocating polygon memory");
+                  exit (-1);
+                }
+
+              for (int32_t j = 0 ; j < parts ; j++)
+                {
+                  int32_t start = shape->nParts ? shape->panPartStart[j] : 0;
+                  int32_t end = (j + 1 < shape->nParts) ? shape->panPartStart[j + 1] : shape->nVertices;
+                  int32_t k = num_poly++;
+                  double *b = &ring_box[k * 4];
+
+                  poly_count[k] = end - start;
+                  poly_x[k] = (double *) malloc (qMax (1, end - start) * sizeof (double));
+                  poly_y[k] = (double *) malloc (qMax (1, end - start) * sizeof (double));
+                  if (poly_x[k] == NULL || poly_y[k] == NULL)
+                    {
+                      perror ("Allocating polygon memory");
+                      exit (-1);
+                    }
+
+                  memcpy (poly_x[k], &shape->padfX[start], (end - start) * sizeof (double));
+                  memcpy (poly_y[k], &shape->padfY[start], (end - start) * sizeof (double));
+
+                  b[0] = b[1] = 999.0;
+                  b[2] = b[3] = -999.0;
+
+                  for (int32_t m = start ; m < end ; m++)
+                    {
+                      b[0] = qMin (b[0], shape->padfY[m]);
+                      b[1] = qMin (b[1], shape->padfX[m]);
+                      b[2] = qMax (b[2], shape->padfY[m]);
+                      b[3] = qMax (b[3], shape->padfX[m]);
+                    }
+                }
+            }
+
+          SHPDestroyObject (shape);
+        }
+
+      SHPClose (shpHandle);
+
+
+      uint8_t *block = (uint8_t *) malloc ((size_t) pc * pc);
+      int32_t *cell_count = (int32_t *) malloc (qMax (1, num_poly) * sizeof (int32_t));
+      double **cell_x = (double **) malloc (qMax (1, num_poly) * sizeof (double *));
+      double **cell_y = (double **) malloc (qMax (1, num_poly) * sizeof (double *));
+      if (block == NULL || cell_count == NULL || cell_x == NULL || cell_y == NULL)
+        {
+          perror ("Allocating patch memory");
+          exit (-1);
+        }
+
+
+      //  Rasterize the rings that touch each block in the bounding box of all of them.
+
+      double south = 999.0, west = 999.0, north = -999.0, east = -999.0;
+      for (int32_t k = 0 ; k < num_poly ; k++)
+        {
+          south = qMin (south, ring_box[k * 4]);
+          west = qMin (west, ring_box[k * 4 + 1]);
+          north = qMax (north, ring_box[k * 4 + 2]);
+          east = qMax (east, ring_box[k * 4 + 3]);
+        }
+
+      for (int32_t lat = qMax (-90, (int32_t) floor (south)) ; num_poly && lat <= qMin (89, (int32_t) floor (north)) ; lat++)
+        {
+          for (int32_t lon = qMax (-180, (int32_t) floor (west)) ; lon <= qMin (179, (int32_t) floor (east)) ; lon++)
+            {
+              int32_t cell_poly = 0;
+
+              for (int32_t k = 0 ; k < num_poly ; k++)
+                {
+                  double *b = &ring_box[k * 4];
+
+                  if (b[2] < (double) lat || b[0] > (double) (lat + 1) || b[3] < (double) lon || b[1] > (double) (lon + 1)) continue;
+
+                  cell_count[cell_poly] = poly_count[k];
+                  cell_x[cell_poly] = poly_x[k];
+                  cell_y[cell_poly] = poly_y[k];
+                  cell_poly++;
+                }
+
+              if (!cell_poly) continue;
+
+
+              uint8_t complete[4];
+              memset (complete, 0, sizeof (complete));
+
+              for (int32_t i = 0 ; i < 4 ; i++)
+                mask_thread[i].mask (block, overlay->resolution, cell_poly, cell_count, cell_y, cell_x, (double) lat, (double) lon,
+                                     complete, 4, i);
+
+              for (int32_t i = 0 ; i < 4 ; i++) mask_thread[i].wait ();
+
+
+              //  maskThread marks the inside of the polygons NVFalse (they're SWBD water polygons).
+
+              memset (area, 0, overlay->bit_size);
+
+              for (int64_t pos = 0 ; pos < (int64_t) pc * pc ; pos++)
+                {
+                  if (!block[pos]) area[pos >> 3] |= 0x80 >> (pos & 7);
+                }
+
+              blocks += patch_block (overlay, lat, lon, operation, area, mask, value);
+            }
+        }
+
+
+      for (int32_t k = 0 ; k < num_poly ; k++)
+        {
+          free (poly_x[k]);
+          free (poly_y[k]);
+        }
+
+      free (poly_count);
+      free (poly_x);
+      free (poly_y);
+      free (ring_box);
+      free (block);
+      free (cell_count);
+      free (cell_x);
+      free (cell_y);
+    }
+
+
+  free (area);
+  free (mask);
+  free (value);
+
+
+  int32_t total = 0;
+  for (int32_t i = 0 ; i < CLM_BLOCKS ; i++) total += (clm_overlay_code (overlay, i / 360 - 90, i % 360 - 180) != 0);
+
+  clm_overlay_close (overlay);
+
+
+  fprintf (stderr, "%s: %d blocks edited (%s), %d blocks have corrections\n\n", argv[optind], blocks, operation_name[operation],
+           total);
+  fflush (stderr);
+
+  return (0);
+}
@@ -0,0 +1,284 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#include "perf.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#endif
+
+
+/*!
+  - Per stage profiling with the Linux perf_event counters.  Counts are user space only (exclude_kernel) so that
+    they can be read with the default perf_event_paranoid setting of 2.  The counters are opened one at a time
+    (not as a group) so that any that the hardware doesn't have are simply left out.  If the kernel has to
+    multiplex them the counts are scaled by the time enabled over the time running.
+*/
+
+
+//  The stage totals are only changed with atomic builtins (QAtomicInteger<qint64> needs Qt 5.3).
+
+static QAtomicInt perf_enabled (0);
+static QAtomicInt perf_warned (0);
+
+static int64_t stage_count[CLM_PERF_STAGES][CLM_PERF_EVENTS];
+static int64_t stage_valid[CLM_PERF_STAGES][CLM_PERF_EVENTS];   //  Tasks that had the counter
+static int64_t stage_tasks[CLM_PERF_STAGES];
+static int64_t stage_nsecs[CLM_PERF_STAGES];
+static int64_t stage_pixels[CLM_PERF_STAGES];
+
+static const char *stage_name[CLM_PERF_STAGES] = {"ingest", "rasterize", "pack", "compress", "write"};
+
+
+
+//!  Turn profiling on or off (off by default).  Counters opened while it was off stay inactive.
+
+void clm_perf_enable (uint8_t enable)
+{
+  perf_enabled.fetchAndStoreOrdered (enable ? 1 : 0);
+}
+
+
+
+uint8_t clm_perf_enabled ()
+{
+  return (perf_enabled.fetchAndAddOrdered (0) != 0);
+}
+
+
+
+//!  Open the counters for the calling thread.
+
+void clm_perf_open (CLM_PERF *perf)
+{
+  perf->active = clm_perf_enabled ();
+
+  for (int32_t i = 0 ; i < CLM_PERF_EVENTS ; i++) perf->fd[i] = -1;
+
+  if (!perf->active) return;
+
+
+#ifdef __linux__
+
+  static const uint64_t config[CLM_PERF_EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                   PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+  for (int32_t i = 0 ; i < CLM_PERF_EVENTS ; i++)
+    {
+      struct perf_event_attr attr;
+      memset (&attr, 0, sizeof (attr));
+
+      attr.size = sizeof (attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = config[i];
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      perf->fd[i] = syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0);
+
+
+      //  Say why once, then carry on with whatever we've got.
+
+      if (perf->fd[i] < 0 && !perf_warned.fetchAndStoreOrdered (1))
+        {
+          fprintf (stderr, "\nHardware counter %d is not available (%s), it will be reported as n/a", i, strerror (errno));
+          if (errno == EACCES || errno == EPERM) fprintf (stderr, " (see /proc/sys/kernel/perf_event_paranoid)");
+          fprintf (stderr, "\n\n");
+          fflush (stderr);
+        }
+    }
+
+#else
+
+  if (!perf_warned.fetchAndStoreOrdered (1))
+    {
+      fprintf (stderr, "\nHardware counters are only available on Linux, only times will be reported\n\n");
+      fflush (stderr);
+    }
+
+#endif
+}
+
+
+
+void clm_perf_close (CLM_PERF *perf)
+{
+  for (int32_t i = 0 ; i < CLM_PERF_EVENTS ; i++)
+    {
+      if (perf->fd[i] >= 0) close (perf->fd[i]);
+      perf->fd[i] = -1;
+    }
+
+  perf->active = NVFalse;
+}
+
+
+
+//!  Read value, time enabled, and time running for counter i.  Returns NVFalse if it can't be read.
+
+static uint8_t perf_read (CLM_PERF *perf, int32_t i, uint64_t *value)
+{
+  if (perf->fd[i] < 0) return (NVFalse);
+
+  if (read (perf->fd[i], value, 3 * sizeof (uint64_t)) != (ssize_t) (3 * sizeof (uint64_t))) return (NVFalse);
+
+  return (NVTrue);
+}
+
+
+
+//!  Start a task.
+
+void clm_perf_begin (CLM_PERF *perf)
+{
+  if (!perf->active) return;
+
+  for (int32_t i = 0 ; i < CLM_PERF_EVENTS ; i++) perf_read (perf, i, perf->start[i]);
+
+  perf->timer.start ();
+}
+
+
+
+//!  End a task and add it (and the number of cells that it produced, if any) to the totals for stage.
+
+void clm_perf_end (CLM_PERF *perf, int32_t stage, int64_t pixels)
+{
+  if (!perf->active) return;
+
+  __atomic_fetch_add (&stage_nsecs[stage], perf->timer.nsecsElapsed (), __ATOMIC_RELAXED);
+  __atomic_fetch_add (&stage_tasks[stage], 1, __ATOMIC_RELAXED);
+  if (pixels) __atomic_fetch_add (&stage_pixels[stage], pixels, __ATOMIC_RELAXED);
+
+
+  for (int32_t i = 0 ; i < CLM_PERF_EVENTS ; i++)
+    {
+      uint64_t end[3];
+
+      if (!perf_read (perf, i, end)) continue;
+
+      uint64_t count = end[0] - perf->start[i][0];
+      uint64_t enabled = end[1] - perf->start[i][1];
+      uint64_t running = end[2] - perf->start[i][2];
+
+
+      //  The counter was never scheduled during the task so we don't know anything.
+
+      if (!running) continue;
+
+      if (running < enabled) count = (uint64_t) ((double) count * (double) enabled / (double) running);
+
+      __atomic_fetch_add (&stage_count[stage][i], (int64_t) count, __ATOMIC_RELAXED);
+      __atomic_fetch_add (&stage_valid[stage][i], 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+
+//!  Add cells to a stage whose tasks don't know how many cells they are for (ingest).
+
+void clm_perf_pixels (int32_t stage, int64_t pixels)
+{
+  if (clm_perf_enabled ()) __atomic_fetch_add (&stage_pixels[stage], pixels, __ATOMIC_RELAXED);
+}
+
+
+
+/*!
+  - Print the totals for each stage: tasks, seconds (summed over the threads), IPC, last level cache misses per
+    thousand instructions, and cache and branch misses per cell.  A low IPC with a high miss rate points at memory,
+    a high IPC at compute.  Counters that weren't available for every task of a stage are printed as n/a.
+*/
+
+void clm_perf_report (FILE *fp)
+{
+  if (!clm_perf_enabled ()) return;
+
+
+  fprintf (fp, "\nStage profile (user space hardware counters, seconds summed over threads)\n\n");
+  fprintf (fp, "%-10s %10s %10s %16s %16s %6s %8s %14s %14s\n", "stage", "tasks", "seconds", "cycles", "instructions", "IPC",
+           "LLC/kI", "LLC miss/cell", "br miss/cell");
+
+  for (int32_t s = 0 ; s < CLM_PERF_STAGES ; s++)
+    {
+      int64_t tasks = __atomic_load_n (&stage_tasks[s], __ATOMIC_ACQUIRE);
+      int64_t pixels = __atomic_load_n (&stage_pixels[s], __ATOMIC_ACQUIRE);
+      int64_t count[CLM_PERF_EVENTS];
+      uint8_t valid[CLM_PERF_EVENTS];
+      char field[5][32];
+
+      if (!tasks) continue;
+
+      for (int32_t i = 0 ; i < CLM_PERF_EVENTS ; i++)
+        {
+          count[i] = __atomic_load_n (&stage_count[s][i], __ATOMIC_ACQUIRE);
+          valid[i] = (__atomic_load_n (&stage_valid[s][i], __ATOMIC_ACQUIRE) == tasks);
+        }
+
+      for (int32_t i = 0 ; i < 5 ; i++) strcpy (field[i], "n/a");
+
+      if (valid[CLM_PERF_CYCLES]) sprintf (field[0], "%lld", (long long) count[CLM_PERF_CYCLES]);
+      if (valid[CLM_PERF_INSTRUCTIONS]) sprintf (field[1], "%lld", (long long) count[CLM_PERF_INSTRUCTIONS]);
+
+      if (valid[CLM_PERF_CYCLES] && valid[CLM_PERF_INSTRUCTIONS] && count[CLM_PERF_CYCLES])
+        sprintf (field[2], "%.2f", (double) count[CLM_PERF_INSTRUCTIONS] / (double) count[CLM_PERF_CYCLES]);
+
+      if (valid[CLM_PERF_LLC_MISSES] && valid[CLM_PERF_INSTRUCTIONS] && count[CLM_PERF_INSTRUCTIONS])
+        sprintf (field[3], "%.3f", (double) count[CLM_PERF_LLC_MISSES] * 1000.0 / (double) count[CLM_PERF_INSTRUCTIONS]);
+
+      double seconds = (double) __atomic_load_n (&stage_nsecs[s], __ATOMIC_ACQUIRE) / 1.0e9;
+
+      fprintf (fp, "%-10s %10lld %10.3f %16s %16s %6s %8s", stage_name[s], (long long) tasks, seconds, field[0],
+               field[1], field[2], field[3]);
+
+      for (int32_t i = CLM_PERF_LLC_MISSES ; i <= CLM_PERF_BRANCH_MISSES ; i++)
+        {
+          strcpy (field[4], "n/a");
+          if (valid[i] && pixels) sprintf (field[4], "%.4f", (double) count[i] / (double) pixels);
+
+          fprintf (fp, " %14s", field[4]);
+        }
+
+      fprintf (fp, "\n");
+    }
+
+  fprintf (fp, "\n");
+  fflush (fp);
+}
@@ -0,0 +1,91 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#ifndef PERF_H
+#define PERF_H
+
+
+#include "clm.hpp"
+
+
+//  Hardware counters read around each stage (see clm_perf_open).
+
+#define CLM_PERF_CYCLES              0
+#define CLM_PERF_INSTRUCTIONS        1
+#define CLM_PERF_LLC_MISSES          2
+#define CLM_PERF_BRANCH_MISSES       3
+#define CLM_PERF_EVENTS              4
+
+
+//  Stages of the main build.
+
+#define CLM_PERF_INGEST              0          //  Reading and parsing the shapefiles (reader threads)
+#define CLM_PERF_RASTERIZE           1          //  Point in polygon tests (maskThread passes)
+#define CLM_PERF_PACK                2          //  One byte per cell to packed bits
+#define CLM_PERF_COMPRESS            3          //  zlib
+#define CLM_PERF_WRITE               4          //  Appending the block to the .clm file
+#define CLM_PERF_STAGES              5
+
+
+/*!
+  - Hardware counters for one thread.  Each thread that does work for a stage opens its own counters (they only
+    count the thread that opened them), brackets each task with clm_perf_begin and clm_perf_end, and closes them
+    when it's done.  Totals for each stage are kept in the perf module and printed by clm_perf_report.  When
+    profiling isn't enabled all of these do nothing.  Counters that can't be opened (not Linux, no PMU in a virtual
+    machine, perf_event_paranoid too high) are skipped and reported as n/a, times are always kept.
+*/
+
+typedef struct
+{
+  uint8_t         active;                                 //!<  NVTrue if profiling was enabled when opened
+  int32_t         fd[CLM_PERF_EVENTS];                    //!<  -1 if the counter isn't available
+  uint64_t        start[CLM_PERF_EVENTS][3];              //!<  Value, time enabled, and time running at clm_perf_begin
+  QElapsedTimer   timer;
+} CLM_PERF;
+
+
+void clm_perf_enable (uint8_t enable);
+uint8_t clm_perf_enabled ();
+void clm_perf_open (CLM_PERF *perf);
+void clm_perf_close (CLM_PERF *perf);
+void clm_perf_begin (CLM_PERF *perf);
+void clm_perf_end (CLM_PERF *perf, int32_t stage, int64_t pixels);
+void clm_perf_pixels (int32_t stage, int64_t pixels);
+void clm_perf_report (FILE *fp);
+
+
+#endif
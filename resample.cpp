@@ -0,0 +1,517 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "resample.hpp"
+
+
+/*!
+  - Build a coarser .clm (for instance 10, 30, or 60 second) from a finer one without going back to the
+    shapefiles.  A coarse cell is made from the fine cells whose centers fall inside it (so 3 to 10 second,
+    where the cells don't line up, still works).  The rules are:
+        - center - the fine cell that holds the center of the coarse cell
+        - majority - land if more than half of the fine cells are land (ties go to the center cell)
+        - land - land if any of the fine cells are land
+        - water - water if any of the fine cells are water
+  - The fine rows are combined a 64 bit word at a time (OR for land, AND for water, and popcounts for the
+    majority) so the cost is per word, not per cell.  Blocks are done in parallel.
+  - Optionally, a sample of the one-degree cells that came from SWBD shapefiles can be rasterized directly at the
+    output resolution (same even-odd, cell center test as the main program) and compared to the result.
+*/
+
+
+static const char *rule_name[4] = {"center", "majority", "land", "water"};
+
+
+//!  Return the value of bit k of a packed row.
+
+static inline int32_t row_bit (uint64_t *words, int32_t k)
+{
+  return ((int32_t) ((words[k >> 6] >> (63 - (k & 63))) & 1));
+}
+
+
+
+/*!
+  - For each of the count coarse cells along one side of a block, the first fine cell (the last is first[j + 1] - 1)
+    and the fine cell that holds its center.
+*/
+
+static void resample_index (int32_t in_res, int32_t out_res, int32_t count, int32_t *first, int32_t *center)
+{
+  for (int32_t j = 0 ; j <= count ; j++)
+    {
+      //  Smallest k with (k + 0.5) * in_res >= j * out_res.
+
+      first[j] = (2 * j * out_res + in_res - 1) / (2 * in_res);
+
+      if (j < count) center[j] = ((2 * j + 1) * out_res) / (2 * in_res);
+    }
+}
+
+
+
+resampleThread::resampleThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+resampleThread::~resampleThread ()
+{
+}
+
+
+
+void resampleThread::resample (CLM_FILE *in, CLM_FILE *out, int32_t r, QAtomicInt *n)
+{
+  QMutexLocker locker (&mutex);
+
+  l_in = in;
+  l_out = out;
+  l_rule = r;
+  l_next = n;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+void resampleThread::run ()
+{
+  mutex.lock ();
+
+  CLM_FILE *in = l_in;
+  CLM_FILE *out = l_out;
+  int32_t rule = l_rule;
+  QAtomicInt *next = l_next;
+
+  mutex.unlock ();
+
+
+  int32_t pc = out->point_count;
+  uint64_t words[CLM_MAX_ROW_WORDS], acc[CLM_MAX_ROW_WORDS], mid[CLM_MAX_ROW_WORDS], res[CLM_MAX_ROW_WORDS];
+
+  int32_t *first = (int32_t *) malloc ((pc + 1) * sizeof (int32_t));
+  int32_t *center = (int32_t *) malloc (pc * sizeof (int32_t));
+  int32_t *count = (int32_t *) malloc (pc * sizeof (int32_t));
+  uint8_t *bits = (uint8_t *) malloc (in->bit_size);
+  uint8_t *out_bits = (uint8_t *) calloc (out->bit_size, sizeof (uint8_t));
+
+  if (first == NULL || center == NULL || count == NULL || bits == NULL || out_bits == NULL)
+    {
+      perror ("Allocating memory in resampleThread");
+      exit (-1);
+    }
+
+  resample_index (in->resolution, out->resolution, pc, first, center);
+
+
+  int32_t i;
+  while ((i = next->fetchAndAddOrdered (1)) < CLM_BLOCKS)
+    {
+      int32_t lat = i / 360 - 90;
+      int32_t lon = i % 360 - 180;
+
+
+      if (!(i % 648))
+        {
+          fprintf (stderr, "%03d%% processed\r", i / 648);
+          fflush (stderr);
+        }
+
+
+      //  Undefined, all land, and all water blocks don't change.
+
+      uint32_t address = clm_block_address (in, lat, lon, NULL);
+
+      if (address == CLM_UNDEFINED) continue;
+
+      if (address <= CLM_ALL_WATER)
+        {
+          clm_set_code (out, lat, lon, address);
+          continue;
+        }
+
+
+      if (clm_read_block (in, lat, lon, bits) != CLM_MIXED)
+        {
+          fprintf (stderr, "\nError reading block %d %d from %s\n", lat, lon, in->path);
+          exit (-1);
+        }
+
+
+      for (int32_t row = 0 ; row < pc ; row++)
+        {
+          memset (res, 0, sizeof (res));
+
+
+          //  The fine row holding the center of the coarse row (used by center and to break majority ties).
+
+          if (rule == RESAMPLE_CENTER || rule == RESAMPLE_MAJORITY) clm_get_row (in, bits, center[row], mid);
+
+          switch (rule)
+            {
+            case RESAMPLE_CENTER:
+              for (int32_t j = 0 ; j < pc ; j++)
+                {
+                  if (row_bit (mid, center[j])) res[j >> 6] |= 1ULL << (63 - (j & 63));
+                }
+              break;
+
+            case RESAMPLE_MAJORITY:
+              memset (count, 0, pc * sizeof (int32_t));
+
+              for (int32_t k = first[row] ; k < first[row + 1] ; k++)
+                {
+                  clm_get_row (in, bits, k, words);
+
+                  for (int32_t j = 0 ; j < pc ; j++) count[j] += clm_count_bits (words, first[j], first[j + 1]);
+                }
+
+              for (int32_t j = 0 ; j < pc ; j++)
+                {
+                  int32_t cells = (first[row + 1] - first[row]) * (first[j + 1] - first[j]);
+
+                  if (2 * count[j] > cells || (2 * count[j] == cells && row_bit (mid, center[j])))
+                    res[j >> 6] |= 1ULL << (63 - (j & 63));
+                }
+              break;
+
+            case RESAMPLE_ANY_LAND:
+            case RESAMPLE_ANY_WATER:
+              for (int32_t k = first[row] ; k < first[row + 1] ; k++)
+                {
+                  clm_get_row (in, bits, k, words);
+
+                  for (int32_t w = 0 ; w < in->row_words ; w++)
+                    {
+                      if (k == first[row])
+                        {
+                          acc[w] = words[w];
+                        }
+                      else
+                        {
+                          acc[w] = (rule == RESAMPLE_ANY_LAND) ? (acc[w] | words[w]) : (acc[w] & words[w]);
+                        }
+                    }
+                }
+
+              for (int32_t j = 0 ; j < pc ; j++)
+                {
+                  int32_t land = clm_count_bits (acc, first[j], first[j + 1]);
+
+                  if (rule == RESAMPLE_ANY_LAND ? (land > 0) : (land == first[j + 1] - first[j]))
+                    res[j >> 6] |= 1ULL << (63 - (j & 63));
+                }
+              break;
+            }
+
+          clm_put_row (out, out_bits, row, res);
+        }
+
+
+      if (clm_write_block (out, lat, lon, out_bits) < 0)
+        {
+          fprintf (stderr, "\nError writing block %d %d to %s\n", lat, lon, out->path);
+          exit (-1);
+        }
+    }
+
+
+  free (first);
+  free (center);
+  free (count);
+  free (bits);
+  free (out_bits);
+}
+
+
+
+/*!
+  - Compare num_samples one-degree cells of out (spread evenly over the cells that are mixed in in) against
+    a rasterization of the SWBD shapefiles at the output resolution.
+*/
+
+static void resample_check (CLM_FILE *in, CLM_FILE *out, int32_t num_samples)
+{
+  char              dirname[512];
+
+
+  if (getenv ("ABE_DATA") == NULL)
+    {
+      fprintf (stderr, "\n\nEnvironment variable ABE_DATA is not set\n\n");
+      fflush (stderr);
+      exit (-1);
+    }
+
+  sprintf (dirname, "%s", getenv ("ABE_DATA"));
+
+  SWBD_SOURCE *source = swbd_open (dirname);
+
+
+  int32_t *mixed = (int32_t *) malloc (CLM_BLOCKS * sizeof (int32_t));
+  uint8_t *bits = (uint8_t *) malloc (out->bit_size);
+  if (mixed == NULL || bits == NULL)
+    {
+      perror ("Allocating memory in resample_check");
+      exit (-1);
+    }
+
+  int32_t num_mixed = 0;
+  for (int32_t i = 0 ; i < CLM_BLOCKS ; i++)
+    {
+      if (clm_block_address (in, i / 360 - 90, i % 360 - 180, NULL) > CLM_ALL_WATER) mixed[num_mixed++] = i;
+    }
+
+
+  int32_t pc = out->point_count, cells = 0;
+  int64_t compared = 0, differ = 0, false_land = 0;
+  uint64_t words[CLM_MAX_ROW_WORDS], truth[CLM_MAX_ROW_WORDS];
+
+  for (int32_t s = 0 ; s < num_samples && s < num_mixed ; s++)
+    {
+      int32_t i = mixed[(int64_t) s * num_mixed / qMin (num_samples, num_mixed)];
+      int32_t lat = i / 360 - 90;
+      int32_t lon = i % 360 - 180;
+
+
+      SWBD_CELL *cell = swbd_read_cell (source, lat, lon);
+      if (cell == NULL) continue;
+
+      FILL_POLYGON *fill = fill_create (cell->num_poly, cell->poly_count, cell->poly_x, cell->poly_y);
+      if (fill == NULL)
+        {
+          perror ("Allocating fill memory");
+          exit (-1);
+        }
+
+      swbd_free_cell (cell);
+
+      double *spans = (double *) malloc (2 * (fill->max_count + 1) * sizeof (double));
+      if (spans == NULL)
+        {
+          perror ("Allocating span memory");
+          exit (-1);
+        }
+
+      int32_t code = clm_read_block (out, lat, lon, bits);
+      if (code < 0)
+        {
+          fprintf (stderr, "\nError reading block %d %d from %s\n", lat, lon, out->path);
+          exit (-1);
+        }
+
+
+      //  A block that resampled to all land or all water has no bits in the file.
+
+      if (code != CLM_MIXED) clm_fill_block (out, bits, code);
+
+
+      //  SWBD polygons are water.
+
+      for (int32_t row = 0 ; row < pc ; row++)
+        {
+          double y = (double) lat + ((double) row + 0.5) / (double) pc;
+
+          memset (truth, 0, sizeof (truth));
+          clm_fill_bits (truth, 0, pc, 1);
+
+          int32_t num_spans = fill_spans (fill, y, (double) lon, (double) (lon + 1), spans);
+
+          for (int32_t k = 0 ; k < num_spans ; k++)
+            {
+              int32_t first, last;
+
+              fill_span_cells (spans[2 * k], spans[2 * k + 1], (double) lon, pc, &first, &last);
+              if (last >= first) clm_fill_bits (truth, first, last + 1, 0);
+            }
+
+          clm_get_row (out, bits, row, words);
+
+          for (int32_t w = 0 ; w < out->row_words ; w++)
+            {
+              differ += __builtin_popcountll (words[w] ^ truth[w]);
+              false_land += __builtin_popcountll (words[w] & ~truth[w]);
+            }
+        }
+
+      compared += (int64_t) pc * pc;
+      cells++;
+
+      free (spans);
+      fill_destroy (fill);
+    }
+
+
+  fprintf (stderr, "%d sampled cells, %lld of %lld pixels differ from the shapefiles (%.4f%%), %lld land that should be water, %lld water that should be land\n\n",
+           cells, (long long) differ, (long long) compared, compared ? 100.0 * (double) differ / (double) compared : 0.0,
+           (long long) false_land, (long long) (differ - false_land));
+  fflush (stderr);
+
+  swbd_close (source);
+
+  free (mixed);
+  free (bits);
+}
+
+
+
+static void resample_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask resample [-r RULE] [-c NUM_CELLS] [-u] [-t NUM_THREADS] INPUT_CLM RESOLUTION OUTPUT_CLM\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-r RULE = center, majority, land (any land), or water (any water) (default center)\n");
+  fprintf (stderr, "\t-c NUM_CELLS = compare NUM_CELLS one-degree cells to a rasterization of the SWBD shapefiles\n");
+  fprintf (stderr, "\t              (requires ABE_DATA, default 0)\n");
+  fprintf (stderr, "\t-u = unordered, threads write blocks with pwrite as they finish them, without locking\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of compute threads (1 to %d, default 4)\n", CLM_MAX_THREADS);
+  fprintf (stderr, "\tRESOLUTION = output resolution in seconds (3, 10, 30, or 60, coarser than INPUT_CLM)\n\n");
+  exit (-1);
+}
+
+
+
+/*!
+  - Resample an existing .clm file to a coarser resolution.
+*/
+
+int32_t resample (int32_t argc, char **argv)
+{
+  int32_t           num_threads = 4, rule = RESAMPLE_CENTER, num_samples = 0, resolution = 0, c;
+  uint8_t           unordered = NVFalse;
+  char              extra_header[SWBD_MASK_HEADER_SIZE / 2];
+  resampleThread    resample_thread[CLM_MAX_THREADS];
+
+
+  while ((c = getopt (argc, argv, "r:c:ut:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'r':
+          rule = -1;
+          for (int32_t i = 0 ; i < 4 ; i++)
+            {
+              if (!strcmp (optarg, rule_name[i])) rule = i;
+            }
+          break;
+
+        case 'c':
+          sscanf (optarg, "%d", &num_samples);
+          break;
+
+        case 'u':
+          unordered = NVTrue;
+          break;
+
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          resample_usage ();
+          break;
+        }
+    }
+
+
+  if (optind + 3 != argc || rule < 0 || num_samples < 0 || num_threads < 1 || num_threads > CLM_MAX_THREADS) resample_usage ();
+
+
+  sscanf (argv[optind + 1], "%d", &resolution);
+  if (resolution != 3 && resolution != 10 && resolution != 30 && resolution != 60) resample_usage ();
+
+
+  CLM_FILE *in = clm_open (argv[optind]);
+  if (in == NULL)
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+  if (resolution <= in->resolution)
+    {
+      fprintf (stderr, "\n\nOutput resolution must be coarser than the %d second resolution of %s\n\n", in->resolution, in->path);
+      exit (-1);
+    }
+
+
+  sprintf (extra_header, "[SOURCE MASK] = %s\n[SOURCE RESOLUTION] = %d\n[RESAMPLE RULE] = %s\n", in->path, in->resolution,
+           rule_name[rule]);
+
+  CLM_FILE *out = clm_create (argv[optind + 2], resolution, extra_header);
+  if (out == NULL)
+    {
+      perror (argv[optind + 2]);
+      exit (-1);
+    }
+
+
+  //  With -u the threads write blocks without locking (see clm_set_unordered).
+
+  if (unordered && !clm_set_unordered (out)) fprintf (stderr, "Unordered writes aren't supported here, writing in order\n");
+
+
+  QAtomicInt next (0);
+
+  for (int32_t i = 0 ; i < num_threads ; i++) resample_thread[i].resample (in, out, rule, &next);
+  for (int32_t i = 0 ; i < num_threads ; i++) resample_thread[i].wait ();
+
+
+  clm_close (out);
+
+  fprintf (stderr, "100%% processed                         \n\n");
+  fflush (stderr);
+
+
+  if (num_samples)
+    {
+      if ((out = clm_open (argv[optind + 2])) == NULL)
+        {
+          perror (argv[optind + 2]);
+          exit (-1);
+        }
+
+      resample_check (in, out, num_samples);
+
+      clm_close (out);
+    }
+
+
+  clm_close (in);
+
+  return (0);
+}
@@ -0,0 +1,209 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#include <algorithm>
+
+#include "runs.hpp"
+
+
+/*!
+  - Run-length form of a block (see runs.hpp).  A one second block is 1.6 MB of packed bits, its runs are usually
+    a small fraction of that since most rows only cross a few coastlines.  Blocks whose runs wouldn't be smaller
+    than the packed bits (very fragmented coastlines) are kept as packed bits so the run form is never bigger.
+*/
+
+
+
+/*!
+  - Encode the packed block in bits.  Returns the run form (malloc'ed, free it when done) and sets *size to its
+    size in bytes.  Returns NULL if it can't be allocated.
+*/
+
+uint8_t *clm_runs_encode (CLM_FILE *clm, uint8_t *bits, int32_t *size)
+{
+  int32_t pc = clm->point_count;
+  uint64_t words[CLM_MAX_ROW_WORDS];
+
+
+  //  Count the changes first so that the buffer can be allocated at its final size.
+
+  int64_t count = 0;
+
+  for (int32_t row = 0 ; row < pc ; row++)
+    {
+      clm_get_row (clm, bits, row, words);
+
+      for (int32_t col = 0, value = 1 ; (col = clm_next_bit (words, pc, col, value)) < pc ; value ^= 1) count++;
+    }
+
+  int64_t run_size = 4 + (int64_t) (pc + 1) * 4 + count * 2;
+
+
+  uint8_t *runs;
+
+  if (run_size >= 4 + (int64_t) clm->bit_size)
+    {
+      *size = 4 + clm->bit_size;
+
+      if ((runs = (uint8_t *) malloc (*size)) == NULL) return (NULL);
+
+      uint32_t raw = CLM_RUNS_RAW;
+      memcpy (runs, &raw, 4);
+      memcpy (runs + 4, bits, clm->bit_size);
+
+      return (runs);
+    }
+
+
+  *size = (int32_t) run_size;
+
+  if ((runs = (uint8_t *) malloc (*size)) == NULL) return (NULL);
+
+  uint32_t *start = (uint32_t *) (runs + 4);
+  uint16_t *change = (uint16_t *) (runs + 4 + (pc + 1) * 4);
+  uint32_t n = 0;
+
+  for (int32_t row = 0 ; row < pc ; row++)
+    {
+      clm_get_row (clm, bits, row, words);
+
+      start[row] = n;
+
+      for (int32_t col = 0, value = 1 ; (col = clm_next_bit (words, pc, col, value)) < pc ; value ^= 1)
+        {
+          change[n++] = (uint16_t) col;
+        }
+    }
+
+  start[pc] = n;
+  memcpy (runs, &n, 4);
+
+  return (runs);
+}
+
+
+
+//!  Land (1) or water (0) at row, col.
+
+int32_t clm_runs_value (CLM_FILE *clm, uint8_t *runs, int32_t row, int32_t col)
+{
+  int32_t pc = clm->point_count;
+
+  if (*(uint32_t *) runs == CLM_RUNS_RAW) return (bit_unpack (runs + 4, row * pc + col, 1));
+
+
+  uint32_t *start = (uint32_t *) (runs + 4);
+  uint16_t *change = (uint16_t *) (runs + 4 + (pc + 1) * 4);
+
+  uint16_t *first = change + start[row];
+  uint16_t *last = change + start[row + 1];
+
+  return ((int32_t) ((std::upper_bound (first, last, (uint16_t) col) - first) & 1));
+}
+
+
+
+//!  Expand a row into 64 bit words (as clm_get_row does for packed bits).
+
+void clm_runs_get_row (CLM_FILE *clm, uint8_t *runs, int32_t row, uint64_t *words)
+{
+  int32_t pc = clm->point_count;
+
+  if (*(uint32_t *) runs == CLM_RUNS_RAW)
+    {
+      clm_get_row (clm, runs + 4, row, words);
+      return;
+    }
+
+
+  uint32_t *start = (uint32_t *) (runs + 4);
+  uint16_t *change = (uint16_t *) (runs + 4 + (pc + 1) * 4);
+
+  memset (words, 0, clm->row_words * sizeof (uint64_t));
+
+  for (uint32_t i = start[row] ; i < start[row + 1] ; i += 2)
+    {
+      int32_t end = (i + 1 < start[row + 1]) ? change[i + 1] : pc;
+
+      clm_fill_bits (words, change[i], end, 1);
+    }
+}
+
+
+
+//!  Number of land cells from start through end - 1 of a row (as clm_count_bits does for a row).
+
+int32_t clm_runs_count (CLM_FILE *clm, uint8_t *runs, int32_t row, int32_t start, int32_t end)
+{
+  int32_t pc = clm->point_count;
+
+  if (*(uint32_t *) runs == CLM_RUNS_RAW)
+    {
+      uint64_t words[CLM_MAX_ROW_WORDS];
+
+      clm_get_row (clm, runs + 4, row, words);
+
+      return (clm_count_bits (words, start, end));
+    }
+
+
+  uint32_t *row_start = (uint32_t *) (runs + 4);
+  uint16_t *change = (uint16_t *) (runs + 4 + (pc + 1) * 4);
+
+  uint16_t *first = change + row_start[row];
+  uint16_t *last = change + row_start[row + 1];
+
+
+  //  Changes at or before start tell us what start is, then walk the runs to end.
+
+  uint16_t *next = std::upper_bound (first, last, (uint16_t) start);
+  int32_t land = (int32_t) ((next - first) & 1);
+  int32_t count = 0, pos = start;
+
+  while (pos < end)
+    {
+      int32_t stop = (next < last) ? qMin ((int32_t) *next, end) : end;
+
+      if (land) count += stop - pos;
+
+      pos = stop;
+      land ^= 1;
+      if (next < last) next++;
+    }
+
+  return (count);
+}
@@ -0,0 +1,69 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#ifndef RUNS_H
+#define RUNS_H
+
+
+#include "clm.hpp"
+
+
+//  First word of a block that is kept as packed bits because its runs wouldn't have been any smaller.
+
+#define CLM_RUNS_RAW                 0xffffffff
+
+
+/*!
+  - Run-length form of an uncompressed block for the run-length block cache (clm_cache_create_runs).  Every row
+    is stored as the sorted columns at which the value changes, starting from water at column 0 (so a row that
+    starts with land has a change at column 0).  A cell is land if the number of changes at or before its column
+    is odd, which is a binary search in the row's changes.
+
+    <pre>
+    uint32_t   count                    total number of changes (or CLM_RUNS_RAW, followed by the packed bits)
+    uint32_t   start[point_count + 1]   index of each row's first change (start[point_count] = count)
+    uint16_t   change[count]            change columns, row by row
+    </pre>
+*/
+
+uint8_t *clm_runs_encode (CLM_FILE *clm, uint8_t *bits, int32_t *size);
+int32_t clm_runs_value (CLM_FILE *clm, uint8_t *runs, int32_t row, int32_t col);
+void clm_runs_get_row (CLM_FILE *clm, uint8_t *runs, int32_t row, uint64_t *words);
+int32_t clm_runs_count (CLM_FILE *clm, uint8_t *runs, int32_t row, int32_t start, int32_t end);
+
+
+#endif
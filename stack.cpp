@@ -0,0 +1,363 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+
+#include "stack.hpp"
+
+
+/*!
+  - Build a multi-layer file (see CLM_LAYERS) from several .clm files of the same resolution in one run, or look
+    points up in one.  The threads work through the blocks in parallel, reading the block from each input,
+    interleaving the rows of the layers, and compressing them as one block.
+*/
+
+
+stackThread::stackThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+stackThread::~stackThread ()
+{
+}
+
+
+
+void stackThread::stack (CLM_FILE **in, CLM_LAYERS *out, QAtomicInt *n)
+{
+  QMutexLocker locker (&mutex);
+
+  l_in = in;
+  l_out = out;
+  l_next = n;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+void stackThread::run ()
+{
+  mutex.lock ();
+
+  CLM_FILE **in = l_in;
+  CLM_LAYERS *out = l_out;
+  QAtomicInt *next = l_next;
+
+  mutex.unlock ();
+
+
+  int32_t num_layers = out->num_layers, pc = out->point_count;
+  uint8_t codes[CLM_MAX_LAYERS];
+  uint64_t words[CLM_MAX_ROW_WORDS];
+
+  uint8_t *bits = (uint8_t *) malloc (out->block_size);
+  uint8_t *layer = (uint8_t *) malloc (out->block_size);
+  if (bits == NULL || layer == NULL)
+    {
+      perror ("Allocating memory in stackThread");
+      exit (-1);
+    }
+
+
+  int32_t i;
+  while ((i = next->fetchAndAddOrdered (1)) < CLM_BLOCKS)
+    {
+      int32_t lat = i / 360 - 90;
+      int32_t lon = i % 360 - 180;
+      uint8_t mixed = NVFalse;
+
+
+      if (!(i % 648))
+        {
+          fprintf (stderr, "%03d%% processed\r", i / 648);
+          fflush (stderr);
+        }
+
+
+      //  Each input is read into its own slice of "layer".
+
+      for (int32_t j = 0 ; j < num_layers ; j++)
+        {
+          uint8_t *slice = &layer[j * out->bit_size];
+
+          int32_t code = clm_read_block (in[j], lat, lon, slice);
+          if (code < 0)
+            {
+              fprintf (stderr, "\nError reading block %d %d from %s\n", lat, lon, in[j]->path);
+              exit (-1);
+            }
+
+          if (code == CLM_MIXED)
+            {
+              mixed = NVTrue;
+            }
+          else
+            {
+              clm_fill_block (in[j], slice, code);
+            }
+
+          codes[j] = code;
+        }
+
+
+      //  Interleave the rows of the layers.
+
+      if (mixed)
+        {
+          for (int32_t row = 0 ; row < pc ; row++)
+            {
+              for (int32_t j = 0 ; j < num_layers ; j++)
+                {
+                  clm_get_row (in[j], &layer[j * out->bit_size], row, words);
+                  clm_put_bits (bits, ((int64_t) row * num_layers + j) * pc, pc, words);
+                }
+            }
+        }
+
+      if (clm_layers_write_block (out, lat, lon, codes, bits) < 0)
+        {
+          perror (out->path);
+          exit (-1);
+        }
+    }
+
+
+  free (bits);
+  free (layer);
+}
+
+
+
+static void stack_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask stack [-t NUM_THREADS] OUTPUT INPUT_CLM INPUT_CLM [INPUT_CLM ...]\n");
+  fprintf (stderr, "       swbd_mask stack -q LAYER_FILE [POINT_FILE]\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of compute threads (1 to %d, default 4)\n", CLM_MAX_THREADS);
+  fprintf (stderr, "\t-q = look up LAT LON points (one per line, from POINT_FILE or standard input) in LAYER_FILE\n\n");
+  fprintf (stderr, "The inputs (up to %d, all the same resolution) become layers 0, 1, ... of OUTPUT.\n", CLM_MAX_LAYERS);
+  fprintf (stderr, "Query output is the point followed by 1 (land), 0 (water), or -1 (undefined) for each layer.\n\n");
+  exit (-1);
+}
+
+
+
+/*!
+  - Look points up in a multi-layer file.  The last block that was decoded is kept so runs of points in the same
+    one-degree block only cost one decode for all of the layers.
+*/
+
+static void stack_query (CLM_LAYERS *layers, FILE *fp)
+{
+  char string[1024];
+  uint8_t codes[CLM_MAX_LAYERS];
+  int32_t last = -1, code = CLM_UNDEFINED, pc = layers->point_count;
+  int64_t count = 0, decodes = 0;
+
+
+  uint8_t *bits = (uint8_t *) malloc (layers->block_size);
+  if (bits == NULL)
+    {
+      perror ("Allocating query memory");
+      exit (-1);
+    }
+
+
+  while (fgets (string, sizeof (string), fp) != NULL)
+    {
+      double lat, lon;
+
+      if (sscanf (string, "%lf %lf", &lat, &lon) != 2 || !(lat >= -90.0 && lat <= 90.0 && lon >= -360.0 && lon <= 360.0))
+        {
+          fprintf (stdout, "INVALID\n");
+          continue;
+        }
+
+      if (lon < -180.0) lon += 360.0;
+      if (lon >= 180.0) lon -= 360.0;
+
+      int32_t ilat = (int32_t) floor (lat);
+      int32_t ilon = (int32_t) floor (lon);
+      if (ilat > 89) ilat = 89;
+
+
+      int32_t index = clm_block_index (ilat, ilon);
+
+      if (index != last)
+        {
+          if ((code = clm_layers_read_block (layers, ilat, ilon, codes, bits)) < 0)
+            {
+              fprintf (stderr, "\nError reading block %d %d from %s\n", ilat, ilon, layers->path);
+              exit (-1);
+            }
+
+          last = index;
+          decodes++;
+        }
+
+
+      int32_t row = (int32_t) ((lat - (double) ilat) * (double) pc);
+      int32_t col = (int32_t) ((lon - (double) ilon) * (double) pc);
+      if (row >= pc) row = pc - 1;
+      if (col >= pc) col = pc - 1;
+
+      uint32_t defined;
+      uint32_t land = clm_layers_cell (layers, codes, bits, row, col, &defined);
+
+      fprintf (stdout, "%.9f %.9f", lat, lon);
+
+      for (int32_t i = 0 ; i < layers->num_layers ; i++)
+        fprintf (stdout, " %d", (defined & (1U << i)) ? (int32_t) ((land >> i) & 1) : -1);
+
+      fprintf (stdout, "\n");
+
+      count++;
+    }
+
+
+  free (bits);
+
+  fprintf (stderr, "%lld points, %lld block decodes\n\n", (long long) count, (long long) decodes);
+  fflush (stderr);
+}
+
+
+
+int32_t stack (int32_t argc, char **argv)
+{
+  int32_t           num_threads = 4, query = NVFalse, c;
+  stackThread       stack_thread[CLM_MAX_THREADS];
+
+
+  while ((c = getopt (argc, argv, "qt:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'q':
+          query = NVTrue;
+          break;
+
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          stack_usage ();
+          break;
+        }
+    }
+
+
+  if (query)
+    {
+      if (optind >= argc || optind + 2 < argc) stack_usage ();
+
+      CLM_LAYERS *layers = clm_layers_open (argv[optind]);
+      if (layers == NULL)
+        {
+          perror (argv[optind]);
+          exit (-1);
+        }
+
+      FILE *fp = stdin;
+      if (optind + 1 < argc && (fp = fopen (argv[optind + 1], "r")) == NULL)
+        {
+          perror (argv[optind + 1]);
+          exit (-1);
+        }
+
+      stack_query (layers, fp);
+
+      if (fp != stdin) fclose (fp);
+      clm_layers_close (layers);
+
+      return (0);
+    }
+
+
+  int32_t num_layers = argc - optind - 1;
+
+  if (num_layers < 2 || num_layers > CLM_MAX_LAYERS || num_threads < 1 || num_threads > CLM_MAX_THREADS) stack_usage ();
+
+
+  CLM_FILE *in[CLM_MAX_LAYERS];
+
+  for (int32_t i = 0 ; i < num_layers ; i++)
+    {
+      if ((in[i] = clm_open (argv[optind + 1 + i])) == NULL)
+        {
+          perror (argv[optind + 1 + i]);
+          exit (-1);
+        }
+
+      if (in[i]->resolution != in[0]->resolution)
+        {
+          fprintf (stderr, "\n\n%s is %d second, %s is %d second\n\n", in[i]->path, in[i]->resolution, in[0]->path,
+                   in[0]->resolution);
+          exit (-1);
+        }
+    }
+
+
+  CLM_LAYERS *out = clm_layers_create (argv[optind], in[0]->resolution, num_layers, &argv[optind + 1]);
+  if (out == NULL)
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+
+  QElapsedTimer timer;
+  timer.start ();
+
+  QAtomicInt next (0);
+
+  for (int32_t i = 0 ; i < num_threads ; i++) stack_thread[i].stack (in, out, &next);
+  for (int32_t i = 0 ; i < num_threads ; i++) stack_thread[i].wait ();
+
+
+  clm_layers_close (out);
+  for (int32_t i = 0 ; i < num_layers ; i++) clm_close (in[i]);
+
+
+  fprintf (stderr, "100%% processed, %d layers, %.3f seconds\n\n", num_layers, (double) timer.elapsed () / 1000.0);
+  fflush (stderr);
+
+  return (0);
+}
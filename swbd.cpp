@@ -0,0 +1,866 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "swbd.hpp"
+#include "perf.hpp"
+
+
+/*!
+  - Reading the SWBD shapefiles.  The shapefiles can be uncompressed in the SWBD directory or left in the zip
+    archives that they are distributed in (also in the SWBD directory).  When the source is opened the central
+    directory of every archive is read so finding a cell is just a lookup.  The .shp and .shx members of a cell
+    are inflated into memory on demand (only the seek and read of the compressed bytes is locked, so many threads
+    can inflate at once) and handed to shapelib through SHPOpenLL with hooks that read from memory.  Nothing is
+    ever extracted to disk.  Zip64 archives are supported, encrypted members are not.
+  - swbd_prefetch_start starts reader threads that read cells ahead of the consumer (in the consumer's order) so
+    that the inflating and parsing of the next cells overlaps the rasterization of the current one.
+*/
+
+
+#define ZIP_LOCAL_HEADER             0x04034b50
+#define ZIP_CENTRAL_HEADER           0x02014b50
+#define ZIP_END_OF_DIRECTORY         0x06054b50
+#define ZIP64_END_LOCATOR            0x07064b50
+#define ZIP64_END_OF_DIRECTORY       0x06064b50
+
+
+//!  Little endian fields (zip files are always little endian).
+
+static uint32_t get16 (uint8_t *p)
+{
+  return ((uint32_t) p[0] | ((uint32_t) p[1] << 8));
+}
+
+static uint32_t get32 (uint8_t *p)
+{
+  return (get16 (p) | (get16 (p + 2) << 16));
+}
+
+static uint64_t get64 (uint8_t *p)
+{
+  return ((uint64_t) get32 (p) | ((uint64_t) get32 (p + 4) << 32));
+}
+
+
+
+static int32_t archive_seek (FILE *fp, int64_t offset, int32_t whence)
+{
+#ifdef NVWIN3X
+  return (_fseeki64 (fp, offset, whence));
+#else
+  return (fseeko (fp, (off_t) offset, whence));
+#endif
+}
+
+
+
+static int64_t archive_tell (FILE *fp)
+{
+#ifdef NVWIN3X
+  return (_ftelli64 (fp));
+#else
+  return ((int64_t) ftello (fp));
+#endif
+}
+
+
+
+//!  Lower case name without any directories.
+
+static std::string member_key (const char *name)
+{
+  const char *slash = strrchr (name, '/');
+  const char *back = strrchr (name, '\\');
+
+  if (back > slash) slash = back;
+  if (slash != NULL) name = slash + 1;
+
+  std::string key (name);
+  for (size_t i = 0 ; i < key.size () ; i++) key[i] = tolower (key[i]);
+
+  return (key);
+}
+
+
+
+/*!
+  - Add the .shp and .shx members of the archive to the index.  Returns NVFalse if the archive can't be read.
+*/
+
+static int32_t index_archive (SWBD_SOURCE *source, int32_t a)
+{
+  FILE *fp = source->archive[a].fp;
+  uint8_t tail[65536 + 22];
+
+
+  //  The end of central directory record is in the last 64K + 22 bytes (it ends with a comment of up to 64K).
+
+  if (archive_seek (fp, 0, SEEK_END)) return (NVFalse);
+
+  int64_t file_size = archive_tell (fp);
+  int64_t tail_size = qMin (file_size, (int64_t) sizeof (tail));
+
+  if (tail_size < 22 || archive_seek (fp, file_size - tail_size, SEEK_SET) || fread (tail, tail_size, 1, fp) != 1) return (NVFalse);
+
+  int64_t end = -1;
+  for (int64_t i = tail_size - 22 ; i >= 0 ; i--)
+    {
+      if (get32 (&tail[i]) == ZIP_END_OF_DIRECTORY)
+        {
+          end = i;
+          break;
+        }
+    }
+
+  if (end < 0) return (NVFalse);
+
+  int64_t entries = get16 (&tail[end + 10]);
+  int64_t directory_size = get32 (&tail[end + 12]);
+  int64_t directory_offset = get32 (&tail[end + 16]);
+
+
+  //  Zip64 (the locator is just before the end of central directory record).
+
+  if ((entries == 0xffff || directory_size == 0xffffffff || directory_offset == 0xffffffff) && end >= 20 &&
+      get32 (&tail[end - 20]) == ZIP64_END_LOCATOR)
+    {
+      uint8_t record[56];
+
+      if (archive_seek (fp, (int64_t) get64 (&tail[end - 20 + 8]), SEEK_SET) || fread (record, 56, 1, fp) != 1 ||
+          get32 (record) != ZIP64_END_OF_DIRECTORY) return (NVFalse);
+
+      entries = (int64_t) get64 (&record[32]);
+      directory_size = (int64_t) get64 (&record[40]);
+      directory_offset = (int64_t) get64 (&record[48]);
+    }
+
+
+  uint8_t *directory = (uint8_t *) malloc (qMax ((int64_t) 1, directory_size));
+  if (directory == NULL)
+    {
+      perror ("Allocating zip directory memory");
+      exit (-1);
+    }
+
+  if (archive_seek (fp, directory_offset, SEEK_SET) || (directory_size && fread (directory, directory_size, 1, fp) != 1))
+    {
+      free (directory);
+      return (NVFalse);
+    }
+
+
+  int64_t pos = 0;
+  for (int64_t i = 0 ; i < entries && pos + 46 <= directory_size ; i++)
+    {
+      uint8_t *entry = &directory[pos];
+
+      if (get32 (entry) != ZIP_CENTRAL_HEADER) break;
+
+      int32_t name_length = get16 (&entry[28]);
+      int32_t extra_length = get16 (&entry[30]);
+      int32_t comment_length = get16 (&entry[32]);
+
+      if (pos + 46 + name_length + extra_length > directory_size) break;
+
+
+      SWBD_MEMBER member;
+      member.archive = a;
+      member.method = get16 (&entry[10]);
+      member.compressed_size = get32 (&entry[20]);
+      member.size = get32 (&entry[24]);
+      member.offset = get32 (&entry[42]);
+
+
+      //  Zip64 extended information (only the fields that overflowed are there, in this order).
+
+      uint8_t *extra = &entry[46 + name_length];
+      for (int32_t e = 0 ; e + 4 <= extra_length ; )
+        {
+          int32_t id = get16 (&extra[e]), length = get16 (&extra[e + 2]);
+
+          if (id == 1)
+            {
+              int32_t f = e + 4;
+
+              if (member.size == 0xffffffff && f + 8 <= e + 4 + length) member.size = (int64_t) get64 (&extra[f]), f += 8;
+              if (member.compressed_size == 0xffffffff && f + 8 <= e + 4 + length) member.compressed_size = (int64_t) get64 (&extra[f]), f += 8;
+              if (member.offset == 0xffffffff && f + 8 <= e + 4 + length) member.offset = (int64_t) get64 (&extra[f]);
+            }
+
+          e += 4 + length;
+        }
+
+
+      std::string key = member_key (std::string ((char *) &entry[46], name_length).c_str ());
+
+      if (key.size () > 4 && (key.compare (key.size () - 4, 4, ".shp") == 0 || key.compare (key.size () - 4, 4, ".shx") == 0) &&
+          !(get16 (&entry[8]) & 1) && (member.method == 0 || member.method == 8) && !source->members.count (key))
+        source->members[key] = member;
+
+      pos += 46 + name_length + extra_length + comment_length;
+    }
+
+
+  free (directory);
+
+  return (NVTrue);
+}
+
+
+
+/*!
+  - Open the SWBD source in dirname (the ABE_DATA directory) and index any zip archives in dirname/SWBD.
+*/
+
+SWBD_SOURCE *swbd_open (const char *dirname)
+{
+  char              swbd_dir[1024];
+
+
+  SWBD_SOURCE *source = new SWBD_SOURCE;
+
+  strcpy (source->dirname, dirname);
+  source->num_archives = 0;
+  source->archive = NULL;
+
+  sprintf (swbd_dir, "%s%1cSWBD", dirname, (char) SEPARATOR);
+
+
+  QDir dir (swbd_dir);
+  QStringList zips = dir.entryList (QStringList ("*.zip"), QDir::Files, QDir::Name);
+
+  if (zips.size ())
+    {
+      source->archive = new SWBD_ARCHIVE[zips.size ()];
+
+      for (int32_t i = 0 ; i < (int32_t) zips.size () ; i++)
+        {
+          SWBD_ARCHIVE *archive = &source->archive[source->num_archives];
+
+          sprintf (archive->path, "%s%1c%s", swbd_dir, (char) SEPARATOR, zips.at (i).toLatin1 ().constData ());
+
+          if ((archive->fp = fopen (archive->path, "rb")) == NULL)
+            {
+              perror (archive->path);
+              exit (-1);
+            }
+
+          if (!index_archive (source, source->num_archives))
+            {
+              fprintf (stderr, "\n\nUnable to read the zip directory of %s\n\n", archive->path);
+              exit (-1);
+            }
+
+          source->num_archives++;
+        }
+
+      fprintf (stderr, "Indexed %d zip archives, %d shapefile members\n", source->num_archives, (int32_t) source->members.size ());
+      fflush (stderr);
+    }
+
+  return (source);
+}
+
+
+
+void swbd_close (SWBD_SOURCE *source)
+{
+  if (source == NULL) return;
+
+  for (int32_t i = 0 ; i < source->num_archives ; i++) fclose (source->archive[i].fp);
+
+  delete[] source->archive;
+  delete source;
+}
+
+
+
+/*!
+  - Read (and inflate) a zip member.  Returns a malloc'd buffer or NULL.
+*/
+
+static uint8_t *read_member (SWBD_SOURCE *source, SWBD_MEMBER *member)
+{
+  SWBD_ARCHIVE *archive = &source->archive[member->archive];
+  uint8_t header[30];
+
+
+  uint8_t *compressed = (uint8_t *) malloc (qMax ((int64_t) 1, member->compressed_size));
+  if (compressed == NULL)
+    {
+      perror ("Allocating zip member memory");
+      exit (-1);
+    }
+
+  archive->mutex.lock ();
+
+  int32_t ok = (!archive_seek (archive->fp, member->offset, SEEK_SET) && fread (header, 30, 1, archive->fp) == 1 &&
+                get32 (header) == ZIP_LOCAL_HEADER &&
+                !archive_seek (archive->fp, member->offset + 30 + get16 (&header[26]) + get16 (&header[28]), SEEK_SET) &&
+                (!member->compressed_size || fread (compressed, member->compressed_size, 1, archive->fp) == 1));
+
+  archive->mutex.unlock ();
+
+  if (!ok)
+    {
+      free (compressed);
+      return (NULL);
+    }
+
+  if (member->method == 0) return (compressed);
+
+
+  //  Raw deflate.
+
+  uint8_t *data = (uint8_t *) malloc (qMax ((int64_t) 1, member->size));
+  if (data == NULL)
+    {
+      perror ("Allocating zip member memory");
+      exit (-1);
+    }
+
+  z_stream stream;
+  memset (&stream, 0, sizeof (z_stream));
+
+  if (inflateInit2 (&stream, -MAX_WBITS) != Z_OK)
+    {
+      free (compressed);
+      free (data);
+      return (NULL);
+    }
+
+  stream.next_in = compressed;
+  stream.avail_in = (uInt) member->compressed_size;
+  stream.next_out = data;
+  stream.avail_out = (uInt) member->size;
+
+  int32_t status = inflate (&stream, Z_FINISH);
+  ok = (status == Z_STREAM_END && (int64_t) stream.total_out == member->size);
+
+  inflateEnd (&stream);
+  free (compressed);
+
+  if (!ok)
+    {
+      free (data);
+      return (NULL);
+    }
+
+  return (data);
+}
+
+
+
+/*
+  - In memory files for SHPOpenLL.  Inflated members are registered under a name (lower case) and the hooks
+    open them from there.
+*/
+
+typedef struct
+{
+  uint8_t          *data;
+  int64_t          size;
+} SWBD_MEMORY;
+
+typedef struct
+{
+  uint8_t          *data;
+  int64_t          size, pos;
+} SWBD_MEMORY_FILE;
+
+
+static std::map<std::string, SWBD_MEMORY> memory_files;
+static QMutex memory_mutex;
+
+
+static SAFile memory_open (const char *filename, const char *access)
+{
+  if (strchr (access, 'w') || strchr (access, 'a') || strchr (access, '+')) return (NULL);
+
+  std::string key (filename);
+  for (size_t i = 0 ; i < key.size () ; i++) key[i] = tolower (key[i]);
+
+  QMutexLocker locker (&memory_mutex);
+
+  std::map<std::string, SWBD_MEMORY>::iterator it = memory_files.find (key);
+  if (it == memory_files.end ()) return (NULL);
+
+  SWBD_MEMORY_FILE *file = (SWBD_MEMORY_FILE *) malloc (sizeof (SWBD_MEMORY_FILE));
+  if (file == NULL) return (NULL);
+
+  file->data = it->second.data;
+  file->size = it->second.size;
+  file->pos = 0;
+
+  return ((SAFile) file);
+}
+
+static SAOffset memory_read (void *p, SAOffset size, SAOffset nmemb, SAFile handle)
+{
+  SWBD_MEMORY_FILE *file = (SWBD_MEMORY_FILE *) handle;
+
+  if (!size || file->pos >= file->size) return (0);
+
+  SAOffset count = qMin (nmemb, (SAOffset) ((file->size - file->pos) / (int64_t) size));
+
+  memcpy (p, &file->data[file->pos], count * size);
+  file->pos += count * size;
+
+  return (count);
+}
+
+static SAOffset memory_write (void *, SAOffset, SAOffset, SAFile)
+{
+  return (0);
+}
+
+static SAOffset memory_seek (SAFile handle, SAOffset offset, int whence)
+{
+  SWBD_MEMORY_FILE *file = (SWBD_MEMORY_FILE *) handle;
+  int64_t pos = (whence == SEEK_SET) ? 0 : ((whence == SEEK_CUR) ? file->pos : file->size);
+
+  pos += (int64_t) offset;
+  if (pos < 0) return ((SAOffset) -1);
+
+  file->pos = pos;
+
+  return (0);
+}
+
+static SAOffset memory_tell (SAFile handle)
+{
+  return ((SAOffset) ((SWBD_MEMORY_FILE *) handle)->pos);
+}
+
+static int memory_flush (SAFile)
+{
+  return (0);
+}
+
+static int memory_close (SAFile handle)
+{
+  free (handle);
+
+  return (0);
+}
+
+
+
+/*!
+  - Find the SWBD shapefile for the one-degree cell with its southwest corner at lat, lon.  The name is placed in
+    shpname (at least 512 characters).  For a zipped shapefile the name is the archive name followed by the
+    member name.  Returns NVFalse if there isn't one.
+*/
+
+int32_t swbd_find_cell (SWBD_SOURCE *source, int32_t lat, int32_t lon, char *shpname)
+{
+  char              name[32], lathem, lonhem, dataset[7] = {'a', 'e', 'f', 'i', 'n', 's', 'x'};
+  FILE              *tfp;
+
+
+  lathem = (lat < 0) ? 's' : 'n';
+  lonhem = (lon < 0) ? 'w' : 'e';
+
+
+  //  Same order (and the same six datasets) as the main program always used.
+
+  for (int32_t ds = 0 ; ds < 6 ; ds++)
+    {
+      sprintf (name, "%1c%03d%1c%02d%1c.shp", lonhem, abs (lon), lathem, abs (lat), dataset[ds]);
+
+      std::map<std::string, SWBD_MEMBER>::iterator it = source->members.find (std::string (name));
+      if (it != source->members.end ())
+        {
+          sprintf (shpname, "%s%1c%s", source->archive[it->second.archive].path, (char) SEPARATOR, name);
+          return (NVTrue);
+        }
+
+      sprintf (shpname, "%s%1cSWBD%1c%s", source->dirname, (char) SEPARATOR, (char) SEPARATOR, name);
+
+      if ((tfp = fopen (shpname, "rb")) != NULL)
+        {
+          fclose (tfp);
+          return (NVTrue);
+        }
+    }
+
+  return (NVFalse);
+}
+
+
+
+//!  Read all of the rings of all of the shapes in an open shapefile into cell.
+
+static void read_shapes (SWBD_CELL *cell, SHPHandle shpHandle)
+{
+  int32_t           type, numShapes;
+  double            minBounds[4], maxBounds[4];
+
+
+  SHPGetInfo (shpHandle, &numShapes, &type, minBounds, maxBounds);
+
+  cell->min_x = cell->min_y = 999.0;
+  cell->max_x = cell->max_y = -999.0;
+
+
+  for (int32_t i = 0 ; i < numShapes ; i++)
+    {
+      SHPObject *shape = SHPReadObject (shpHandle, i);
+      if (shape == NULL) continue;
+
+      if (shape->nVertices >= 2)
+        {
+          int32_t parts = qMax (1, shape->nParts);
+
+          cell->poly_count = (int32_t *) realloc (cell->poly_count, (cell->num_poly + parts) * sizeof (int32_t));
+          cell->poly_x = (double **) realloc (cell->poly_x, (cell->num_poly + parts) * sizeof (double *));
+          cell->poly_y = (double **) realloc (cell->poly_y, (cell->num_poly + parts) * sizeof (double *));
+          if (cell->poly_count == NULL || cell->poly_x == NULL || cell->poly_y == NULL)
+            {
+              perror ("Allocating polygon memory");
+              exit (-1);
+            }
+
+          for (int32_t j = 0 ; j < parts ; j++)
+            {
+              int32_t start = shape->nParts ? shape->panPartStart[j] : 0;
+              int32_t end = (j + 1 < shape->nParts) ? shape->panPartStart[j + 1] : shape->nVertices;
+              int32_t k = cell->num_poly;
+
+              cell->poly_count[k] = end - start;
+              cell->poly_x[k] = (double *) malloc (qMax (1, end - start) * sizeof (double));
+              cell->poly_y[k] = (double *) malloc (qMax (1, end - start) * sizeof (double));
+              if (cell->poly_x[k] == NULL || cell->poly_y[k] == NULL)
+                {
+                  perror ("Allocating polygon memory");
+                  exit (-1);
+                }
+
+              memcpy (cell->poly_x[k], &shape->padfX[start], (end - start) * sizeof (double));
+              memcpy (cell->poly_y[k], &shape->padfY[start], (end - start) * sizeof (double));
+
+              for (int32_t m = start ; m < end ; m++)
+                {
+                  cell->min_x = qMin (cell->min_x, shape->padfX[m]);
+                  cell->max_x = qMax (cell->max_x, shape->padfX[m]);
+                  cell->min_y = qMin (cell->min_y, shape->padfY[m]);
+                  cell->max_y = qMax (cell->max_y, shape->padfY[m]);
+                }
+
+              cell->num_poly++;
+            }
+        }
+
+      SHPDestroyObject (shape);
+    }
+}
+
+
+
+/*!
+  - Read all of the rings in the SWBD shapefile for the one-degree cell at lat, lon.  Returns NULL if there is
+    no shapefile for the cell.  Free the result with swbd_free_cell.
+*/
+
+SWBD_CELL *swbd_read_cell (SWBD_SOURCE *source, int32_t lat, int32_t lon)
+{
+  SWBD_CELL *cell = (SWBD_CELL *) calloc (1, sizeof (SWBD_CELL));
+  if (cell == NULL)
+    {
+      perror ("Allocating SWBD cell memory");
+      exit (-1);
+    }
+
+  if (!swbd_find_cell (source, lat, lon, cell->path))
+    {
+      free (cell);
+      return (NULL);
+    }
+
+
+  std::string shp_key = member_key (cell->path);
+
+  std::map<std::string, SWBD_MEMBER>::iterator shp = source->members.find (shp_key);
+
+
+  //  Uncompressed shapefile.
+
+  if (shp == source->members.end ())
+    {
+      SHPHandle shpHandle = SHPOpen (cell->path, "rb");
+      if (shpHandle == NULL)
+        {
+          perror (cell->path);
+          exit (-1);
+        }
+
+      read_shapes (cell, shpHandle);
+
+      SHPClose (shpHandle);
+
+      return (cell);
+    }
+
+
+  //  Zipped shapefile.  Inflate the .shp and .shx members and open them from memory.
+
+  std::string shx_key = shp_key.substr (0, shp_key.size () - 4) + ".shx";
+  std::map<std::string, SWBD_MEMBER>::iterator shx = source->members.find (shx_key);
+
+  uint8_t *shp_data = read_member (source, &shp->second);
+  uint8_t *shx_data = (shx == source->members.end ()) ? NULL : read_member (source, &shx->second);
+
+  if (shp_data == NULL || shx_data == NULL)
+    {
+      fprintf (stderr, "\n\nUnable to read %s (and its .shx) from %s\n\n", shp_key.c_str (), source->archive[shp->second.archive].path);
+      exit (-1);
+    }
+
+
+  std::string name (cell->path);
+  for (size_t i = 0 ; i < name.size () ; i++) name[i] = tolower (name[i]);
+
+  std::string base = name.substr (0, name.size () - 4);
+
+  SWBD_MEMORY shp_memory = {shp_data, shp->second.size};
+  SWBD_MEMORY shx_memory = {shx_data, shx->second.size};
+
+  memory_mutex.lock ();
+  memory_files[base + ".shp"] = shp_memory;
+  memory_files[base + ".shx"] = shx_memory;
+  memory_mutex.unlock ();
+
+
+  //  Start from the defaults so that any hooks that newer versions of shapelib add are set, then replace the ones
+  //  that take our file handles.
+
+  SAHooks hooks;
+  SASetupDefaultHooks (&hooks);
+  hooks.FOpen = memory_open;
+  hooks.FRead = memory_read;
+  hooks.FWrite = memory_write;
+  hooks.FSeek = memory_seek;
+  hooks.FTell = memory_tell;
+  hooks.FFlush = memory_flush;
+  hooks.FClose = memory_close;
+
+  SHPHandle shpHandle = SHPOpenLL (cell->path, "rb", &hooks);
+  if (shpHandle == NULL)
+    {
+      fprintf (stderr, "\n\nUnable to open %s\n\n", cell->path);
+      exit (-1);
+    }
+
+  read_shapes (cell, shpHandle);
+
+  SHPClose (shpHandle);
+
+
+  memory_mutex.lock ();
+  memory_files.erase (base + ".shp");
+  memory_files.erase (base + ".shx");
+  memory_mutex.unlock ();
+
+  free (shp_data);
+  free (shx_data);
+
+  return (cell);
+}
+
+
+
+void swbd_free_cell (SWBD_CELL *cell)
+{
+  if (cell == NULL) return;
+
+  for (int32_t i = 0 ; i < cell->num_poly ; i++)
+    {
+      free (cell->poly_x[i]);
+      free (cell->poly_y[i]);
+    }
+
+  free (cell->poly_count);
+  free (cell->poly_x);
+  free (cell->poly_y);
+  free (cell);
+}
+
+
+
+swbdReadThread::swbdReadThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+swbdReadThread::~swbdReadThread ()
+{
+}
+
+
+
+void swbdReadThread::read (SWBD_PREFETCH *p)
+{
+  QMutexLocker locker (&mutex);
+
+  l_prefetch = p;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+void swbdReadThread::run ()
+{
+  mutex.lock ();
+
+  SWBD_PREFETCH *prefetch = l_prefetch;
+
+  mutex.unlock ();
+
+
+  CLM_PERF perf;
+  clm_perf_open (&perf);
+
+
+  int32_t i;
+  while ((i = prefetch->next.fetchAndAddOrdered (1)) < prefetch->num_cells)
+    {
+      //  Don't get more than window cells ahead of the consumer.
+
+      prefetch->mutex.lock ();
+      while (i >= prefetch->consumed + prefetch->window) prefetch->space.wait (&prefetch->mutex);
+      prefetch->mutex.unlock ();
+
+
+      int32_t lat = prefetch->cell[i] / 360 - 90;
+      int32_t lon = prefetch->cell[i] % 360 - 180;
+
+      clm_perf_begin (&perf);
+
+      SWBD_CELL *cell = swbd_read_cell (prefetch->source, lat, lon);
+
+      clm_perf_end (&perf, CLM_PERF_INGEST, 0);
+
+
+      prefetch->mutex.lock ();
+      prefetch->result[i] = cell;
+      prefetch->ready[i] = NVTrue;
+      prefetch->done.wakeAll ();
+      prefetch->mutex.unlock ();
+    }
+
+  clm_perf_close (&perf);
+}
+
+
+
+/*!
+  - Start num_threads reader threads on the num_cells cells in cell (block indices, in the order they will be
+    asked for).
+*/
+
+SWBD_PREFETCH *swbd_prefetch_start (SWBD_SOURCE *source, int32_t num_cells, int32_t *cell, int32_t num_threads, int32_t window)
+{
+  SWBD_PREFETCH *prefetch = new SWBD_PREFETCH;
+
+  prefetch->source = source;
+  prefetch->num_cells = num_cells;
+  prefetch->cell = cell;
+  prefetch->window = qMax (1, window);
+  prefetch->consumed = 0;
+  prefetch->num_threads = qMax (1, num_threads);
+  prefetch->result = (SWBD_CELL **) calloc (qMax (1, num_cells), sizeof (SWBD_CELL *));
+  prefetch->ready = (uint8_t *) calloc (qMax (1, num_cells), sizeof (uint8_t));
+
+  if (prefetch->result == NULL || prefetch->ready == NULL)
+    {
+      perror ("Allocating prefetch memory");
+      exit (-1);
+    }
+
+  prefetch->thread = new swbdReadThread[prefetch->num_threads];
+
+  for (int32_t i = 0 ; i < prefetch->num_threads ; i++) prefetch->thread[i].read (prefetch);
+
+  return (prefetch);
+}
+
+
+
+/*!
+  - Wait for cell i (they must be asked for in order) and return it (NULL if there is no shapefile for it).  The
+    caller frees it with swbd_free_cell.
+*/
+
+SWBD_CELL *swbd_prefetch_get (SWBD_PREFETCH *prefetch, int32_t i)
+{
+  QMutexLocker locker (&prefetch->mutex);
+
+  while (!prefetch->ready[i]) prefetch->done.wait (&prefetch->mutex);
+
+  SWBD_CELL *cell = prefetch->result[i];
+  prefetch->result[i] = NULL;
+
+  prefetch->consumed = i + 1;
+  prefetch->space.wakeAll ();
+
+  return (cell);
+}
+
+
+
+void swbd_prefetch_stop (SWBD_PREFETCH *prefetch)
+{
+  //  Stop handing out cells and let any waiting threads go.
+
+  prefetch->next.fetchAndStoreOrdered (prefetch->num_cells);
+
+  prefetch->mutex.lock ();
+  prefetch->consumed = prefetch->num_cells;
+  prefetch->space.wakeAll ();
+  prefetch->mutex.unlock ();
+
+  for (int32_t i = 0 ; i < prefetch->num_threads ; i++) prefetch->thread[i].wait ();
+
+  for (int32_t i = 0 ; i < prefetch->num_cells ; i++) swbd_free_cell (prefetch->result[i]);
+
+  delete[] prefetch->thread;
+  free (prefetch->result);
+  free (prefetch->ready);
+  delete prefetch;
+}
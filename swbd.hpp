@@ -0,0 +1,172 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef SWBD_H
+#define SWBD_H
+
+
+#include "clm.hpp"
+#include "shapefil.h"
+
+#include <map>
+#include <string>
+
+
+//  Default number of reader threads and how many cells they may get ahead of the consumer.
+
+#define SWBD_READ_THREADS            4
+#define SWBD_READ_WINDOW             32
+
+
+/*!
+  - All of the rings from the SWBD shapefile for one one-degree cell.  SWBD polygons are water and, like the
+    main program (maskThread), the rings are treated as one even-odd polygon set.
+*/
+
+typedef struct
+{
+  char             path[512];               //!<  Shapefile name (archive/member for zipped shapefiles)
+  int32_t          num_poly;
+  int32_t          *poly_count;
+  double           **poly_x, **poly_y;
+  double           min_x, min_y, max_x, max_y;
+} SWBD_CELL;
+
+
+//!  One zip archive in the SWBD directory.
+
+typedef struct
+{
+  char             path[512];
+  FILE             *fp;
+  QMutex           mutex;                   //!<  Serializes seeking and reading (inflating is done outside)
+} SWBD_ARCHIVE;
+
+
+//!  One member of a zip archive (from the central directory).
+
+typedef struct
+{
+  int32_t          archive;
+  int32_t          method;                  //!<  0 (stored) or 8 (deflated)
+  int64_t          offset;                  //!<  Offset of the local file header
+  int64_t          compressed_size, size;
+} SWBD_MEMBER;
+
+
+/*!
+  - Where the SWBD shapefiles come from.  Every *.zip file in the SWBD directory is indexed (central directory
+    only) when the source is opened.  A shapefile that is a member of an archive is used from there, otherwise
+    the uncompressed file in the SWBD directory is used.
+*/
+
+typedef struct
+{
+  char             dirname[512];            //!<  ABE_DATA directory
+  int32_t          num_archives;
+  SWBD_ARCHIVE     *archive;
+  std::map<std::string, SWBD_MEMBER> members;  //!<  Keyed by the lower case member name without directories
+} SWBD_SOURCE;
+
+
+SWBD_SOURCE *swbd_open (const char *dirname);
+void swbd_close (SWBD_SOURCE *source);
+int32_t swbd_find_cell (SWBD_SOURCE *source, int32_t lat, int32_t lon, char *shpname);
+SWBD_CELL *swbd_read_cell (SWBD_SOURCE *source, int32_t lat, int32_t lon);
+void swbd_free_cell (SWBD_CELL *cell);
+
+
+class swbdReadThread;
+
+
+/*!
+  - Cells read ahead (in order) by reader threads.  The threads inflate and parse the shapefiles for up to
+    window cells past the last one the consumer has taken.
+*/
+
+typedef struct
+{
+  SWBD_SOURCE      *source;
+  int32_t          num_cells;
+  int32_t          *cell;                   //!<  Block index (see clm_block_index) of each cell, in order
+  SWBD_CELL        **result;
+  uint8_t          *ready;
+  int32_t          window, consumed, num_threads;
+  QAtomicInt       next;
+  QMutex           mutex;
+  QWaitCondition   done, space;
+  swbdReadThread   *thread;
+} SWBD_PREFETCH;
+
+
+SWBD_PREFETCH *swbd_prefetch_start (SWBD_SOURCE *source, int32_t num_cells, int32_t *cell, int32_t num_threads, int32_t window);
+SWBD_CELL *swbd_prefetch_get (SWBD_PREFETCH *prefetch, int32_t i);
+void swbd_prefetch_stop (SWBD_PREFETCH *prefetch);
+
+
+class swbdReadThread:public QThread
+{
+  Q_OBJECT 
+
+
+public:
+
+  swbdReadThread (QObject *parent = 0);
+  ~swbdReadThread ();
+
+  void read (SWBD_PREFETCH *p = NULL);
+
+
+signals:
+
+
+protected:
+
+
+  QMutex           mutex;
+
+  SWBD_PREFETCH    *l_prefetch;
+
+
+  void             run ();
+
+
+protected slots:
+
+private:
+};
+
+#endif
@@ -16,5 +16,5 @@ DEPENDPATH += .
 INCLUDEPATH += .
 
 # Input
-HEADERS += maskThread.hpp version.h
-SOURCES += main.cpp maskThread.cpp
+HEADERS += async.hpp cache.hpp calibrate.hpp classify.hpp clm.hpp combine.hpp compact.hpp components.hpp crossing.hpp daemon.hpp decode.hpp distance.hpp edgefile.hpp edges.hpp engine.hpp exact.hpp extract.hpp fill.hpp gdalbench.hpp layers.hpp maskThread.hpp morph.hpp overlay.hpp patch.hpp perf.hpp resample.hpp runs.hpp stack.hpp swbd.hpp tiles.hpp transcode.hpp vectorize.hpp version.h zonal.hpp
+SOURCES += async.cpp cache.cpp calibrate.cpp classify.cpp clm.cpp combine.cpp compact.cpp components.cpp crossing.cpp daemon.cpp decode.cpp distance.cpp edgefile.cpp edges.cpp engine.cpp exact.cpp extract.cpp fill.cpp gdalbench.cpp layers.cpp main.cpp maskThread.cpp morph.cpp overlay.cpp patch.cpp perf.cpp resample.cpp runs.cpp stack.cpp swbd.cpp tiles.cpp transcode.cpp vectorize.cpp zonal.cpp
@@ -0,0 +1,673 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "tiles.hpp"
+
+#ifndef NVWIN3X
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#endif
+
+
+/*!
+  - Local HTTP tile server for looking at a .clm file in a web map (XYZ tiles in the Web Mercator projection,
+    which is what Leaflet, OpenLayers, and QGIS "XYZ Tiles" use).  Tiles are rendered when they are asked for.
+    Each pixel row is a single latitude, so for each block that the row passes through we pull the one mask row
+    out of the block (clm_get_row) and expand its bits to pixels.  Only the blocks that a tile touches are
+    uncompressed (through the shared block cache).  Encoded tiles are kept in a memory cache (least recently used
+    are dropped first) and, optionally, written to a disk cache so they survive restarts.  The disk cache is in a
+    directory named for the .clm file and its modification time so a rebuilt mask doesn't show stale tiles.
+
+    <pre>
+    GET /Z/X/Y.png        256 by 256 PNG (land, water, and transparent for undefined)
+    GET /Z/X/Y.bits       8192 bytes, one bit per pixel (1 is land), north row first, most significant bit first
+    GET /                 a Leaflet page showing the tiles over OpenStreetMap
+    </pre>
+*/
+
+
+static const char *tile_index =
+  "<!DOCTYPE html>\n"
+  "<html><head><title>swbd_mask</title>\n"
+  "<link rel=\"stylesheet\" href=\"https://unpkg.com/leaflet@1.9.4/dist/leaflet.css\"/>\n"
+  "<script src=\"https://unpkg.com/leaflet@1.9.4/dist/leaflet.js\"></script>\n"
+  "<style>html, body, #map {height: 100%; margin: 0;}</style></head>\n"
+  "<body><div id=\"map\"></div><script>\n"
+  "var map = L.map ('map').setView ([0, 0], 2);\n"
+  "var osm = L.tileLayer ('https://tile.openstreetmap.org/{z}/{x}/{y}.png', {maxZoom: 19}).addTo (map);\n"
+  "var mask = L.tileLayer ('/{z}/{x}/{y}.png', {maxZoom: 22, opacity: 0.6}).addTo (map);\n"
+  "L.control.layers (null, {'OpenStreetMap': osm, 'Mask': mask}).addTo (map);\n"
+  "</script></body></html>\n";
+
+
+
+/*!
+  - Render tile z, x, y into TILE_SIZE * TILE_SIZE pixels (TILE_UNDEFINED, TILE_LAND, or TILE_WATER), north row
+    first.  Each pixel is the mask cell under its center.
+*/
+
+void tile_render (CLM_CACHE *cache, int32_t z, int32_t x, int32_t y, uint8_t *pixels)
+{
+  int32_t pc = cache->clm->point_count;
+  double n = (double) (1 << z);
+  uint64_t words[CLM_MAX_ROW_WORDS];
+  double lon[TILE_SIZE];
+
+
+  for (int32_t i = 0 ; i < TILE_SIZE ; i++)
+    lon[i] = ((double) x + ((double) i + 0.5) / (double) TILE_SIZE) / n * 360.0 - 180.0;
+
+
+  for (int32_t j = 0 ; j < TILE_SIZE ; j++)
+    {
+      uint8_t *pixel = &pixels[j * TILE_SIZE];
+
+      double lat = atan (sinh (M_PI * (1.0 - 2.0 * ((double) y + ((double) j + 0.5) / (double) TILE_SIZE) / n))) *
+        NV_RAD_TO_DEG;
+
+      int32_t ilat = qMin (89, (int32_t) floor (lat));
+      int32_t row = qMin (pc - 1, (int32_t) ((lat - (double) ilat) * (double) pc));
+
+
+      //  Walk across the row a block at a time.
+
+      int32_t i = 0;
+      while (i < TILE_SIZE)
+        {
+          int32_t ilon = qMin (179, (int32_t) floor (lon[i]));
+          int32_t end = i;
+          while (end < TILE_SIZE && qMin (179, (int32_t) floor (lon[end])) == ilon) end++;
+
+          uint8_t *bits;
+          int32_t code = clm_cache_get (cache, ilat, ilon, &bits);
+
+          switch (code)
+            {
+            case CLM_UNDEFINED:
+              memset (&pixel[i], TILE_UNDEFINED, end - i);
+              break;
+
+            case CLM_ALL_LAND:
+              memset (&pixel[i], TILE_LAND, end - i);
+              break;
+
+            case CLM_ALL_WATER:
+              memset (&pixel[i], TILE_WATER, end - i);
+              break;
+
+            default:
+              clm_get_row (cache->clm, bits, row, words);
+              clm_cache_release (cache, ilat, ilon);
+
+              for (int32_t k = i ; k < end ; k++)
+                {
+                  int32_t col = qMin (pc - 1, (int32_t) ((lon[k] - (double) ilon) * (double) pc));
+
+                  pixel[k] = ((words[col >> 6] >> (63 - (col & 63))) & 1) ? TILE_LAND : TILE_WATER;
+                }
+              break;
+            }
+
+          i = end;
+        }
+    }
+}
+
+
+
+static void png_chunk (std::vector<uint8_t> &png, const char *type, const uint8_t *data, uint32_t size)
+{
+  uint8_t b[4];
+
+  bit_pack (b, 0, 32, size);
+  png.insert (png.end (), b, b + 4);
+
+  size_t start = png.size ();
+  png.insert (png.end (), (const uint8_t *) type, (const uint8_t *) type + 4);
+  if (size) png.insert (png.end (), data, data + size);
+
+  bit_pack (b, 0, 32, crc32 (0, &png[start], png.size () - start));
+  png.insert (png.end (), b, b + 4);
+}
+
+
+
+//!  Encode rendered tile pixels as an 8 bit palette PNG (zlib does all of the work).
+
+void tile_png (uint8_t *pixels, std::vector<uint8_t> &png)
+{
+  static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  static const uint8_t palette[9] = {0, 0, 0, 0x2e, 0x8b, 0x57, 0x1e, 0x5a, 0xc8};
+  static const uint8_t alpha[3] = {0, 255, 255};
+
+  uint8_t ihdr[13];
+  bit_pack (ihdr, 0, 32, TILE_SIZE);
+  bit_pack (ihdr, 32, 32, TILE_SIZE);
+  ihdr[8] = 8;
+  ihdr[9] = 3;
+  ihdr[10] = ihdr[11] = ihdr[12] = 0;
+
+
+  //  Every row starts with filter type 0 (none).
+
+  uint8_t raw[TILE_SIZE * (TILE_SIZE + 1)];
+
+  for (int32_t j = 0 ; j < TILE_SIZE ; j++)
+    {
+      raw[j * (TILE_SIZE + 1)] = 0;
+      memcpy (&raw[j * (TILE_SIZE + 1) + 1], &pixels[j * TILE_SIZE], TILE_SIZE);
+    }
+
+  uLongf size = compressBound (sizeof (raw));
+  std::vector<uint8_t> idat (size);
+  compress2 (&idat[0], &size, raw, sizeof (raw), 6);
+
+
+  png.clear ();
+  png.insert (png.end (), signature, signature + 8);
+  png_chunk (png, "IHDR", ihdr, 13);
+  png_chunk (png, "PLTE", palette, 9);
+  png_chunk (png, "tRNS", alpha, 3);
+  png_chunk (png, "IDAT", &idat[0], size);
+  png_chunk (png, "IEND", NULL, 0);
+}
+
+
+
+#ifndef NVWIN3X
+
+//!  Make every directory in path (like mkdir -p).
+
+static void make_dirs (char *path)
+{
+  for (char *p = path + 1 ; *p ; p++)
+    {
+      if (*p == '/')
+        {
+          *p = 0;
+          mkdir (path, 0777);
+          *p = '/';
+        }
+    }
+
+  mkdir (path, 0777);
+}
+
+
+
+//!  Get an encoded tile from the memory cache, the disk cache, or by rendering it.
+
+static void get_tile (TILE_SERVER *server, int32_t z, int32_t x, int32_t y, uint8_t png, std::vector<uint8_t> &data)
+{
+  uint64_t key = ((uint64_t) png << 63) | ((uint64_t) z << 56) | ((uint64_t) x << 28) | (uint64_t) y;
+
+
+  //  Memory cache.
+
+  server->mutex.lock ();
+
+  std::map<uint64_t, TILE_ENTRY>::iterator it = server->tiles.find (key);
+  if (it != server->tiles.end ())
+    {
+      server->lru.splice (server->lru.begin (), server->lru, it->second.lru);
+      data = it->second.data;
+      server->mutex.unlock ();
+      return;
+    }
+
+  server->mutex.unlock ();
+
+
+  //  Disk cache.
+
+  char path[1024], dir[1024];
+  uint8_t found = NVFalse;
+
+  if (server->dir[0])
+    {
+      snprintf (dir, sizeof (dir), "%s/%d/%d", server->dir, z, x);
+      snprintf (path, sizeof (path), "%s/%d.%s", dir, y, png ? "png" : "bits");
+
+      FILE *fp = fopen (path, "rb");
+      if (fp != NULL)
+        {
+          fseek (fp, 0, SEEK_END);
+          long size = ftell (fp);
+          fseek (fp, 0, SEEK_SET);
+
+          data.resize (size);
+          found = (size > 0 && fread (&data[0], size, 1, fp) == 1);
+
+          fclose (fp);
+        }
+    }
+
+
+  //  Render it.
+
+  if (!found)
+    {
+      uint8_t pixels[TILE_SIZE * TILE_SIZE];
+
+      tile_render (server->cache, z, x, y, pixels);
+
+      if (png)
+        {
+          tile_png (pixels, data);
+        }
+      else
+        {
+          data.assign (TILE_SIZE * TILE_SIZE / 8, 0);
+          for (int32_t i = 0 ; i < TILE_SIZE * TILE_SIZE ; i++)
+            {
+              if (pixels[i] == TILE_LAND) data[i >> 3] |= 0x80 >> (i & 7);
+            }
+        }
+
+
+      //  Write to a temporary name and rename so other threads never see part of a tile.
+
+      if (server->dir[0])
+        {
+          char temp[1100];
+
+          make_dirs (dir);
+          snprintf (temp, sizeof (temp), "%s.%p", path, (void *) &data);
+
+          FILE *fp = fopen (temp, "wb");
+          if (fp != NULL)
+            {
+              size_t n = fwrite (&data[0], data.size (), 1, fp);
+              fclose (fp);
+
+              if (n == 1)
+                {
+                  rename (temp, path);
+                }
+              else
+                {
+                  remove (temp);
+                }
+            }
+        }
+    }
+
+
+  //  Save it in memory, dropping the least recently used tiles if we need room.
+
+  QMutexLocker locker (&server->mutex);
+
+  if (server->tiles.find (key) != server->tiles.end ()) return;
+
+  server->lru.push_front (key);
+  TILE_ENTRY &entry = server->tiles[key];
+  entry.data = data;
+  entry.lru = server->lru.begin ();
+  server->bytes += data.size ();
+
+  while (server->bytes > server->max_bytes && server->lru.size () > 1)
+    {
+      std::map<uint64_t, TILE_ENTRY>::iterator old = server->tiles.find (server->lru.back ());
+
+      server->bytes -= old->second.data.size ();
+      server->tiles.erase (old);
+      server->lru.pop_back ();
+    }
+}
+
+
+
+static int32_t send_all (int32_t fd, const void *data, size_t size)
+{
+  const uint8_t *d = (const uint8_t *) data;
+
+  while (size)
+    {
+      ssize_t n = send (fd, d, size, MSG_NOSIGNAL);
+
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return (-1);
+
+      d += n;
+      size -= n;
+    }
+
+  return (0);
+}
+
+
+
+static int32_t send_response (int32_t fd, int32_t status, const char *type, const void *body, size_t size,
+                              uint8_t keep_alive)
+{
+  char header[512];
+
+  snprintf (header, sizeof (header), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %d\r\n"
+            "Cache-Control: max-age=3600\r\nAccess-Control-Allow-Origin: *\r\nConnection: %s\r\n\r\n", status,
+            (status == 200) ? "OK" : "Not Found", type, (int32_t) size, keep_alive ? "keep-alive" : "close");
+
+  if (send_all (fd, header, strlen (header))) return (-1);
+  if (size && send_all (fd, body, size)) return (-1);
+
+  return (0);
+}
+
+
+
+//!  Answer HTTP requests on one connection until the client closes it, asks us to, or goes idle (see tileThread::run).
+
+static void serve_http (int32_t fd, TILE_SERVER *server)
+{
+  char request[8192];
+  int32_t len = 0;
+  std::vector<uint8_t> data;
+
+
+  while (1)
+    {
+      //  Read until we have the whole request header (anything after it is the next request).
+
+      char *end;
+      request[len] = 0;
+
+      while ((end = strstr (request, "\r\n\r\n")) == NULL)
+        {
+          if (len >= (int32_t) sizeof (request) - 1) return;
+
+          ssize_t n = recv (fd, &request[len], sizeof (request) - 1 - len, 0);
+
+          if (n < 0 && errno == EINTR) continue;
+          if (n <= 0) return;
+
+          len += n;
+          request[len] = 0;
+        }
+
+      *end = 0;
+      int32_t used = (int32_t) (end - request) + 4;
+
+
+      char method[16], path[512], version[16];
+      int32_t z, x, y;
+      char ext[8];
+
+      if (sscanf (request, "%15s %511s %15s", method, path, version) != 3) return;
+
+      uint8_t keep_alive = strcmp (version, "HTTP/1.0") ? NVTrue : NVFalse;
+      for (char *p = request ; *p ; p++) *p = tolower (*p);
+      if (strstr (request, "connection: close")) keep_alive = NVFalse;
+      if (strstr (request, "connection: keep-alive")) keep_alive = NVTrue;
+
+
+      int32_t status;
+
+      if (strcmp (method, "GET"))
+        {
+          status = send_response (fd, 404, "text/plain", "Not found\n", 10, NVFalse);
+          return;
+        }
+      else if (!strcmp (path, "/"))
+        {
+          status = send_response (fd, 200, "text/html", tile_index, strlen (tile_index), keep_alive);
+        }
+      else if (sscanf (path, "/%d/%d/%d.%7s", &z, &x, &y, ext) == 4 && z >= 0 && z <= TILE_MAX_ZOOM && x >= 0 &&
+               x < (1 << z) && y >= 0 && y < (1 << z) && (!strcmp (ext, "png") || !strcmp (ext, "bits")))
+        {
+          uint8_t png = !strcmp (ext, "png");
+
+          get_tile (server, z, x, y, png, data);
+
+          status = send_response (fd, 200, png ? "image/png" : "application/octet-stream", &data[0], data.size (),
+                                  keep_alive);
+        }
+      else
+        {
+          status = send_response (fd, 404, "text/plain", "Not found\n", 10, keep_alive);
+        }
+
+      if (status || !keep_alive) return;
+
+
+      memmove (request, &request[used], len - used);
+      len -= used;
+    }
+}
+
+#endif
+
+
+
+tileThread::tileThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+tileThread::~tileThread ()
+{
+}
+
+
+
+void tileThread::serve (int32_t fd, TILE_SERVER *s)
+{
+  QMutexLocker locker (&mutex);
+
+  l_listen_fd = fd;
+  l_server = s;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+void tileThread::run ()
+{
+  mutex.lock ();
+
+  int32_t listen_fd = l_listen_fd;
+  TILE_SERVER *server = l_server;
+
+  mutex.unlock ();
+
+
+#ifndef NVWIN3X
+
+  while (1)
+    {
+      int32_t fd = accept (listen_fd, NULL, NULL);
+
+      if (fd < 0)
+        {
+          if (errno == EINTR || errno == ECONNABORTED) continue;
+
+          perror ("accept");
+          break;
+        }
+
+      //  Don't let an idle (or stalled) client keep this thread to itself.
+
+      struct timeval timeout = {TILE_IDLE_TIMEOUT, 0};
+      setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+      setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+
+      serve_http (fd, server);
+
+      close (fd);
+    }
+
+#endif
+}
+
+
+
+static void tiles_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask tiles [-p PORT] [-m CACHE_MB] [-d CACHE_DIR] [-t NUM_THREADS] INPUT_CLM\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-p PORT = port to listen on (on 127.0.0.1, default 8080)\n");
+  fprintf (stderr, "\t-m CACHE_MB = megabytes for uncompressed blocks and, separately, for tiles (default 256)\n");
+  fprintf (stderr, "\t-d CACHE_DIR = directory for the disk tile cache (default no disk cache)\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of connections served at once (1 to %d, default 8)\n\n", CLM_MAX_THREADS);
+  fprintf (stderr, "Open http://127.0.0.1:PORT/ in a browser or add http://127.0.0.1:PORT/{z}/{x}/{y}.png as an\n");
+  fprintf (stderr, "XYZ tile layer.  Runs until it is killed.\n\n");
+  exit (-1);
+}
+
+
+
+/*!
+  - Run the tile server.
+*/
+
+int32_t tiles (int32_t argc, char **argv)
+{
+#ifdef NVWIN3X
+
+  fprintf (stderr, "The tile server is not available on Windows\n\n");
+  return (-1);
+
+#else
+
+  int32_t           num_threads = 8, cache_mb = 256, port = 8080, c;
+  char              *dir = NULL;
+  tileThread        tile_thread[CLM_MAX_THREADS];
+
+
+  while ((c = getopt (argc, argv, "p:m:d:t:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'p':
+          sscanf (optarg, "%d", &port);
+          break;
+
+        case 'm':
+          sscanf (optarg, "%d", &cache_mb);
+          break;
+
+        case 'd':
+          dir = optarg;
+          break;
+
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          tiles_usage ();
+          break;
+        }
+    }
+
+
+  if (optind + 1 != argc || port < 1 || port > 65535 || cache_mb < 1 || num_threads < 1 ||
+      num_threads > CLM_MAX_THREADS) tiles_usage ();
+
+
+  CLM_FILE *clm = clm_open (argv[optind]);
+  if (clm == NULL)
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+
+  TILE_SERVER *server = new TILE_SERVER;
+
+  server->cache = clm_cache_create (clm, (int64_t) cache_mb * 1048576);
+  server->max_bytes = (int64_t) cache_mb * 1048576;
+  server->bytes = 0;
+  server->dir[0] = 0;
+
+  if (server->cache == NULL)
+    {
+      perror ("Allocating cache memory");
+      exit (-1);
+    }
+
+
+  //  The disk cache goes in a directory named for the .clm file and its modification time.
+
+  if (dir != NULL)
+    {
+      struct stat st;
+      char *name = strrchr (clm->path, '/');
+      name = (name == NULL) ? clm->path : name + 1;
+
+      stat (clm->path, &st);
+      snprintf (server->dir, sizeof (server->dir), "%s/%s_%lld", dir, name, (long long) st.st_mtime);
+      make_dirs (server->dir);
+    }
+
+
+  struct sockaddr_in addr;
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons (port);
+  addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+  int32_t on = 1;
+  int32_t fd = socket (AF_INET, SOCK_STREAM, 0);
+  if (fd >= 0) setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
+
+  if (fd < 0 || bind (fd, (struct sockaddr *) &addr, sizeof (addr)) || listen (fd, 128))
+    {
+      perror ("Listening for HTTP connections");
+      exit (-1);
+    }
+
+  fprintf (stderr, "Serving tiles from %s at http://127.0.0.1:%d/\n\n", clm->path, port);
+  fflush (stderr);
+
+
+  for (int32_t i = 0 ; i < num_threads ; i++) tile_thread[i].serve (fd, server);
+  for (int32_t i = 0 ; i < num_threads ; i++) tile_thread[i].wait ();
+
+
+  close (fd);
+  clm_cache_destroy (server->cache);
+  delete server;
+  clm_close (clm);
+
+  return (0);
+
+#endif
+}
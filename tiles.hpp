@@ -0,0 +1,127 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef TILES_H
+#define TILES_H
+
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include "cache.hpp"
+
+
+#define TILE_SIZE                    256
+#define TILE_MAX_ZOOM                22
+
+
+//  Seconds a connection may sit idle (or stall a send) before its server thread drops it.  Each thread serves one
+//  connection at a time so an idle keep-alive connection must not hold one for long.
+
+#define TILE_IDLE_TIMEOUT            5
+
+
+//  Tile pixel values (palette indices).
+
+#define TILE_UNDEFINED               0
+#define TILE_LAND                    1
+#define TILE_WATER                   2
+
+
+//!  Memory cache entry (an encoded tile).
+
+typedef struct
+{
+  std::vector<uint8_t>           data;
+  std::list<uint64_t>::iterator  lru;
+} TILE_ENTRY;
+
+
+//!  Everything the tile server threads share.
+
+typedef struct
+{
+  CLM_CACHE                      *cache;
+  char                           dir[512];          //!<  Disk cache directory (empty for none)
+  int64_t                        max_bytes;         //!<  Memory cache limit
+  int64_t                        bytes;
+  std::map<uint64_t, TILE_ENTRY> tiles;
+  std::list<uint64_t>            lru;               //!<  Most recently used first
+  QMutex                         mutex;
+} TILE_SERVER;
+
+
+void tile_render (CLM_CACHE *cache, int32_t z, int32_t x, int32_t y, uint8_t *pixels);
+void tile_png (uint8_t *pixels, std::vector<uint8_t> &png);
+int32_t tiles (int32_t argc, char **argv);
+
+
+class tileThread:public QThread
+{
+  Q_OBJECT 
+
+
+public:
+
+  tileThread (QObject *parent = 0);
+  ~tileThread ();
+
+  void serve (int32_t fd = -1, TILE_SERVER *s = NULL);
+
+
+signals:
+
+
+protected:
+
+
+  QMutex           mutex;
+
+  int32_t          l_listen_fd;
+
+  TILE_SERVER      *l_server;
+
+
+  void             run ();
+
+
+protected slots:
+
+private:
+};
+
+#endif
@@ -0,0 +1,340 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "transcode.hpp"
+
+
+/*!
+  - Re-encode an existing .clm file without going back to the shapefiles.  The compression level and zlib
+    strategy can be changed and blocks can be aligned (for instance to 4096 bytes so each block starts on a page).
+    Blocks are done a row of 360 (one latitude) at a time.  The threads read, uncompress, and re-compress the
+    blocks and then check the round trip by uncompressing what they made and comparing it to the original.  Then
+    the row is written in block order so the output is the same no matter how many threads are used.  Mixed blocks
+    that turn out to be all land or all water are stored as map codes.
+  - With -u (unordered) the threads work through the whole file instead of a row at a time and write each block
+    as soon as it is done, with pwrite, at an offset reserved with an atomic add (see clm_set_unordered).  There
+    is no waiting at the end of each row and no single writer, but the block order in the output depends on the
+    threads.  Use it for scratch files.
+*/
+
+
+#define TRANSCODE_STRATEGIES         4
+
+static const char *strategy_name[TRANSCODE_STRATEGIES] = {"default", "filtered", "huffman", "rle"};
+static const int32_t strategy_value[TRANSCODE_STRATEGIES] = {Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE};
+
+
+//!  Write a re-encoded block (or its map code) to the output file and free it.
+
+static void transcode_write (CLM_FILE *out, int32_t lat, int32_t lon, TRANSCODE_BLOCK *block)
+{
+  if (block->code == CLM_MIXED)
+    {
+      if (clm_write_raw (out, lat, lon, block->buf, block->size) < 0)
+        {
+          perror (out->path);
+          exit (-1);
+        }
+
+      free (block->buf);
+      block->buf = NULL;
+    }
+  else if (block->code != CLM_UNDEFINED)
+    {
+      clm_set_code (out, lat, lon, block->code);
+    }
+}
+
+
+
+transcodeThread::transcodeThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+transcodeThread::~transcodeThread ()
+{
+}
+
+
+
+void transcodeThread::transcode (CLM_FILE *in, CLM_FILE *out, int32_t la, TRANSCODE_BLOCK *b, int32_t lv, int32_t st,
+                                 QAtomicInt *n)
+{
+  QMutexLocker locker (&mutex);
+
+  l_in = in;
+  l_out = out;
+  l_lat = la;
+  l_blocks = b;
+  l_level = lv;
+  l_strategy = st;
+  l_next = n;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+void transcodeThread::run ()
+{
+  mutex.lock ();
+
+  CLM_FILE *in = l_in;
+  CLM_FILE *out = l_out;
+  int32_t lat = l_lat;
+  TRANSCODE_BLOCK *blocks = l_blocks;
+  int32_t level = l_level;
+  int32_t strategy = l_strategy;
+  QAtomicInt *next = l_next;
+
+  mutex.unlock ();
+
+
+  uint8_t *bits = (uint8_t *) malloc (in->bit_size);
+  uint8_t *check = (uint8_t *) malloc (in->bit_size);
+  if (bits == NULL || check == NULL)
+    {
+      perror ("Allocating memory in transcodeThread");
+      exit (-1);
+    }
+
+
+  //  If out is set we're writing unordered, do the whole file and write the blocks as we go.
+
+  TRANSCODE_BLOCK unordered;
+  int32_t count = (out != NULL) ? CLM_BLOCKS : 360;
+
+  int32_t i;
+  while ((i = next->fetchAndAddOrdered (1)) < count)
+    {
+      int32_t lon = i % 360 - 180;
+      TRANSCODE_BLOCK *block = &blocks[i];
+
+      if (out != NULL)
+        {
+          lat = i / 360 - 90;
+          block = &unordered;
+        }
+
+      block->buf = NULL;
+      block->code = clm_read_block (in, lat, lon, bits);
+
+      if (block->code < 0)
+        {
+          fprintf (stderr, "\nError reading block %d %d from %s\n", lat, lon, in->path);
+          exit (-1);
+        }
+
+      if (block->code == CLM_MIXED && (block->code = clm_block_code (in, bits)) == CLM_MIXED)
+        {
+          if ((block->buf = clm_compress_block (in, bits, level, strategy, &block->size)) == NULL)
+            {
+              fprintf (stderr, "\nError compressing block %d %d\n", lat, lon);
+              exit (-1);
+            }
+
+
+          //  Round trip check.
+
+          uLongf size = in->bit_size;
+
+          if (uncompress (check, &size, block->buf, block->size) != Z_OK || size != (uLongf) in->bit_size ||
+              memcmp (check, bits, in->bit_size))
+            {
+              fprintf (stderr, "\nRound trip check failed for block %d %d\n", lat, lon);
+              exit (-1);
+            }
+        }
+
+      if (out != NULL) transcode_write (out, lat, lon, block);
+    }
+
+
+  free (bits);
+  free (check);
+}
+
+
+
+static void transcode_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask transcode [-l LEVEL] [-s STRATEGY] [-a ALIGNMENT] [-u] [-t NUM_THREADS] INPUT_CLM OUTPUT_CLM\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-l LEVEL = zlib compression level (0 to 9, default 9)\n");
+  fprintf (stderr, "\t-s STRATEGY = zlib strategy, default, filtered, huffman, or rle (default default)\n");
+  fprintf (stderr, "\t-a ALIGNMENT = start each compressed block on a multiple of ALIGNMENT bytes (default 1)\n");
+  fprintf (stderr, "\t-u = unordered, threads write blocks as they finish them (block order depends on the threads)\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of compute threads (1 to %d, default 4)\n\n", CLM_MAX_THREADS);
+  exit (-1);
+}
+
+
+
+/*!
+  - Transcode a .clm file.
+*/
+
+int32_t transcode (int32_t argc, char **argv)
+{
+  int32_t           num_threads = 4, level = 9, strategy = 0, align = 1, c;
+  uint8_t           unordered = NVFalse;
+  char              extra_header[SWBD_MASK_HEADER_SIZE / 2];
+  TRANSCODE_BLOCK   blocks[360];
+  transcodeThread   transcode_thread[CLM_MAX_THREADS];
+
+
+  while ((c = getopt (argc, argv, "l:s:a:ut:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'l':
+          sscanf (optarg, "%d", &level);
+          break;
+
+        case 's':
+          strategy = -1;
+          for (int32_t i = 0 ; i < TRANSCODE_STRATEGIES ; i++)
+            {
+              if (!strcmp (optarg, strategy_name[i])) strategy = i;
+            }
+          break;
+
+        case 'a':
+          sscanf (optarg, "%d", &align);
+          break;
+
+        case 'u':
+          unordered = NVTrue;
+          break;
+
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          transcode_usage ();
+          break;
+        }
+    }
+
+
+  if (optind + 2 != argc || level < 0 || level > 9 || strategy < 0 || align < 1 || align > 1048576 ||
+      num_threads < 1 || num_threads > CLM_MAX_THREADS) transcode_usage ();
+
+
+  CLM_FILE *in = clm_open (argv[optind]);
+  if (in == NULL)
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+  snprintf (extra_header, sizeof (extra_header), "[SOURCE MASK] = %s\n[COMPRESSION LEVEL] = %d\n"
+            "[COMPRESSION STRATEGY] = %s\n[BLOCK ALIGNMENT] = %d\n", in->path, level, strategy_name[strategy], align);
+
+  CLM_FILE *out = clm_create (argv[optind + 1], in->resolution, extra_header);
+  if (out == NULL)
+    {
+      perror (argv[optind + 1]);
+      exit (-1);
+    }
+
+  out->align = align;
+
+  if (unordered && !clm_set_unordered (out))
+    {
+      fprintf (stderr, "Unordered writes aren't supported here, writing in order\n");
+      unordered = NVFalse;
+    }
+
+
+  QElapsedTimer timer;
+  timer.start ();
+
+  if (unordered)
+    {
+      QAtomicInt next (0);
+
+      for (int32_t i = 0 ; i < num_threads ; i++)
+        transcode_thread[i].transcode (in, out, 0, NULL, level, strategy_value[strategy], &next);
+      for (int32_t i = 0 ; i < num_threads ; i++) transcode_thread[i].wait ();
+    }
+  else
+    {
+      for (int32_t lat = -90 ; lat < 90 ; lat++)
+        {
+          QAtomicInt next (0);
+
+          for (int32_t i = 0 ; i < num_threads ; i++)
+            transcode_thread[i].transcode (in, NULL, lat, blocks, level, strategy_value[strategy], &next);
+          for (int32_t i = 0 ; i < num_threads ; i++) transcode_thread[i].wait ();
+
+
+          //  Write the row in order.
+
+          for (int32_t i = 0 ; i < 360 ; i++) transcode_write (out, lat, i - 180, &blocks[i]);
+
+          fprintf (stderr, "%03d%% processed\r", (lat + 90) * 100 / 180);
+          fflush (stderr);
+        }
+    }
+
+
+  int64_t in_bytes = 0, out_bytes = 0;
+
+  for (int32_t i = 0 ; i < CLM_BLOCKS ; i++)
+    {
+      uint32_t size;
+
+      if (clm_block_address (in, i / 360 - 90, i % 360 - 180, &size) > CLM_ALL_WATER) in_bytes += size;
+      if (clm_block_address (out, i / 360 - 90, i % 360 - 180, &size) > CLM_ALL_WATER) out_bytes += size;
+    }
+
+
+  clm_close (out);
+  clm_close (in);
+
+
+  fprintf (stderr, "100%% processed, %lld bytes of blocks in, %lld out (%.1f%%), %.3f seconds\n\n",
+           (long long) in_bytes, (long long) out_bytes, in_bytes ? 100.0 * (double) out_bytes / (double) in_bytes : 0.0,
+           (double) timer.elapsed () / 1000.0);
+  fflush (stderr);
+
+  return (0);
+}
@@ -0,0 +1,650 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include <map>
+
+#include "vectorize.hpp"
+
+
+/*!
+  - Conversion of the land/water boundaries in a .clm file to shoreline polygons.  Each one-degree block is traced
+    on its own (in parallel).  The edges between land and water cells are directed so that land is always on the
+    right (so land boundaries run clockwise and water boundaries run counter-clockwise).  Each block owns the
+    edges along its south and west sides and the next edge at each corner is chosen from the four cells around
+    the corner (marching squares, turning right first so diagonal land cells are separate polygons).  Only the
+    corners where the direction changes are kept.  Rings that close inside a block are written as soon as they
+    are found.  Fragments that run off of the block are saved and stitched together across the seams when all
+    of the blocks are done.  Undefined blocks are treated as water and polygons are closed along the 180 degree
+    meridian.
+
+    Every ring is written as its own polygon (clockwise, as shapefiles require) with a LAND attribute of 1 for
+    land boundaries and 0 for water boundaries (lakes inside of land) so that drawing them in order of
+    decreasing size reproduces the mask.
+*/
+
+
+/*!
+  - Write a closed ring (global cell corner indices) to the shapefile.  Water rings are reversed so that all
+    polygons are clockwise.
+*/
+
+void write_ring (SHPHandle shp, DBFHandle dbf, std::vector<int32_t> &vertex, int32_t point_count)
+{
+  int32_t count = vertex.size () / 2;
+  if (count < 4) return;
+
+
+  //  Twice the signed area (negative for clockwise rings, which are land).
+
+  double area = 0.0;
+  for (int32_t i = 0 ; i < count - 1 ; i++)
+    area += (double) vertex[i * 2] * (double) vertex[i * 2 + 3] - (double) vertex[i * 2 + 2] * (double) vertex[i * 2 + 1];
+
+  int32_t land = (area < 0.0);
+
+
+  double *x = (double *) malloc (count * sizeof (double));
+  double *y = (double *) malloc (count * sizeof (double));
+  if (x == NULL || y == NULL)
+    {
+      perror ("Allocating vertex memory in write_ring");
+      exit (-1);
+    }
+
+  for (int32_t i = 0 ; i < count ; i++)
+    {
+      int32_t j = land ? i : count - 1 - i;
+
+      x[i] = -180.0 + (double) vertex[j * 2] / (double) point_count;
+      y[i] = -90.0 + (double) vertex[j * 2 + 1] / (double) point_count;
+    }
+
+
+  SHPObject *shape = SHPCreateSimpleObject (SHPT_POLYGON, count, x, y, NULL);
+  int32_t id = SHPWriteObject (shp, -1, shape);
+  SHPDestroyObject (shape);
+
+  DBFWriteIntegerAttribute (dbf, id, 0, land);
+
+  free (x);
+  free (y);
+}
+
+
+
+vectorizeThread::vectorizeThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+vectorizeThread::~vectorizeThread ()
+{
+}
+
+
+
+void vectorizeThread::vectorize (CLM_FILE *in, SHPHandle sh, DBFHandle db, QMutex *sm, std::vector<VEC_FRAGMENT> *f, QAtomicInt *n)
+{
+  QMutexLocker locker (&mutex);
+
+  l_in = in;
+  l_shp = sh;
+  l_dbf = db;
+  l_shp_mutex = sm;
+  l_fragments = f;
+  l_next = n;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+void vectorizeThread::run ()
+{
+  mutex.lock ();
+
+  CLM_FILE *in = l_in;
+  SHPHandle shp = l_shp;
+  DBFHandle dbf = l_dbf;
+  QMutex *shp_mutex = l_shp_mutex;
+  std::vector<VEC_FRAGMENT> *fragments = l_fragments;
+  QAtomicInt *next = l_next;
+
+  mutex.unlock ();
+
+
+  int32_t pc = in->point_count;
+  int32_t pad_size = pc + 2;
+  int32_t pad_words = (pad_size + 63) / 64;
+  int64_t world_x = 360 * pc + 1;
+  uint64_t words[CLM_MAX_ROW_WORDS];
+  static const int32_t step_x[4] = {1, 0, -1, 0}, step_y[4] = {0, 1, 0, -1};
+
+
+  uint8_t *bits[3][3];
+  int32_t code[3][3];
+
+  for (int32_t i = 0 ; i < 3 ; i++)
+    {
+      for (int32_t j = 0 ; j < 3 ; j++)
+        {
+          if ((bits[i][j] = (uint8_t *) malloc (in->bit_size)) == NULL)
+            {
+              perror ("Allocating bits memory in vectorizeThread");
+              exit (-1);
+            }
+        }
+    }
+
+
+  //  The block with a one cell border (cell x, y is bit x + 1 of row y + 1) and the used flags for the
+  //  horizontal (y * pc + x) and vertical (y * (pc + 1) + x) edges.
+
+  uint64_t *pad = (uint64_t *) malloc ((size_t) pad_size * pad_words * sizeof (uint64_t));
+  if (pad == NULL)
+    {
+      perror ("Allocating pad memory in vectorizeThread");
+      exit (-1);
+    }
+
+  std::vector<bool> used_h ((size_t) (pc + 1) * pc), used_v ((size_t) pc * (pc + 1));
+  std::vector<int32_t> ring;
+
+
+  int32_t i;
+  while ((i = next->fetchAndAddOrdered (1)) < CLM_BLOCKS)
+    {
+      int32_t lat = i / 360 - 90;
+      int32_t lon = i % 360 - 180;
+
+
+      if (!(i % 648))
+        {
+          fprintf (stderr, "%03d%% processed\r", i / 648);
+          fflush (stderr);
+        }
+
+
+      //  Neighbors past the poles, across the 180 degree meridian, or undefined are water.
+
+      for (int32_t dy = -1 ; dy <= 1 ; dy++)
+        {
+          for (int32_t dx = -1 ; dx <= 1 ; dx++)
+            {
+              int32_t nlat = lat + dy;
+              int32_t nlon = lon + dx;
+
+              if (nlat < -90 || nlat > 89 || nlon < -180 || nlon > 179)
+                {
+                  code[dy + 1][dx + 1] = CLM_ALL_WATER;
+                }
+              else
+                {
+                  uint32_t address = clm_block_address (in, nlat, nlon, NULL);
+
+                  if (address == CLM_UNDEFINED)
+                    {
+                      code[dy + 1][dx + 1] = CLM_ALL_WATER;
+                    }
+                  else
+                    {
+                      code[dy + 1][dx + 1] = (address <= CLM_ALL_WATER) ? (int32_t) address : CLM_MIXED;
+                    }
+                }
+            }
+        }
+
+
+      //  A block only owns edges inside of it and along its south and west sides (and along the north pole or the
+      //  180 degree meridian) so uniform blocks with matching south and west neighbors can be skipped.
+
+      if (code[1][1] != CLM_MIXED && code[0][1] == code[1][1] && code[1][0] == code[1][1] &&
+          (code[1][1] == CLM_ALL_WATER || (lat < 89 && lon < 179))) continue;
+
+
+      for (int32_t dy = -1 ; dy <= 1 ; dy++)
+        {
+          for (int32_t dx = -1 ; dx <= 1 ; dx++)
+            {
+              if (code[dy + 1][dx + 1] == CLM_MIXED)
+                {
+                  if (clm_read_block (in, lat + dy, lon + dx, bits[dy + 1][dx + 1]) < 0)
+                    {
+                      fprintf (stderr, "\nError reading block %d %d from %s\n", lat + dy, lon + dx, in->path);
+                      exit (-1);
+                    }
+                }
+            }
+        }
+
+
+      //  Build the padded block.
+
+      for (int32_t py = 0 ; py < pad_size ; py++)
+        {
+          int32_t row = py - 1, dy = 0;
+
+          if (row < 0)
+            {
+              row += pc;
+              dy = -1;
+            }
+          else if (row >= pc)
+            {
+              row -= pc;
+              dy = 1;
+            }
+
+          uint64_t *w = &pad[(size_t) py * pad_words];
+
+          for (int32_t dx = -1 ; dx <= 1 ; dx++)
+            {
+              int32_t c = code[dy + 1][dx + 1];
+
+              int32_t src_start = (dx < 0) ? pc - 1 : 0;
+              int32_t dst_start = (dx < 0) ? 0 : (dx == 0) ? 1 : pc + 1;
+              int32_t count = dx ? 1 : pc;
+
+              if (c == CLM_MIXED)
+                {
+                  clm_get_row (in, bits[dy + 1][dx + 1], row, words);
+                  clm_copy_bits (w, dst_start, words, src_start, count);
+                }
+              else
+                {
+                  clm_fill_bits (w, dst_start, dst_start + count, (c == CLM_ALL_LAND));
+                }
+            }
+        }
+
+
+      //  Land flag for cell x, y (-1 to pc).
+
+#define CELL(x, y) ((pad[(size_t) ((y) + 1) * pad_words + (((x) + 1) >> 6)] >> (63 - (((x) + 1) & 63))) & 1)
+
+
+      //  Edges owned by this block.  The northern most blocks also own their north sides and the blocks on the
+      //  180 degree meridian also own their east sides.
+
+      int32_t max_y = (lat == 89) ? pc : pc - 1;
+      int32_t max_x = (lon == 179) ? pc : pc - 1;
+
+#define OWNED(x, y, d) ((d) == VEC_EAST ? ((x) >= 0 && (x) < pc && (y) >= 0 && (y) <= max_y) : \
+                        (d) == VEC_WEST ? ((x) >= 1 && (x) <= pc && (y) >= 0 && (y) <= max_y) : \
+                        (d) == VEC_NORTH ? ((y) >= 0 && (y) < pc && (x) >= 0 && (x) <= max_x) : \
+                        ((y) >= 1 && (y) <= pc && (x) >= 0 && (x) <= max_x))
+
+
+      std::fill (used_h.begin (), used_h.end (), false);
+      std::fill (used_v.begin (), used_v.end (), false);
+
+
+      //  Trace from every unused edge.  Both loops find the edges a word at a time.
+
+      for (int32_t pass = 0 ; pass < 2 ; pass++)
+        {
+          int32_t max_row = pass ? pc - 1 : max_y;
+
+          for (int32_t y = 0 ; y <= max_row ; y++)
+            {
+              uint64_t *cur = &pad[(size_t) (y + 1) * pad_words];
+              uint64_t *below = &pad[(size_t) y * pad_words];
+              uint64_t diff[CLM_MAX_ROW_WORDS + 1];
+              int32_t first, last;
+
+
+              //  Horizontal edges (cells that differ from the cell below) are at bits 1 to pc, vertical edges
+              //  (cells that differ from the cell to the west) are at bits 1 to max_x + 1.
+
+              if (!pass)
+                {
+                  for (int32_t w = 0 ; w < pad_words ; w++) diff[w] = cur[w] ^ below[w];
+                  first = 1;
+                  last = pc;
+                }
+              else
+                {
+                  for (int32_t w = 0 ; w < pad_words ; w++) diff[w] = cur[w] ^ ((cur[w] >> 1) | (w ? cur[w - 1] << 63 : 0));
+                  first = 1;
+                  last = max_x + 1;
+                }
+
+
+              int32_t p = first;
+              while ((p = clm_next_bit (diff, last + 1, p, 1)) <= last)
+                {
+                  int32_t x = p - 1, sx, sy, d;
+
+                  if (!pass)
+                    {
+                      if (CELL (x, y - 1))
+                        {
+                          sx = x;
+                          d = VEC_EAST;
+                        }
+                      else
+                        {
+                          sx = x + 1;
+                          d = VEC_WEST;
+                        }
+
+                      sy = y;
+                      if (used_h[(size_t) y * pc + x]) 
+                        {
+                          p++;
+                          continue;
+                        }
+                    }
+                  else
+                    {
+                      if (CELL (x, y))
+                        {
+                          sy = y;
+                          d = VEC_NORTH;
+                        }
+                      else
+                        {
+                          sy = y + 1;
+                          d = VEC_SOUTH;
+                        }
+
+                      sx = x;
+                      if (used_v[(size_t) y * (pc + 1) + x])
+                        {
+                          p++;
+                          continue;
+                        }
+                    }
+
+
+                  //  Follow the boundary until it leaves the block or runs into a used edge.
+
+                  int32_t x0 = sx, y0 = sy, d0 = d;
+
+                  ring.clear ();
+                  ring.push_back (sx);
+                  ring.push_back (sy);
+
+                  while (1)
+                    {
+                      if (d == VEC_EAST)
+                        {
+                          used_h[(size_t) sy * pc + sx] = true;
+                        }
+                      else if (d == VEC_WEST)
+                        {
+                          used_h[(size_t) sy * pc + sx - 1] = true;
+                        }
+                      else if (d == VEC_NORTH)
+                        {
+                          used_v[(size_t) sy * (pc + 1) + sx] = true;
+                        }
+                      else
+                        {
+                          used_v[(size_t) (sy - 1) * (pc + 1) + sx] = true;
+                        }
+
+                      sx += step_x[d];
+                      sy += step_y[d];
+
+
+                      //  Edges leaving this corner (land on the right) - east if SE is land and NE is water, north
+                      //  if NE is land and NW is water, west if NW is land and SW is water, south if SW is land
+                      //  and SE is water.  Try right, straight, and then left.
+
+                      int32_t sw = CELL (sx - 1, sy - 1), se = CELL (sx, sy - 1), nw = CELL (sx - 1, sy), ne = CELL (sx, sy);
+                      uint8_t out[4];
+                      out[VEC_EAST] = se && !ne;
+                      out[VEC_NORTH] = ne && !nw;
+                      out[VEC_WEST] = nw && !sw;
+                      out[VEC_SOUTH] = sw && !se;
+
+                      int32_t nd = (d + 3) & 3;
+                      if (!out[nd]) nd = d;
+                      if (!out[nd]) nd = (d + 1) & 3;
+
+                      if (nd != d)
+                        {
+                          ring.push_back (sx);
+                          ring.push_back (sy);
+                        }
+
+
+                      uint8_t used;
+                      if (nd == VEC_EAST || nd == VEC_WEST)
+                        {
+                          int32_t ex = (nd == VEC_EAST) ? sx : sx - 1;
+                          used = OWNED (sx, sy, nd) && used_h[(size_t) sy * pc + ex];
+                        }
+                      else
+                        {
+                          int32_t ey = (nd == VEC_NORTH) ? sy : sy - 1;
+                          used = OWNED (sx, sy, nd) && used_v[(size_t) ey * (pc + 1) + sx];
+                        }
+
+
+                      if (!OWNED (sx, sy, nd) || used)
+                        {
+                          if (ring[ring.size () - 2] != sx || ring[ring.size () - 1] != sy)
+                            {
+                              ring.push_back (sx);
+                              ring.push_back (sy);
+                            }
+
+
+                          //  Convert to global corner indices.
+
+                          for (uint32_t k = 0 ; k < ring.size () ; k += 2)
+                            {
+                              ring[k] += (lon + 180) * pc;
+                              ring[k + 1] += (lat + 90) * pc;
+                            }
+
+
+                          if (used && sx == x0 && sy == y0 && nd == d0)
+                            {
+                              shp_mutex->lock ();
+                              write_ring (shp, dbf, ring, pc);
+                              shp_mutex->unlock ();
+                            }
+                          else
+                            {
+                              VEC_FRAGMENT frag;
+
+                              frag.start_key = (((int64_t) (y0 + (lat + 90) * pc) * world_x + x0 + (lon + 180) * pc) << 2) | d0;
+                              frag.end_key = (((int64_t) (sy + (lat + 90) * pc) * world_x + sx + (lon + 180) * pc) << 2) | nd;
+                              frag.vertex = ring;
+
+                              fragments[i].push_back (frag);
+                            }
+
+                          break;
+                        }
+
+                      d = nd;
+                    }
+
+                  p++;
+                }
+            }
+        }
+    }
+
+
+  for (int32_t i = 0 ; i < 3 ; i++)
+    {
+      for (int32_t j = 0 ; j < 3 ; j++) free (bits[i][j]);
+    }
+
+  free (pad);
+}
+
+
+
+static void vectorize_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask vectorize [-t NUM_THREADS] INPUT_CLM OUTPUT_SHAPEFILE\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of compute threads (1 to %d, default 4)\n\n", CLM_MAX_THREADS);
+  fprintf (stderr, "Each land or water boundary is written as a separate clockwise polygon with a LAND attribute\n");
+  fprintf (stderr, "of 1 for land and 0 for water.\n\n");
+  exit (-1);
+}
+
+
+
+/*!
+  - Trace the land/water boundaries in an existing .clm file and write them to a polygon shapefile.
+*/
+
+int32_t vectorize (int32_t argc, char **argv)
+{
+  int32_t           num_threads = 4, c;
+  char              shpname[512];
+  QMutex            shp_mutex;
+  vectorizeThread   vectorize_thread[CLM_MAX_THREADS];
+
+
+  while ((c = getopt (argc, argv, "t:")) != EOF)
+    {
+      switch (c)
+        {
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          vectorize_usage ();
+          break;
+        }
+    }
+
+
+  if (optind + 2 != argc || num_threads < 1 || num_threads > CLM_MAX_THREADS) vectorize_usage ();
+
+
+  CLM_FILE *in = clm_open (argv[optind]);
+  if (in == NULL)
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+
+  strcpy (shpname, argv[optind + 1]);
+  if (strlen (shpname) > 4 && !strcmp (&shpname[strlen (shpname) - 4], ".shp")) shpname[strlen (shpname) - 4] = 0;
+
+  SHPHandle shp = SHPCreate (shpname, SHPT_POLYGON);
+  DBFHandle dbf = DBFCreate (shpname);
+
+  if (shp == NULL || dbf == NULL)
+    {
+      perror (shpname);
+      exit (-1);
+    }
+
+  DBFAddField (dbf, "LAND", FTInteger, 1, 0);
+
+
+  std::vector<VEC_FRAGMENT> *fragments = new std::vector<VEC_FRAGMENT>[CLM_BLOCKS];
+
+  QAtomicInt next (0);
+
+  for (int32_t i = 0 ; i < num_threads ; i++) vectorize_thread[i].vectorize (in, shp, dbf, &shp_mutex, fragments, &next);
+  for (int32_t i = 0 ; i < num_threads ; i++) vectorize_thread[i].wait ();
+
+
+  //  Stitch the fragments together across the block seams.
+
+  std::map<int64_t, VEC_FRAGMENT *> start;
+
+  for (int32_t i = 0 ; i < CLM_BLOCKS ; i++)
+    {
+      for (uint32_t j = 0 ; j < fragments[i].size () ; j++) start[fragments[i][j].start_key] = &fragments[i][j];
+    }
+
+  fprintf (stderr, "\nStitching %d fragments\n", (int32_t) start.size ());
+
+
+  int32_t broken = 0;
+  std::vector<int32_t> ring;
+
+  while (!start.empty ())
+    {
+      VEC_FRAGMENT *first = start.begin ()->second;
+      VEC_FRAGMENT *frag = first;
+
+      start.erase (start.begin ());
+      ring = first->vertex;
+
+      while (frag->end_key != first->start_key)
+        {
+          std::map<int64_t, VEC_FRAGMENT *>::iterator it = start.find (frag->end_key);
+
+          if (it == start.end ())
+            {
+              broken++;
+              ring.clear ();
+              break;
+            }
+
+          frag = it->second;
+          start.erase (it);
+
+          ring.insert (ring.end (), frag->vertex.begin () + 2, frag->vertex.end ());
+          std::vector<int32_t> ().swap (frag->vertex);
+        }
+
+      if (!ring.empty ()) write_ring (shp, dbf, ring, in->point_count);
+    }
+
+  if (broken) fprintf (stderr, "%d boundaries could not be closed\n", broken);
+
+
+  delete[] fragments;
+
+  SHPClose (shp);
+  DBFClose (dbf);
+  clm_close (in);
+
+
+  fprintf (stderr, "100%% processed                         \n\n");
+  fflush (stderr);
+
+  return (0);
+}
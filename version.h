@@ -22,7 +22,7 @@
 
 #ifndef VERSION
 
-#define     VERSION       "PFM Software - swbd_mask V1.03 - 07/23/14"
+#define     VERSION       "PFM Software - swbd_mask V1.28 - 10/18/26"
 
 #endif
 
@@ -57,4 +57,204 @@
     - Switched from using the old NV_INT64 and NV_U_INT32 type definitions to the C99 standard stdint.h and
       inttypes.h sized data types (e.g. int64_t and uint32_t).
 
+
+    Version 1.04
+    PFM Software
+    10/18/26
+
+    - Added the .clm file access functions (clm.cpp) and the "components" mode which uses parallel, run based
+      connected component labeling to build an ocean connected water mask or to remove small water bodies.
+
+
+    Version 1.05
+    PFM Software
+    10/18/26
+
+    - Added the "morph" mode which dilates or erodes the land in a .clm file using word wide shifts and ORs on
+      packed rows with separable (van Herk) passes and halos taken from the neighboring blocks.
+
+
+    Version 1.06
+    PFM Software
+    10/18/26
+
+    - Added the "distance" mode which uses a parallel, block by block, Felzenszwalb/Huttenlocher Euclidean
+      distance transform (with latitude dependent cell widths and bounded halos) to build a compressed, tiled,
+      distance to land (.cdm) file.
+
+
+    Version 1.07
+    PFM Software
+    10/18/26
+
+    - Added the "vectorize" mode which traces the land/water boundaries of a .clm file (in parallel, block by
+      block, using marching squares on the packed rows), stitches them together across the block seams, and
+      writes them to a polygon shapefile.
+
+
+    Version 1.08
+    PFM Software
+    10/18/26
+
+    - Added the "combine" mode which computes the union, intersection, difference, or exclusive or of two or
+      more .clm files in parallel, deciding what it can from the map codes and compressed blocks and only
+      uncompressing mixed blocks when they have to be combined (64 bits at a time).
+
+
+    Version 1.09
+    PFM Software
+    10/18/26
+
+    - Added "crossing" mode to find where straight segments first cross land (DDA block walk with a shared
+      block cache).
+
+
+    Version 1.10
+    PFM Software
+    10/18/26
+
+    - Added "zonal" mode for land/water area inside area of interest polygons (scanline spans from the new
+      fill.cpp intersected with mask rows using popcount).
+
+
+    Version 1.11
+    PFM Software
+    10/18/26
+
+    - Added "serve" mode, a query daemon on a Unix domain socket with one shared block cache and
+      pipelined point, batch, and box requests, and "bench" mode to measure its latency.
+
+
+    Version 1.12
+    PFM Software
+    10/18/26
+
+    - Added a POSIX shared memory block cache (lock free slot table with reference counts and a memory
+      cap) that "crossing" and "serve" use with -s so cooperating processes uncompress each block once.
+
+
+    Version 1.13
+    PFM Software
+    10/18/26
+
+    - Added "tiles" mode, a local HTTP server that renders XYZ/Web Mercator PNG (or bit) tiles on demand with
+      memory and disk tile caches.
+
+
+    Version 1.14
+    PFM Software
+    10/18/26
+
+    - Added "classify" mode to flag or filter ASCII XYZ and LAS points that fall on land (chunked, threaded
+      parsing and block sorted batch queries).
+
+
+    Version 1.15
+    PFM Software
+    10/18/26
+
+    - Added transcode mode to re-compress a .clm with a different zlib level, strategy, or block alignment.
+
+
+    Version 1.16
+    PFM Software
+    10/18/26
+
+    - Added resample mode to build a coarser .clm from a finer one (center, majority, any land, or any water)
+      with an optional comparison of sampled cells against the SWBD shapefiles.
+
+
+    Version 1.17
+    PFM Software
+    10/18/26
+
+    - Added gdalbench mode to time and compare the scanline and point in polygon engines against
+      GDALRasterizeGeometries on SWBD cells.  Moved SWBD shapefile cell reading into swbd.cpp.
+
+
+    Version 1.18
+    PFM Software
+    10/18/26
+
+    - Added the nonzero winding fill rule to the scanline fill (fill.cpp) and maskThread.  zonal and gdalbench
+      take -w to use it.
+
+
+    Version 1.19
+    PFM Software
+    10/18/26
+
+    - Added clm_decode_row/rect/block (decode.cpp) to expand blocks into byte, float, or packed bit grids a byte
+      (eight cells) at a time and extract mode to write an area as a raw grid with an ESRI header.
+
+
+    Version 1.20
+    PFM Software
+    10/18/26
+
+    - Read the SWBD shapefiles straight out of the distribution .zip archives and read cells ahead in reader
+      threads.
+
+
+    Version 1.21
+    PFM Software
+    10/18/26
+
+    - Unordered (pwrite, atomic offset) block writes for scratch files, transcode -u, the other block modes and
+      the main build use them.
+
+
+    Version 1.22
+    PFM Software
+    10/18/26
+
+    - Added overlay (patch) files with the patch and compact modes and -o in crossing and classify.
+
+
+    Version 1.23
+    PFM Software
+    10/18/26
+
+    - Added multi-layer files (several masks per block, rows interleaved) and the stack mode to build and query
+      them.
+
+
+    Version 1.24
+    PFM Software
+    10/18/26
+
+    - Added edge files (boundary pixels and the SWBD polygon edges near them) with the edges and exact modes.
+
+
+    Version 1.25
+    PFM Software
+    10/18/26
+
+    - Added -p to the main build to report hardware counters (IPC, cache and branch misses) for each build
+      stage.
+
+
+    Version 1.26
+    PFM Software
+    10/18/26
+
+    - Added per cell selection of the rasterization engine (brute force or scanline) from a calibrated cost
+      model and the calibrate mode.
+
+
+    Version 1.27
+    PFM Software
+    10/18/26
+
+    - Added non-blocking point, batch, and box queries (async.cpp) that coalesce requests for the same block and
+      read blocks in a thread pool.
+
+
+    Version 1.28
+    PFM Software
+    10/18/26
+
+    - Added the run-length block cache (runs.cpp, clm_cache_create_runs) and the -r option to serve and
+      classify.
+
 */
@@ -0,0 +1,350 @@
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "zonal.hpp"
+
+
+/*!
+  - Land, water, and undefined area (in square kilometers) inside area of interest polygons.  Each row of cell centers
+    in a block is turned into spans with the scanline fill (fill.cpp), so a cell counts if its center is inside the
+    polygon (the same even-odd rule that is used to build the mask, or nonzero winding with -w).  The land cells in
+    each span are counted 64 at a time with popcount and weighted by the area of a cell in that row.  Blocks that
+    don't touch the polygon are never read and all land, all water, and undefined blocks are never uncompressed.  The
+    blocks in the polygon's bounding box are handed out to the threads.
+*/
+
+
+zonalThread::zonalThread (QObject *parent)
+  : QThread(parent)
+{
+}
+
+
+
+zonalThread::~zonalThread ()
+{
+}
+
+
+
+void zonalThread::zonal (CLM_FILE *in, FILL_POLYGON *f, int32_t *b, int32_t nb, double *a, QAtomicInt *n)
+{
+  QMutexLocker locker (&mutex);
+
+  l_in = in;
+  l_fill = f;
+  l_blocks = b;
+  l_num_blocks = nb;
+  l_area = a;
+  l_next = n;
+
+  if (!isRunning ()) start ();
+}
+
+
+
+void zonalThread::run ()
+{
+  mutex.lock ();
+
+  CLM_FILE *in = l_in;
+  FILL_POLYGON *fill = l_fill;
+  int32_t *blocks = l_blocks;
+  int32_t num_blocks = l_num_blocks;
+  double *area = l_area;
+  QAtomicInt *next = l_next;
+
+  mutex.unlock ();
+
+
+  int32_t pc = in->point_count;
+  uint64_t words[CLM_MAX_ROW_WORDS];
+
+  uint8_t *bits = (uint8_t *) malloc (in->bit_size);
+  double *spans = (double *) malloc (2 * (fill->max_count + 1) * sizeof (double));
+  if (bits == NULL || spans == NULL)
+    {
+      perror ("Allocating memory in zonalThread");
+      exit (-1);
+    }
+
+  area[ZONAL_LAND] = area[ZONAL_WATER] = area[ZONAL_UNDEFINED] = 0.0;
+
+
+  int32_t i;
+  while ((i = next->fetchAndAddOrdered (1)) < num_blocks)
+    {
+      int32_t lat = blocks[i] / 360 - 90;
+      int32_t lon = blocks[i] % 360 - 180;
+
+      uint32_t address = clm_block_address (in, lat, lon, NULL);
+      int32_t code = (address <= CLM_ALL_WATER) ? (int32_t) address : CLM_MIXED;
+      uint8_t read = NVFalse;
+
+
+      for (int32_t row = 0 ; row < pc ; row++)
+        {
+          double y = (double) lat + ((double) row + 0.5) / (double) pc;
+
+          int32_t num_spans = fill_spans (fill, y, (double) lon, (double) (lon + 1), spans);
+          if (!num_spans) continue;
+
+
+          //  Only uncompress the block if the polygon actually covers some of its cells.
+
+          if (code == CLM_MIXED && !read)
+            {
+              if (clm_read_block (in, lat, lon, bits) != CLM_MIXED)
+                {
+                  fprintf (stderr, "\nError reading block %d %d from %s\n", lat, lon, in->path);
+                  exit (-1);
+                }
+
+              read = NVTrue;
+            }
+
+          if (code == CLM_MIXED) clm_get_row (in, bits, row, words);
+
+
+          int32_t cells = 0, land = 0;
+
+          for (int32_t s = 0 ; s < num_spans ; s++)
+            {
+              int32_t first, last;
+
+              fill_span_cells (spans[2 * s], spans[2 * s + 1], (double) lon, pc, &first, &last);
+              if (last < first) continue;
+
+              cells += last - first + 1;
+
+              if (code == CLM_MIXED) land += clm_count_bits (words, first, last + 1);
+            }
+
+          if (!cells) continue;
+
+
+          double cell_area = clm_cell_area (in, lat, row);
+
+          switch (code)
+            {
+            case CLM_UNDEFINED:
+              area[ZONAL_UNDEFINED] += cell_area * (double) cells;
+              break;
+
+            case CLM_ALL_LAND:
+              area[ZONAL_LAND] += cell_area * (double) cells;
+              break;
+
+            case CLM_ALL_WATER:
+              area[ZONAL_WATER] += cell_area * (double) cells;
+              break;
+
+            default:
+              area[ZONAL_LAND] += cell_area * (double) land;
+              area[ZONAL_WATER] += cell_area * (double) (cells - land);
+              break;
+            }
+        }
+    }
+
+
+  free (spans);
+  free (bits);
+}
+
+
+
+static void zonal_usage ()
+{
+  fprintf (stderr, "Usage: swbd_mask zonal [-w] [-t NUM_THREADS] INPUT_CLM AOI_SHAPEFILE\n\n");
+  fprintf (stderr, "Where\n");
+  fprintf (stderr, "\t-w = use the nonzero winding rule (overlapping parts don't cancel)\n");
+  fprintf (stderr, "\t-t NUM_THREADS = number of compute threads (1 to %d, default 4)\n\n", CLM_MAX_THREADS);
+  fprintf (stderr, "Each polygon shape in AOI_SHAPEFILE (longitudes -180 to 180, parts are combined with the\n");
+  fprintf (stderr, "even-odd rule, or the nonzero rule with -w, so holes work) gets one line on standard output:\n\n");
+  fprintf (stderr, "\tSHAPE LAND_KM2 WATER_KM2 UNDEFINED_KM2 LAND_FRACTION\n\n");
+  fprintf (stderr, "LAND_FRACTION is land / (land + water) or -1 if there is neither.\n\n");
+  exit (-1);
+}
+
+
+
+/*!
+  - Zonal land/water statistics for the polygons in a shapefile.
+*/
+
+int32_t zonal (int32_t argc, char **argv)
+{
+  int32_t           num_threads = 4, c, numShapes, type, rule = FILL_EVEN_ODD;
+  double            minBounds[4], maxBounds[4], area[CLM_MAX_THREADS][3];
+  zonalThread       zonal_thread[CLM_MAX_THREADS];
+
+
+  while ((c = getopt (argc, argv, "wt:")) != EOF)
+    {
+      switch (c)
+        {
+        case 'w':
+          rule = FILL_NONZERO;
+          break;
+
+        case 't':
+          sscanf (optarg, "%d", &num_threads);
+          break;
+
+        default:
+          zonal_usage ();
+          break;
+        }
+    }
+
+
+  if (optind + 2 != argc || num_threads < 1 || num_threads > CLM_MAX_THREADS) zonal_usage ();
+
+
+  CLM_FILE *in = clm_open (argv[optind]);
+  if (in == NULL)
+    {
+      perror (argv[optind]);
+      exit (-1);
+    }
+
+  SHPHandle shpHandle = SHPOpen (argv[optind + 1], "rb");
+  if (shpHandle == NULL)
+    {
+      perror (argv[optind + 1]);
+      exit (-1);
+    }
+
+  SHPGetInfo (shpHandle, &numShapes, &type, minBounds, maxBounds);
+
+
+  int32_t *blocks = (int32_t *) malloc (CLM_BLOCKS * sizeof (int32_t));
+  if (blocks == NULL)
+    {
+      perror ("Allocating block list memory");
+      exit (-1);
+    }
+
+
+  for (int32_t i = 0 ; i < numShapes ; i++)
+    {
+      SHPObject *shape = SHPReadObject (shpHandle, i);
+      if (shape == NULL) continue;
+
+
+      //  Each part is a ring.
+
+      int32_t num_poly = qMax (1, shape->nParts);
+      int32_t *poly_count = (int32_t *) malloc (num_poly * sizeof (int32_t));
+      double **poly_x = (double **) malloc (num_poly * sizeof (double *));
+      double **poly_y = (double **) malloc (num_poly * sizeof (double *));
+      if (poly_count == NULL || poly_x == NULL || poly_y == NULL)
+        {
+          perror ("Allocating polygon memory");
+          exit (-1);
+        }
+
+      for (int32_t j = 0 ; j < num_poly ; j++)
+        {
+          int32_t start = shape->nParts ? shape->panPartStart[j] : 0;
+          int32_t end = (j + 1 < shape->nParts) ? shape->panPartStart[j + 1] : shape->nVertices;
+
+          poly_count[j] = end - start;
+          poly_x[j] = &shape->padfX[start];
+          poly_y[j] = &shape->padfY[start];
+        }
+
+      FILL_POLYGON *fill = fill_create (num_poly, poly_count, poly_x, poly_y);
+      if (fill == NULL)
+        {
+          perror ("Allocating fill memory");
+          exit (-1);
+        }
+
+      fill->rule = rule;
+
+      free (poly_count);
+      free (poly_x);
+      free (poly_y);
+
+
+      //  The blocks in the bounding box.
+
+      int32_t num_blocks = 0;
+
+      if (fill->min_y <= fill->max_y)
+        {
+          int32_t south = qMax (-90, (int32_t) floor (fill->min_y)), north = qMin (89, (int32_t) floor (fill->max_y));
+          int32_t west = qMax (-180, (int32_t) floor (fill->min_x)), east = qMin (179, (int32_t) floor (fill->max_x));
+
+          for (int32_t lat = south ; lat <= north ; lat++)
+            {
+              for (int32_t lon = west ; lon <= east ; lon++) blocks[num_blocks++] = clm_block_index (lat, lon);
+            }
+        }
+
+
+      QAtomicInt next (0);
+
+      for (int32_t j = 0 ; j < num_threads ; j++) zonal_thread[j].zonal (in, fill, blocks, num_blocks, area[j], &next);
+      for (int32_t j = 0 ; j < num_threads ; j++) zonal_thread[j].wait ();
+
+
+      double land = 0.0, water = 0.0, undefined = 0.0;
+
+      for (int32_t j = 0 ; j < num_threads ; j++)
+        {
+          land += area[j][ZONAL_LAND];
+          water += area[j][ZONAL_WATER];
+          undefined += area[j][ZONAL_UNDEFINED];
+        }
+
+      fprintf (stdout, "%d %.6f %.6f %.6f %.9f\n", i, land, water, undefined,
+               (land + water > 0.0) ? land / (land + water) : -1.0);
+      fflush (stdout);
+
+      fill_destroy (fill);
+      SHPDestroyObject (shape);
+    }
+
+
+  free (blocks);
+  SHPClose (shpHandle);
+  clm_close (in);
+
+  return (0);
+}